@@ -0,0 +1,40 @@
+/// \file Measures ssl accept throughput while stalled clients hold handshakes open
+#include <benchmark/benchmark.h>
+#include "BenchUtil.h"
+#include <SSLAcceptor.h>
+#include <Socket.h>
+#include <Address.h>
+#include <TlsContext.h>
+#include <future>
+#include <vector>
+
+constexpr auto connectionsPerIteration = 16;
+
+/**
+* Connects `connectionsPerIteration` clients per iteration while
+* `state.range(0)` clients sit in the middle of their handshake
+*/
+static void BM_AcceptStorm(benchmark::State& state) {
+    const auto port = next_port();
+    SSLAcceptor acceptor(Address(port), std::make_shared<TlsContext>(
+        BENCH_DATA_DIR "/cert.pem", BENCH_DATA_DIR "/key.pem"));
+    std::vector<TcpSocket> stalled;
+    for (auto i = 0; i < state.range(0); ++i)
+        stalled.emplace_back(Address("127.0.0.1", port));
+    const auto clientCtx = std::make_shared<TlsContext>();
+
+    std::vector<SSLSocket> accepted;
+    for (auto _ : state) {
+        auto clients = std::async(std::launch::async, [port, &clientCtx]() {
+            for (auto i = 0; i < connectionsPerIteration; ++i)
+                SSLSocket(Address("127.0.0.1", port), clientCtx);
+            });
+        while (accepted.size() < connectionsPerIteration)
+            acceptor.accept(accepted);
+        clients.get();
+        accepted.clear();
+    }
+    state.SetItemsProcessed(state.iterations() * connectionsPerIteration);
+    state.counters["pending"] = static_cast<double>(acceptor.pending());
+}
+BENCHMARK(BM_AcceptStorm)->Arg(0)->Arg(64)->Arg(1024)->UseRealTime();
@@ -0,0 +1,50 @@
+#include "BenchUtil.h"
+#include <Address.h>
+#include <atomic>
+#include <cstdlib>
+#include <future>
+#include <new>
+
+static std::atomic<size_t> allocations{ 0 };
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (auto ptr = std::malloc(size == 0 ? 1 : size))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+size_t allocation_count() noexcept {
+    return allocations.load(std::memory_order_relaxed);
+}
+
+std::pair<std::unique_ptr<SSLSocket>, std::unique_ptr<SSLSocket>> make_ssl_pair(port_t port,
+    bool ktls)
+{
+    auto serverCtx = std::make_shared<TlsContext>(BENCH_DATA_DIR "/cert.pem",
+        BENCH_DATA_DIR "/key.pem");
+    auto clientCtx = std::make_shared<TlsContext>();
+    if (ktls) {
+        serverCtx->enable_ktls();
+        clientCtx->enable_ktls();
+    }
+    SSLSocket server(Address(port), std::move(serverCtx));
+    auto fut = std::async(std::launch::async, [&server]() {
+        return std::make_unique<SSLSocket>(server.accept());
+    });
+    auto client = std::make_unique<SSLSocket>(Address("127.0.0.1", port), std::move(clientCtx));
+    return std::make_pair(std::move(client), fut.get());
+}
+
+port_t next_port() noexcept {
+    static port_t port = 6430;
+    return port++;
+}
@@ -0,0 +1,21 @@
+/// \file Shared helpers for benchmarks
+#pragma once
+#include <SSLSocket.h>
+#include <Networking.h>
+#include <memory>
+#include <utility>
+
+/// @return the amount of heap allocations made by the program so far
+size_t allocation_count() noexcept;
+
+/**
+* Connects a client ssl socket to a new server ssl socket over loopback
+* @param port the port to start the server on
+* @param ktls true to enable kernel TLS on both sides, see `TlsContext::enable_ktls`
+* @return a pair of the client socket and the server's connection to the client
+*/
+std::pair<std::unique_ptr<SSLSocket>, std::unique_ptr<SSLSocket>> make_ssl_pair(port_t port,
+    bool ktls = false);
+
+/// @return a new port that hasn't been used by the benchmark process yet
+port_t next_port() noexcept;
@@ -0,0 +1,67 @@
+/// \file Compares writing and reading messages in pieces through an ssl socket and through a buffered port
+#include <benchmark/benchmark.h>
+#include "BenchUtil.h"
+#include <BufferedPort.h>
+#include <string>
+#include <vector>
+
+/// A response head of 12 header lines and a small body, written a line at a time
+static const std::vector<std::string> responsePieces = [] {
+    std::vector<std::string> pieces{ "HTTP/1.1 200 OK\r\n" };
+    for (auto i = 0; i < 10; ++i)
+        pieces.push_back("X-Header-" + std::to_string(i) + ": some header value\r\n");
+    pieces.push_back("Content-Length: 64\r\n\r\n");
+    pieces.push_back(std::string(64, 'x'));
+    return pieces;
+}();
+
+static size_t response_size() {
+    size_t size = 0;
+    for (const auto& piece : responsePieces)
+        size += piece.size();
+    return size;
+}
+
+/// Writes every piece with its own `SSLSocket::write`, so every piece is a TLS record
+static void BM_WritePieces(benchmark::State& state) {
+    auto [client, server] = make_ssl_pair(next_port());
+    std::vector<char> buffer(response_size());
+    for (auto _ : state) {
+        for (const auto& piece : responsePieces)
+            server->write(piece);
+        client->read_into(buffer.data(), buffer.size(), buffer.size());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * buffer.size()));
+}
+BENCHMARK(BM_WritePieces)->UseRealTime();
+
+/// Writes the pieces to a buffered port, which sends them as one record
+static void BM_WritePiecesBuffered(benchmark::State& state) {
+    auto [client, server] = make_ssl_pair(next_port());
+    BufferedPort buffered(*server);
+    std::vector<char> buffer(response_size());
+    for (auto _ : state) {
+        for (const auto& piece : responsePieces)
+            buffered.write(piece);
+        buffered.flush();
+        client->read_into(buffer.data(), buffer.size(), buffer.size());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * buffer.size()));
+}
+BENCHMARK(BM_WritePiecesBuffered)->UseRealTime();
+
+/// Reads `state.range(0)` pipelined request heads sent at once, each up to its blank line
+static void BM_ReadUntil(benchmark::State& state) {
+    auto [client, server] = make_ssl_pair(next_port());
+    std::string requests;
+    for (auto i = 0; i < state.range(0); ++i)
+        requests += "GET /index.html HTTP/1.1\r\nHost: localhost\r\nAccept: */*\r\n\r\n";
+    BufferedPort buffered(*server);
+    for (auto _ : state) {
+        client->write(requests);
+        for (auto i = 0; i < state.range(0); ++i)
+            benchmark::DoNotOptimize(buffered.read_until("\r\n\r\n").data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * requests.size()));
+}
+BENCHMARK(BM_ReadUntil)->Arg(1)->Arg(16)->UseRealTime();
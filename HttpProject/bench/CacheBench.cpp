@@ -0,0 +1,144 @@
+/// \file Compares answering requests from the response cache with running the
+///   handler and composing the response
+#include <benchmark/benchmark.h>
+#include "BenchUtil.h"
+#include <ResponseCache.h>
+#include <HttpServer.h>
+#include <Socket.h>
+#include <Address.h>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// Builds a small JSON document, standing in for a handler doing some work
+void json_handler(const HttpRequestFrame& request, HttpResponseFrame& response) {
+    response[KnownHeader::ContentType] = "application/json";
+    response["Cache-Control"] = "max-age=60";
+    response.content = "{\"path\":\"";
+    response.content += request.path;
+    response.content += "\",\"items\":[";
+    for (auto i = 0; i < 32; ++i) {
+        if (i > 0)
+            response.content += ',';
+        response.content += std::to_string(i * 37);
+    }
+    response.content += "]}";
+    response[KnownHeader::ContentLength] = std::to_string(response.content.size());
+}
+
+/// @return a GET request for a path with a few typical headers
+HttpRequestFrame make_request(std::string path) {
+    HttpRequestFrame request;
+    request.protocol = HttpFrame::Protocol::GET;
+    request.path = std::move(path);
+    request["Host"] = "bench";
+    request["Accept-Encoding"] = "gzip";
+    return request;
+}
+
+static void BM_HandlerCompose(benchmark::State& state) {
+    const auto request = make_request("/items");
+    HttpResponseFrame response;
+    std::vector<std::string_view> views;
+    for (auto _ : state) {
+        response.headers().clear();
+        response.responseCode = HttpResponse::ok;
+        json_handler(request, response);
+        views.clear();
+        response.compose_views(views);
+        benchmark::DoNotOptimize(views.data());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_HandlerCompose);
+
+/// Cache shared by the threads of the lookup benchmark
+static std::unique_ptr<ResponseCache> sharedCache;
+
+/**
+* Looks up cached responses from `state.threads()` threads, each looking up
+* `state.range(0)` distinct keys, so 1 has every thread hit the same entry
+*/
+static void BM_CacheHit(benchmark::State& state) {
+    const auto now = ResponseCache::Clock::now();
+    if (state.thread_index() == 0) {
+        CacheOptions options;
+        options.varyHeaders = { "Accept-Encoding" };
+        sharedCache = std::make_unique<ResponseCache>(options);
+        std::string key;
+        for (auto i = 0; i < state.range(0); ++i) {
+            const auto request = make_request("/items/" + std::to_string(i));
+            HttpResponseFrame response;
+            response.responseCode = HttpResponse::ok;
+            json_handler(request, response);
+            sharedCache->make_key(request, key);
+            sharedCache->store(key, response, now);
+        }
+    }
+    std::vector<HttpRequestFrame> requests;
+    for (auto i = 0; i < state.range(0); ++i)
+        requests.push_back(make_request("/items/" + std::to_string(i)));
+    std::string key;
+    size_t next = static_cast<size_t>(state.thread_index());
+    const auto allocs = allocation_count();
+    for (auto _ : state) {
+        sharedCache->make_key(requests[next++ % requests.size()], key);
+        auto found = sharedCache->find(key, now);
+        benchmark::DoNotOptimize(found.get());
+    }
+    state.SetItemsProcessed(state.iterations());
+    if (state.thread_index() == 0) {
+        state.counters["allocs/iter"] = benchmark::Counter(
+            static_cast<double>(allocation_count() - allocs), benchmark::Counter::kAvgIterations);
+    }
+}
+BENCHMARK(BM_CacheHit)->Arg(1)->Arg(1024)->Threads(1)->Threads(4)->UseRealTime();
+
+/**
+* Sends pipelined requests for one path over 4 persistent connections to a server
+* with `state.range(0)` 1 to answer from a cache, 0 to call the handler every time
+*/
+static void BM_ServerCache(benchmark::State& state) {
+    constexpr auto clients = 4;
+    constexpr auto pipelined = 8;
+    constexpr std::string_view request = "GET /items HTTP/1.1\r\nHost: bench\r\n\r\n";
+    ServerOptions options;
+    options.port = next_port();
+    options.threads = 1;
+    options.maxRequestsPerConnection = 0;
+    if (state.range(0) != 0)
+        options.cache = std::make_shared<ResponseCache>();
+    HttpServer server(options, &json_handler);
+    server.start();
+    std::string requests;
+    for (auto i = 0; i < pipelined; ++i)
+        requests.append(request);
+    std::vector<std::unique_ptr<TcpSocket>> sockets;
+    for (auto c = 0; c < clients; ++c)
+        sockets.push_back(std::make_unique<TcpSocket>(Address("127.0.0.1", options.port)));
+    // every response is the same, so the responses are counted by their size
+    const auto responseSize = [&]() {
+        sockets.front()->write(request);
+        char buffer[1024];
+        return sockets.front()->read_into(buffer, sizeof(buffer));
+    }();
+    for (auto _ : state) {
+        std::vector<std::thread> threads;
+        for (auto& sock : sockets) {
+            threads.emplace_back([&sock, &requests, responseSize]() {
+                char buffer[16 * 1024];
+                for (auto i = 0; i < 32; i += pipelined) {
+                    sock->write(requests);
+                    size_t received = 0;
+                    while (received < responseSize * pipelined)
+                        received += sock->read_into(buffer, sizeof(buffer));
+                }
+                });
+        }
+        for (auto& thread : threads)
+            thread.join();
+    }
+    state.SetItemsProcessed(state.iterations() * clients * 32);
+}
+BENCHMARK(BM_ServerCache)->Arg(0)->Arg(1)->UseRealTime();
@@ -0,0 +1,73 @@
+/// \file Measures the throughput of the chunked transfer encoding codec
+#include <benchmark/benchmark.h>
+#include "../test/MockPort.h"
+#include <ChunkedCodec.h>
+#include <algorithm>
+#include <string>
+
+/// @return a chunked body of `size` bytes of payload in chunks of `chunkSize` bytes
+std::string make_body(size_t size, size_t chunkSize) {
+    std::string body;
+    testing::NiceMock<MockPort> port;
+    ON_CALL(port, write(testing::_)).WillByDefault([&body](std::string_view data) {
+        body.append(data);
+        });
+    ChunkedWriter writer(port, chunkSize);
+    writer.write(std::string(size, 'x'));
+    writer.finish();
+    return body;
+}
+
+constexpr size_t bodySize = 1 << 20;
+
+/// Decodes a body held in memory, `state.range(0)` is the chunk size
+static void BM_Decode(benchmark::State& state) {
+    const auto body = make_body(bodySize, static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        ChunkedDecoder decoder;
+        std::string_view input = body;
+        while (decoder.status() == ChunkedDecoder::Status::Incomplete)
+            benchmark::DoNotOptimize(decoder.decode(input));
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bodySize));
+}
+BENCHMARK(BM_Decode)->Arg(1024)->Arg(ChunkedWriter::recordChunkSize);
+
+/// Reads a body from a port in 16KB reads, `state.range(0)` is the chunk size
+static void BM_Read(benchmark::State& state) {
+    const auto body = make_body(bodySize, static_cast<size_t>(state.range(0)));
+    testing::NiceMock<MockPort> port;
+    size_t pos = 0;
+    ON_CALL(port, read_into(testing::_, testing::_, testing::_)).WillByDefault(
+        [&body, &pos](char* buffer, size_t size, size_t) {
+            const auto read = std::min(size, body.size() - pos);
+            std::copy_n(body.data() + pos, read, buffer);
+            pos += read;
+            return read;
+        });
+    for (auto _ : state) {
+        pos = 0;
+        ChunkedReader reader(port);
+        for (auto slice = reader.read(); !slice.empty(); slice = reader.read())
+            benchmark::DoNotOptimize(slice.data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bodySize));
+}
+BENCHMARK(BM_Read)->Arg(1024)->Arg(ChunkedWriter::recordChunkSize);
+
+/// Writes a body produced in 4KB pieces, `state.range(0)` is the chunk size
+static void BM_Write(benchmark::State& state) {
+    testing::NiceMock<MockPort> port;
+    ON_CALL(port, write(testing::_)).WillByDefault([](std::string_view data) {
+        benchmark::DoNotOptimize(data.data());
+        });
+    const std::string piece(4096, 'x');
+    for (auto _ : state) {
+        ChunkedWriter writer(port, static_cast<size_t>(state.range(0)));
+        for (size_t written = 0; written < bodySize; written += piece.size())
+            writer.write(piece);
+        writer.finish();
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bodySize));
+}
+BENCHMARK(BM_Write)->Arg(1024)->Arg(ChunkedWriter::recordChunkSize);
@@ -0,0 +1,110 @@
+/// \file Compares sending responses composed into one string with vectored writes
+#include <benchmark/benchmark.h>
+#include "BenchUtil.h"
+#include <HttpResponseFrame.h>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+/// @return a response with typical headers and a body of `bodySize` bytes
+HttpResponseFrame make_response(size_t bodySize) {
+    HttpResponseFrame frame;
+    frame.responseCode = HttpResponse::ok;
+    frame[KnownHeader::ContentType] = "application/octet-stream";
+    frame[KnownHeader::ContentLength] = std::to_string(bodySize);
+    frame["Cache-Control"] = "max-age=3600";
+    frame["Server"] = "HttpProject";
+    frame.content.assign(bodySize, 'x');
+    return frame;
+}
+
+/// Sets up a loopback ssl connection whose server side discards everything it reads
+struct WriteFixture {
+    std::unique_ptr<SSLSocket> client, server;
+    std::thread drain;
+    HttpResponseFrame frame;
+
+    explicit WriteFixture(const benchmark::State& state) :
+        frame(make_response(static_cast<size_t>(state.range(0))))
+    {
+        std::tie(client, server) = make_ssl_pair(next_port());
+        drain = std::thread([this]() {
+            std::vector<char> buffer(65536);
+            try {
+                for (;;)
+                    server->read_into(buffer.data(), buffer.size());
+            }
+            catch (const std::runtime_error&) {} // the client closed the connection
+            });
+    }
+
+    ~WriteFixture() {
+        client.reset();
+        drain.join();
+    }
+
+    /// Reports the allocations made per iteration and the bytes written
+    void report(benchmark::State& state, size_t allocsBefore) {
+        state.counters["allocs/iter"] = benchmark::Counter(
+            static_cast<double>(allocation_count() - allocsBefore),
+            benchmark::Counter::kAvgIterations);
+        state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * frame.compose().size()));
+    }
+};
+
+/// Composes the frame into one string, without sending it
+static void BM_Compose(benchmark::State& state) {
+    auto frame = make_response(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        auto data = frame.compose();
+        benchmark::DoNotOptimize(data.data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * frame.compose().size()));
+}
+BENCHMARK(BM_Compose)->Arg(1024)->Arg(65536);
+
+/// Composes the frame into buffers referring to it, without sending it
+static void BM_ComposeViews(benchmark::State& state) {
+    const auto frame = make_response(static_cast<size_t>(state.range(0)));
+    std::vector<std::string_view> views;
+    for (auto _ : state) {
+        views.clear();
+        frame.compose_views(views);
+        benchmark::DoNotOptimize(views.data());
+    }
+}
+BENCHMARK(BM_ComposeViews)->Arg(1024)->Arg(65536);
+
+static void BM_ComposeAndWrite(benchmark::State& state) {
+    WriteFixture f(state);
+    const auto allocs = allocation_count();
+    for (auto _ : state) {
+        f.client->write(f.frame.compose());
+    }
+    f.report(state, allocs);
+}
+BENCHMARK(BM_ComposeAndWrite)->Arg(1024)->Arg(65536)->Arg(2 << 20)->UseRealTime();
+
+static void BM_WriteFrame(benchmark::State& state) {
+    WriteFixture f(state);
+    const auto allocs = allocation_count();
+    for (auto _ : state) {
+        write_frame(*f.client, f.frame);
+    }
+    f.report(state, allocs);
+}
+BENCHMARK(BM_WriteFrame)->Arg(1024)->Arg(65536)->Arg(2 << 20)->UseRealTime();
+
+/// Writes each piece of the frame on its own, like `Port::writev` does by default
+static void BM_WritePieces(benchmark::State& state) {
+    WriteFixture f(state);
+    std::vector<std::string_view> views;
+    for (auto _ : state) {
+        views.clear();
+        f.frame.compose_views(views);
+        for (const auto view : views)
+            f.client->write(view);
+    }
+    f.report(state, 0);
+}
+BENCHMARK(BM_WritePieces)->Arg(1024)->Arg(65536)->UseRealTime();
@@ -0,0 +1,76 @@
+/// \file Measures compressing response bodies, and serving compressed copies of files
+#include <benchmark/benchmark.h>
+#include "BenchUtil.h"
+#include <ContentEncoding.h>
+#include <MappedFile.h>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <zlib.h>
+
+/// @return `size` bytes of html-like text
+static std::string make_page(size_t size) {
+    std::mt19937 rng(3);
+    const std::string_view pieces[] = { "<div class=\"item\">", "</div>\n", "<a href=\"/path\">",
+        "</a>", "some text ", "other words ", "<span>", "</span>" };
+    std::string page;
+    while (page.size() < size)
+        page += pieces[rng() % 8];
+    page.resize(size);
+    return page;
+}
+
+/// Compresses a body of `state.range(0)` bytes at level `state.range(1)`, reusing the thread's state
+static void BM_Compress(benchmark::State& state) {
+    const auto page = make_page(static_cast<size_t>(state.range(0)));
+    std::string out;
+    const auto allocs = allocation_count();
+    for (auto _ : state) {
+        Compressor(ContentCoding::Gzip, static_cast<int>(state.range(1))).compress_all(page, out);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.counters["allocs/iter"] = benchmark::Counter(
+        static_cast<double>(allocation_count() - allocs), benchmark::Counter::kAvgIterations);
+    state.counters["ratio"] = static_cast<double>(page.size()) / static_cast<double>(out.size());
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * page.size()));
+}
+BENCHMARK(BM_Compress)->Args({ 4096, 6 })->Args({ 65536, 1 })->Args({ 65536, 6 })
+    ->Args({ 65536, 9 });
+
+/// Like `BM_Compress` with new zlib state for each body, as compressing without reuse would
+static void BM_CompressFreshState(benchmark::State& state) {
+    const auto page = make_page(static_cast<size_t>(state.range(0)));
+    std::string out(compressBound(static_cast<uLong>(page.size())) + 32, '\0');
+    for (auto _ : state) {
+        z_stream stream{};
+        deflateInit2(&stream, static_cast<int>(state.range(1)), Z_DEFLATED, 15 + 16, 8,
+            Z_DEFAULT_STRATEGY);
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(page.data()));
+        stream.avail_in = static_cast<uInt>(page.size());
+        stream.next_out = reinterpret_cast<Bytef*>(out.data());
+        stream.avail_out = static_cast<uInt>(out.size());
+        deflate(&stream, Z_FINISH);
+        deflateEnd(&stream);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * page.size()));
+}
+BENCHMARK(BM_CompressFreshState)->Args({ 4096, 6 })->Args({ 65536, 6 });
+
+/// Gets the compressed copy of a file of `state.range(0)` bytes, which is compressed once
+static void BM_CompressedFileHit(benchmark::State& state) {
+    const auto path = std::filesystem::temp_directory_path() /
+        ("CompressionBench" + std::to_string(next_port()) + ".html");
+    const auto page = make_page(static_cast<size_t>(state.range(0)));
+    std::ofstream(path, std::ios::binary).write(page.data(), static_cast<std::streamsize>(page.size()));
+    const auto file = std::make_shared<const MappedFile>(path.string());
+    CompressedFiles files(64 * 1024 * 1024);
+    for (auto _ : state) {
+        auto data = files.get(file, 0, file->size(), ContentCoding::Gzip, 6);
+        benchmark::DoNotOptimize(data.get());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * page.size()));
+    std::filesystem::remove(path);
+}
+BENCHMARK(BM_CompressedFileHit)->Arg(65536);
@@ -0,0 +1,98 @@
+/// \file Benchmarks waiting on large fd sets where only a few fds are active
+#include <benchmark/benchmark.h>
+#include <FdSet.h>
+#include <Networking.h>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+constexpr auto activeCount = 100;
+
+/**
+* A set of idle sockets which never have activity and a set of
+* connected socket pairs which always have data waiting to be read
+*/
+class SocketPool {
+    std::vector<socket_t> idle;
+    std::vector<std::pair<socket_t, socket_t>> active;
+public:
+    SocketPool(size_t idleCount, size_t activeCount) {
+        // udp sockets only use one fd each, letting us stay under the fd limit
+        for (size_t i = 0; i < idleCount; ++i) {
+            const auto s = socket(AF_INET, SOCK_DGRAM, 0);
+            if (s == INVALID_SOCKET)
+                throw std::runtime_error("Could not create idle socket, is the fd limit too low?");
+            idle.push_back(s);
+        }
+        for (size_t i = 0; i < activeCount; ++i) {
+            socket_t fds[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+                throw std::runtime_error("Could not create active socket pair");
+            sock_block(fds[0], false);
+            active.emplace_back(fds[0], fds[1]);
+        }
+    }
+
+    ~SocketPool() {
+        for (auto s : idle)
+            close(s);
+        for (auto [a, b] : active) {
+            close(a);
+            close(b);
+        }
+    }
+
+    /// Adds all sockets that can receive data to the set
+    void add_to(FdSet& set) const {
+        for (auto s : idle)
+            set.add(s);
+        for (auto [s, peer] : active)
+            set.add(s);
+    }
+
+    /// Sends a byte to every active socket
+    void signal() const {
+        for (auto [s, peer] : active)
+            ::write(peer, "x", 1);
+    }
+
+    /// Reads all pending data from the active sockets
+    void drain() const {
+        char buf[64];
+        for (auto [s, peer] : active)
+            while (::read(s, buf, sizeof(buf)) > 0);
+    }
+};
+
+/// Level triggered wait with the active sockets always ready
+static void BM_WaitLevel(benchmark::State& state) {
+    SocketPool pool(static_cast<size_t>(state.range(0)), activeCount);
+    FdSet set;
+    pool.add_to(set);
+    pool.signal();
+    size_t handled = 0;
+    for (auto _ : state) {
+        FdSet::wait(ReadSet{ set });
+        for (auto fd : set.ready())
+            handled += set.is_set(fd);
+    }
+    benchmark::DoNotOptimize(handled);
+    state.SetItemsProcessed(static_cast<int64_t>(handled));
+}
+BENCHMARK(BM_WaitLevel)->Arg(0)->Arg(1000)->Arg(10000);
+
+/// Edge triggered wait where every iteration signals, waits on and drains the active sockets
+static void BM_WaitEdge(benchmark::State& state) {
+    SocketPool pool(static_cast<size_t>(state.range(0)), activeCount);
+    FdSet set(Trigger::Edge);
+    pool.add_to(set);
+    size_t handled = 0;
+    for (auto _ : state) {
+        pool.signal();
+        FdSet::wait(ReadSet{ set });
+        handled += set.ready().size();
+        pool.drain();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(handled));
+}
+BENCHMARK(BM_WaitEdge)->Arg(0)->Arg(1000)->Arg(10000);
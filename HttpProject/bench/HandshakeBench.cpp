@@ -0,0 +1,35 @@
+/// \file Compares full tls handshakes with resumed ones
+#include <benchmark/benchmark.h>
+#include "BenchUtil.h"
+#include <Address.h>
+#include <TlsContext.h>
+#include <future>
+
+/**
+* Connects to a server and reads a byte from it, which also receives the session tickets
+* Resumes sessions when `state.range(0)` is not 0, otherwise every connection uses
+* a new client context and does a full handshake
+*/
+static void BM_Handshake(benchmark::State& state) {
+    const auto port = next_port();
+    const auto serverCtx = std::make_shared<TlsContext>(BENCH_DATA_DIR "/cert.pem",
+        BENCH_DATA_DIR "/key.pem");
+    SSLSocket server(Address(port), serverCtx);
+    const auto resume = state.range(0) != 0;
+    auto clientCtx = std::make_shared<TlsContext>();
+
+    for (auto _ : state) {
+        auto fut = std::async(std::launch::async, [&server]() {
+            auto connection = server.accept();
+            connection.write("x");
+            return connection;
+            });
+        if (!resume)
+            clientCtx = std::make_shared<TlsContext>();
+        SSLSocket client(Address("127.0.0.1", port), clientCtx);
+        benchmark::DoNotOptimize(client.read(1));
+        fut.get();
+    }
+    state.counters["resumption hit rate"] = serverCtx->stats().hit_rate();
+}
+BENCHMARK(BM_Handshake)->Arg(0)->Arg(1);
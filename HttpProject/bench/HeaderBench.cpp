@@ -0,0 +1,149 @@
+/// \file Compares the cost of looking up headers in different header maps
+#include <benchmark/benchmark.h>
+#include <HttpHeaders.h>
+#include <HttpRequestFrame.h>
+#include <algorithm>
+#include <cctype>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/// Headers of a typical request
+const std::pair<std::string, std::string> requestHeaders[] = {
+    { "Host", "www.example.com" },
+    { "User-Agent", "Mozilla/5.0 (X11; Linux x86_64; rv:109.0) Gecko/20100101 Firefox/115.0" },
+    { "Accept", "text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8" },
+    { "Accept-Language", "en-US,en;q=0.5" },
+    { "Accept-Encoding", "gzip, deflate, br" },
+    { "Referer", "https://www.example.com/" },
+    { "Connection", "keep-alive" },
+    { "Cookie", "session=0123456789abcdef" },
+    { "Content-Type", "application/json" },
+    { "Content-Length", "1024" },
+};
+
+/// @return true if `a` and `b` are equal ignoring case, using the C locale functions
+bool tolower_equals(std::string_view a, std::string_view b) {
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(),
+        [](char x, char y) {
+            return std::tolower(static_cast<unsigned char>(x))
+                == std::tolower(static_cast<unsigned char>(y));
+        });
+}
+
+/// The header storage HttpFrame used before HttpHeaders
+struct LinearHeaders {
+    std::vector<std::pair<std::string, std::string>> headers;
+
+    const std::string* find(std::string_view name) const {
+        const auto it = std::find_if(headers.begin(), headers.end(), [name](const auto& h) {
+            return tolower_equals(h.first, name);
+            });
+        return it == headers.end() ? nullptr : &it->second;
+    }
+};
+
+struct CaseInsensitiveLess {
+    bool operator()(const std::string& a, const std::string& b) const {
+        return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end(),
+            [](char x, char y) { return detail::ascii_lower(x) < detail::ascii_lower(y); });
+    }
+};
+
+struct CaseInsensitiveHash {
+    size_t operator()(const std::string& s) const noexcept {
+        return header_hash(s);
+    }
+};
+
+struct CaseInsensitiveEqual {
+    bool operator()(const std::string& a, const std::string& b) const noexcept {
+        return detail::iequals(a, b);
+    }
+};
+
+/// Looks up a known and an unknown header, `state.range(0)` selects which
+template<class Map>
+void lookup(benchmark::State& state, const Map& map) {
+    // the request keys are held as std::string like a caller of HttpFrame::operator[] would
+    const std::string name = state.range(0) ? "accept-language" : "content-length";
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(map.find(name));
+    }
+}
+
+static void BM_LookupLinear(benchmark::State& state) {
+    LinearHeaders headers;
+    for (const auto& header : requestHeaders)
+        headers.headers.push_back(header);
+    lookup(state, headers);
+}
+BENCHMARK(BM_LookupLinear)->Arg(0)->Arg(1);
+
+static void BM_LookupMap(benchmark::State& state) {
+    std::map<std::string, std::string, CaseInsensitiveLess> headers(
+        std::begin(requestHeaders), std::end(requestHeaders));
+    lookup(state, headers);
+}
+BENCHMARK(BM_LookupMap)->Arg(0)->Arg(1);
+
+static void BM_LookupUnorderedMap(benchmark::State& state) {
+    std::unordered_map<std::string, std::string, CaseInsensitiveHash, CaseInsensitiveEqual>
+        headers(std::begin(requestHeaders), std::end(requestHeaders));
+    lookup(state, headers);
+}
+BENCHMARK(BM_LookupUnorderedMap)->Arg(0)->Arg(1);
+
+static void BM_LookupHttpHeaders(benchmark::State& state) {
+    HttpHeaders headers;
+    for (const auto& [name, value] : requestHeaders)
+        headers[name] = value;
+    lookup(state, headers);
+}
+BENCHMARK(BM_LookupHttpHeaders)->Arg(0)->Arg(1);
+
+static void BM_LookupKnownSlot(benchmark::State& state) {
+    HttpHeaders headers;
+    for (const auto& [name, value] : requestHeaders)
+        headers[name] = value;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(headers.find(KnownHeader::ContentLength));
+    }
+}
+BENCHMARK(BM_LookupKnownSlot);
+
+/// Looks up headers through the frame API handlers use, present and missing ones
+static void BM_LookupFrame(benchmark::State& state) {
+    HttpRequestFrame frame;
+    for (const auto& [name, value] : requestHeaders)
+        frame[name] = value;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(frame.get(KnownHeader::ContentLength).size());
+        benchmark::DoNotOptimize(frame.get("Accept-Language").size());
+        benchmark::DoNotOptimize(frame.has_header("X-Request-Id"));
+    }
+}
+BENCHMARK(BM_LookupFrame);
+
+/// Builds the header map of a request from scratch
+static void BM_InsertHttpHeaders(benchmark::State& state) {
+    for (auto _ : state) {
+        HttpHeaders headers;
+        for (const auto& [name, value] : requestHeaders)
+            headers[name] = value;
+        benchmark::DoNotOptimize(headers.size());
+    }
+}
+BENCHMARK(BM_InsertHttpHeaders);
+
+static void BM_InsertLinear(benchmark::State& state) {
+    for (auto _ : state) {
+        LinearHeaders headers;
+        for (const auto& header : requestHeaders)
+            headers.headers.push_back(header);
+        benchmark::DoNotOptimize(headers.headers.size());
+    }
+}
+BENCHMARK(BM_InsertLinear);
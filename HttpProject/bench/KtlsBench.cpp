@@ -0,0 +1,36 @@
+/// \file Compares the throughput of ssl sockets encrypting in user space and with kernel TLS
+#include <benchmark/benchmark.h>
+#include "BenchUtil.h"
+#include <string>
+#include <vector>
+
+/// Sends small segments right away, which the ping-pong of the benchmark would otherwise
+/// hold until the delayed acknowledgement of the previous one
+static void set_nodelay(SSLSocket& sock) {
+    const int on = 1;
+    setsockopt(static_cast<socket_t>(sock.handle()), IPPROTO_TCP, TCP_NODELAY,
+        reinterpret_cast<const char*>(&on), sizeof(on));
+}
+
+/**
+* Sends `state.range(0)` bytes from the server to the client and back, with kernel TLS
+* if `state.range(1)` is 1. Where the kernel lacks the tls module, both runs encrypt in
+* user space and the `ktls_send` and `ktls_receive` counters are 0
+*/
+static void BM_TlsThroughput(benchmark::State& state) {
+    auto [client, server] = make_ssl_pair(next_port(), state.range(1) != 0);
+    set_nodelay(*client);
+    set_nodelay(*server);
+    const std::string data(static_cast<size_t>(state.range(0)), 'x');
+    std::vector<char> buffer(data.size());
+    for (auto _ : state) {
+        server->write(data);
+        client->read_into(buffer.data(), buffer.size(), buffer.size());
+        client->write(data);
+        server->read_into(buffer.data(), buffer.size(), buffer.size());
+    }
+    state.counters["ktls_send"] = server->ktls().send;
+    state.counters["ktls_receive"] = client->ktls().receive;
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * data.size() * 2));
+}
+BENCHMARK(BM_TlsThroughput)->ArgsProduct({ { 1024, 16384, 65536 }, { 0, 1 } })->UseRealTime();
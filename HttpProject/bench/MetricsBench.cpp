@@ -0,0 +1,102 @@
+/// \file Measures what the server metrics cost per request
+#include <benchmark/benchmark.h>
+#include "BenchUtil.h"
+#include <HttpServer.h>
+#include <Metrics.h>
+#include <Socket.h>
+#include <Address.h>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// Adds to a counter, as the server does for every read, write and request
+static void BM_CounterAdd(benchmark::State& state) {
+    MetricCounter counter;
+    for (auto _ : state) {
+        counter.add(128);
+        benchmark::DoNotOptimize(counter);
+    }
+}
+BENCHMARK(BM_CounterAdd);
+
+/// Times a phase, as the server does for parsing and every handler call
+static void BM_TimedPhase(benchmark::State& state) {
+    MetricHistogram histogram;
+    for (auto _ : state) {
+        const auto start = std::chrono::steady_clock::now();
+        histogram.record(std::chrono::steady_clock::now() - start);
+    }
+    benchmark::DoNotOptimize(histogram.snapshot());
+}
+BENCHMARK(BM_TimedPhase);
+
+/// Adds up the metrics of a server and formats them, as a scrape of the metrics path does
+static void BM_Scrape(benchmark::State& state) {
+    ServerOptions options;
+    options.port = next_port();
+    options.threads = static_cast<unsigned>(state.range(0));
+    HttpServer server(options, [](const HttpRequestFrame&, HttpResponseFrame&) {});
+    std::string out;
+    for (auto _ : state) {
+        out.clear();
+        server.metrics().write_prometheus(out);
+        benchmark::DoNotOptimize(out.data());
+    }
+}
+BENCHMARK(BM_Scrape)->Arg(1)->Arg(4);
+
+/**
+* Sends requests over persistent connections to a server with one worker thread,
+* which times one in `state.range(0)` requests, or none for 0. The difference in time
+* per request is the overhead of timing parsing and handlers, the counters are always kept
+*/
+static void BM_ServerTimings(benchmark::State& state) {
+    constexpr auto clients = 4;
+    constexpr auto requestsPerClient = 64;
+    constexpr auto pipelined = 4;
+    ServerOptions options;
+    options.port = next_port();
+    options.threads = 1;
+    options.maxRequestsPerConnection = 0;
+    options.timingInterval = static_cast<unsigned>(state.range(0));
+    HttpServer server(options, [](const HttpRequestFrame&, HttpResponseFrame& response) {
+        response.content = "hello";
+    });
+    server.start();
+    std::string requests;
+    for (auto i = 0; i < pipelined; ++i)
+        requests.append("GET /bench HTTP/1.1\r\nHost: bench\r\n\r\n");
+
+    std::vector<std::unique_ptr<TcpSocket>> sockets;
+    for (auto c = 0; c < clients; ++c)
+        sockets.push_back(std::make_unique<TcpSocket>(Address("127.0.0.1", options.port)));
+    const auto responseSize = [&]() {
+        sockets.front()->write("GET /bench HTTP/1.1\r\nHost: bench\r\n\r\n");
+        char buffer[512];
+        return sockets.front()->read_into(buffer, sizeof(buffer));
+    }();
+    for (auto _ : state) {
+        std::vector<std::thread> threads;
+        for (auto& socket : sockets) {
+            threads.emplace_back([&socket, &requests, responseSize]() {
+                char buffer[16 * 1024];
+                for (auto i = 0; i < requestsPerClient; i += pipelined) {
+                    socket->write(requests);
+                    size_t received = 0;
+                    while (received < responseSize * pipelined)
+                        received += socket->read_into(buffer, sizeof(buffer));
+                }
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+    }
+    state.SetItemsProcessed(state.iterations() * clients * requestsPerClient);
+    const auto metrics = server.metrics();
+    state.counters["handler_us"] = metrics.handlerTime.count == 0 ? 0
+        : static_cast<double>(metrics.handlerTime.sum) / 1e3
+            / static_cast<double>(metrics.handlerTime.count);
+}
+BENCHMARK(BM_ServerTimings)->Arg(0)->Arg(1)->Arg(16)->UseRealTime();
@@ -0,0 +1,89 @@
+/// \file Measures the throughput of parsing HTTP request heads
+#include <benchmark/benchmark.h>
+#include "BenchUtil.h"
+#include <HttpRequestParser.h>
+#include <HttpRequestFrame.h>
+#include <string>
+
+/// A request head as sent by a browser
+constexpr std::string_view browserRequest =
+    "GET /wp-content/uploads/2010/03/hello-kitty-darth-vader-pink.jpg HTTP/1.1\r\n"
+    "Host: www.kittyhell.com\r\n"
+    "User-Agent: Mozilla/5.0 (Macintosh; U; Intel Mac OS X 10.6; ja-JP-mac; rv:1.9.2.3) "
+    "Gecko/20100401 Firefox/3.6.3 Pathtraq/0.9\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+    "Accept-Language: ja,en-us;q=0.7,en;q=0.3\r\n"
+    "Accept-Encoding: gzip,deflate\r\n"
+    "Accept-Charset: Shift_JIS,utf-8;q=0.7,*;q=0.7\r\n"
+    "Keep-Alive: 115\r\n"
+    "Connection: keep-alive\r\n"
+    "Cookie: wp_ozh_wsa_visits=2; wp_ozh_wsa_visit_lasttime=xxxxxxxxxx; "
+    "__utma=xxxxxxxxx.xxxxxxxxxx.xxxxxxxxxx.xxxxxxxxxx.xxxxxxxxxx.x; "
+    "__utmz=xxxxxxxxx.xxxxxxxxxx.x.x.utmccn=(referral)|utmcsr=reader.livedoor.com"
+    "|utmcct=/reader/|utmcmd=referral\r\n"
+    "\r\n";
+
+/// A minimal request head, as sent by load generators
+constexpr std::string_view shortRequest =
+    "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n";
+
+/// Parses a whole request per iteration, `state.range(0)` selects the short request
+static void BM_ParseRequest(benchmark::State& state) {
+    const auto request = state.range(0) ? shortRequest : browserRequest;
+    HttpRequestParser parser;
+    const auto allocs = allocation_count();
+    for (auto _ : state) {
+        parser.feed(request);
+        if (parser.parse() != HttpRequestParser::Status::Done)
+            state.SkipWithError("Failed to parse");
+        benchmark::DoNotOptimize(parser.find("host"));
+        parser.consume();
+    }
+    state.counters["allocs/iter"] = benchmark::Counter(
+        static_cast<double>(allocation_count() - allocs), benchmark::Counter::kAvgIterations);
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * request.size());
+}
+BENCHMARK(BM_ParseRequest)->Arg(0)->Arg(1);
+
+/// Parses a request arriving in `state.range(0)` byte fragments
+static void BM_ParseFragmented(benchmark::State& state) {
+    const auto fragment = static_cast<size_t>(state.range(0));
+    HttpRequestParser parser;
+    for (auto _ : state) {
+        for (size_t i = 0; i < browserRequest.size(); i += fragment) {
+            parser.feed(browserRequest.substr(i, fragment));
+            benchmark::DoNotOptimize(parser.parse());
+        }
+        parser.consume();
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * browserRequest.size());
+}
+BENCHMARK(BM_ParseFragmented)->Arg(16)->Arg(128);
+
+/// Parses a request and copies it into an HttpRequestFrame
+static void BM_ParseAndFill(benchmark::State& state) {
+    HttpRequestParser parser;
+    for (auto _ : state) {
+        parser.feed(browserRequest);
+        parser.parse();
+        HttpRequestFrame frame;
+        parser.fill(frame);
+        benchmark::DoNotOptimize(frame.path.data());
+        parser.consume();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ParseAndFill);
+
+/// Scans a line of `state.range(0)` bytes for its end
+static void BM_FindLineEnd(benchmark::State& state) {
+    std::string line(static_cast<size_t>(state.range(0)), 'x');
+    line += "\r\n";
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(find_line_end(line.data(), line.data() + line.size()));
+    }
+    state.SetBytesProcessed(state.iterations() * line.size());
+}
+BENCHMARK(BM_FindLineEnd)->Arg(16)->Arg(64)->Arg(1024);
@@ -0,0 +1,90 @@
+/// \file Compares the allocating and buffer filling read calls of ports
+#include <benchmark/benchmark.h>
+#include "BenchUtil.h"
+#include <vector>
+
+/// Sets up a loopback ssl connection and a payload of `state.range(0)` bytes
+struct ReadFixture {
+    std::unique_ptr<SSLSocket> client, server;
+    std::vector<char> payload;
+
+    explicit ReadFixture(const benchmark::State& state) :
+        payload(static_cast<size_t>(state.range(0)), 'x')
+    {
+        std::tie(client, server) = make_ssl_pair(next_port());
+    }
+
+    /// Reports the allocations made per iteration and the bytes read
+    void report(benchmark::State& state, size_t allocsBefore) const {
+        state.counters["allocs/iter"] = benchmark::Counter(
+            static_cast<double>(allocation_count() - allocsBefore),
+            benchmark::Counter::kAvgIterations);
+        state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * payload.size()));
+    }
+};
+
+static void BM_ReadVector(benchmark::State& state) {
+    ReadFixture f(state);
+    const auto allocs = allocation_count();
+    for (auto _ : state) {
+        f.client->write({ f.payload.data(), f.payload.size() });
+        auto data = f.server->read(f.payload.size());
+        benchmark::DoNotOptimize(data.data());
+    }
+    f.report(state, allocs);
+}
+BENCHMARK(BM_ReadVector)->Arg(64)->Arg(1024)->Arg(16384)->Arg(65536);
+
+static void BM_ReadInto(benchmark::State& state) {
+    ReadFixture f(state);
+    std::vector<char> buffer(f.payload.size());
+    const auto allocs = allocation_count();
+    for (auto _ : state) {
+        f.client->write({ f.payload.data(), f.payload.size() });
+        f.server->read_into(buffer.data(), buffer.size(), buffer.size());
+        benchmark::DoNotOptimize(buffer.data());
+    }
+    f.report(state, allocs);
+}
+BENCHMARK(BM_ReadInto)->Arg(64)->Arg(1024)->Arg(16384)->Arg(65536);
+
+static void BM_TryReadVector(benchmark::State& state) {
+    ReadFixture f(state);
+    const auto allocs = allocation_count();
+    for (auto _ : state) {
+        f.client->write({ f.payload.data(), f.payload.size() });
+        size_t read = 0;
+        while (read < f.payload.size())
+            read += f.server->try_read().size();
+    }
+    f.report(state, allocs);
+}
+BENCHMARK(BM_TryReadVector)->Arg(64)->Arg(1024)->Arg(16384);
+
+static void BM_TryReadInto(benchmark::State& state) {
+    ReadFixture f(state);
+    std::vector<char> buffer(f.payload.size());
+    const auto allocs = allocation_count();
+    for (auto _ : state) {
+        f.client->write({ f.payload.data(), f.payload.size() });
+        size_t read = 0;
+        while (read < f.payload.size())
+            read += f.server->try_read_into(buffer.data() + read, buffer.size() - read);
+    }
+    f.report(state, allocs);
+}
+BENCHMARK(BM_TryReadInto)->Arg(64)->Arg(1024)->Arg(16384);
+
+/// Sends a payload and has the server echo it back, the latency of one exchange
+static void BM_RoundTrip(benchmark::State& state) {
+    ReadFixture f(state);
+    std::vector<char> buffer(f.payload.size());
+    for (auto _ : state) {
+        f.client->write({ f.payload.data(), f.payload.size() });
+        f.server->read_into(buffer.data(), buffer.size(), buffer.size());
+        f.server->write({ buffer.data(), buffer.size() });
+        f.client->read_into(buffer.data(), buffer.size(), buffer.size());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * 2 * f.payload.size()));
+}
+BENCHMARK(BM_RoundTrip)->Arg(64)->Arg(1024)->Arg(16384)->UseRealTime();
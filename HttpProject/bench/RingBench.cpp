@@ -0,0 +1,142 @@
+/// \file Compares echo servers on a scheduler using io_uring and one waiting with FdSet
+#include <benchmark/benchmark.h>
+#include "BenchUtil.h"
+#include <Scheduler.h>
+#include <IoUring.h>
+#include <Socket.h>
+#include <SSLSocket.h>
+#include <Address.h>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <csignal>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+constexpr std::string_view message = "sixteen bytes!!\n";
+
+/// Echoes what a connection sends until it closes
+template<class Sock>
+Task<void> echo(Sock connection) {
+    char buffer[64];
+    try {
+        for (;;) {
+            const auto read = co_await connection.async_read(buffer, sizeof(buffer));
+            co_await connection.async_write({ buffer, read });
+        }
+    }
+    catch (const std::runtime_error&) {}
+}
+
+template<class Sock>
+Task<void> echo_server(Scheduler& scheduler, const Sock& listener) {
+    for (;;)
+        scheduler.spawn(echo(co_await listener.async_accept()));
+}
+
+/**
+* Runs an echo server in a child process, so the server's connections and the
+* benchmark's clients each have the whole fd limit
+*/
+class ServerProcess {
+    pid_t pid;
+public:
+    template<class Sock>
+    ServerProcess(SchedulerBackend backend, Sock&& listener) {
+        pid = fork();
+        if (pid < 0)
+            throw std::runtime_error("Could not start the server process");
+        if (pid == 0) {
+            try {
+                Scheduler scheduler(backend);
+                scheduler.spawn(echo_server(scheduler, listener));
+                scheduler.run();
+            }
+            catch (...) {}
+            _exit(0);
+        }
+    }
+
+    ~ServerProcess() {
+        kill(pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+    }
+};
+
+/// Raises the fd limit as far as it goes, 10k connections need more than the usual soft limit
+static void raise_fd_limit() {
+    rlimit limit{};
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+/**
+* Sends a message on each of `state.range(0)` connections per iteration and reads the
+* echoes, from a server with the backend `Backend`
+*/
+template<SchedulerBackend Backend>
+static void BM_Echo(benchmark::State& state) {
+    if (Backend == SchedulerBackend::IoUring && !IoUring::supported())
+        return state.SkipWithError("io_uring isn't supported");
+    raise_fd_limit();
+    const auto port = next_port();
+    std::unique_ptr<ServerProcess> server;
+    {
+        // the listener is only kept open by the server process
+        TcpSocket listener(Address{ port });
+        server = std::make_unique<ServerProcess>(Backend, std::move(listener));
+    }
+    std::vector<TcpSocket> clients;
+    try {
+        for (auto i = 0; i < state.range(0); ++i)
+            clients.emplace_back(Address("127.0.0.1", port));
+    }
+    catch (const std::runtime_error& e) {
+        return state.SkipWithError(e.what());
+    }
+    char buffer[message.size()];
+    for (auto _ : state) {
+        for (auto& client : clients)
+            client.write(message);
+        for (auto& client : clients)
+            client.read_into(buffer, sizeof(buffer), sizeof(buffer));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_TEMPLATE(BM_Echo, SchedulerBackend::FdSet)->Arg(100)->Arg(1000)->Arg(10000)
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Echo, SchedulerBackend::IoUring)->Arg(100)->Arg(1000)->Arg(10000)
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+/// Like `BM_Echo` over TLS, where the io_uring server moves the ciphertext through memory BIOs
+template<SchedulerBackend Backend>
+static void BM_TlsEcho(benchmark::State& state) {
+    if (Backend == SchedulerBackend::IoUring && !IoUring::supported())
+        return state.SkipWithError("io_uring isn't supported");
+    raise_fd_limit();
+    const auto port = next_port();
+    std::unique_ptr<ServerProcess> server;
+    {
+        SSLSocket listener(Address{ port }, BENCH_DATA_DIR "/cert.pem", BENCH_DATA_DIR "/key.pem");
+        server = std::make_unique<ServerProcess>(Backend, std::move(listener));
+    }
+    std::vector<SSLSocket> clients;
+    for (auto i = 0; i < state.range(0); ++i)
+        clients.emplace_back(Address("127.0.0.1", port));
+    char buffer[message.size()];
+    for (auto _ : state) {
+        for (auto& client : clients)
+            client.write(message);
+        for (auto& client : clients)
+            client.read_into(buffer, sizeof(buffer), sizeof(buffer));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_TEMPLATE(BM_TlsEcho, SchedulerBackend::FdSet)->Arg(1000)
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_TlsEcho, SchedulerBackend::IoUring)->Arg(1000)
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
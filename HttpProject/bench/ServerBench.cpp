@@ -0,0 +1,118 @@
+/// \file Measures request throughput of the server as worker threads are added
+#include <benchmark/benchmark.h>
+#include "BenchUtil.h"
+#include <HttpServer.h>
+#include <Socket.h>
+#include <Address.h>
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+constexpr auto clientThreads = 8;
+constexpr auto requestsPerClient = 32;
+constexpr std::string_view request = "GET /bench HTTP/1.1\r\nHost: bench\r\n\r\n";
+/// the request of a client which connects for every request
+constexpr std::string_view closingRequest =
+    "GET /bench HTTP/1.1\r\nHost: bench\r\nConnection: close\r\n\r\n";
+
+/// Answers every request with a small fixed body
+void hello_handler(const HttpRequestFrame&, HttpResponseFrame& response) {
+    response.content = "hello";
+}
+
+/**
+* Sends `clientThreads * requestsPerClient` requests per iteration, each on its own
+* connection, to a server with `state.range(0)` worker threads
+*/
+static void BM_ServerRequests(benchmark::State& state) {
+    ServerOptions options;
+    options.port = next_port();
+    options.threads = static_cast<unsigned>(state.range(0));
+    HttpServer server(options, &hello_handler);
+    server.start();
+
+    std::atomic<int> failures{ 0 };
+    const auto allocs = allocation_count();
+    for (auto _ : state) {
+        std::vector<std::thread> clients;
+        for (auto c = 0; c < clientThreads; ++c) {
+            clients.emplace_back([&options, &failures]() {
+                char buffer[512];
+                for (auto i = 0; i < requestsPerClient; ++i) {
+                    try {
+                        TcpSocket client(Address("127.0.0.1", options.port));
+                        client.write(closingRequest);
+                        // the server closes the connection after its response
+                        while (client.read_into(buffer, sizeof(buffer)) > 0) {}
+                    }
+                    catch (const std::runtime_error&) {
+                        // reading past the response ends with the connection closing
+                    }
+                }
+                });
+        }
+        for (auto& client : clients)
+            client.join();
+    }
+    uint64_t answered = 0;
+    for (const auto& stats : server.stats())
+        answered += stats.requests;
+    state.SetItemsProcessed(state.iterations() * clientThreads * requestsPerClient);
+    state.counters["allocs/req"] = static_cast<double>(allocation_count() - allocs)
+        / static_cast<double>(state.iterations() * clientThreads * requestsPerClient);
+    state.counters["answered"] = static_cast<double>(answered);
+}
+BENCHMARK(BM_ServerRequests)->Arg(1)->Arg(2)->Arg(4)->UseRealTime();
+
+/**
+* Sends `clientThreads * requestsPerClient` requests per iteration over one persistent
+* connection per client thread, with `state.range(1)` requests pipelined per write,
+* to a server with `state.range(0)` worker threads
+*/
+static void BM_ServerKeepAlive(benchmark::State& state) {
+    ServerOptions options;
+    options.port = next_port();
+    options.threads = static_cast<unsigned>(state.range(0));
+    options.maxRequestsPerConnection = 0;
+    HttpServer server(options, &hello_handler);
+    server.start();
+    const auto pipelined = static_cast<int>(state.range(1));
+    std::string requests;
+    for (auto i = 0; i < pipelined; ++i)
+        requests.append(request);
+
+    std::vector<std::unique_ptr<TcpSocket>> clients;
+    for (auto c = 0; c < clientThreads; ++c)
+        clients.push_back(std::make_unique<TcpSocket>(Address("127.0.0.1", options.port)));
+    // every response is the same, so the responses are counted by their size
+    const auto responseSize = [&]() {
+        clients.front()->write(request);
+        char buffer[512];
+        return clients.front()->read_into(buffer, sizeof(buffer));
+    }();
+    const auto allocs = allocation_count();
+    for (auto _ : state) {
+        std::vector<std::thread> threads;
+        for (auto& client : clients) {
+            threads.emplace_back([&client, &requests, pipelined, responseSize]() {
+                char buffer[16 * 1024];
+                for (auto i = 0; i < requestsPerClient; i += pipelined) {
+                    client->write(requests);
+                    size_t received = 0;
+                    while (received < responseSize * pipelined)
+                        received += client->read_into(buffer, sizeof(buffer));
+                }
+                });
+        }
+        for (auto& thread : threads)
+            thread.join();
+    }
+    state.SetItemsProcessed(state.iterations() * clientThreads * requestsPerClient);
+    state.counters["allocs/req"] = static_cast<double>(allocation_count() - allocs)
+        / static_cast<double>(state.iterations() * clientThreads * requestsPerClient);
+}
+BENCHMARK(BM_ServerKeepAlive)->Args({ 1, 1 })->Args({ 1, 8 })->Args({ 4, 1 })->Args({ 4, 8 })
+    ->UseRealTime();
@@ -0,0 +1,124 @@
+/// \file Compares the ways ports send a file: `sendfile`, writes from the mapping
+///   and reading the file into a buffer first
+#include <benchmark/benchmark.h>
+#include "BenchUtil.h"
+#include <Address.h>
+#include <MappedFile.h>
+#include <Socket.h>
+#include <cstdio>
+#include <fstream>
+#include <future>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+/// How a fixture sends the file
+enum class SendMode { SendFile, Mapping, ReadWrite };
+
+/**
+* A file of `state.range(0)` bytes and a loopback connection whose peer
+* drains everything sent to it on a thread
+*/
+template<typename Sock>
+struct SendFixture {
+    std::string path;
+    std::unique_ptr<MappedFile> file;
+    std::unique_ptr<Sock> client, server;
+    std::thread drain;
+
+    explicit SendFixture(const benchmark::State& state) :
+        path("/tmp/StaticFileBench" + std::to_string(getpid()))
+    {
+        {
+            std::ofstream out(path, std::ios::binary | std::ios::trunc);
+            const std::vector<char> data(static_cast<size_t>(state.range(0)), 'x');
+            out.write(data.data(), static_cast<std::streamsize>(data.size()));
+        }
+        file = std::make_unique<MappedFile>(path);
+        connect();
+        drain = std::thread([this]() {
+            std::vector<char> buffer(256 * 1024);
+            try {
+                while (true)
+                    client->read_into(buffer.data(), buffer.size());
+            } catch (const std::runtime_error&) {
+                // closed by the fixture
+            }
+        });
+    }
+
+    ~SendFixture() {
+        server.reset();
+        drain.join();
+        std::remove(path.c_str());
+    }
+
+    /// Sends the whole file to the client
+    void send(SendMode mode, std::vector<char>& buffer) {
+        switch (mode) {
+        case SendMode::SendFile:
+            server->send_file(*file, 0, file->size());
+            break;
+        case SendMode::Mapping:
+            server->Port::send_file(*file, 0, file->size());
+            break;
+        case SendMode::ReadWrite:
+            for (uint64_t offset = 0; offset < file->size();) {
+                const auto read = pread(file->fd(), buffer.data(), buffer.size(),
+                    static_cast<off_t>(offset));
+                if (read <= 0)
+                    throw std::runtime_error("Failed to read file");
+                server->write({ buffer.data(), static_cast<size_t>(read) });
+                offset += static_cast<uint64_t>(read);
+            }
+            break;
+        }
+    }
+private:
+    void connect();
+};
+
+template<>
+void SendFixture<TcpSocket>::connect() {
+    const auto port = next_port();
+    TcpSocket listener{ Address(port) };
+    auto fut = std::async(std::launch::async, [&listener]() {
+        return std::make_unique<TcpSocket>(listener.accept());
+    });
+    client = std::make_unique<TcpSocket>(Address("127.0.0.1", port));
+    server = fut.get();
+}
+
+template<>
+void SendFixture<SSLSocket>::connect() {
+    std::tie(client, server) = make_ssl_pair(next_port());
+}
+
+template<typename Sock>
+static void run_send_file(benchmark::State& state, SendMode mode) {
+    SendFixture<Sock> f(state);
+    std::vector<char> buffer(64 * 1024);
+    for (auto _ : state)
+        f.send(mode, buffer);
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * f.file->size()));
+}
+
+static void BM_TcpSendFile(benchmark::State& state, SendMode mode) {
+    run_send_file<TcpSocket>(state, mode);
+}
+
+static void BM_SslSendFile(benchmark::State& state, SendMode mode) {
+    run_send_file<SSLSocket>(state, mode);
+}
+BENCHMARK_CAPTURE(BM_TcpSendFile, sendfile, SendMode::SendFile)
+    ->Arg(64 * 1024)->Arg(1024 * 1024)->Arg(16 * 1024 * 1024);
+BENCHMARK_CAPTURE(BM_TcpSendFile, mapping, SendMode::Mapping)
+    ->Arg(64 * 1024)->Arg(1024 * 1024)->Arg(16 * 1024 * 1024);
+BENCHMARK_CAPTURE(BM_TcpSendFile, read_write, SendMode::ReadWrite)
+    ->Arg(64 * 1024)->Arg(1024 * 1024)->Arg(16 * 1024 * 1024);
+// without kernel TLS, SSL sockets send files from the mapping
+BENCHMARK_CAPTURE(BM_SslSendFile, send_file, SendMode::SendFile)
+    ->Arg(64 * 1024)->Arg(1024 * 1024)->Arg(16 * 1024 * 1024);
+BENCHMARK_CAPTURE(BM_SslSendFile, read_write, SendMode::ReadWrite)
+    ->Arg(64 * 1024)->Arg(1024 * 1024)->Arg(16 * 1024 * 1024);
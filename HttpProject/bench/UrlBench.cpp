@@ -0,0 +1,155 @@
+/// \file Compares URL encoded form parsing with a byte at a time parser into a std::map
+#include <benchmark/benchmark.h>
+#include "BenchUtil.h"
+#include <UrlEncoding.h>
+#include <cctype>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+/// @return random params like the ones QueryTest generates
+std::vector<std::pair<std::string, std::string>> make_params() {
+    std::default_random_engine randEng{ 42 };
+    std::uniform_int_distribution<short> asciiGenerator{ 32, 126 };
+    std::uniform_int_distribution<int> sizeGenerator{ 10, 2048 };
+    const auto word = [&]() {
+        std::string res(static_cast<size_t>(sizeGenerator(randEng)), ' ');
+        for (auto& c : res)
+            c = static_cast<char>(asciiGenerator(randEng));
+        return res;
+    };
+    std::vector<std::pair<std::string, std::string>> params;
+    for (auto i = 0; i < 30; ++i)
+        params.emplace_back(word(), word());
+    return params;
+}
+
+/// @return the form encoding of `params`
+std::string encode_params(const std::vector<std::pair<std::string, std::string>>& params) {
+    std::string form;
+    for (const auto& [key, value] : params) {
+        url_encode(key, form);
+        form.push_back('=');
+        url_encode(value, form);
+        form.push_back('&');
+    }
+    form.pop_back();
+    return form;
+}
+
+/// Decodes one byte at a time into a new string
+std::string naive_decode(std::string_view data) {
+    std::string out;
+    for (size_t i = 0; i < data.size(); ++i) {
+        if (data[i] == '+')
+            out.push_back(' ');
+        else if (data[i] == '%' && i + 2 < data.size()) {
+            out.push_back(static_cast<char>(std::stoi(std::string(data.substr(i + 1, 2)),
+                nullptr, 16)));
+            i += 2;
+        }
+        else
+            out.push_back(data[i]);
+    }
+    return out;
+}
+
+/// Parses a form into a map of copies
+std::map<std::string, std::string> naive_parse(std::string_view form) {
+    std::map<std::string, std::string> params;
+    while (!form.empty()) {
+        const auto param = form.substr(0, form.find('&'));
+        const auto eq = param.find('=');
+        params.emplace(naive_decode(param.substr(0, eq)),
+            eq == std::string_view::npos ? std::string() : naive_decode(param.substr(eq + 1)));
+        form.remove_prefix(std::min(form.size(), param.size() + 1));
+    }
+    return params;
+}
+
+/// Encodes with a `snprintf` per escape
+std::string naive_encode(std::string_view data) {
+    std::string out;
+    for (const auto c : data) {
+        if (std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '.' || c == '_'
+            || c == '*')
+            out.push_back(c);
+        else if (c == ' ')
+            out.push_back('+');
+        else {
+            char escape[4];
+            std::snprintf(escape, sizeof(escape), "%%%02X", static_cast<unsigned char>(c));
+            out.append(escape);
+        }
+    }
+    return out;
+}
+
+static void BM_ParseNaive(benchmark::State& state) {
+    const auto form = encode_params(make_params());
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(naive_parse(form));
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * form.size()));
+}
+BENCHMARK(BM_ParseNaive);
+
+static void BM_ParseQueryParams(benchmark::State& state) {
+    const auto form = encode_params(make_params());
+    QueryParams params;
+    const auto allocs = allocation_count();
+    for (auto _ : state) {
+        params.parse(form);
+        benchmark::DoNotOptimize(params.find("key"));
+    }
+    state.counters["allocs/iter"] = benchmark::Counter(
+        static_cast<double>(allocation_count() - allocs), benchmark::Counter::kAvgIterations);
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * form.size()));
+}
+BENCHMARK(BM_ParseQueryParams);
+
+/// Decodes a form without escapes, which is skipped over with SIMD
+static void BM_DecodeUnescaped(benchmark::State& state) {
+    const std::string data(4096, 'x');
+    std::string buffer;
+    for (auto _ : state) {
+        buffer = data;
+        benchmark::DoNotOptimize(url_decode_in_place(buffer.data(), buffer.size()));
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * data.size()));
+}
+BENCHMARK(BM_DecodeUnescaped);
+
+static void BM_EncodeNaive(benchmark::State& state) {
+    const auto params = make_params();
+    size_t bytes = 0;
+    for (auto _ : state) {
+        for (const auto& [key, value] : params) {
+            benchmark::DoNotOptimize(naive_encode(key));
+            benchmark::DoNotOptimize(naive_encode(value));
+            bytes += key.size() + value.size();
+        }
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+}
+BENCHMARK(BM_EncodeNaive);
+
+static void BM_Encode(benchmark::State& state) {
+    const auto params = make_params();
+    std::string out;
+    size_t bytes = 0;
+    for (auto _ : state) {
+        out.clear();
+        for (const auto& [key, value] : params) {
+            url_encode(key, out);
+            url_encode(value, out);
+            bytes += key.size() + value.size();
+        }
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+}
+BENCHMARK(BM_Encode);
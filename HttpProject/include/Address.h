@@ -1,22 +1,44 @@
+#pragma once
+#include <optional>
 #include <string_view>
+#include <string>
 #include <tuple>
 #include "Networking.h"
-/// Encapsulates a sockaddr structure
+/// Encapsulates a sockaddr structure of any family, such as ipv4 or ipv6
 class Address {
-    sockaddr_in addrData;
+    sockaddr_storage addrData;
+    socklen_t addrSize;
 public:
     /// Constructs an address for a server socket
-    /// Accepts all clients from any address
+    /// Accepts all clients from any ipv4 address
     /// @param port port to start server on in host byte order
     explicit Address(unsigned short port);
 
     /**
-    * Constructs an address from an ip or uri and a port
-    * @param addr an ip address stored in a string or a named address
+    * Constructs an address from an ip or uri and a port.
+    * Names are resolved by `Resolver::shared()`, which blocks until the name is
+    * resolved unless it is cached, and the first address it returns is used.
+    * Connect with a host name and port instead to try every address of the name
+    * @param addr an ipv4 or ipv6 address stored in a string or a named address.
+    *   "::" is the address of a server accepting clients from any ipv6 address
     * @param port the port to use in host byte order
+    * @throw std::runtime_error if the name can't be resolved
     */ 
     Address(std::string_view addr, unsigned short port);
 
+    /**
+    * Copies a socket address
+    * @throw std::invalid_argument if `size` is larger than any socket address
+    */
+    Address(const struct sockaddr* addr, socklen_t size);
+
+    /**
+    * Parses an ip address without resolving it
+    * @param addr an ipv4 address, or an ipv6 address which may be in brackets
+    * @return the address, or an empty optional if `addr` isn't an ip address
+    */
+    static std::optional<Address> from_ip(std::string_view addr, unsigned short port);
+
     /**
     * Gets a non-owning pointer of internal address struct
     * @return tuple of pointer to address struct and size of the structure being pointed to
@@ -26,7 +48,8 @@ public:
 
     /**
     * Gets a non-owning mutable pointer of internal address struct
-    * @return tuple of pointer to address struct and size of the structure being pointed to
+    * @return tuple of pointer to address struct and size of the structure being pointed to,
+    *   which fits an address of any family
     *   Requires the pointer is not deleted and not used beyond the lifetime of this object
     */
     std::tuple<struct sockaddr*, socklen_t> addr_mut() noexcept;
@@ -36,4 +59,18 @@ public:
 
     /// Gets the socket family type (ipv4, ipv6 etc).
     int family() const noexcept;
+
+    /// @return the port in host byte order
+    unsigned short port() const noexcept;
+
+    /// Changes the port, in host byte order
+    void set_port(unsigned short port) noexcept;
+
+    /// @return the address in the form ip:port, or [ip]:port for ipv6
+    std::string to_string() const;
+
+    /// @return true if both addresses have the same family, ip and port
+    bool operator==(const Address& other) const noexcept;
+
+    bool operator!=(const Address& other) const noexcept { return !(*this == other); }
 };
\ No newline at end of file
@@ -0,0 +1,145 @@
+#pragma once
+#include "Port.h"
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+/// Settings of a `BufferedPort`
+struct BufferedPortOptions {
+    /// size the read buffer starts at, it grows to fit the largest message read
+    size_t readBufferSize = 16 * 1024;
+    /// largest message `read_until`, `read_exact` and `peek` hold in the read buffer
+    size_t maxMessageSize = 1024 * 1024;
+    /// buffered output which is flushed once reached. The default fills one TLS record
+    size_t flushSize = 16 * 1024;
+    /// longest output stays buffered before the next write or read flushes it,
+    /// or empty to keep it until `flushSize` is reached or `flush` is called
+    std::optional<std::chrono::microseconds> flushDelay;
+};
+
+/**
+* Port which buffers the reads and writes of another port.
+*
+* Reads fill a buffer which is reused for the whole connection, so messages can be
+* read up to a delimiter or a length without reassembling them from the pieces the
+* port returns. Data left over after a message, such as the start of a pipelined
+* request, stays buffered for the next read.
+*
+* Small writes are gathered and sent to the port with one write once `flushSize` bytes
+* are buffered, so a head and body written separately go out as one TLS record and
+* one packet instead of several. Buffered output is also flushed by `flush`, by
+* `uncork`, by the next write or read once it has waited `flushDelay`, and before a
+* blocking read, since the peer may be waiting for it before sending anything.
+*
+* The wrapped port must outlive the buffered port, and shouldn't be read from
+* or written to directly while the buffered port holds data. Output which is still
+* buffered when the buffered port is destroyed is discarded, so it must be flushed
+*/
+class BufferedPort : public Port {
+public:
+    using clock = std::chrono::steady_clock;
+
+    explicit BufferedPort(Port& port, BufferedPortOptions options = {});
+
+    /**
+    * Blocks until `delimiter` is read
+    * @return the data up to and including the delimiter, which is valid until the
+    *   next call on the port
+    * @throws std::runtime_error if no delimiter is found in `maxMessageSize` bytes,
+    *   or if reading from the port fails
+    */
+    std::string_view read_until(std::string_view delimiter);
+
+    /**
+    * Blocks until `bytes` bytes are read
+    * @return the data, which is valid until the next call on the port
+    * @throws std::invalid_argument if `bytes` is larger than `maxMessageSize`
+    */
+    std::string_view read_exact(size_t bytes);
+
+    /**
+    * Blocks until at least `bytes` bytes are buffered, without consuming them
+    * @param bytes the amount of bytes to wait for, 0 for whatever is buffered
+    *   or first available
+    * @return all of the buffered data, which is valid until the next call on the port
+    * @throws std::invalid_argument if `bytes` is larger than `maxMessageSize`
+    */
+    std::string_view peek(size_t bytes = 0);
+
+    /// @return the data which has been read from the port but not consumed
+    std::string_view buffered() const noexcept;
+
+    /// Writes all of the buffered output to the port
+    void flush();
+
+    /**
+    * Flushes the buffered output if it has waited `flushDelay`
+    * @return true if output was flushed
+    */
+    bool flush_if_due();
+
+    /// @return when the buffered output is due to be flushed, or an empty optional if
+    ///   there is none or it doesn't have a deadline
+    std::optional<clock::time_point> flush_deadline() const noexcept;
+
+    /**
+    * Holds all output in the buffer until a matching `uncork`, however large it grows,
+    * so a response written in many pieces is sent in as few writes as possible.
+    * Corks nest, and `flush` still sends the buffered output
+    */
+    void cork() noexcept;
+
+    /// Undoes a `cork`, flushing the buffered output once no corks are left
+    void uncork();
+
+    /// @return the amount of output waiting to be flushed
+    size_t pending() const noexcept { return output.size(); }
+
+    size_t available() const noexcept override;
+
+    void write(std::string_view data) override;
+
+    std::vector<char> read(size_t bytes = 0) override;
+
+    std::vector<char> try_read() override;
+
+    size_t read_into(char* buffer, size_t size, size_t minBytes = 0) override;
+
+    size_t try_read_into(char* buffer, size_t size) override;
+
+    void writev(const std::string_view* buffers, size_t count) override;
+
+    /// Buffers the part of the file like a write if it fits under `flushSize`,
+    /// otherwise flushes and sends it with the port's `send_file`
+    void send_file(const class MappedFile& file, uint64_t offset, uint64_t size) override;
+
+    void add_to_fd(class FdSet& fd) const override;
+
+    /// @return true if there is activity on the port, or data is buffered
+    bool is_in_fd(const class FdSet& fd) const override;
+
+    void remove_from_fd(class FdSet& fd) const override;
+private:
+    Port& port;
+    BufferedPortOptions options;
+    std::vector<char> input;
+    size_t pos = 0, end = 0; //< the unconsumed data in `input`
+    std::vector<char> output;
+    unsigned corks = 0;
+    clock::time_point firstPending; //< when the oldest buffered output was written
+
+    /// Reads from the port until at least `bytes` bytes are buffered
+    void fill(size_t bytes);
+
+    /// Makes room for `bytes` buffered bytes in `input`, moving the buffered data
+    /// to the start of the buffer
+    void reserve_input(size_t bytes);
+
+    /// Copies and consumes up to `size` buffered bytes
+    size_t take(char* buffer, size_t size) noexcept;
+
+    /// Flushes if the size or the deadline of the buffered output has been reached
+    void flush_if_needed();
+};
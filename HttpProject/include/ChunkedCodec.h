@@ -0,0 +1,160 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+#include <vector>
+class Port;
+
+/**
+* Incremental decoder of a chunked transfer encoded body.
+*
+* Decodes data as it arrives and hands back slices of the payload which point
+* into the caller's data, so a body of any size is decoded without being buffered.
+* Chunk extensions and trailers are skipped
+*/
+class ChunkedDecoder {
+public:
+    enum class Status {
+        /// More data is needed to finish the body
+        Incomplete,
+        /// The last chunk and the trailers have been decoded
+        Done,
+        /// The body is malformed, see `error()`
+        Error
+    };
+
+    enum class Error {
+        None,
+        /// A chunk size isn't a hex number or doesn't fit in 64 bits
+        BadSize,
+        /// A chunk or line isn't terminated by CRLF
+        BadTerminator,
+        /// A chunk size line or the trailers are larger than the decoder's limit
+        TooLarge
+    };
+
+    /// @param maxLineSize the largest chunk size line, and the largest trailers, accepted
+    explicit ChunkedDecoder(size_t maxLineSize = 8 * 1024) noexcept;
+
+    /**
+    * Decodes the start of `input` up to and including the next slice of payload,
+    * removing what was decoded from `input`
+    * @return the slice of payload, which points into `input`. Empty if all of
+    *   `input` was decoded without reaching payload, or if decoding stopped
+    *   because the body ended or is malformed
+    */
+    std::string_view decode(std::string_view& input) noexcept;
+
+    /// @return whether the body is finished
+    Status status() const noexcept;
+
+    /// @return the reason decoding failed, or `Error::None`
+    Error error() const noexcept { return err; }
+
+    /// Prepares the decoder for the next body
+    void reset() noexcept;
+private:
+    enum class State : uint8_t {
+        Size, Extension, SizeLF, Data, DataCR, DataLF,
+        TrailerStart, Trailer, TrailerLF, FinalLF, Done, Error
+    } state = State::Size;
+    Error err = Error::None;
+    bool sawDigit = false;
+    uint64_t remaining = 0; //< size of the current chunk, then the amount of it left
+    size_t lineSize = 0;
+    size_t maxLineSize;
+
+    void fail(Error error) noexcept;
+};
+
+/**
+* Reads a chunked body from a port, a slice of payload at a time
+*/
+class ChunkedReader {
+public:
+    /**
+    * @param port the port to read the body from
+    * @param buffered data of the body already read from the port, such as the data
+    *   after a request head
+    * @param bufferSize the size of the buffer data is read into from the port
+    */
+    explicit ChunkedReader(Port& port, std::string_view buffered = {},
+        size_t bufferSize = 16 * 1024);
+
+    /**
+    * Blocks until the next slice of payload is read
+    * @return the slice of payload, which is valid until the next call.
+    *   Empty once the body is finished
+    * @throws std::runtime_error if the body is malformed
+    */
+    std::string_view read();
+
+    /// @return true once the whole body has been read
+    bool done() const noexcept;
+
+    /// @return data read from the port after the end of the body,
+    ///   such as the start of a pipelined request
+    std::string_view leftover() const noexcept;
+private:
+    Port& port;
+    ChunkedDecoder decoder;
+    std::vector<char> buffer;
+    size_t pos = 0, end = 0; //< the unread data in `buffer`
+};
+
+/**
+* Writes a body to a port with chunked transfer encoding.
+*
+* Payload is gathered into chunks of `chunkSize` bytes which are framed in place,
+* so each chunk is sent with one write call. The default size makes each chunk,
+* including its framing, exactly fill a TLS record
+*/
+class ChunkedWriter {
+public:
+    /// Payload per chunk which makes a chunk fill a TLS record
+    static constexpr size_t recordChunkSize = 16384 - 8;
+
+    /// @param chunkSize the payload of every chunk but the last, at least 1
+    explicit ChunkedWriter(Port& port, size_t chunkSize = recordChunkSize);
+
+    /// Writes payload, sending every chunk it fills
+    void write(std::string_view data);
+
+    /**
+    * Writes all of the payload made by a producer, which writes payload straight into
+    * the chunk buffer
+    * @param produce callable taking a `char*` buffer and its `size_t` size, which writes
+    *   payload into the buffer and returns the amount of bytes written, or 0 when done
+    */
+    template<class Producer>
+    void write_from(Producer&& produce);
+
+    /// Sends the payload which hasn't filled a chunk as a smaller chunk
+    void flush();
+
+    /// Sends the remaining payload and the last chunk which ends the body
+    void finish();
+private:
+    /// space for the largest chunk size line
+    static constexpr size_t headerSpace = 16 + 2;
+
+    Port& port;
+    size_t chunkSize;
+    size_t filled = 0; //< payload in the current chunk
+    std::vector<char> buffer;
+
+    char* payload() noexcept { return buffer.data() + headerSpace; }
+    void send_chunk();
+};
+
+template<class Producer>
+void ChunkedWriter::write_from(Producer&& produce) {
+    for (;;) {
+        const auto produced = static_cast<size_t>(
+            produce(payload() + filled, chunkSize - filled));
+        if (produced == 0)
+            return;
+        filled += produced;
+        if (filled == chunkSize)
+            send_chunk();
+    }
+}
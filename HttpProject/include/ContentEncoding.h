@@ -0,0 +1,145 @@
+#pragma once
+#include "ChunkedCodec.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+class MappedFile;
+
+/// Codings a response body can be sent with
+enum class ContentCoding : uint8_t {
+    Identity, Gzip, Deflate
+};
+
+/// @return the name of a coding as it appears in `Content-Encoding`
+std::string_view coding_name(ContentCoding coding) noexcept;
+
+/**
+* Picks the coding of a response from the `Accept-Encoding` header of its request.
+* Gzip is preferred over deflate when the client weighs them equally, codings with
+* `q=0` are refused and `*` stands for the codings not listed
+* @return the coding with the highest weight, or `ContentCoding::Identity` if the
+*   client accepts neither gzip nor deflate
+*/
+ContentCoding negotiate_coding(std::string_view acceptEncoding) noexcept;
+
+/// @return true if bodies of a media type are worth compressing, which is text
+///   and the structured text types such as JSON, JavaScript, XML and SVG
+bool compressible_type(std::string_view contentType) noexcept;
+
+/// Settings of the compression of response bodies
+struct CompressionOptions {
+    /// true to compress the bodies of responses to clients which accept gzip or deflate
+    bool enabled = false;
+    /// zlib compression level, from 1 for the fastest to 9 for the smallest output
+    int level = 6;
+    /// smallest body which is compressed, smaller ones barely shrink
+    size_t minSize = 1024;
+    /// most compressed file data kept, so a file is compressed once rather than on
+    /// every request. 0 to compress files on every request
+    size_t maxCachedBytes = 32 * 1024 * 1024;
+};
+
+/**
+* Streaming gzip or deflate compressor.
+*
+* zlib's state takes a few hundred kilobytes to set up, so every thread keeps one
+* state per coding which its compressors reset and reuse, and compressing a body
+* doesn't allocate. A thread which has two compressors of the same coding at once
+* gives the second its own state
+*/
+class Compressor {
+    struct State;
+    State* state;
+    /// the state of a compressor which couldn't use its thread's state
+    std::unique_ptr<State> owned;
+    bool finished = false;
+public:
+    /// How much of the compressed data is written out by `compress`
+    enum class Flush {
+        /// as much as zlib has decided on, which may be nothing
+        None,
+        /// everything, so the data compressed so far can be decompressed
+        Sync,
+        /// everything, ending the stream
+        Finish
+    };
+
+    /**
+    * @param coding gzip or deflate
+    * @param level zlib compression level, from 1 to 9
+    * @throws std::invalid_argument if the coding is identity or the level is invalid
+    */
+    explicit Compressor(ContentCoding coding, int level = 6);
+
+    /// Returns the thread's state for reuse
+    ~Compressor();
+
+    Compressor(const Compressor&) = delete;
+    Compressor& operator=(const Compressor&) = delete;
+
+    /**
+    * Compresses the start of `input` into `out`, removing what was compressed from `input`
+    * @return the amount of bytes written to `out`, which is 0 once all of the input is
+    *   compressed and everything `flush` asks for is written
+    */
+    size_t compress(std::string_view& input, char* out, size_t size, Flush flush);
+
+    /// Compresses a whole body into `out`, replacing its contents
+    void compress_all(std::string_view input, std::string& out);
+
+    /// @return true once the stream has been ended by `Flush::Finish`
+    bool done() const noexcept { return finished; }
+};
+
+/**
+* Writes a body compressed and with chunked transfer encoding, so a body of unknown
+* length is compressed as it is produced. The compressor writes straight into the
+* chunk buffer, so the compressed data isn't copied
+*/
+class CompressedChunkedWriter {
+public:
+    /// @see ChunkedWriter::ChunkedWriter
+    CompressedChunkedWriter(Port& port, ContentCoding coding, int level = 6,
+        size_t chunkSize = ChunkedWriter::recordChunkSize);
+
+    /// Compresses payload, sending every chunk it fills
+    void write(std::string_view data);
+
+    /// Sends all of the payload written so far, so the client can decompress it
+    void flush();
+
+    /// Ends the compressed stream and sends the last chunk which ends the body
+    void finish();
+private:
+    ChunkedWriter chunked;
+    Compressor compressor;
+
+    void compress(std::string_view data, Compressor::Flush flush);
+};
+
+/**
+* Compressed copies of parts of files, so files served often are compressed once.
+*
+* Copies are found by the mapping of their file, which the file cache of
+* `StaticFiles` keeps while the file is unchanged, so the copy of a file which has
+* changed is no longer found and is replaced. Once the copies take more than the
+* limit, the oldest are dropped. Thread safe
+*/
+class CompressedFiles {
+    struct Impl;
+    std::unique_ptr<Impl> pimpl;
+public:
+    /// @param maxBytes the most compressed data kept
+    explicit CompressedFiles(size_t maxBytes);
+
+    ~CompressedFiles();
+
+    /**
+    * Gets the compressed copy of part of a file, compressing it if it has none
+    * @return the compressed data, which is valid as long as the returned pointer is kept
+    */
+    std::shared_ptr<const std::string> get(const std::shared_ptr<const MappedFile>& file,
+        uint64_t offset, uint64_t size, ContentCoding coding, int level);
+};
@@ -1,54 +1,182 @@
 #pragma once
 #include <optional>
 #include <chrono>
+#include <functional>
+#include <type_traits>
+#include <vector>
 #include "Networking.h"
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
+/// The type of interaction an Fd Set will wait for
+enum class SetType {
+    Read, Write, Error
+};
+
+/// How activity on an fd is reported by an FdSet
+enum class Trigger {
+    /// An fd is reported by every wait while it has activity
+    Level,
+    /// An fd is only reported once per new activity.
+    /// Its data must be fully drained before it is reported again
+    Edge
+};
+
+/**
+* Determines if the given type is a set wrapper that can be waited on,
+* such as `ReadSet`. If the type adheres, the constexpr member `value` is `true`,
+* otherwise it is `false`.
+* @{
+*/
+template<class T, typename = void>
+struct WaitSetConcept : public std::false_type {};
+
+template<class T>
+struct WaitSetConcept<T, std::void_t<
+    std::enable_if_t<std::is_same_v<std::decay_t<decltype(T::type)>, SetType>>,
+    decltype(std::declval<T>().fd.get())
+    >> : public std::true_type {};
+/// @}
+
+/// @return true if `Sets` are between 1 and 3 wait sets with distinct set types
+template<class ... Sets>
+constexpr bool are_wait_sets() {
+    if constexpr (sizeof...(Sets) < 1 || sizeof...(Sets) > 3 ||
+        !(WaitSetConcept<std::decay_t<Sets>>::value && ...))
+    {
+        return false;
+    }
+    else {
+        constexpr SetType types[] = { std::decay_t<Sets>::type... };
+        for (size_t i = 0; i < sizeof...(Sets); ++i) {
+            for (size_t j = i + 1; j < sizeof...(Sets); ++j) {
+                if (types[i] == types[j])
+                    return false;
+            }
+        }
+        return true;
+    }
+}
+
+/// True if the specified types can be waited on together by an FdSet
+/// @see WaitSetConcept
+template<class ... Sets>
+constexpr auto is_wait_sets_v = are_wait_sets<Sets...>();
+
 /// Set of file descriptors.
 /// When activity is detected on an FD that is part of the set
 /// a flag is set, which can be queried
+///
+/// On Linux the set is backed by epoll, so the set persists between waits
+/// and the cost of a wait depends only on the amount of ready fds. Fds should
+/// be added once and removed when no longer needed instead of being re-added
+/// before every wait
 class FdSet {
-    fd_set set;
+#ifdef __linux__
+    int epollFd;
+    /// epoll event mask every fd in the set is currently registered with
+    unsigned registered;
+    /// membership and readiness flags of each fd, indexed by fd
+    std::vector<unsigned char> flags;
+    std::vector<struct epoll_event> events;
+#else
+    fd_set set, active;
+    /// the fds in `set`, so a wait only checks the members instead of every fd up to the largest
+    std::vector<socket_t> members;
+#endif
+    std::vector<socket_t> readyFds;
+    Trigger trigger;
+
+    struct WaitTarget {
+        FdSet* set;
+        SetType type;
+    };
+
+    /**
+    * Waits for activity on the given targets
+    * @param timeout the maximum time to wait or an empty optional to wait indefinitely
+    * @return the amount of ready fds across all targets
+    */
+    static size_t wait_for(const WaitTarget* targets, size_t count,
+        std::optional<std::chrono::microseconds> timeout);
+
+    /// Clears the flags of all fds that were ready after the last wait
+    void clear_ready() noexcept;
 public:
+    explicit FdSet(Trigger trigger = Trigger::Level);
+    ~FdSet();
+
+    FdSet(const FdSet&) = delete;
+    FdSet& operator=(const FdSet&) = delete;
+
+    FdSet(FdSet&&) noexcept;
+    FdSet& operator=(FdSet&&) noexcept;
+
     /**
     * Removes all FDs from the set.
-    * 
+    *
     * Clears all set flags
     */
-    void reset() {}
+    void reset();
 
     /// @return true if there is activity on the specified socket/port/fd
     /// @param fd the socket or port integral file descriptor
-    bool is_set(unsigned long long) const { return false; }
+    bool is_set(unsigned long long fd) const noexcept;
 
     /// Removes an fd from the set and clears its flags
     /// @param fd the socket or port integral file descriptor
-    void remove(unsigned long long) {  }
+    void remove(unsigned long long fd);
 
     /// Adds an fd to the set
     /// Begins listening for activity on that fd
     /// @param fd the socket or port integral file descriptor
-    void add(unsigned long long) {  }
+    void add(unsigned long long fd);
+
+    /**
+    * Gets all fds with activity after the last wait.
+    * Lets a caller dispatch ready fds without checking every member
+    * @return non-owning view of the ready fds, invalidated by the next wait or modification
+    */
+    const std::vector<socket_t>& ready() const noexcept { return readyFds; }
+
+    /// @return the trigger mode of this set
+    Trigger trigger_mode() const noexcept { return trigger; }
+
+    /**
+    * Registers the fds of the set, and those added later, for a type of activity,
+    * as waiting on the set with that type does. Lets a set which is only waited on by
+    * another set through its handle report that activity. Sets start registered for reads
+    */
+    void watch(SetType type);
+
+#ifdef __linux__
+    /**
+    * @return the epoll instance backing the set, which is readable while any fd in
+    *   the set is ready, so the set can be added to and waited on by another set
+    */
+    int handle() const noexcept { return epollFd; }
+#endif
 
     /**
     * Suspends program until there is activity on an fd set
     * @param ... sets the read and/or write and/or error set to wait for
     *   Cannot have duplicate set types and at most 3 sets can be specified
+    * @return the amount of fds with activity
     */
     template<class ... Sets>
-    static std::enable_if_t<true/*TODO*/> wait(Sets&& ... sets);
+    static std::enable_if_t<is_wait_sets_v<Sets...>, size_t> wait(Sets&& ... sets);
 
     /**
     * Suspends program until there is activity on an fd set or
     * the timeout is reached
     * @param ... sets the read and/or write and/or error set to wait for
     *   Cannot have duplicate set types and at most 3 sets can be specified
+    * @return the amount of fds with activity, 0 if the timeout was reached
     */
     template<class ... Sets>
-    static std::enable_if_t<true/*TODO*/> wait(std::chrono::microseconds timeout, Sets&& ... sets);
-};
-
-/// The type of interaction an Fd Set will wait for
-enum class SetType {
-    Read, Write, Error
+    static std::enable_if_t<is_wait_sets_v<Sets...>, size_t>
+        wait(std::chrono::microseconds timeout, Sets&& ... sets);
 };
 
 /// An FD set of FDs to wait for data to come in
@@ -67,4 +195,19 @@ struct ErrorSet {
 struct WriteSet {
     const std::reference_wrapper<FdSet> fd;
     constexpr static auto type = SetType::Write;
-};
\ No newline at end of file
+};
+
+template<class ... Sets>
+std::enable_if_t<is_wait_sets_v<Sets...>, size_t> FdSet::wait(Sets&& ... sets)
+{
+    const WaitTarget targets[] = { WaitTarget{ &sets.fd.get(), sets.type }... };
+    return wait_for(targets, sizeof...(Sets), std::nullopt);
+}
+
+template<class ... Sets>
+std::enable_if_t<is_wait_sets_v<Sets...>, size_t>
+    FdSet::wait(std::chrono::microseconds timeout, Sets&& ... sets)
+{
+    const WaitTarget targets[] = { WaitTarget{ &sets.fd.get(), sets.type }... };
+    return wait_for(targets, sizeof...(Sets), timeout);
+}
\ No newline at end of file
@@ -0,0 +1,91 @@
+#pragma once
+#include "HttpRequestFrame.h"
+#include "HttpResponseFrame.h"
+#include "Networking.h"
+#include "TlsContext.h"
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+/// Settings of an `HttpClient`
+struct HttpClientOptions {
+    /// most connections open to one host at once, counting the ones in use
+    unsigned maxPerHost = 16;
+    /// most idle connections kept open to one host
+    unsigned maxIdlePerHost = 16;
+    /// time an idle connection is kept before it is closed
+    std::chrono::milliseconds idleTimeout = std::chrono::seconds(30);
+    /// longest a request waits for a connection when its host is at `maxPerHost`
+    std::chrono::milliseconds acquireTimeout = std::chrono::seconds(10);
+    /// client context of HTTPS connections, or null for the context shared by client sockets
+    std::shared_ptr<TlsContext> tls;
+};
+
+/**
+* HTTP/1.1 client which keeps connections open between requests.
+*
+* Connections are pooled by scheme, host name and port. A request takes the most
+* recently used idle connection to its host, so the connections kept warm are the
+* ones in use, and opens a new one only if there is none and the host is below its
+* limit, otherwise it waits for one to be released. An idle connection is checked
+* with a non-blocking read before it is reused, which finds the connections the
+* server closed, and connections idle longer than the timeout are closed.
+*
+* Names are resolved by `Resolver::shared`, and HTTPS connections resume their
+* host's last TLS session, so a new connection to a known host skips both the
+* name lookup and the full handshake.
+* Safe to use from any thread
+*/
+class HttpClient {
+    struct Impl;
+    std::unique_ptr<Impl> pimpl;
+public:
+    /// Counters of a client
+    struct Stats {
+        /// connections opened
+        uint64_t connects;
+        /// requests sent on an idle connection instead of a new one
+        uint64_t reuses;
+        /// idle connections the server closed, found by the check before reuse
+        uint64_t stale;
+        /// idle connections closed for being idle longer than the timeout
+        uint64_t evictions;
+    };
+
+    explicit HttpClient(HttpClientOptions options = {});
+
+    /// Closes every idle connection
+    ~HttpClient();
+
+    HttpClient(const HttpClient&) = delete;
+    HttpClient& operator=(const HttpClient&) = delete;
+
+    /**
+    * Sends a request and blocks until its response is read.
+    * Adds a `Host` header to the request if it has none, and a `Content-Length` header
+    * if it has content and no length or transfer encoding.
+    * Requests with an idempotent method are sent again on a new connection if a reused
+    * connection closes before any of the response arrives
+    * @param tls true to connect with HTTPS
+    * @return the response, with a chunked body decoded into its content
+    * @throw std::runtime_error if the host can't be reached, no connection to it is
+    *   released in time or the response is malformed
+    */
+    HttpResponseFrame request(std::string_view host, port_t port, HttpRequestFrame& request,
+        bool tls = false);
+
+    /**
+    * Closes the connections which have been idle longer than the timeout.
+    * Requests also do this now and then, so calling it is only needed to close
+    * idle connections while no requests are made
+    * @return the amount of connections closed
+    */
+    size_t evict_idle();
+
+    /// @return the amount of idle connections to every host
+    size_t idle_count() const;
+
+    /// @return the counters of this client
+    Stats stats() const noexcept;
+};
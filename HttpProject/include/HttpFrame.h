@@ -1,44 +1,106 @@
 #pragma once
 #include <string>
 #include <string_view>
+#include <optional>
+#include <utility>
+#include <vector>
+#include "HttpHeaders.h"
+class Port;
 /// Encapsulates the headers and information of an HTTP request or response frame
 class HttpFrame {
+    HttpHeaders headerData;
+    int versionMajor = 1, versionMinor = 1;
+protected:
+    /// Appends every header line and the blank line ending the headers to `out`
+    /// @throws std::invalid_argument if a value has CR, LF or NUL
+    void compose_headers(std::vector<std::string_view>& out) const;
 public:
+    /// HTTP methods. `DELETE_` has an underscore since winnt.h defines `DELETE` as a macro
     enum class Protocol {
-        GET, POST
-    } protocol;
+        GET, POST, HEAD, PUT, DELETE_, PATCH, OPTIONS, CONNECT, TRACE
+    } protocol = Protocol::GET;
 
     virtual ~HttpFrame() = default;
 
     /**
     * Composes the data into a well-formatted HTTP frame to be sent
     *
-    * @throws <something> if the request is malformed
+    * @throws std::invalid_argument if the request is malformed
     * @return string of HTTP request frame
     */
-    virtual std::string compose() = 0;
+    virtual std::string compose();
+
+    /**
+    * Composes the frame into a list of buffers which, sent in order, are the same
+    * data as `compose()`, without copying the frame's strings. The buffers refer to
+    * the frame and to static strings, so they are invalidated by changing the frame
+    *
+    * @throws std::invalid_argument if the request is malformed
+    * @param out vector to append the buffers to
+    */
+    virtual void compose_views(std::vector<std::string_view>& out) const = 0;
 
     /**
     * Gets or sets the value of the specified header.
     *
     * If the specified header is not present in the HTTP frame, adds it
     *   with a default value of the empty string
+    * @param header case insensitive header name
+    * @throws std::invalid_argument if `header` isn't a token
+    */
+    std::string& operator[](std::string_view header);
+
+    /// @see operator[](std::string_view)
+    std::string& operator[](KnownHeader header) noexcept;
+
+    /**
+    * Checks that the header values can be sent. A value with CR, LF or NUL could end
+    * its header line and add lines of its own, such as when a value echoes a request
+    * @throws std::invalid_argument if a value has CR, LF or NUL
     */
-    std::string& operator[](std::string header);
+    void check_headers() const;
 
     /// @return true if the HTTP frame contains the specified header
-    bool has_header(std::string_view header) noexcept;
+    bool has_header(std::string_view header) const noexcept;
+
+    /// @see has_header(std::string_view)
+    bool has_header(KnownHeader header) const noexcept;
 
     /**
     * Gets the specified header
-    * @throws ... if the header isn't found
+    * @throws std::out_of_range if the header isn't found
     */
-    const std::string& get(std::string_view header);
+    const std::string& get(std::string_view header) const;
+
+    /// @see get(std::string_view)
+    const std::string& get(KnownHeader header) const;
+
+    /// @return all headers of the frame
+    const HttpHeaders& headers() const noexcept { return headerData; }
+
+    /// @return all headers of the frame
+    HttpHeaders& headers() noexcept { return headerData; }
 
     /// @return a `(major, minor)` pair indicating the HTTP major and minor version
     std::pair<int, int> http_version() const noexcept;
+
+    /// Sets the HTTP version of the frame
+    void set_http_version(int major, int minor) noexcept;
+
+    /**
+    * Checks if the connection the frame was sent on persists after it.
+    * HTTP/1.1 connections persist unless the `Connection` header has `close`,
+    * older versions only persist if it has `keep-alive`
+    */
+    bool keep_alive() const noexcept;
 };
 
+/// @return the name of an HTTP method as it appears in a request line
+std::string_view protocol_name(HttpFrame::Protocol protocol) noexcept;
+
+/// @return the HTTP method with the given name, or an empty optional for unknown methods
+std::optional<HttpFrame::Protocol> protocol_from_name(std::string_view name) noexcept;
+
 namespace HttpResponse {
     constexpr const char* ok = "200 OK";
     constexpr const char* created = "201 Created";
@@ -49,6 +111,31 @@ namespace HttpResponse {
     constexpr const char* not_allow = "405 Method Not Allowed";
     constexpr const char* not_implement = "501 Not Implemented";
     constexpr const char* switch_proto = "101 Switching Protocols";
+    constexpr const char* too_large = "413 Payload Too Large";
+    constexpr const char* server_error = "500 Internal Server Error";
+    constexpr const char* partial = "206 Partial Content";
+    constexpr const char* not_modified = "304 Not Modified";
+    constexpr const char* range_not_satisfiable = "416 Range Not Satisfiable";
+}
+
+/// Status lines of the `HttpResponse` codes in HTTP/1.1, which responses use
+/// instead of building their status line
+namespace HttpStatusLine {
+    constexpr std::string_view ok = "HTTP/1.1 200 OK\r\n";
+    constexpr std::string_view created = "HTTP/1.1 201 Created\r\n";
+    constexpr std::string_view bad = "HTTP/1.1 400 Bad Request\r\n";
+    constexpr std::string_view forbidden = "HTTP/1.1 403 Forbidden\r\n";
+    constexpr std::string_view unauth = "HTTP/1.1 401 Unauthorized\r\n";
+    constexpr std::string_view not_found = "HTTP/1.1 404 Not Found\r\n";
+    constexpr std::string_view not_allow = "HTTP/1.1 405 Method Not Allowed\r\n";
+    constexpr std::string_view not_implement = "HTTP/1.1 501 Not Implemented\r\n";
+    constexpr std::string_view switch_proto = "HTTP/1.1 101 Switching Protocols\r\n";
+    constexpr std::string_view too_large = "HTTP/1.1 413 Payload Too Large\r\n";
+    constexpr std::string_view server_error = "HTTP/1.1 500 Internal Server Error\r\n";
+    constexpr std::string_view partial = "HTTP/1.1 206 Partial Content\r\n";
+    constexpr std::string_view not_modified = "HTTP/1.1 304 Not Modified\r\n";
+    constexpr std::string_view range_not_satisfiable =
+        "HTTP/1.1 416 Range Not Satisfiable\r\n";
 }
 
 namespace HttpRespNum {
@@ -61,4 +148,22 @@ namespace HttpRespNum {
     constexpr const int not_allow = 405;
     constexpr const int not_implement = 501;
     constexpr const int switch_proto = 101;
-}
\ No newline at end of file
+    constexpr const int too_large = 413;
+    constexpr const int server_error = 500;
+    constexpr const int partial = 206;
+    constexpr const int not_modified = 304;
+    constexpr const int range_not_satisfiable = 416;
+}
+
+/**
+* Writes a frame to a port with a vectored write, without building the frame in one string
+* @return the amount of bytes written
+* @throws std::invalid_argument if the frame is malformed
+*/
+size_t write_frame(Port& port, const HttpFrame& frame);
+
+/**
+* Writes a response to a port, sending its file content with `Port::send_file`
+* @see write_frame(Port&, const HttpFrame&)
+*/
+size_t write_frame(Port& port, const class HttpResponseFrame& frame);
\ No newline at end of file
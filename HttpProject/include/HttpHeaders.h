@@ -0,0 +1,160 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// Headers most requests and responses use, which have a fixed slot in `HttpHeaders`
+enum class KnownHeader : uint8_t {
+    Host, ContentLength, TransferEncoding, Connection, ContentType
+};
+
+constexpr size_t knownHeaderCount = 5;
+
+constexpr std::string_view knownHeaderNames[knownHeaderCount] = {
+    "Host", "Content-Length", "Transfer-Encoding", "Connection", "Content-Type"
+};
+
+/// Ascii helpers of the header functions, shared with the parsers
+namespace detail {
+/// @return the lower case version of an ascii character
+constexpr char ascii_lower(char c) noexcept {
+    return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+/// @return true if `a` and `b` are equal ignoring ascii case
+constexpr bool iequals(std::string_view a, std::string_view b) noexcept {
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (ascii_lower(a[i]) != ascii_lower(b[i]))
+            return false;
+    }
+    return true;
+}
+}
+
+/**
+* Checks a comma separated header value, such as `Connection`, for a token
+* @return true if one of the elements of `list` equals `token` ignoring ascii case
+*/
+constexpr bool has_token(std::string_view list, std::string_view token) noexcept {
+    while (!list.empty()) {
+        const auto comma = list.find(',');
+        auto element = list.substr(0, comma);
+        list = comma == std::string_view::npos ? std::string_view() : list.substr(comma + 1);
+        const auto start = element.find_first_not_of(" \t");
+        if (start == std::string_view::npos)
+            continue;
+        element = element.substr(start, element.find_last_not_of(" \t") + 1 - start);
+        if (detail::iequals(element, token))
+            return true;
+    }
+    return false;
+}
+
+/// @return the case insensitive FNV-1a hash of a header name
+constexpr uint32_t header_hash(std::string_view name) noexcept {
+    uint32_t hash = 2166136261u;
+    for (const auto c : name) {
+        hash ^= static_cast<unsigned char>(detail::ascii_lower(c));
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/// @return the name of a known header
+constexpr std::string_view known_header_name(KnownHeader header) noexcept {
+    return knownHeaderNames[static_cast<size_t>(header)];
+}
+
+/// @return the known header with the case insensitive name `name`, or an empty optional
+constexpr std::optional<KnownHeader> known_header(std::string_view name) noexcept {
+    for (size_t i = 0; i < knownHeaderCount; ++i) {
+        // the known names all have different lengths
+        if (knownHeaderNames[i].size() == name.size())
+            return detail::iequals(knownHeaderNames[i], name)
+                ? std::optional(static_cast<KnownHeader>(i)) : std::nullopt;
+    }
+    return {};
+}
+
+/**
+* Case insensitive map of header names to values, optimized for a few headers.
+*
+* Known headers live in fixed slots, so looking them up is an index once the name
+* is resolved, which happens at compile time when given a `KnownHeader`.
+* Up to `inlineCapacity` other headers are stored inline with their hashes kept
+* together, so a lookup compares a cache line of hashes before comparing any names
+*/
+class HttpHeaders {
+public:
+    static constexpr size_t inlineCapacity = 8;
+
+    /**
+    * Gets the value of a header, adding it with an empty value if it isn't present
+    * @param name case insensitive name of the header
+    */
+    std::string& operator[](std::string_view name);
+
+    /// @see operator[](std::string_view)
+    std::string& operator[](KnownHeader header) noexcept;
+
+    /// @return pointer to the value of a header or nullptr if it isn't present
+    const std::string* find(std::string_view name) const noexcept;
+
+    /// @see find(std::string_view)
+    const std::string* find(KnownHeader header) const noexcept;
+
+    /// Removes a header
+    /// @return true if the header was present
+    bool erase(std::string_view name) noexcept;
+
+    /// @see erase(std::string_view)
+    bool erase(KnownHeader header) noexcept;
+
+    /// @return the amount of headers
+    size_t size() const noexcept;
+
+    /// Removes all headers
+    void clear() noexcept;
+
+    /**
+    * Calls `func(name, value)` for every header, starting with the known headers
+    * @param func callable taking a `std::string_view` name and `const std::string&` value
+    */
+    template<class Func>
+    void for_each(Func&& func) const;
+private:
+    struct Entry {
+        std::string name, value;
+    };
+
+    std::array<std::string, knownHeaderCount> known;
+    /// bit i is set if the known header i is present
+    uint32_t knownMask = 0;
+
+    std::array<uint32_t, inlineCapacity> inlineHashes{};
+    std::array<Entry, inlineCapacity> inlineEntries;
+    uint32_t inlineCount = 0;
+
+    /// headers that didn't fit inline
+    std::vector<uint32_t> spillHashes;
+    std::vector<Entry> spillEntries;
+
+    const Entry* find_entry(std::string_view name, uint32_t hash) const noexcept;
+};
+
+template<class Func>
+void HttpHeaders::for_each(Func&& func) const {
+    for (size_t i = 0; i < knownHeaderCount; ++i) {
+        if (knownMask & (1u << i))
+            func(knownHeaderNames[i], known[i]);
+    }
+    for (size_t i = 0; i < inlineCount; ++i)
+        func(std::string_view(inlineEntries[i].name), inlineEntries[i].value);
+    for (const auto& entry : spillEntries)
+        func(std::string_view(entry.name), entry.value);
+}
@@ -8,4 +8,6 @@ public:
     std::string content;
     /// Path of resource to request
     std::string path;
+
+    void compose_views(std::vector<std::string_view>& out) const override;
 };
\ No newline at end of file
@@ -0,0 +1,173 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "HttpHeaders.h"
+
+/**
+* Incremental parser of HTTP/1.1 request heads.
+*
+* Owns a per-connection buffer which data is read into, either with `feed` or
+* with `prepare` and `commit` to read from a port without an intermediate copy.
+* Requests can be split across any amount of reads: `parse` resumes where the last
+* call stopped instead of rescanning the buffer.
+*
+* The method, path, version and headers of a parsed request are views into the
+* buffer, so parsing allocates nothing once the buffer and header table have grown
+* to fit the connection's requests. Views are invalidated by `feed`, `prepare`
+* and `consume`
+*/
+class HttpRequestParser {
+public:
+    enum class Status {
+        /// More data is needed to finish the request head
+        Incomplete,
+        /// The request head is parsed
+        Done,
+        /// The request is malformed, see `error()`
+        Error
+    };
+
+    enum class Error {
+        None,
+        /// The request line isn't `method SP target SP HTTP/x.y`
+        BadRequestLine,
+        /// A header line is malformed or uses obsolete line folding
+        BadHeader,
+        /// A control character is in the request head
+        BadCharacter,
+        /// The request head is larger than the parser's limit
+        TooLarge
+    };
+
+    struct Header {
+        std::string_view name, value;
+    };
+
+    /**
+    * @param maxHeadSize the largest request head, including the request line, accepted.
+    *   Larger requests fail with `Error::TooLarge`
+    */
+    explicit HttpRequestParser(size_t maxHeadSize = 64 * 1024);
+
+    ~HttpRequestParser();
+    HttpRequestParser(HttpRequestParser&&) noexcept;
+    HttpRequestParser& operator=(HttpRequestParser&&) noexcept;
+
+    /// Copies data to the end of the buffer
+    void feed(std::string_view data);
+
+    /**
+    * Makes sure there are at least `minSpace` unused bytes at the end of the buffer
+    * @return pointer to the unused space and its size, to read data into
+    */
+    std::pair<char*, size_t> prepare(size_t minSpace = 4096);
+
+    /// Marks `bytes` of the space returned by `prepare` as data
+    void commit(size_t bytes) noexcept;
+
+    /**
+    * Reads the data that's immediately available on a port into the buffer
+    * @return the amount of bytes read
+    */
+    size_t read_from(class Port& port);
+
+    /**
+    * Continues parsing the buffered data
+    * @return `Done` once a complete request head has been parsed, after which
+    *   parse keeps returning `Done` until the request is consumed
+    */
+    Status parse();
+
+    /// @return the reason of the last `Error` status
+    Error error() const noexcept;
+
+    /// @{
+    /// Parts of the request, requires `parse` returned `Done`
+    std::string_view method() const noexcept;
+    std::string_view path() const noexcept;
+    std::pair<int, int> http_version() const noexcept;
+    size_t header_count() const noexcept;
+    Header header(size_t index) const noexcept;
+    /// @}
+
+    /**
+    * Finds a header by case insensitive name
+    * @return the value of the first header named `name` or an empty optional
+    */
+    std::optional<std::string_view> find(std::string_view name) const noexcept;
+
+    /// @see find(std::string_view), but without comparing any names
+    std::optional<std::string_view> find(KnownHeader known) const noexcept;
+
+    /// @return the size in bytes of the parsed request head
+    size_t head_size() const noexcept;
+
+    /// @return the data buffered after the request head, the start of the body or next request
+    std::string_view buffered_body() const noexcept;
+
+    /// Copies the request into a frame, without its content
+    void fill(class HttpRequestFrame& frame) const;
+
+    /**
+    * Discards the parsed request head and `bodySize` bytes after it, keeping any
+    * further data, such as pipelined requests, to parse next
+    * @param bodySize the amount of body bytes to discard, at most `buffered_body().size()`
+    */
+    void consume(size_t bodySize = 0) noexcept;
+
+    /// Discards all buffered data and resets the parser
+    void reset() noexcept;
+
+    /**
+    * Frees the buffer if it holds no data and has grown past `maxCapacity`, such as
+    * for a large request body, so a parser kept for reuse doesn't keep that memory
+    */
+    void shrink(size_t maxCapacity) noexcept;
+
+    /// @return the amount of bytes in the buffer
+    size_t size() const noexcept;
+private:
+    enum class State : uint8_t {
+        RequestLine, Headers, Done, Error
+    };
+    /// location of a header in the buffer
+    struct HeaderSlot {
+        uint32_t name, nameLen, value, valueLen;
+    };
+
+    std::unique_ptr<char[]> buffer;
+    size_t capacity, used;
+    size_t maxHeadSize;
+    /// offset the next parse continues scanning from
+    size_t scanPos;
+    /// offset of the line being parsed
+    size_t lineStart;
+    State state;
+    Error err;
+    uint32_t methodLen, pathStart, pathLen;
+    uint32_t headEnd;
+    uint8_t versionMajor, versionMinor;
+    std::vector<HeaderSlot> headers;
+    /// index + 1 of the first header of each known header, 0 if it isn't present
+    std::array<uint16_t, knownHeaderCount> knownSlots;
+
+    /// Parses the line [lineStart, end) in the current state
+    /// @return false if the line is malformed
+    bool parse_line(size_t end);
+    bool parse_request_line(std::string_view line);
+    bool parse_header(std::string_view line);
+    Status fail(Error e) noexcept;
+};
+
+/**
+* Finds the first control character other than tab, which includes the CR and LF
+* ending a line, in [begin, end).
+* Uses SIMD on x86-64, choosing AVX2 at runtime when the cpu supports it
+* @return a pointer to the character or `end` if there is none
+*/
+const char* find_line_end(const char* begin, const char* end) noexcept;
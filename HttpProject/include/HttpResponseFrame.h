@@ -1,8 +1,25 @@
 #pragma once
 #include "HttpFrame.h"
+#include <cstdint>
+#include <memory>
+class MappedFile;
 /// The HTTP response frame sent from servers to clients
 /// to return information
 class HttpResponseFrame : public HttpFrame {
 public:
+    /// Status code and reason phrase, such as `HttpResponse::ok`
     std::string responseCode;
+    /// Content data of response
+    std::string content;
+
+    /// Part of a file sent as content after `content`
+    struct FileBody {
+        std::shared_ptr<const MappedFile> file;
+        uint64_t offset = 0, size = 0;
+    };
+    /// File content of the response, which `write_frame` sends without copying it
+    /// into user space when the port supports it
+    FileBody fileBody;
+
+    void compose_views(std::vector<std::string_view>& out) const override;
 };
\ No newline at end of file
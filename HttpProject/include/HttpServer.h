@@ -0,0 +1,131 @@
+#pragma once
+#include "ContentEncoding.h"
+#include "HttpRequestFrame.h"
+#include "HttpResponseFrame.h"
+#include "Metrics.h"
+#include "Networking.h"
+#include "TlsContext.h"
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+class ResponseCache;
+
+/// Fills in the response to a request
+using HttpHandler = std::function<void(const HttpRequestFrame& request,
+    HttpResponseFrame& response)>;
+
+/// Settings of an `HttpServer`
+struct ServerOptions {
+    /// port to listen on
+    port_t port = 8080;
+    /// amount of worker threads, 0 for one per cpu
+    unsigned threads = 0;
+    /// true to pin each worker thread to its own cpu
+    bool pinThreads = false;
+    /// server context to serve HTTPS with, or null to serve plain HTTP
+    std::shared_ptr<TlsContext> tls;
+    /// largest request head accepted, larger requests are answered with 400
+    size_t maxHeadSize = 64 * 1024;
+    /// largest request body accepted, larger requests are answered with 413
+    size_t maxBodySize = 16 * 1024 * 1024;
+    /// requests answered on a persistent connection before it is closed, 0 for no limit
+    unsigned maxRequestsPerConnection = 1000;
+    /// time a connection may go without sending data, or without reading any of the
+    /// responses waiting for it, before it is closed
+    std::chrono::milliseconds idleTimeout = std::chrono::seconds(30);
+    /// cache answering repeated GET and HEAD requests without calling the handler, or null.
+    /// Can be shared between servers
+    std::shared_ptr<ResponseCache> cache;
+    /// path answered with the metrics of the server in the Prometheus text format,
+    /// or empty to pass every path to the handler
+    std::string metricsPath;
+    /**
+    * Parsing and handling of one in this many requests is timed for the metrics, or
+    * 0 to time nothing, including handshakes. Timing reads the clock twice per phase,
+    * which would cost a few percent of the time of a small request if every request
+    * was timed. Every handshake is timed unless this is 0
+    */
+    unsigned timingInterval = 16;
+    /// compression of response bodies for the clients which accept it
+    CompressionOptions compression;
+};
+
+/**
+* Multi-threaded HTTP/1.1 server.
+*
+* Every worker thread runs its own event loop over its own listening socket.
+* The listeners share the port with SO_REUSEPORT, so the kernel spreads new
+* connections across the workers without a shared accept lock, and a connection
+* stays on the worker which accepted it. Workers share nothing but the handler.
+*
+* Connections persist between requests as HTTP/1.1 and `Connection: keep-alive`
+* ask. Pipelined requests are answered in order, and the responses to all the
+* requests completed by one read are sent with one write. Sockets never block:
+* what a socket doesn't take is kept until it is writable, and the connection isn't
+* read meanwhile, so a client which reads slowly only holds up itself. A client
+* which takes nothing for the idle timeout is closed. A connection is read for at most
+* a fixed amount per wakeup, so a client sending fast can't starve the others, and
+* holds at most `maxHeadSize + maxBodySize` unanswered bytes before it is answered
+* with 413 and closed.
+*
+* With a response cache, cacheable responses to GET requests are stored serialized,
+* and later requests for them are answered from the cache, with 304 if their
+* `If-None-Match` matches the response's ETag.
+*
+* Every worker counts its own connections, bytes and requests and times its own
+* handshakes, parsing and handler calls, without sharing a cache line with another
+* worker. The counts of all workers are only added up when the metrics are read.
+*
+* With compression enabled, 200 responses with a large enough body of a textual type
+* are compressed with the coding the client's `Accept-Encoding` prefers. Compressed
+* copies of file bodies are kept and sent as they are, so a file is compressed once
+* rather than on every request, and the response cache stores the response of each
+* coding separately. Bodies are only compressed if they are sent, not for a 304
+*/
+class HttpServer {
+    struct Impl;
+    struct Worker;
+    std::unique_ptr<Impl> pimpl;
+public:
+    /// Counters of a worker thread
+    struct Stats {
+        /// Amount of connections accepted
+        uint64_t connections;
+        /// Amount of requests answered, including error responses
+        uint64_t requests;
+    };
+
+    /**
+    * Creates the listening sockets of the server, without starting any threads
+    * @param handler called by the worker threads to answer requests, so it must be
+    *   safe to call concurrently
+    * @throw std::runtime_error if the server can't listen on the port
+    * @throw std::invalid_argument if the compression level isn't from 1 to 9
+    */
+    HttpServer(const ServerOptions& options, HttpHandler handler);
+
+    /// Stops the server
+    ~HttpServer();
+
+    HttpServer(const HttpServer&) = delete;
+    HttpServer& operator=(const HttpServer&) = delete;
+
+    /// Starts the worker threads
+    void start();
+
+    /// Stops and joins the worker threads, closing all connections
+    void stop();
+
+    /// @return the amount of worker threads
+    unsigned thread_count() const noexcept;
+
+    /// @return the counters of each worker thread
+    std::vector<Stats> stats() const;
+
+    /// @return the metrics of all worker threads added up
+    ServerMetrics metrics() const;
+};
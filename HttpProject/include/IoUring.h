@@ -0,0 +1,105 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+/**
+* A Linux io_uring, through which the kernel runs socket operations asynchronously.
+*
+* Operations are queued in memory shared with the kernel and submitted in batches, so a
+* batch costs one `io_uring_enter` syscall however many sockets it reads, writes and
+* accepts on, and waiting for the results is part of the same syscall. Multishot
+* accepts and receives stay armed after they complete, producing a completion for
+* every connection or every packet without being queued again. Receives take their
+* buffers from a ring of provided buffers, so idle sockets don't hold a buffer each,
+* and writes from the fixed buffer skip mapping their pages on every write.
+*
+* Requires Linux 6.0 or later. Not thread safe, a ring is used by one thread
+*/
+class IoUring {
+    struct Impl;
+    std::unique_ptr<Impl> pimpl;
+public:
+    /// The result of an operation
+    struct Completion {
+        /// the tag the operation was queued with
+        uint64_t tag;
+        /// what the operation's syscall would have returned, or -errno if it failed
+        int result;
+        /// the provided buffer the data was received into, if `hasBuffer`
+        uint16_t buffer;
+        bool hasBuffer;
+        /// true if the operation is multishot and stays armed
+        bool more;
+    };
+
+    /**
+    * Creates a ring
+    * @param entries the amount of operations which can be queued before they are submitted
+    * @param bufferCount the amount of buffers provided to receives, a power of 2
+    * @param bufferSize the size of each provided buffer
+    * @param fixedSize the size of the fixed buffer, 0 for none
+    * @throw std::runtime_error if io_uring or the operations used aren't supported
+    */
+    explicit IoUring(unsigned entries = 1024, unsigned bufferCount = 4096,
+        unsigned bufferSize = 4096, size_t fixedSize = 1024 * 1024);
+
+    /// Closes the ring, cancelling its operations
+    ~IoUring();
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    /// @return true if rings can be created, which is checked once per process
+    static bool supported() noexcept;
+
+    /// Queues a multishot accept, completing with each accepted socket
+    void accept(int fd, uint64_t tag);
+
+    /// Queues a multishot receive, completing with each piece of data received into a provided buffer
+    void receive(int fd, uint64_t tag);
+
+    /// Queues a send of `data`, which must stay valid until the send completes
+    void send(int fd, const char* data, size_t size, uint64_t tag);
+
+    /// Queues a write of `data`, which must be part of the fixed buffer
+    void write_fixed(int fd, const char* data, size_t size, uint64_t tag);
+
+    /**
+    * Queues a poll, completing once `fd` is readable or writable
+    * @param multishot true to complete every time `fd` becomes ready
+    */
+    void poll(int fd, bool writable, bool multishot, uint64_t tag);
+
+    /// Queues the cancellation of the operations with tag `target`
+    void cancel(uint64_t target, uint64_t tag);
+
+    /**
+    * Submits the queued operations and waits for completions.
+    * Operations the kernel doesn't take yet, as completions are waiting to be taken,
+    * stay queued and are submitted again by the next call
+    * @param waitFor the amount of completions to wait for
+    * @param timeout the longest time to wait, or an empty optional to wait without limit
+    */
+    void submit(unsigned waitFor, std::optional<std::chrono::microseconds> timeout = {});
+
+    /**
+    * Takes the oldest completion which hasn't been taken
+    * @return false if there are no completions
+    */
+    bool next(Completion& completion) noexcept;
+
+    /// @return the memory of a provided buffer
+    const char* buffer(uint16_t id) const noexcept;
+
+    /// Returns a provided buffer to the ring once its data has been used
+    void recycle(uint16_t id) noexcept;
+
+    /// @return the fixed buffer, or nullptr if there is none
+    char* fixed() const noexcept;
+
+    /// @return the size of the fixed buffer
+    size_t fixed_size() const noexcept;
+};
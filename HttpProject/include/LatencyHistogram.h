@@ -0,0 +1,69 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+/**
+* Histogram of latencies with a bounded relative error, in the style of HdrHistogram.
+*
+* Values up to `subBucketCount` nanoseconds have a bucket each. Larger values share
+* buckets which double in width every power of two, with `subBucketCount / 2`
+* buckets per power of two, so every recorded value is off by less than 1 part in
+* 1024 and recording is a few shifts and an increment, whatever the value.
+* Values above `maxValue` are recorded as `maxValue`. Not thread safe, threads
+* record into their own histograms which are merged afterwards
+*/
+class LatencyHistogram {
+public:
+    static constexpr unsigned subBucketBits = 11;
+    static constexpr uint64_t subBucketCount = uint64_t(1) << subBucketBits;
+    /// largest latency recorded exactly, in nanoseconds, about 18 minutes
+    static constexpr uint64_t maxValue = (uint64_t(1) << 40) - 1;
+
+    LatencyHistogram();
+
+    /// Records a latency in nanoseconds
+    void record(uint64_t nanoseconds) noexcept;
+
+    /// Records a latency
+    void record(std::chrono::nanoseconds latency) noexcept {
+        record(latency.count() < 0 ? 0 : static_cast<uint64_t>(latency.count()));
+    }
+
+    /// Adds the values recorded by another histogram
+    void merge(const LatencyHistogram& other) noexcept;
+
+    /// Removes all recorded values
+    void reset() noexcept;
+
+    /// @return the amount of recorded values
+    uint64_t count() const noexcept { return total; }
+
+    /// @return the smallest recorded value, 0 if there are none
+    uint64_t min() const noexcept;
+
+    /// @return the largest recorded value, 0 if there are none
+    uint64_t max() const noexcept;
+
+    /// @return the mean of the recorded values, 0 if there are none
+    double mean() const noexcept;
+
+    /**
+    * @param percentile between 0 and 100
+    * @return the value at or below which `percentile` percent of the recorded values
+    *   are, as the largest value of its bucket, 0 if there are none
+    */
+    uint64_t percentile(double percentile) const noexcept;
+
+    /// @return the index of the bucket a value is counted in
+    static size_t bucket_index(uint64_t value) noexcept;
+
+    /// @return the largest value counted in a bucket
+    static uint64_t bucket_max(size_t index) noexcept;
+private:
+    std::vector<uint64_t> counts;
+    uint64_t total = 0;
+    uint64_t minValue = UINT64_MAX, maxSeen = 0;
+    /// sum of the recorded values, for the mean
+    double sum = 0;
+};
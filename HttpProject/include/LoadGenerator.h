@@ -0,0 +1,64 @@
+#pragma once
+#include "LatencyHistogram.h"
+#include "Networking.h"
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/// Settings of a load test run by `run_load`
+struct LoadOptions {
+    /// host name or ip of the server
+    std::string host = "127.0.0.1";
+    /// port of the server
+    port_t port = 8080;
+    /// true to connect with TLS
+    bool tls = false;
+    /// amount of connections, spread evenly across the threads
+    unsigned connections = 16;
+    /// amount of threads sending requests
+    unsigned threads = 1;
+    /// how long requests are sent for
+    std::chrono::milliseconds duration = std::chrono::seconds(10);
+    /**
+    * Requests per second across all connections. 0 runs a closed loop, where every
+    * connection sends its next request as soon as the last one is answered.
+    * Otherwise every connection sends requests on a fixed schedule, and latencies are
+    * measured from when a request was scheduled instead of when it could be sent, so
+    * a stalled server isn't hidden by the requests that weren't sent while it stalled
+    */
+    double rate = 0;
+    /// complete request sent over and over, responses to which keep the connection open
+    /// unless they have `Connection: close`
+    std::string request = "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n";
+};
+
+/// Outcome of a load test
+struct LoadResult {
+    /// amount of responses received
+    uint64_t responses = 0;
+    /// amount of responses with a status of 400 or above
+    uint64_t errorResponses = 0;
+    /// amount of requests which failed because their connection failed or closed
+    uint64_t failures = 0;
+    /// amount of connections opened after the first ones, after a server closed them
+    uint64_t reconnects = 0;
+    /// time the requests were sent for
+    std::chrono::nanoseconds elapsed{ 0 };
+    /// latencies of the responses
+    LatencyHistogram latency;
+
+    /// @return the responses received per second
+    double throughput() const noexcept {
+        return elapsed.count() == 0 ? 0
+            : static_cast<double>(responses) * 1e9 / static_cast<double>(elapsed.count());
+    }
+};
+
+/**
+* Sends requests to an HTTP server over persistent connections, with one event loop
+* per thread driving its connections, and measures the latency of the responses.
+* Responses are delimited by their `Content-Length` or chunked encoding.
+* Connections which close are opened again
+* @throw std::runtime_error if a connection can't be opened at the start
+*/
+LoadResult run_load(const LoadOptions& options);
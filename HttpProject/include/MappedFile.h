@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <string_view>
+
+/**
+* A regular file opened for reading and mapped into memory.
+*
+* The descriptor stays open, so ports can send the file with `sendfile` instead
+* of from the mapping. A file truncated while it is mapped makes reads past its new
+* end fault, so served files should be replaced, not rewritten in place
+*/
+class MappedFile {
+public:
+    /// @throws std::runtime_error if the file can't be opened or isn't a regular file
+    explicit MappedFile(const std::string& path);
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /// @return the open descriptor of the file, -1 on platforms without `sendfile`
+    int fd() const noexcept { return file; }
+
+    /// @return the contents of the file
+    std::string_view data() const noexcept { return { mapping, length }; }
+
+    /// @return the size of the file in bytes
+    uint64_t size() const noexcept { return length; }
+
+    /// @return the last modification time of the file in seconds since the epoch
+    time_t modified() const noexcept { return static_cast<time_t>(modifiedNs / 1000000000); }
+
+    /// @return the last modification time of the file in nanoseconds since the epoch
+    int64_t modified_ns() const noexcept { return modifiedNs; }
+private:
+    int file = -1;
+    char* mapping = nullptr;
+    size_t length = 0;
+    int64_t modifiedNs = 0;
+};
@@ -0,0 +1,107 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/**
+* Counter which one thread adds to and any thread reads.
+*
+* Adding is a plain load and store instead of an atomic increment, so it costs no
+* more than incrementing an integer, and readers still never see a torn value
+*/
+class MetricCounter {
+    std::atomic<uint64_t> value{ 0 };
+public:
+    /// Adds to the counter, only from the thread which owns it
+    void add(uint64_t amount = 1) noexcept {
+        value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    /// Sets the counter, only from the thread which owns it
+    void set(uint64_t amount) noexcept {
+        value.store(amount, std::memory_order_relaxed);
+    }
+
+    uint64_t get() const noexcept { return value.load(std::memory_order_relaxed); }
+};
+
+/**
+* Histogram of durations which one thread records into and any thread reads,
+* with the buckets of a Prometheus histogram.
+*
+* Bucket `i` counts the durations of at most 2^i microseconds, from 1 microsecond
+* to about 17 seconds, and the last bucket counts the longer ones. Finding the bucket
+* of a duration is a division and a bit scan
+*/
+class MetricHistogram {
+public:
+    /// amount of buckets with an upper bound
+    static constexpr size_t boundedBuckets = 25;
+
+    /// Counts of a histogram, which can be added up across threads
+    struct Snapshot {
+        /// counts of the durations in each bucket, not cumulative
+        std::array<uint64_t, boundedBuckets + 1> buckets{};
+        uint64_t count = 0;
+        /// sum of the durations in nanoseconds
+        uint64_t sum = 0;
+
+        Snapshot& operator+=(const Snapshot& other) noexcept;
+    };
+
+    /// @return the index of the bucket a duration is counted in
+    static size_t bucket_index(std::chrono::nanoseconds duration) noexcept;
+
+    /// @return the upper bound of a bounded bucket in seconds
+    static double bucket_bound(size_t index) noexcept {
+        return static_cast<double>(uint64_t(1) << index) * 1e-6;
+    }
+
+    /// Records a duration, only from the thread which owns the histogram
+    void record(std::chrono::nanoseconds duration) noexcept {
+        buckets[bucket_index(duration)].add();
+        sum.add(duration.count() < 0 ? 0 : static_cast<uint64_t>(duration.count()));
+    }
+
+    /// @return the counts recorded so far
+    Snapshot snapshot() const noexcept;
+private:
+    std::array<MetricCounter, boundedBuckets + 1> buckets;
+    MetricCounter sum;
+};
+
+/// Metrics of an `HttpServer`, added up across its worker threads
+struct ServerMetrics {
+    /// connections accepted, counting TLS connections once their handshake finished
+    uint64_t connectionsAccepted = 0;
+    /// connections closed
+    uint64_t connectionsClosed = 0;
+    /// TLS handshakes which finished
+    uint64_t handshakes = 0;
+    /// TLS handshakes which failed or timed out
+    uint64_t handshakeFailures = 0;
+    /// bytes read from and written to connections, after decryption and before encryption
+    uint64_t bytesRead = 0, bytesWritten = 0;
+    /// requests answered, including error and cached responses
+    uint64_t requests = 0;
+    /// requests answered from the response cache
+    uint64_t cacheHits = 0;
+    /// time spent in accept() for each accepted connection
+    MetricHistogram::Snapshot acceptTime;
+    /// time from accepting a TLS connection to finishing its handshake
+    MetricHistogram::Snapshot handshakeTime;
+    /// time spent parsing each request head
+    MetricHistogram::Snapshot parseTime;
+    /// time spent in the handler for each request
+    MetricHistogram::Snapshot handlerTime;
+
+    /// @return the amount of open connections
+    uint64_t active_connections() const noexcept {
+        return connectionsAccepted - connectionsClosed;
+    }
+
+    /// Appends the metrics to `out` in the Prometheus text exposition format
+    void write_prometheus(std::string& out) const;
+};
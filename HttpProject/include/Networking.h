@@ -1,6 +1,8 @@
 /// \file OS specific includes for networking APIs
 /// Includes some basic defines for cross platform usage
 #pragma once
+#include <chrono>
+#include <cstddef>
 #ifdef WIN32
 #include <WinSock2.h>
 #include <WS2tcpip.h>
@@ -14,6 +16,7 @@ using socket_t = SOCKET;
 #include <net/if.h>
 #include <netdb.h>
 #include <netinet/tcp.h>
+#include <poll.h>
 #include <errno.h>
 #include <unistd.h>
 using socket_t = int;
@@ -24,4 +27,68 @@ using socket_t = int;
 using port_t = unsigned short;
 
 /// Enables or disables blocking mode on a socket
-void sock_block(socket_t sock, bool blocking);
\ No newline at end of file
+void sock_block(socket_t sock, bool blocking);
+
+/// Closes a socket
+void close_sock(socket_t sock);
+
+/**
+* Keeps the writes of the calling thread from raising SIGPIPE while it exists, for the
+* writes which have no flag to suppress it such as `sendfile`, so they fail with EPIPE.
+* Only the thread's signal mask changes: SIGPIPE is blocked, and a SIGPIPE raised
+* meanwhile is consumed before it is unblocked. Does nothing on Windows, which has no SIGPIPE
+*/
+class SigpipeGuard {
+#ifndef WIN32
+    bool wasPending; //< a SIGPIPE was already pending, so it isn't consumed
+    bool wasBlocked; //< the thread already blocked SIGPIPE, so it isn't unblocked
+#endif
+public:
+    SigpipeGuard() noexcept;
+    ~SigpipeGuard();
+
+    SigpipeGuard(const SigpipeGuard&) = delete;
+    SigpipeGuard& operator=(const SigpipeGuard&) = delete;
+};
+
+/**
+* Creates two connected sockets, such as to wake threads waiting on one of them by
+* closing the other. Windows has no socketpair, so the sockets are connected over
+* loopback there
+* @throw std::runtime_error if the sockets can't be created
+*/
+void socket_pair(socket_t (&sockets)[2]);
+
+/**
+* Creates a socket listening on `addr`
+* @param reusePort true to set SO_REUSEPORT, which lets several sockets listen on the
+*   same port, with the kernel spreading new connections across them.
+*   Ignored on platforms without SO_REUSEPORT
+* @throw std::runtime_error if the socket can't listen on `addr`
+*/
+socket_t listen_socket(const class Address& addr, bool reusePort = false);
+
+/**
+* Creates a tcp socket connected to `addr`
+* @throw std::runtime_error if the connection fails
+*/
+socket_t connect_socket(const class Address& addr);
+
+/**
+* Creates a tcp socket connected to the first of several addresses of a host which
+* accepts, racing them as Happy Eyeballs (RFC 8305) does.
+*
+* The addresses are tried in order, alternating between ipv6 and ipv4 starting with
+* the family of the first address, so a broken family costs one attempt delay instead
+* of a timeout per address. An attempt starts every `attemptDelay` or as soon as the
+* previous attempt fails, and the attempts still connecting when one succeeds are closed
+* @param addresses the addresses in order of preference, such as from a `Resolver`
+* @param count the amount of addresses
+* @param[out] connected index of the address which accepted
+* @param timeout the longest time to wait for any address to accept
+* @return the connected socket, in blocking mode
+* @throw std::runtime_error if no address accepts
+*/
+socket_t connect_socket(const class Address* addresses, size_t count, size_t& connected,
+    std::chrono::milliseconds attemptDelay = std::chrono::milliseconds(250),
+    std::chrono::milliseconds timeout = std::chrono::seconds(10));
\ No newline at end of file
@@ -0,0 +1,73 @@
+#pragma once
+#include <cstddef>
+#include <new>
+
+/**
+* Per-thread free lists of blocks the size of `T`, for objects which are created and
+* destroyed over and over, such as the state of every connection.
+*
+* Freed blocks are kept on the freeing thread's list, up to `MaxFree` of them, and
+* handed out again by `allocate` on that thread without calling the global allocator,
+* so threads don't contend in malloc and memory doesn't fragment into blocks of every
+* size. Blocks come from the global allocator, so a block may be freed on any thread.
+*
+* Classes opt in by forwarding their class specific `operator new` and `operator delete`
+*/
+template<class T, size_t MaxFree = 1024>
+class ObjectPool {
+    static_assert(alignof(T) <= alignof(std::max_align_t), "Over-aligned types aren't pooled");
+
+    /// true once the thread's list is destroyed, after which blocks come from and go to
+    /// the global allocator. Trivially destructible, so it can be read after the list is gone
+    static inline thread_local bool tornDown = false;
+
+    struct FreeList {
+        void* head = nullptr;
+        size_t count = 0;
+
+        ~FreeList() {
+            tornDown = true;
+            while (head != nullptr) {
+                const auto next = *static_cast<void**>(head);
+                ::operator delete(head);
+                head = next;
+            }
+        }
+    };
+
+    static FreeList& free_list() noexcept {
+        thread_local FreeList list;
+        return list;
+    }
+
+    static constexpr size_t blockSize = sizeof(T) < sizeof(void*) ? sizeof(void*) : sizeof(T);
+public:
+    /// @return a block for one `T`, reusing a block freed on this thread if there is one
+    static void* allocate() {
+        if (tornDown)
+            return ::operator new(blockSize);
+        auto& list = free_list();
+        if (list.head == nullptr)
+            return ::operator new(blockSize);
+        const auto block = list.head;
+        list.head = *static_cast<void**>(block);
+        --list.count;
+        return block;
+    }
+
+    /// Returns a block from `allocate` to this thread's list
+    static void deallocate(void* block) noexcept {
+        if (tornDown) {
+            ::operator delete(block);
+            return;
+        }
+        auto& list = free_list();
+        if (list.count >= MaxFree) {
+            ::operator delete(block);
+            return;
+        }
+        *static_cast<void**>(block) = list.head;
+        list.head = block;
+        ++list.count;
+    }
+};
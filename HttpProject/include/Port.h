@@ -1,4 +1,5 @@
 #pragma once
+#include <cstdint>
 #include <string_view>
 #include <vector>
 #include <memory>
@@ -37,6 +38,67 @@ public:
     */
     virtual std::vector<char> try_read() = 0;
 
+    /**
+    * Blocking read call into a caller provided buffer.
+    * Lets callers reuse a buffer instead of allocating one for each read
+    * 
+    * @param buffer the buffer to read into
+    * @param size the capacity of `buffer` in bytes
+    * @param minBytes the amount of bytes to wait for, which is clamped to `size`.
+    *   If minBytes is 0, this will read however much data is first available
+    * @returns the amount of bytes read into `buffer`, at least 1 if `size` is non-zero
+    */
+    virtual size_t read_into(char* buffer, size_t size, size_t minBytes = 0) = 0;
+
+    /**
+    * Non blocking read call into a caller provided buffer.
+    * 
+    * @param buffer the buffer to read into
+    * @param size the capacity of `buffer` in bytes
+    * @returns the amount of bytes read into `buffer`, 0 if no data is immediately available
+    */
+    virtual size_t try_read_into(char* buffer, size_t size) = 0;
+
+    /**
+    * Writes all of the buffers to the port, in order, as if they were one buffer.
+    * Lets callers send data held in several places without concatenating it first.
+    * The default implementation writes each buffer separately
+    * 
+    * @param buffers array of `count` buffers to send
+    */
+    virtual void writev(const std::string_view* buffers, size_t count);
+
+    /**
+    * Writes part of a file to the port.
+    * Lets ports send a file without reading it into user space, such as with
+    * `sendfile`. The default implementation writes from the file's mapping
+    * 
+    * @param offset the offset of the first byte to send
+    * @param size the amount of bytes to send, `offset + size` must be at most the file size
+    */
+    virtual void send_file(const class MappedFile& file, uint64_t offset, uint64_t size);
+
+    /**
+    * Writes as much of the buffers as the port takes without blocking, in order.
+    * Lets a server keep the rest for when the port is writable instead of waiting
+    * on a slow reader. A write which took part of the data must be retried with the
+    * rest starting at the same byte, though it may be held somewhere else.
+    * The default implementation writes all of the buffers with `writev`
+    * 
+    * @param buffers array of `count` buffers to send
+    * @return the amount of bytes written, 0 if the port can't take any yet
+    */
+    virtual size_t try_writev(const std::string_view* buffers, size_t count);
+
+    /**
+    * Sends as much of part of a file as the port takes without blocking.
+    * The default implementation sends all of it with `send_file`
+    * 
+    * @see send_file
+    * @return the amount of bytes sent, 0 if the port can't take any yet
+    */
+    virtual uint64_t try_send_file(const class MappedFile& file, uint64_t offset, uint64_t size);
+
     /// Adds a port to an fd set
     /// the fd can query activity on this port
     virtual void add_to_fd(class FdSet& fd) const = 0;
@@ -0,0 +1,95 @@
+#pragma once
+#include "Address.h"
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// Settings of a `Resolver`
+struct ResolverOptions {
+    /// most lookups running at once, each on its own thread as getaddrinfo blocks
+    unsigned threads = 4;
+    /**
+    * How long resolved addresses are cached. getaddrinfo doesn't report the TTLs of
+    * the records it returns, so every name is cached for this long
+    */
+    std::chrono::milliseconds ttl = std::chrono::seconds(30);
+    /// how long a name which couldn't be resolved is cached
+    std::chrono::milliseconds negativeTtl = std::chrono::seconds(5);
+    /// most names cached, the names closest to expiring are evicted first
+    size_t maxEntries = 4096;
+    /**
+    * Looks up the addresses of a name, or null to use getaddrinfo. Called on the
+    * resolver's threads, and throws std::runtime_error if the name can't be resolved.
+    * Lets tests resolve names without a name server
+    */
+    std::function<std::vector<Address>(const std::string& name)> lookup;
+};
+
+/**
+* Resolves host names to addresses on a pool of threads, caching the results.
+*
+* Lookups of a name which is already being looked up wait for that lookup instead of
+* starting another. Addresses are returned in the order getaddrinfo prefers them,
+* which follows the system's address selection rules, with both ipv4 and ipv6
+* addresses so a client can race them (see `connect_socket`).
+* Safe to use from any thread
+*/
+class Resolver {
+    struct Impl;
+    std::unique_ptr<Impl> pimpl;
+public:
+    /// Called with the addresses of a name, or with the exception that resolving it threw
+    using Callback = std::function<void(std::vector<Address> addresses,
+        std::exception_ptr error)>;
+
+    /// Counters of a resolver
+    struct Stats {
+        /// names resolved from the cache, including names which couldn't be resolved
+        uint64_t hits;
+        /// names which weren't cached
+        uint64_t misses;
+        /// lookups run, which is less than the misses when lookups of a name overlap
+        uint64_t lookups;
+    };
+
+    explicit Resolver(ResolverOptions options = {});
+
+    /// Waits for the lookups in progress
+    ~Resolver();
+
+    Resolver(const Resolver&) = delete;
+    Resolver& operator=(const Resolver&) = delete;
+
+    /**
+    * Resolves a name, blocking until it is resolved unless it is cached
+    * @param port the port of the returned addresses
+    * @return the addresses of the name, at least one
+    * @throw std::runtime_error if the name can't be resolved
+    */
+    std::vector<Address> resolve(std::string_view name, unsigned short port);
+
+    /**
+    * Resolves a name without blocking
+    * @param callback called with the addresses, at once if the name is cached,
+    *   otherwise on one of the resolver's threads
+    */
+    void resolve_async(std::string_view name, unsigned short port, Callback callback);
+
+    /// @see resolve_async(std::string_view, unsigned short, Callback)
+    std::future<std::vector<Address>> resolve_async(std::string_view name, unsigned short port);
+
+    /// Forgets every cached name
+    void clear();
+
+    /// @return the counters of this resolver
+    Stats stats() const noexcept;
+
+    /// @return the resolver used to resolve names given to `Address`
+    static Resolver& shared();
+};
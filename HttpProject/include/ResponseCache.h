@@ -0,0 +1,122 @@
+#pragma once
+#include "HttpRequestFrame.h"
+#include "HttpResponseFrame.h"
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// Settings of a `ResponseCache`
+struct CacheOptions {
+    /// amount of independently locked parts of the cache, rounded up to a power of two
+    size_t shards = 16;
+    /// most response bytes kept by the cache, split evenly across the shards
+    size_t maxBytes = 64 * 1024 * 1024;
+    /// time a response is served from the cache after it was stored
+    std::chrono::milliseconds ttl = std::chrono::seconds(60);
+    /// request headers whose values select different responses, such as `Accept-Encoding`.
+    /// Requests with cookies are only cached if `Cookie` is one of them
+    std::vector<std::string> varyHeaders;
+};
+
+/// A response stored by a `ResponseCache`, serialized as it is sent
+struct CachedResponse {
+    /// status line, headers and content of the response
+    std::string bytes;
+    /// offset of the empty line ending the headers in `bytes`, where headers
+    /// which depend on the connection are inserted
+    size_t headSize = 0;
+    /// entity tag of the response, with its quotes
+    std::string etag;
+    /// when the response stops being served
+    std::chrono::steady_clock::time_point expires;
+
+    /// @return the status line and headers, without the empty line ending them
+    std::string_view head() const noexcept { return std::string_view(bytes).substr(0, headSize); }
+
+    /// @return the empty line ending the headers and the content
+    std::string_view tail() const noexcept { return std::string_view(bytes).substr(headSize); }
+};
+
+/// @return true if an `If-None-Match` header matches an entity tag,
+///   comparing weakly as RFC 9110 asks for GET and HEAD requests
+bool etag_matches(std::string_view ifNoneMatch, std::string_view etag) noexcept;
+
+/**
+* Bounded in-memory cache of serialized responses to GET requests.
+*
+* Responses are keyed by their request's method, target and the values of
+* the configured varying headers. The key space is split across shards which are
+* each guarded by their own reader-writer lock, so lookups on different shards never
+* contend and lookups on the same shard only take a shared lock. Eviction uses the
+* CLOCK algorithm, which lets lookups mark entries as used without the exclusive
+* lock an LRU list would need.
+*
+* Stored responses get a strong ETag from a hash of their content unless they
+* already have one, so clients can revalidate them with `If-None-Match`.
+* Thread safe
+*/
+class ResponseCache {
+    struct Impl;
+    std::unique_ptr<Impl> pimpl;
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /// Counters of the cache
+    struct Stats {
+        /// Lookups which found a current response
+        uint64_t hits;
+        /// Lookups which found no response or an expired one
+        uint64_t misses;
+        /// Responses stored
+        uint64_t stores;
+        /// Responses removed to make space or because they expired
+        uint64_t evictions;
+        /// Amount of cached responses
+        uint64_t entries;
+        /// Size of the cached responses
+        uint64_t bytes;
+    };
+
+    explicit ResponseCache(CacheOptions options = {});
+
+    ~ResponseCache();
+
+    ResponseCache(const ResponseCache&) = delete;
+    ResponseCache& operator=(const ResponseCache&) = delete;
+
+    /// @return the options the cache was created with
+    const CacheOptions& options() const noexcept;
+
+    /**
+    * Writes the key of a request into `key`, reusing its capacity
+    * @return false if responses to the request can't be cached, as it has a
+    *   method other than GET and HEAD, credentials, or cookies while `Cookie` isn't
+    *   one of the varying headers
+    */
+    bool make_key(const HttpRequestFrame& request, std::string& key) const;
+
+    /// @return true if a response may be stored: a 200 response with neither
+    ///   a file body, cookies, `Cache-Control: no-store` or `private`, nor a `Connection` header
+    static bool cacheable(const HttpResponseFrame& response) noexcept;
+
+    /// @return the current response stored for a key, or null
+    std::shared_ptr<const CachedResponse> find(std::string_view key, Clock::time_point now);
+
+    /**
+    * Gives a response an ETag if it has none, and stores it for a key, replacing
+    * the response stored before. Responses larger than a shard are not stored.
+    * The response must have its `Content-Length`
+    * @return the stored response, or null if it is too large
+    */
+    std::shared_ptr<const CachedResponse> store(std::string_view key,
+        HttpResponseFrame& response, Clock::time_point now);
+
+    /// Removes every response
+    void clear();
+
+    /// @return the counters of the cache
+    Stats stats() const;
+};
@@ -0,0 +1,91 @@
+#pragma once
+#include "SSLSocket.h"
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <vector>
+
+/**
+* Accepts ssl connections without blocking on any single client.
+*
+* Pending connections are accepted in batches and their handshakes are
+* driven as they become readable or writable, so a slow or stalled client
+* only holds up itself. Connections are handed out once their handshake is done.
+* Handshakes which take longer than the handshake timeout are dropped
+*/
+class SSLAcceptor {
+    struct Impl;
+    std::unique_ptr<Impl> pimpl;
+public:
+    /// Handshake counters of an acceptor
+    struct Stats {
+        /// Amount of tcp connections accepted
+        uint64_t accepted;
+        /// Amount of connections whose handshake finished
+        uint64_t completed;
+        /// Amount of connections dropped because their handshake failed
+        uint64_t failed;
+        /// Amount of connections dropped because their handshake took too long
+        uint64_t timedOut;
+    };
+
+    /**
+    * Creates an acceptor listening on the given address
+    * @param ctx a server context
+    * @param handshakeTimeout the longest time a client can take to finish its handshake
+    * @param reusePort true to let other sockets listen on the same port (SO_REUSEPORT),
+    *   with the kernel spreading new connections across them
+    */
+    SSLAcceptor(const class Address& addr, std::shared_ptr<TlsContext> ctx,
+        std::chrono::milliseconds handshakeTimeout = std::chrono::seconds(10),
+        bool reusePort = false);
+
+    ~SSLAcceptor();
+
+    SSLAcceptor(SSLAcceptor&&) noexcept;
+    SSLAcceptor& operator=(SSLAcceptor&&) noexcept;
+
+    /**
+    * Waits for activity on the listener or pending handshakes, then accepts all
+    * pending connections and continues every handshake that can make progress
+    * @param out vector to append connections that finished their handshake to
+    * @param timeout the maximum time to wait or an empty optional to wait
+    *   until a connection is ready
+    * @return the amount of connections appended to `out`
+    */
+    size_t accept(std::vector<SSLSocket>& out,
+        std::optional<std::chrono::microseconds> timeout = {});
+
+    /**
+    * Adds the acceptor to an fd set, which then reports activity whenever `accept`
+    * has work to do, so an acceptor can share an event loop with other fds.
+    * Once the set reports activity, `accept` should be called with a timeout of 0.
+    * On platforms without epoll, only new connections are reported
+    */
+    void add_to_fd(class FdSet& fd) const;
+
+    /// @return true if the set reported activity of the acceptor after its last wait
+    bool is_in_fd(const class FdSet& fd) const;
+
+    /// Removes the acceptor from an fd set
+    void remove_from_fd(class FdSet& fd) const;
+
+    /// @return the amount of connections whose handshake is in progress
+    size_t pending() const noexcept;
+
+    /// @return the counters of this acceptor
+    Stats stats() const noexcept;
+
+    /**
+    * Records the time from accepting each connection to finishing its handshake
+    * @param histogram histogram which outlives the acceptor, or null to stop recording
+    */
+    void record_handshakes(class MetricHistogram* histogram) noexcept;
+
+    /**
+    * Records the time each call to accept() takes which returns a connection,
+    * apart from the handshakes
+    * @param histogram histogram which outlives the acceptor, or null to stop recording
+    */
+    void record_accepts(class MetricHistogram* histogram) noexcept;
+};
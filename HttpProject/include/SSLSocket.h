@@ -1,16 +1,52 @@
 #pragma once
 #include "Port.h"
+#include "TlsContext.h"
+#include "Task.h"
+#include <optional>
 /// A port to a secure socket
-/// Encrypted with TLS 1.2
+/// Encrypted with TLS 1.2 or later
 class SSLSocket : public Port {
     struct Impl;
     std::unique_ptr<Impl> pimpl;
 
     /// Constructs an SSL socket by taking ownership of a socket
     /// and ssl class
-    SSLSocket(unsigned long long sock, void* ssl, class Address&& addr);
+    SSLSocket(unsigned long long sock, void* ssl, std::shared_ptr<TlsContext> ctx,
+        class Address&& addr);
+
+    friend class SSLAcceptor;
+
+    /**
+    * Accepts a connection without blocking, without starting its handshake
+    * @return the new non-blocking connection or an empty optional if there are no pending connections
+    */
+    std::optional<SSLSocket> try_accept() const;
+
+    /// Creates an ssl connection, whose handshake hasn't started, for an accepted socket
+    SSLSocket make_connection(unsigned long long connection, class Address&& addr,
+        bool blocking) const;
+
+    /**
+    * Continues the server side handshake of a connection from `try_accept`
+    * @return `SSL_ERROR_NONE` if the handshake is done, or `SSL_ERROR_WANT_READ` or
+    *   `SSL_ERROR_WANT_WRITE` if the handshake must be continued once the socket is ready
+    * @throw std::runtime_error if the handshake failed
+    */
+    int step_accept();
+
+    /// Finishes the handshake of a connection from `async_accept`, if it isn't finished
+    Task<void> async_handshake();
 public:
+    /// The directions of a connection which the kernel encrypts (see `TlsContext::enable_ktls`)
+    struct Ktls {
+        /// true if writes are sent with plain syscalls which the kernel encrypts
+        bool send;
+        /// true if reads are received with plain syscalls which the kernel decrypts
+        bool receive;
+    };
+
     /// Creates a client ssl socket connecting to the given address
+    /// Uses a client context shared by all sockets created this way
     explicit SSLSocket(const class Address& addr);
 
     /// Creates a server ssl socket on the given address
@@ -18,6 +54,33 @@ public:
     /// @param keyFile .pem key file
     SSLSocket(const class Address& addr, const char* certificateFile, const char* keyFile);
 
+    /**
+    * Creates a server ssl socket if `ctx` is a server context, otherwise
+    * creates a client ssl socket connecting to the given address
+    * Accepted sockets share the context of their server socket
+    * @param ctx the context to use, cannot be null
+    */
+    SSLSocket(const class Address& addr, std::shared_ptr<TlsContext> ctx);
+
+    /**
+    * Creates a client ssl socket connecting to the given address and writes `firstWrite`.
+    * If the context and the resumed session allow it, `firstWrite` is sent as
+    * early data with the handshake, otherwise it is written once the handshake is done
+    * @param ctx a client context
+    */
+    SSLSocket(const class Address& addr, std::shared_ptr<TlsContext> ctx,
+        std::string_view firstWrite);
+
+    /**
+    * Creates a client ssl socket connected to a host, resolving its name with
+    * `Resolver::shared` and racing its ipv6 and ipv4 addresses (see `connect_socket`).
+    * Sends the host name for SNI, and resumes the last session with the host whichever
+    * of its addresses accepts
+    * @param ctx a client context, or null for the context shared by client sockets
+    */
+    SSLSocket(std::string_view host, unsigned short port,
+        std::shared_ptr<TlsContext> ctx = nullptr);
+
 
     ~SSLSocket();
 
@@ -25,10 +88,42 @@ public:
 
     void write(std::string_view data) override;
 
+    /**
+    * Writes all of the buffers to the socket, in order.
+    * Small buffers are gathered into full TLS records so they aren't each sent
+    * as a record of their own, and buffers larger than a record are encrypted in
+    * place, so at most one record of a large buffer is copied.
+    * When the kernel encrypts the connection, the buffers are sent with one syscall
+    * and the kernel splits them into records
+    */
+    void writev(const std::string_view* buffers, size_t count) override;
+
+    /**
+    * Sends part of a file with `SSL_sendfile` when the kernel encrypts the
+    * connection (see `TlsContext::enable_ktls`), so the file doesn't pass through
+    * user space. Otherwise encrypts the file's mapping, which avoids reading the file
+    * into a buffer first
+    */
+    void send_file(const class MappedFile& file, uint64_t offset, uint64_t size) override;
+
+    /**
+    * Sends what the socket takes of the buffers without blocking, gathered into records
+    * as `writev` does. A record the socket took part of is finished by the next write,
+    * which must start with the rest of the data
+    */
+    size_t try_writev(const std::string_view* buffers, size_t count) override;
+
+    /// Sends what the socket takes of part of a file without blocking, as `send_file` does
+    uint64_t try_send_file(const class MappedFile& file, uint64_t offset, uint64_t size) override;
+
     std::vector<char> read(size_t minBytes) override;
 
     std::vector<char> try_read() override;
 
+    size_t read_into(char* buffer, size_t size, size_t minBytes = 0) override;
+
+    size_t try_read_into(char* buffer, size_t size) override;
+
     void add_to_fd(class FdSet& fd) const override;
 
     bool is_in_fd(const class FdSet& fd) const override;
@@ -45,6 +140,44 @@ public:
     * Gets a new socket connection on this server socket.
     * Requires that this socket is a server socket.
     * Blocks until a connection is available
+    * Any early data sent by the client is already received and is
+    * counted by `available()`
     */
     SSLSocket accept() const;
+
+    /**
+    * Accepts a connection, suspending the awaiting coroutine until a client connects.
+    * The handshake is left to the first `async_read` or `async_write` of the connection,
+    * which throw if it fails, so a slow client only holds up its own coroutine instead
+    * of the one accepting connections. Must be awaited on the thread of a running
+    * `Scheduler`. Requires that this socket is a server socket.
+    * On a scheduler using io_uring, the ring accepts for the socket from then on, and
+    * the ciphertext of a connection awaited there moves through the ring while OpenSSL
+    * only encrypts and decrypts, so the connection can only be awaited from then on
+    */
+    Task<SSLSocket> async_accept() const;
+
+    /**
+    * Reads into a caller provided buffer, suspending the awaiting coroutine until
+    * data is available. Must be awaited on the thread of a running `Scheduler`
+    * @return the amount of bytes read into `buffer`, at least 1 if `size` is non-zero
+    */
+    Task<size_t> async_read(char* buffer, size_t size);
+
+    /**
+    * Writes all of data, suspending the awaiting coroutine whenever the socket can't
+    * take more. Must be awaited on the thread of a running `Scheduler`
+    * @param data the data to write, which must stay valid until the task finishes
+    */
+    Task<void> async_write(std::string_view data);
+
+    /// @return the underlying socket, to find the connection an FdSet reports as ready
+    unsigned long long handle() const noexcept;
+
+    /**
+    * @return the directions the kernel took over once the handshake finished. Both are
+    *   false if kTLS isn't enabled, or the kernel lacks the tls module or the negotiated
+    *   cipher, in which case OpenSSL encrypts in user space as usual
+    */
+    Ktls ktls() const noexcept;
 };
\ No newline at end of file
@@ -0,0 +1,327 @@
+#pragma once
+#include "Task.h"
+#include "FdSet.h"
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <memory>
+#include <span>
+
+/// How a `Scheduler` waits for sockets
+enum class SchedulerBackend {
+    /// io_uring where the kernel supports it, otherwise `FdSet`
+    Automatic,
+    /// waits with `FdSet` until sockets are ready, and coroutines read and write them
+    FdSet,
+    /// reads, writes and accepts on an `IoUring`, which submits them in batches
+    IoUring
+};
+
+/**
+* Links a socket to the state an io_uring scheduler keeps for it: the data its
+* multishot receive has received or the connections its multishot accept has accepted.
+* Destroying the link cancels the operation and frees the state on the scheduler's
+* thread, so the link can be destroyed on any thread, after its socket is closed
+*/
+class RingLink {
+    friend class Scheduler;
+    std::shared_ptr<struct RingRegistry> registry;
+    uint64_t id = 0;
+
+    /// Hands the state to the scheduler to free
+    void release() noexcept;
+public:
+    RingLink() = default;
+
+    ~RingLink();
+
+    RingLink(const RingLink&) = delete;
+    RingLink& operator=(const RingLink&) = delete;
+
+    /// @return true if the socket has been used with an io_uring scheduler
+    bool linked() const noexcept { return id != 0; }
+};
+
+/**
+* Single-threaded event loop which runs coroutines, resuming each one when the fd
+* it awaits is ready, its sleep ends or another thread hands it over.
+*
+* One thread calls `run`, and every coroutine spawned on or scheduled onto the
+* scheduler runs on that thread, so the coroutines of a scheduler never run at once
+* and share its state without locks. Awaiting a port parks the coroutine until its
+* socket is ready instead of blocking the thread, so one thread serves as many
+* connections as it has coroutines, without a thread per connection or polling.
+*
+* On Linux 6.0 and later the scheduler runs the socket operations of `Socket` and
+* `SSLSocket` on an `IoUring` instead of waiting for readiness, so all the reads, writes
+* and accepts its coroutines start before it waits are submitted with one syscall.
+* Elsewhere, or if io_uring is disabled, it falls back to `FdSet`.
+*
+* `spawn`, `stop` and `schedule` may be called from any thread
+*/
+class Scheduler {
+    struct Impl;
+    std::unique_ptr<Impl> pimpl;
+
+    /// Resumes `coroutine` once `fd` is ready for `type`
+    void wait(unsigned long long fd, SetType type, std::coroutine_handle<> coroutine);
+
+    /// Resumes `coroutine` at `time`
+    void wake_at(std::chrono::steady_clock::time_point time, std::coroutine_handle<> coroutine);
+
+    /// Resumes `coroutine` on the scheduler's thread
+    void post(std::coroutine_handle<> coroutine);
+
+    /**
+    * Arms the multishot receive or accept of a linked socket if it isn't armed
+    * @return true if received data, accepted connections or an error are waiting
+    */
+    bool ring_ready(RingLink& link, unsigned long long fd, bool accepting);
+
+    /// Resumes `coroutine` once `ring_ready` would be true
+    void ring_wait(RingLink& link, std::coroutine_handle<> coroutine);
+
+    /**
+    * Copies received data into `buffer`
+    * @throw std::runtime_error if the connection is closed or failed and no data is left
+    */
+    size_t take_received(RingLink& link, char* buffer, size_t size);
+
+    /**
+    * @return an accepted connection
+    * @throw std::runtime_error if accepting failed
+    */
+    unsigned long long take_accepted(RingLink& link);
+public:
+    /// An io_uring operation awaited by a coroutine
+    struct RingOp {
+        std::coroutine_handle<> coroutine;
+        /// what the operation's syscall returned, or -errno
+        int result = 0;
+    };
+private:
+    /// Queues a send on the ring, resuming `op.coroutine` once it completes
+    void ring_send(unsigned long long fd, const char* data, size_t size, bool fixed, RingOp& op);
+public:
+    /// Suspends a coroutine until an fd is ready
+    class FdAwaiter {
+        Scheduler& scheduler;
+        unsigned long long fd;
+        SetType type;
+    public:
+        FdAwaiter(Scheduler& scheduler, unsigned long long fd, SetType type) noexcept :
+            scheduler(scheduler), fd(fd), type(type) {}
+
+        bool await_ready() const noexcept { return false; }
+
+        void await_suspend(std::coroutine_handle<> coroutine) {
+            scheduler.wait(fd, type, coroutine);
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    /// Suspends a coroutine until a time
+    class SleepAwaiter {
+        Scheduler& scheduler;
+        std::chrono::steady_clock::time_point time;
+    public:
+        SleepAwaiter(Scheduler& scheduler, std::chrono::steady_clock::time_point time) noexcept :
+            scheduler(scheduler), time(time) {}
+
+        bool await_ready() const noexcept { return false; }
+
+        void await_suspend(std::coroutine_handle<> coroutine) {
+            scheduler.wake_at(time, coroutine);
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    /// Moves a coroutine onto the scheduler's thread
+    class ScheduleAwaiter {
+        Scheduler& scheduler;
+    public:
+        explicit ScheduleAwaiter(Scheduler& scheduler) noexcept : scheduler(scheduler) {}
+
+        bool await_ready() const noexcept { return false; }
+
+        void await_suspend(std::coroutine_handle<> coroutine) {
+            scheduler.post(coroutine);
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    /// Suspends a coroutine until a send on the ring completes
+    class SendAwaiter {
+        Scheduler& scheduler;
+        unsigned long long fd;
+        const char* data;
+        size_t size;
+        bool fixed;
+        RingOp op;
+    public:
+        SendAwaiter(Scheduler& scheduler, unsigned long long fd, const char* data, size_t size,
+            bool fixed) noexcept :
+            scheduler(scheduler), fd(fd), data(data), size(size), fixed(fixed) {}
+
+        bool await_ready() const noexcept { return false; }
+
+        void await_suspend(std::coroutine_handle<> coroutine) {
+            op.coroutine = coroutine;
+            scheduler.ring_send(fd, data, size, fixed, op);
+        }
+
+        /// @return the amount of bytes sent, or -errno if the send failed
+        int await_resume() const noexcept { return op.result; }
+    };
+
+    /// Suspends a coroutine until a linked socket has received data
+    class ReceiveAwaiter {
+        Scheduler& scheduler;
+        RingLink& link;
+        unsigned long long fd;
+        char* buffer;
+        size_t size;
+    public:
+        ReceiveAwaiter(Scheduler& scheduler, RingLink& link, unsigned long long fd,
+            char* buffer, size_t size) noexcept :
+            scheduler(scheduler), link(link), fd(fd), buffer(buffer), size(size) {}
+
+        bool await_ready() { return scheduler.ring_ready(link, fd, false); }
+
+        void await_suspend(std::coroutine_handle<> coroutine) {
+            scheduler.ring_wait(link, coroutine);
+        }
+
+        /// @return the amount of bytes copied into the buffer
+        size_t await_resume() { return scheduler.take_received(link, buffer, size); }
+    };
+
+    /// Suspends a coroutine until a linked server socket has accepted a connection
+    class AcceptAwaiter {
+        Scheduler& scheduler;
+        RingLink& link;
+        unsigned long long fd;
+    public:
+        AcceptAwaiter(Scheduler& scheduler, RingLink& link, unsigned long long fd) noexcept :
+            scheduler(scheduler), link(link), fd(fd) {}
+
+        bool await_ready() { return scheduler.ring_ready(link, fd, true); }
+
+        void await_suspend(std::coroutine_handle<> coroutine) {
+            scheduler.ring_wait(link, coroutine);
+        }
+
+        /// @return the accepted connection, which is blocking
+        unsigned long long await_resume() { return scheduler.take_accepted(link); }
+    };
+
+    /**
+    * Creates a scheduler
+    * @throw std::runtime_error if `backend` is `SchedulerBackend::IoUring` and io_uring
+    *   isn't supported
+    */
+    explicit Scheduler(SchedulerBackend backend = SchedulerBackend::Automatic);
+
+    /// Destroys the coroutines which haven't finished
+    ~Scheduler();
+
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+
+    /**
+    * Runs a task on the scheduler's thread, without waiting for it.
+    * The task starts once the scheduler runs
+    */
+    void spawn(Task<void> task);
+
+    /**
+    * Runs the spawned tasks on the calling thread until they have all finished or
+    * `stop` is called. Can be called again after it returns
+    * @throw the first exception which escapes a spawned task, leaving the other
+    *   tasks to be run by the next call
+    */
+    void run();
+
+    /// Makes `run` return once the coroutine it is running suspends
+    void stop();
+
+    /// @return an awaitable which resumes the awaiting coroutine once `fd` is readable
+    FdAwaiter readable(unsigned long long fd) noexcept {
+        return { *this, fd, SetType::Read };
+    }
+
+    /// @return an awaitable which resumes the awaiting coroutine once `fd` is writable
+    FdAwaiter writable(unsigned long long fd) noexcept {
+        return { *this, fd, SetType::Write };
+    }
+
+    /// @return an awaitable which resumes the awaiting coroutine after `duration`
+    SleepAwaiter sleep_for(std::chrono::steady_clock::duration duration) noexcept {
+        return { *this, std::chrono::steady_clock::now() + duration };
+    }
+
+    /**
+    * @return an awaitable which resumes the awaiting coroutine on the scheduler's
+    *   thread, such as to return to the scheduler after blocking work on another thread
+    */
+    ScheduleAwaiter schedule() noexcept {
+        return ScheduleAwaiter(*this);
+    }
+
+    /// @return true if socket operations run on an io_uring, and false if they wait with `FdSet`
+    bool uses_ring() const noexcept;
+
+    /**
+    * @return an awaitable which receives data for a socket with its multishot receive,
+    *   and resumes the awaiting coroutine with the amount of bytes copied into `buffer`.
+    *   Requires `uses_ring()`
+    */
+    ReceiveAwaiter receive(RingLink& link, unsigned long long fd, char* buffer,
+        size_t size) noexcept
+    {
+        return { *this, link, fd, buffer, size };
+    }
+
+    /**
+    * @return an awaitable which accepts a connection with the server socket's multishot
+    *   accept, and resumes the awaiting coroutine with the connection. Requires `uses_ring()`
+    */
+    AcceptAwaiter accept(RingLink& link, unsigned long long fd) noexcept {
+        return { *this, link, fd };
+    }
+
+    /**
+    * @return an awaitable which sends `data`, which must stay valid until it is sent,
+    *   and resumes the awaiting coroutine with the amount sent. Requires `uses_ring()`
+    */
+    SendAwaiter send(unsigned long long fd, const char* data, size_t size) noexcept {
+        return { *this, fd, data, size, false };
+    }
+
+    /**
+    * @return an awaitable which writes part of the fixed buffer, see `send`.
+    *   The write raises SIGPIPE if the peer has closed
+    */
+    SendAwaiter write_fixed(unsigned long long fd, const char* data, size_t size) noexcept {
+        return { *this, fd, data, size, true };
+    }
+
+    /**
+    * Takes a free part of the ring's fixed buffer, which writes from without the
+    * kernel mapping its pages each time
+    * @return the part, or an empty span if every part is taken or there is no ring
+    */
+    std::span<char> take_fixed() noexcept;
+
+    /// Frees a part of the fixed buffer from `take_fixed`
+    void return_fixed(std::span<char> part) noexcept;
+
+    /**
+    * @return the scheduler running on the calling thread
+    * @throw std::logic_error if no scheduler is running on the thread
+    */
+    static Scheduler& current();
+};
@@ -1,5 +1,10 @@
 #pragma once
 #include "Port.h"
+#include "Networking.h"
+#include "Task.h"
+#include <cstdint>
+#include <optional>
+#include <string_view>
 
 /// A port to a Berkely socket
 template<class OSSock>
@@ -7,4 +12,166 @@ class Socket : public Port {
     // OSSock can only be a few types.
     // Socket implementation can be done in a cpp file
     // using manual instantiation of the template
-};
\ No newline at end of file
+    struct Impl;
+    std::unique_ptr<Impl> pimpl;
+
+    /// Constructs a socket by taking ownership of a connected socket
+    Socket(OSSock sock, class Address&& addr);
+public:
+    /// Statistics of the zero copy sends on a socket
+    struct ZeroCopyStats {
+        /// Amount of sends made with MSG_ZEROCOPY
+        uint64_t sends;
+        /// Amount of zero copy sends the kernel is done with
+        uint64_t completed;
+        /// Amount of completed sends where the kernel had to copy the data anyway
+        uint64_t copied;
+    };
+
+    /**
+    * Creates a tcp socket on the given address.
+    * If the address is a server address, the socket listens for clients,
+    * otherwise it connects to the address as a client
+    * @param reusePort true to let other sockets listen on the same port (SO_REUSEPORT),
+    *   with the kernel spreading new connections across them
+    */
+    explicit Socket(const class Address& addr, bool reusePort = false);
+
+    /**
+    * Creates a tcp socket connected to a host, resolving its name with
+    * `Resolver::shared` and racing its ipv6 and ipv4 addresses (see `connect_socket`)
+    * @throw std::runtime_error if the name can't be resolved or no address accepts
+    */
+    Socket(std::string_view host, unsigned short port);
+
+    ~Socket();
+
+    size_t available() const noexcept override;
+
+    void write(std::string_view data) override;
+
+    std::vector<char> read(size_t minBytes) override;
+
+    std::vector<char> try_read() override;
+
+    size_t read_into(char* buffer, size_t size, size_t minBytes = 0) override;
+
+    size_t try_read_into(char* buffer, size_t size) override;
+
+    void add_to_fd(class FdSet& fd) const override;
+
+    bool is_in_fd(const class FdSet& fd) const override;
+
+    void remove_from_fd(class FdSet& fd) const override;
+
+    Socket(const Socket&) = delete;
+    Socket& operator=(const Socket&) = delete;
+
+    Socket(Socket&&) noexcept;
+    Socket& operator=(Socket&&) noexcept;
+
+    /**
+    * Gets a new socket connection on this server socket.
+    * Requires that this socket is a server socket.
+    * Blocks until a connection is available
+    */
+    Socket accept() const;
+
+    /**
+    * Accepts a connection without blocking.
+    * Requires that this socket is a server socket
+    * @return the new connection, which is blocking, or an empty optional if there
+    *   are no pending connections
+    */
+    std::optional<Socket> try_accept() const;
+
+    /**
+    * Accepts a connection, suspending the awaiting coroutine until a client connects.
+    * Must be awaited on the thread of a running `Scheduler`.
+    * Requires that this socket is a server socket.
+    * On a scheduler using io_uring, the ring accepts for the socket from then on and
+    * the socket can't use the blocking accepts, and the same goes for the reads of
+    * `async_read`
+    */
+    Task<Socket> async_accept() const;
+
+    /**
+    * Reads into a caller provided buffer, suspending the awaiting coroutine until
+    * data is available. Must be awaited on the thread of a running `Scheduler`
+    * @return the amount of bytes read into `buffer`, at least 1 if `size` is non-zero
+    */
+    Task<size_t> async_read(char* buffer, size_t size);
+
+    /**
+    * Writes all of data, suspending the awaiting coroutine whenever the socket's send
+    * buffer is full. Must be awaited on the thread of a running `Scheduler`
+    * @param data the data to write, which must stay valid until the task finishes
+    */
+    Task<void> async_write(std::string_view data);
+
+    /// @return the underlying socket, to find the connection an FdSet reports as ready
+    unsigned long long handle() const noexcept;
+
+    /**
+    * Writes all of the buffers to the socket, in order, with as few
+    * syscalls as possible and without concatenating them
+    * @param buffers array of `count` buffers to send
+    */
+    void writev(const std::string_view* buffers, size_t count) override;
+
+    /**
+    * Sends part of a file with `sendfile`, so the kernel copies it to the socket
+    * without it passing through user space. Writes from the file's mapping on
+    * platforms without `sendfile`.
+    * Throws instead of raising SIGPIPE if the peer has closed, without changing how
+    * the process handles the signal (see `SigpipeGuard`)
+    */
+    void send_file(const class MappedFile& file, uint64_t offset, uint64_t size) override;
+
+    /// Sends what the socket takes of the buffers without blocking, with `sendmsg`
+    size_t try_writev(const std::string_view* buffers, size_t count) override;
+
+    /// Sends what the socket takes of part of a file without blocking, with `sendfile`
+    uint64_t try_send_file(const class MappedFile& file, uint64_t offset, uint64_t size) override;
+
+    /// Sets TCP_NODELAY, which disables Nagle's algorithm so small writes are sent immediately
+    void set_nodelay(bool enable);
+
+    /**
+    * Corks or uncorks the socket (TCP_CORK).
+    * While corked, partial frames are held back until the socket is uncorked
+    * Does nothing on platforms without TCP_CORK
+    */
+    void set_cork(bool enable);
+
+    /**
+    * Enables sending large payloads with `write_zerocopy` without copying them
+    * into the kernel (MSG_ZEROCOPY). Does nothing on unsupported platforms
+    * @param threshold payloads smaller than this are copied since pinning
+    *   the pages costs more than the copy
+    * @return true if zero copy sends are supported and now enabled
+    */
+    bool enable_zerocopy(size_t threshold = 16384);
+
+    /**
+    * Writes all of data, without copying it if zero copy is enabled and
+    * data is at least as large as the zero copy threshold.
+    * Requires that data is not modified or freed until `zerocopy_pending()` is 0
+    */
+    void write_zerocopy(std::string_view data);
+
+    /**
+    * Processes completion notifications of zero copy sends without blocking
+    * @return the amount of zero copy sends the kernel may still be reading from
+    */
+    size_t zerocopy_pending();
+
+    /// Blocks until the kernel is done with the data of all zero copy sends
+    void flush_zerocopy();
+
+    /// @return statistics of the zero copy sends made on this socket
+    ZeroCopyStats zerocopy_stats() const noexcept;
+};
+
+/// A plain tcp socket using the socket type of the OS
+using TcpSocket = Socket<socket_t>;
\ No newline at end of file
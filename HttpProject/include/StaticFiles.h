@@ -0,0 +1,70 @@
+#pragma once
+#include "HttpRequestFrame.h"
+#include "HttpResponseFrame.h"
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+/// @return a time formatted as an HTTP date, such as `Sun, 06 Nov 1994 08:49:37 GMT`
+std::string format_http_date(time_t time);
+
+/// @return the time of an HTTP date in the preferred (IMF-fixdate) format,
+///   or an empty optional if it isn't one
+std::optional<time_t> parse_http_date(std::string_view date) noexcept;
+
+/**
+* Parses a `Range` header asking for a single range of bytes
+* @param size the size of the resource the range is of
+* @return the first byte and the size of the range, which is empty if no byte of the
+*   resource is in the range, or an empty optional if the header isn't a single
+*   byte range, in which case the header is ignored and the whole resource sent
+*/
+std::optional<std::pair<uint64_t, uint64_t>> parse_byte_range(std::string_view range,
+    uint64_t size) noexcept;
+
+/// @return the media type of a file, based on its extension
+std::string_view content_type(std::string_view path) noexcept;
+
+/**
+* Answers GET and HEAD requests with the files in a directory.
+*
+* Files are sent as the response's file body, so sockets send them with `sendfile`
+* and TLS sockets encrypt straight from the file's mapping. Opened files stay mapped
+* in a cache, which is checked against the file's modification time and size on
+* every request, so changed files are reopened.
+* Answers `Range` requests for one range with 206, and `If-Modified-Since`
+* requests with 304. A path naming a directory serves its `index.html`.
+* Thread safe, so one instance can serve all workers of a server, and copies share
+* the cache
+*/
+class StaticFiles {
+    struct Impl;
+    std::shared_ptr<Impl> pimpl;
+public:
+    /// Counters of the file cache
+    struct Stats {
+        /// Requests answered with a cached file
+        uint64_t hits;
+        /// Requests which opened a file
+        uint64_t misses;
+        /// Size of the cached files
+        uint64_t cachedBytes;
+    };
+
+    /**
+    * @param root the directory to serve the files of
+    * @param maxCachedBytes the most file data kept mapped by the cache. Larger
+    *   files are served without being cached
+    */
+    explicit StaticFiles(std::string root, uint64_t maxCachedBytes = 256 * 1024 * 1024);
+
+    /// Answers a request with the file its path names, or 404 if there is none
+    void operator()(const HttpRequestFrame& request, HttpResponseFrame& response) const;
+
+    /// @return the counters of the cache
+    Stats stats() const;
+};
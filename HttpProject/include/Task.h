@@ -0,0 +1,128 @@
+#pragma once
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+template<class T = void>
+class Task;
+
+/// State shared by the promises of every `Task`
+class TaskPromiseBase {
+    /// coroutine awaiting the task, resumed once the task finishes
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+    std::exception_ptr error;
+
+    /// Resumes the awaiting coroutine without growing the stack
+    struct FinalAwaiter {
+        bool await_ready() const noexcept { return false; }
+
+        template<class Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> task) noexcept {
+            return task.promise().continuation;
+        }
+
+        void await_resume() const noexcept {}
+    };
+public:
+    /// tasks are lazy, they start when they are awaited
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+
+    FinalAwaiter final_suspend() const noexcept { return {}; }
+
+    void unhandled_exception() noexcept { error = std::current_exception(); }
+
+    void set_continuation(std::coroutine_handle<> awaiting) noexcept {
+        continuation = awaiting;
+    }
+protected:
+    /// Throws the exception which escaped the task, if any
+    void rethrow() const {
+        if (error)
+            std::rethrow_exception(error);
+    }
+};
+
+template<class T>
+class TaskPromise : public TaskPromiseBase {
+    std::optional<T> value;
+public:
+    Task<T> get_return_object() noexcept;
+
+    template<class U>
+    void return_value(U&& result) {
+        value.emplace(std::forward<U>(result));
+    }
+
+    /// @return the value of the task, or throws the exception which escaped it
+    T result() {
+        rethrow();
+        return std::move(*value);
+    }
+};
+
+template<>
+class TaskPromise<void> : public TaskPromiseBase {
+public:
+    Task<void> get_return_object() noexcept;
+
+    void return_void() const noexcept {}
+
+    void result() const {
+        rethrow();
+    }
+};
+
+/**
+* A coroutine producing a `T`, which starts when it is awaited and resumes its
+* awaiter when it finishes. Exceptions escaping the coroutine are thrown to the awaiter.
+*
+* Tasks are run by awaiting them from another task, and the outermost task by
+* `Scheduler::spawn`. Destroying a task destroys its coroutine
+*/
+template<class T>
+class Task {
+public:
+    using promise_type = TaskPromise<T>;
+
+    explicit Task(std::coroutine_handle<promise_type> coroutine) noexcept :
+        coroutine(coroutine) {}
+
+    Task(Task&& other) noexcept : coroutine(std::exchange(other.coroutine, {})) {}
+
+    Task& operator=(Task&& other) noexcept {
+        std::swap(coroutine, other.coroutine);
+        return *this;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() {
+        if (coroutine)
+            coroutine.destroy();
+    }
+
+    bool await_ready() const noexcept { return !coroutine || coroutine.done(); }
+
+    /// Starts the task, which resumes `awaiting` once it finishes
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        coroutine.promise().set_continuation(awaiting);
+        return coroutine;
+    }
+
+    T await_resume() {
+        return coroutine.promise().result();
+    }
+private:
+    std::coroutine_handle<promise_type> coroutine;
+};
+
+template<class T>
+Task<T> TaskPromise<T>::get_return_object() noexcept {
+    return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() noexcept {
+    return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
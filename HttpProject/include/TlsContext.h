@@ -0,0 +1,92 @@
+#pragma once
+#include <memory>
+#include <cstdint>
+#include <string>
+
+/**
+* A reusable TLS configuration shared between ssl sockets.
+*
+* Server contexts cache sessions and issue session tickets, client contexts
+* remember the last session of each server address so reconnects can resume
+* it instead of doing a full handshake. A context is thread safe and
+* should be shared with `std::shared_ptr` by every socket using it
+*/
+class TlsContext {
+    struct Impl;
+    std::unique_ptr<Impl> pimpl;
+
+    friend class SSLSocket;
+
+    /**
+    * Creates a new ssl connection object using this context.
+    * For client contexts, resumes the last session with `peer` if there is one
+    * @param peer the key of the server address the client connects to, ignored by servers
+    * @return owning pointer to an SSL object
+    */
+    void* new_ssl(const std::string& peer) const;
+
+    /// Records the result of a finished handshake of an ssl object from `new_ssl`
+    void handshake_done(void* ssl) const noexcept;
+public:
+    /// Statistics of the handshakes made with a context
+    struct Stats {
+        /// Amount of finished handshakes
+        uint64_t handshakes;
+        /// Amount of handshakes that resumed a previous session
+        uint64_t resumed;
+        /// Amount of handshakes after which the kernel encrypts what is sent (see `enable_ktls`)
+        uint64_t ktlsSend;
+        /// Amount of handshakes after which the kernel decrypts what is received
+        uint64_t ktlsReceive;
+
+        /// @return the fraction of handshakes that resumed a session, 0 if there are none
+        double hit_rate() const noexcept {
+            return handshakes == 0 ? 0.0 : static_cast<double>(resumed) / handshakes;
+        }
+    };
+
+    /**
+    * Creates a client context
+    * @param earlyData true to send data before the handshake finishes (TLS 1.3 0-RTT)
+    *   when resuming a session with a server that allows it
+    */
+    explicit TlsContext(bool earlyData = false);
+
+    /**
+    * Creates a server context
+    * @param certificateFile .pem certificate file
+    * @param keyFile .pem key file
+    * @param earlyData true to accept data sent by resuming clients before the handshake
+    *   finishes (TLS 1.3 0-RTT). Early data can be replayed by an attacker, so only enable
+    *   this if the first request of a connection is safe to process more than once
+    */
+    TlsContext(const char* certificateFile, const char* keyFile, bool earlyData = false);
+
+    ~TlsContext();
+
+    TlsContext(const TlsContext&) = delete;
+    TlsContext& operator=(const TlsContext&) = delete;
+
+    /// @return true if this is a server context
+    bool is_server() const noexcept;
+
+    /// @return true if early data is enabled
+    bool early_data() const noexcept;
+
+    /// @return the handshake statistics of all sockets using this context
+    Stats stats() const noexcept;
+
+    /// Forgets all sessions cached by this context
+    void clear_sessions();
+
+    /**
+    * Enables kernel TLS for connections created after the call. Once a handshake
+    * finishes, OpenSSL hands the connection's keys to the kernel if the kernel
+    * supports the cipher, and the connection falls back to user space TLS otherwise.
+    * With kTLS, sockets send and receive with plain syscalls which the kernel encrypts
+    * and decrypts, and `SSLSocket::send_file` sends files without copying them to user
+    * space. `SSLSocket::ktls` and `stats` report which directions the kernel took over
+    * @return false if OpenSSL was built without kTLS, so enabling it has no effect
+    */
+    bool enable_ktls() noexcept;
+};
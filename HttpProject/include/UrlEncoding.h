@@ -0,0 +1,76 @@
+#pragma once
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+class HttpRequestFrame;
+
+/**
+* Decodes percent escapes in place, and `+` as a space if `plusIsSpace`.
+* Malformed escapes are kept as they are.
+* Uses SIMD on x86-64 to skip over data without escapes, choosing AVX2 at
+* runtime when the cpu supports it
+* @return the size of the decoded data, which starts at `data`
+*/
+size_t url_decode_in_place(char* data, size_t size, bool plusIsSpace = true) noexcept;
+
+/**
+* Appends the URL encoding of `data` to `out`
+* @param form true to encode `application/x-www-form-urlencoded` data, which
+*   encodes spaces as `+`, otherwise spaces are encoded as `%20`
+*/
+void url_encode(std::string_view data, std::string& out, bool form = true);
+
+/// @see url_encode(std::string_view, std::string&, bool)
+std::string url_encode(std::string_view data, bool form = true);
+
+/// @return the query of a request path, without the `?` and any fragment
+std::string_view query_string(std::string_view path) noexcept;
+
+/**
+* Decoded key and value pairs of a query string or URL encoded form.
+*
+* The keys and values are views of the decoded data, which is either decoded in
+* place in the caller's buffer, or copied into a buffer owned by the params and
+* reused by each parse. Views are invalidated by the next parse
+*/
+class QueryParams {
+public:
+    struct Param {
+        std::string_view key, value;
+    };
+
+    /// Copies and decodes a query string or form, replacing the current params
+    void parse(std::string_view data);
+
+    /**
+    * Decodes a query string or form in place, replacing the current params
+    * @param data the data to decode, which must outlive the params
+    */
+    void parse_in_place(char* data, size_t size);
+
+    /// Decodes the query of a request's path
+    void parse_query(const HttpRequestFrame& frame);
+
+    /**
+    * Decodes the URL encoded form of a request's content in place, so the content
+    * is left holding the decoded params
+    * @return false, leaving the params empty, if the request's content isn't a form
+    */
+    bool parse_form(HttpRequestFrame& frame);
+
+    /// @return the value of the first param named `key` or an empty optional
+    std::optional<std::string_view> find(std::string_view key) const noexcept;
+
+    size_t size() const noexcept { return params.size(); }
+    bool empty() const noexcept { return params.empty(); }
+    const Param& operator[](size_t index) const noexcept { return params[index]; }
+    auto begin() const noexcept { return params.begin(); }
+    auto end() const noexcept { return params.end(); }
+
+    /// Removes all params
+    void clear() noexcept;
+private:
+    std::vector<Param> params;
+    std::vector<char> storage;
+};
@@ -0,0 +1,150 @@
+#include <HttpServer.h>
+#include <LoadGenerator.h>
+#include <TlsContext.h>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/// Prints how to run the load generator
+void print_usage(const char* program) {
+    std::cerr << "Usage: " << program << " [options]\n"
+        << "  --host <host>        server to load, 127.0.0.1 by default\n"
+        << "  --port <port>        port of the server, 8080 by default\n"
+        << "  --tls                connect with TLS\n"
+        << "  --connections <n>    persistent connections, 16 by default\n"
+        << "  --threads <n>        threads driving the connections, 1 by default\n"
+        << "  --duration <s>       seconds to send requests for, 10 by default\n"
+        << "  --rate <n>           requests per second, a closed loop by default\n"
+        << "  --method <method>    method of the requests, GET by default\n"
+        << "  --path <path>        path of the requests, / by default\n"
+        << "  --header <h: v>      header added to the requests, can be repeated\n"
+        << "  --close              close the connection after every response\n"
+        << "  --stub               load a server started in this process on --port\n"
+        << "  --stub-threads <n>   worker threads of the stub server, 1 by default\n"
+        << "  --cert <file>        certificate of the stub server with --tls\n"
+        << "  --key <file>         private key of the stub server with --tls\n";
+}
+
+/// Prints a latency in the most readable unit
+void print_latency(const char* name, uint64_t nanoseconds) {
+    std::cout << "  " << std::left << std::setw(8) << name << std::right << std::setw(10);
+    if (nanoseconds >= 1000000)
+        std::cout << nanoseconds / 1e6 << " ms\n";
+    else
+        std::cout << nanoseconds / 1e3 << " us\n";
+}
+
+int main(int argc, char** argv) {
+    LoadOptions options;
+    std::string method = "GET", path = "/";
+    std::vector<std::string> headers;
+    auto close = false;
+    auto stub = false;
+    unsigned stubThreads = 1;
+    const char* cert = nullptr;
+    const char* key = nullptr;
+    try {
+        for (auto i = 1; i < argc; ++i) {
+            const auto has_value = i + 1 < argc;
+            if (std::strcmp(argv[i], "--host") == 0 && has_value)
+                options.host = argv[++i];
+            else if (std::strcmp(argv[i], "--port") == 0 && has_value)
+                options.port = static_cast<port_t>(std::stoul(argv[++i]));
+            else if (std::strcmp(argv[i], "--tls") == 0)
+                options.tls = true;
+            else if (std::strcmp(argv[i], "--connections") == 0 && has_value)
+                options.connections = static_cast<unsigned>(std::stoul(argv[++i]));
+            else if (std::strcmp(argv[i], "--threads") == 0 && has_value)
+                options.threads = static_cast<unsigned>(std::stoul(argv[++i]));
+            else if (std::strcmp(argv[i], "--duration") == 0 && has_value)
+                options.duration = std::chrono::milliseconds(
+                    static_cast<long long>(std::stod(argv[++i]) * 1000));
+            else if (std::strcmp(argv[i], "--rate") == 0 && has_value)
+                options.rate = std::stod(argv[++i]);
+            else if (std::strcmp(argv[i], "--method") == 0 && has_value)
+                method = argv[++i];
+            else if (std::strcmp(argv[i], "--path") == 0 && has_value)
+                path = argv[++i];
+            else if (std::strcmp(argv[i], "--header") == 0 && has_value)
+                headers.emplace_back(argv[++i]);
+            else if (std::strcmp(argv[i], "--close") == 0)
+                close = true;
+            else if (std::strcmp(argv[i], "--stub") == 0)
+                stub = true;
+            else if (std::strcmp(argv[i], "--stub-threads") == 0 && has_value)
+                stubThreads = static_cast<unsigned>(std::stoul(argv[++i]));
+            else if (std::strcmp(argv[i], "--cert") == 0 && has_value)
+                cert = argv[++i];
+            else if (std::strcmp(argv[i], "--key") == 0 && has_value)
+                key = argv[++i];
+            else
+                throw std::invalid_argument(argv[i]);
+        }
+        if (stub && options.tls && (cert == nullptr || key == nullptr))
+            throw std::invalid_argument("--stub with --tls needs --cert and --key");
+    }
+    catch (const std::logic_error& e) {
+        std::cerr << "Invalid argument: " << e.what() << '\n';
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    options.request = method + ' ' + path + " HTTP/1.1\r\nHost: " + options.host + "\r\n";
+    for (const auto& header : headers)
+        options.request += header + "\r\n";
+    if (close)
+        options.request += "Connection: close\r\n";
+    options.request += "\r\n";
+
+    try {
+        // a stub server answers from this process, so no network or other server is needed
+        std::unique_ptr<HttpServer> server;
+        if (stub) {
+            ServerOptions serverOptions;
+            serverOptions.port = options.port;
+            serverOptions.threads = stubThreads;
+            serverOptions.maxRequestsPerConnection = 0;
+            if (options.tls)
+                serverOptions.tls = std::make_shared<TlsContext>(cert, key);
+            server = std::make_unique<HttpServer>(serverOptions,
+                [](const HttpRequestFrame&, HttpResponseFrame& response) {
+                    response[KnownHeader::ContentType] = "text/plain";
+                    response.content = "Hello, World!\n";
+                });
+            server->start();
+        }
+
+        const auto result = run_load(options);
+        if (server)
+            server->stop();
+
+        const auto seconds = std::chrono::duration<double>(result.elapsed).count();
+        std::cout << result.responses << " responses in " << seconds << " s over "
+            << options.connections << " connections and " << options.threads << " threads\n"
+            << "  throughput " << std::fixed << std::setprecision(1)
+            << result.throughput() << " req/s\n"
+            << "  errors   " << result.errorResponses << " responses, "
+            << result.failures << " failed requests, "
+            << result.reconnects << " reconnects\n"
+            << "latency" << (options.rate > 0 ? " from scheduled send times\n" : "\n")
+            << std::setprecision(2);
+        print_latency("min", result.latency.min());
+        print_latency("mean", static_cast<uint64_t>(result.latency.mean()));
+        print_latency("p50", result.latency.percentile(50));
+        print_latency("p90", result.latency.percentile(90));
+        print_latency("p99", result.latency.percentile(99));
+        print_latency("p99.9", result.latency.percentile(99.9));
+        print_latency("p99.99", result.latency.percentile(99.99));
+        print_latency("max", result.latency.max());
+    }
+    catch (const std::runtime_error& e) {
+        std::cerr << e.what() << '\n';
+        return EXIT_FAILURE;
+    }
+    return 0;
+}
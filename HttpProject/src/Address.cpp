@@ -1,61 +1,121 @@
-#define _WINSOCK_DEPRECATED_NO_WARNINGS
 #include <Address.h>
 #include <Networking.h>
-#include <algorithm>
+#include <Resolver.h>
+#include <cstring>
 #include <string_view>
 #include <string>
 #include <stdexcept>
 
-Address::Address(unsigned short port)
+Address::Address(unsigned short port) : addrData{}, addrSize(sizeof(sockaddr_in))
 {
-    addrData.sin_family = AF_INET; //ipv4
-    addrData.sin_port = htons(port);
-    addrData.sin_addr.s_addr = INADDR_ANY;
+    auto& ipv4 = reinterpret_cast<sockaddr_in&>(addrData);
+    ipv4.sin_family = AF_INET; //ipv4
+    ipv4.sin_port = htons(port);
+    ipv4.sin_addr.s_addr = INADDR_ANY;
 }
 
-/// @return true if the address in an ipv4 address
-inline bool is_ip(std::string_view addr) {
-    return std::count(addr.begin(), addr.end(), '.') == 3
-        && std::all_of(addr.begin(), addr.end(), [](auto e) {
-        return e == '.' || isdigit(e);
-            });
+Address::Address(std::string_view addrStr, unsigned short port) : Address(port)
+{
+    if (auto ip = from_ip(addrStr, port))
+        *this = *ip;
+    else
+        *this = Resolver::shared().resolve(addrStr, port).front();
 }
 
-Address::Address(std::string_view addrStr, unsigned short port) : Address(port)
+Address::Address(const sockaddr* addr, socklen_t size) : addrData{}, addrSize(size)
 {
-    std::string addrTerm(addrStr); // convert to string to ensure it is null-terminating
-    if (is_ip(addrStr)) {
-        int ret = inet_pton(AF_INET, addrTerm.c_str(), &addrData.sin_addr);
-        if (ret == 0)
-            throw std::invalid_argument("Invalid address string");
-        else if (ret != 1)
-            throw lastError;
-    }
-    else {
-        const auto host = gethostbyname(addrTerm.c_str()); 
-        //only supports Ipv4, see getaddrinfo() for ipv6 support
-        if (host == NULL)
-            throw lastError;
-        addrData.sin_addr = *reinterpret_cast<in_addr*>(*host->h_addr_list);
+    if (size > sizeof(addrData))
+        throw std::invalid_argument("Address is larger than sockaddr_storage");
+    std::memcpy(&addrData, addr, size);
+}
+
+std::optional<Address> Address::from_ip(std::string_view addr, unsigned short port) {
+    if (addr.size() >= 2 && addr.front() == '[' && addr.back() == ']')
+        addr = addr.substr(1, addr.size() - 2);
+    if (addr.empty() || addr.size() >= INET6_ADDRSTRLEN)
+        return {};
+    char ip[INET6_ADDRSTRLEN];
+    addr.copy(ip, addr.size());
+    ip[addr.size()] = '\0'; // inet_pton needs a null terminated string
+    Address result(port);
+    auto& ipv4 = reinterpret_cast<sockaddr_in&>(result.addrData);
+    if (addr.find(':') == std::string_view::npos) {
+        if (inet_pton(AF_INET, ip, &ipv4.sin_addr) != 1)
+            return {};
+        return result;
     }
+    result.addrData = {};
+    auto& ipv6 = reinterpret_cast<sockaddr_in6&>(result.addrData);
+    if (inet_pton(AF_INET6, ip, &ipv6.sin6_addr) != 1)
+        return {};
+    ipv6.sin6_family = AF_INET6;
+    ipv6.sin6_port = htons(port);
+    result.addrSize = sizeof(sockaddr_in6);
+    return result;
 }
 
 bool Address::is_server() const noexcept {
-    return addrData.sin_addr.s_addr == INADDR_ANY;
+    if (addrData.ss_family == AF_INET6) {
+        const auto& ipv6 = reinterpret_cast<const sockaddr_in6&>(addrData);
+        return std::memcmp(&ipv6.sin6_addr, &in6addr_any, sizeof(in6addr_any)) == 0;
+    }
+    return reinterpret_cast<const sockaddr_in&>(addrData).sin_addr.s_addr == INADDR_ANY;
 }
 
 int Address::family() const noexcept {
-    return addrData.sin_family;
+    return addrData.ss_family;
+}
+
+unsigned short Address::port() const noexcept {
+    // the port is at the same offset in the ipv4 and ipv6 structures
+    return ntohs(reinterpret_cast<const sockaddr_in&>(addrData).sin_port);
+}
+
+void Address::set_port(unsigned short port) noexcept {
+    reinterpret_cast<sockaddr_in&>(addrData).sin_port = htons(port);
 }
 
 std::tuple<const sockaddr*, socklen_t> Address::addr() const noexcept
 {
-    return std::make_tuple(reinterpret_cast<const sockaddr*>(&addrData), 
-        static_cast<socklen_t>(sizeof(addrData)));
+    return std::make_tuple(reinterpret_cast<const sockaddr*>(&addrData), addrSize);
 }
 
 std::tuple<struct sockaddr*, socklen_t> Address::addr_mut() noexcept
 {
     return std::make_tuple(reinterpret_cast<sockaddr*>(&addrData), 
         static_cast<socklen_t>(sizeof(addrData)));
+}
+
+std::string Address::to_string() const
+{
+    char ip[INET6_ADDRSTRLEN];
+    const auto ipv6 = addrData.ss_family == AF_INET6;
+    const void* ipData = ipv6
+        ? static_cast<const void*>(&reinterpret_cast<const sockaddr_in6&>(addrData).sin6_addr)
+        : static_cast<const void*>(&reinterpret_cast<const sockaddr_in&>(addrData).sin_addr);
+    if (inet_ntop(addrData.ss_family, ipData, ip, sizeof(ip)) == nullptr)
+        throw std::runtime_error("Failed to format address: " + std::to_string(lastError));
+    const auto portStr = std::to_string(port());
+    std::string formatted;
+    formatted.reserve(std::strlen(ip) + portStr.size() + 3);
+    if (ipv6)
+        formatted.push_back('[');
+    formatted.append(ip);
+    if (ipv6)
+        formatted.push_back(']');
+    formatted.push_back(':');
+    formatted.append(portStr);
+    return formatted;
+}
+
+bool Address::operator==(const Address& other) const noexcept {
+    if (family() != other.family() || port() != other.port())
+        return false;
+    if (family() == AF_INET6) {
+        return std::memcmp(&reinterpret_cast<const sockaddr_in6&>(addrData).sin6_addr,
+            &reinterpret_cast<const sockaddr_in6&>(other.addrData).sin6_addr,
+            sizeof(in6_addr)) == 0;
+    }
+    return reinterpret_cast<const sockaddr_in&>(addrData).sin_addr.s_addr
+        == reinterpret_cast<const sockaddr_in&>(other.addrData).sin_addr.s_addr;
 }
\ No newline at end of file
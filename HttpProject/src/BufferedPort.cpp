@@ -0,0 +1,206 @@
+#include <BufferedPort.h>
+#include <MappedFile.h>
+#include <algorithm>
+#include <stdexcept>
+
+BufferedPort::BufferedPort(Port& port, BufferedPortOptions options) : port(port),
+    options(options), input(std::max<size_t>(options.readBufferSize, 1)) {
+    output.reserve(options.flushSize);
+}
+
+std::string_view BufferedPort::buffered() const noexcept {
+    return { input.data() + pos, end - pos };
+}
+
+void BufferedPort::reserve_input(size_t bytes) {
+    if (pos == end)
+        pos = end = 0;
+    // moving the data back is cheap next to reading into the few bytes left at the end
+    const auto cramped = input.size() - end < input.size() / 4;
+    if (pos > 0 && (input.size() - pos < bytes || cramped)) {
+        std::copy(input.begin() + pos, input.begin() + end, input.begin());
+        end -= pos;
+        pos = 0;
+    }
+    if (input.size() < bytes)
+        input.resize(std::max(bytes, std::min(input.size() * 2, options.maxMessageSize)));
+}
+
+void BufferedPort::fill(size_t bytes) {
+    // the peer may not send anything until it has our output
+    flush();
+    while (end - pos < bytes) {
+        reserve_input(bytes);
+        end += port.read_into(input.data() + end, input.size() - end, bytes - (end - pos));
+    }
+}
+
+size_t BufferedPort::take(char* buffer, size_t size) noexcept {
+    const auto taken = std::min(size, end - pos);
+    std::copy_n(input.data() + pos, taken, buffer);
+    pos += taken;
+    return taken;
+}
+
+std::string_view BufferedPort::read_until(std::string_view delimiter) {
+    size_t scanned = 0; // where the delimiter may start in data not searched yet
+    for (;;) {
+        const auto data = buffered();
+        const auto found = data.find(delimiter, scanned);
+        if (found != data.npos) {
+            pos += found + delimiter.size();
+            return data.substr(0, found + delimiter.size());
+        }
+        if (data.size() >= options.maxMessageSize)
+            throw std::runtime_error("Delimiter not found within the largest message size");
+        scanned = data.size() >= delimiter.size() ? data.size() - delimiter.size() + 1 : 0;
+        fill(data.size() + 1);
+    }
+}
+
+std::string_view BufferedPort::read_exact(size_t bytes) {
+    if (bytes > options.maxMessageSize)
+        throw std::invalid_argument("Read is larger than the largest message size");
+    fill(bytes);
+    const std::string_view data(input.data() + pos, bytes);
+    pos += bytes;
+    return data;
+}
+
+std::string_view BufferedPort::peek(size_t bytes) {
+    if (bytes > options.maxMessageSize)
+        throw std::invalid_argument("Peek is larger than the largest message size");
+    fill(std::max<size_t>(bytes, 1));
+    return buffered();
+}
+
+void BufferedPort::flush() {
+    if (output.empty())
+        return;
+    port.write({ output.data(), output.size() });
+    output.clear();
+}
+
+std::optional<BufferedPort::clock::time_point> BufferedPort::flush_deadline() const noexcept {
+    if (output.empty() || corks > 0 || !options.flushDelay)
+        return {};
+    return firstPending + *options.flushDelay;
+}
+
+bool BufferedPort::flush_if_due() {
+    const auto deadline = flush_deadline();
+    if (!deadline || clock::now() < *deadline)
+        return false;
+    flush();
+    return true;
+}
+
+void BufferedPort::flush_if_needed() {
+    if (corks > 0)
+        return;
+    if (output.size() >= options.flushSize)
+        flush();
+    else
+        flush_if_due();
+}
+
+void BufferedPort::cork() noexcept {
+    ++corks;
+}
+
+void BufferedPort::uncork() {
+    if (corks > 0 && --corks == 0)
+        flush();
+}
+
+size_t BufferedPort::available() const noexcept {
+    return end > pos ? end - pos : port.available();
+}
+
+void BufferedPort::write(std::string_view data) {
+    if (data.empty())
+        return;
+    if (corks == 0 && output.size() + data.size() >= options.flushSize) {
+        // too large to hold, send it along with the buffered output in one call
+        if (output.empty())
+            port.write(data);
+        else {
+            const std::string_view buffers[] = { { output.data(), output.size() }, data };
+            port.writev(buffers, 2);
+            output.clear();
+        }
+        return;
+    }
+    if (output.empty() && options.flushDelay)
+        firstPending = clock::now();
+    output.insert(output.end(), data.begin(), data.end());
+    flush_if_needed();
+}
+
+void BufferedPort::writev(const std::string_view* buffers, size_t count) {
+    for (size_t i = 0; i < count; ++i)
+        write(buffers[i]);
+}
+
+void BufferedPort::send_file(const MappedFile& file, uint64_t offset, uint64_t size) {
+    if (corks > 0 || output.size() + size < options.flushSize) {
+        write(file.data().substr(static_cast<size_t>(offset), static_cast<size_t>(size)));
+        return;
+    }
+    flush();
+    port.send_file(file, offset, size);
+}
+
+std::vector<char> BufferedPort::read(size_t bytes) {
+    if (bytes > 0) {
+        std::vector<char> data(bytes);
+        read_into(data.data(), bytes, bytes);
+        return data;
+    }
+    fill(1);
+    std::vector<char> data(input.begin() + pos, input.begin() + end);
+    pos = end;
+    return data;
+}
+
+std::vector<char> BufferedPort::try_read() {
+    flush_if_due();
+    if (end == pos)
+        return port.try_read();
+    std::vector<char> data(input.begin() + pos, input.begin() + end);
+    pos = end;
+    return data;
+}
+
+size_t BufferedPort::read_into(char* buffer, size_t size, size_t minBytes) {
+    minBytes = std::min(minBytes, size);
+    flush();
+    auto read = take(buffer, size);
+    if (read >= std::max<size_t>(minBytes, 1) || read == size)
+        return read;
+    if (size - read >= input.size())
+        // as large as the buffer, so read straight into the caller's buffer
+        return read + port.read_into(buffer + read, size - read,
+            minBytes > read ? minBytes - read : 0);
+    fill(std::max<size_t>(minBytes - std::min(minBytes, read), 1));
+    return read + take(buffer + read, size - read);
+}
+
+size_t BufferedPort::try_read_into(char* buffer, size_t size) {
+    flush_if_due();
+    if (end == pos)
+        return port.try_read_into(buffer, size);
+    return take(buffer, size);
+}
+
+void BufferedPort::add_to_fd(FdSet& fd) const {
+    port.add_to_fd(fd);
+}
+
+bool BufferedPort::is_in_fd(const FdSet& fd) const {
+    return end > pos || port.is_in_fd(fd);
+}
+
+void BufferedPort::remove_from_fd(FdSet& fd) const {
+    port.remove_from_fd(fd);
+}
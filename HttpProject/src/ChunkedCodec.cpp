@@ -0,0 +1,212 @@
+#include <ChunkedCodec.h>
+#include <Port.h>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+/// @return the value of a hex digit, or -1 if `c` isn't one
+static int hex_value(char c) noexcept {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+ChunkedDecoder::ChunkedDecoder(size_t maxLineSize) noexcept : maxLineSize(maxLineSize) {}
+
+void ChunkedDecoder::fail(Error error) noexcept {
+    state = State::Error;
+    err = error;
+}
+
+std::string_view ChunkedDecoder::decode(std::string_view& input) noexcept {
+    size_t i = 0;
+    for (; i < input.size() && state != State::Done && state != State::Error; ++i) {
+        const auto c = input[i];
+        switch (state) {
+        case State::Size:
+            if (const auto digit = hex_value(c); digit >= 0) {
+                if (remaining >> 60)
+                    fail(Error::BadSize);
+                else {
+                    remaining = remaining << 4 | static_cast<uint64_t>(digit);
+                    sawDigit = true;
+                }
+            }
+            else if (sawDigit && c == '\r')
+                state = State::SizeLF;
+            else if (sawDigit && (c == ';' || c == ' ' || c == '\t'))
+                state = State::Extension;
+            else
+                fail(Error::BadSize);
+            break;
+        case State::Extension:
+            if (c == '\r')
+                state = State::SizeLF;
+            break;
+        case State::SizeLF:
+            if (c != '\n')
+                fail(Error::BadTerminator);
+            else {
+                state = remaining == 0 ? State::TrailerStart : State::Data;
+                sawDigit = false;
+                lineSize = 0;
+            }
+            continue;
+        case State::Data:
+        {
+            const auto size = static_cast<size_t>(
+                std::min<uint64_t>(remaining, input.size() - i));
+            const auto slice = input.substr(i, size);
+            remaining -= size;
+            if (remaining == 0)
+                state = State::DataCR;
+            input.remove_prefix(i + size);
+            return slice;
+        }
+        case State::DataCR:
+            if (c != '\r')
+                fail(Error::BadTerminator);
+            else
+                state = State::DataLF;
+            continue;
+        case State::DataLF:
+            if (c != '\n')
+                fail(Error::BadTerminator);
+            else
+                state = State::Size;
+            continue;
+        case State::TrailerStart:
+            state = c == '\r' ? State::FinalLF : State::Trailer;
+            break;
+        case State::Trailer:
+            if (c == '\r')
+                state = State::TrailerLF;
+            break;
+        case State::TrailerLF:
+            if (c != '\n')
+                fail(Error::BadTerminator);
+            else
+                state = State::TrailerStart;
+            break;
+        case State::FinalLF:
+            if (c != '\n')
+                fail(Error::BadTerminator);
+            else
+                state = State::Done;
+            continue;
+        case State::Done:
+        case State::Error:
+            break;
+        }
+        // size lines and trailers are buffered by callers until they end, so they're limited
+        if (++lineSize > maxLineSize)
+            fail(Error::TooLarge);
+    }
+    // the byte decoding failed at isn't consumed
+    if (state == State::Error && i > 0)
+        --i;
+    input.remove_prefix(i);
+    return {};
+}
+
+ChunkedDecoder::Status ChunkedDecoder::status() const noexcept {
+    switch (state) {
+    case State::Done:
+        return Status::Done;
+    case State::Error:
+        return Status::Error;
+    default:
+        return Status::Incomplete;
+    }
+}
+
+void ChunkedDecoder::reset() noexcept {
+    state = State::Size;
+    err = Error::None;
+    sawDigit = false;
+    remaining = 0;
+    lineSize = 0;
+}
+
+ChunkedReader::ChunkedReader(Port& port, std::string_view buffered, size_t bufferSize) :
+    port(port), buffer(std::max(bufferSize, buffered.size()))
+{
+    std::copy(buffered.begin(), buffered.end(), buffer.begin());
+    end = buffered.size();
+}
+
+std::string_view ChunkedReader::read() {
+    for (;;) {
+        std::string_view input(buffer.data() + pos, end - pos);
+        const auto slice = decoder.decode(input);
+        pos = end - input.size();
+        if (!slice.empty())
+            return slice;
+        switch (decoder.status()) {
+        case ChunkedDecoder::Status::Done:
+            return {};
+        case ChunkedDecoder::Status::Error:
+            throw std::runtime_error("Malformed chunked body: "
+                + std::to_string(static_cast<int>(decoder.error())));
+        case ChunkedDecoder::Status::Incomplete:
+            // the decoder consumed everything, so the buffer can be reused
+            pos = 0;
+            end = port.read_into(buffer.data(), buffer.size());
+            break;
+        }
+    }
+}
+
+bool ChunkedReader::done() const noexcept {
+    return decoder.status() == ChunkedDecoder::Status::Done;
+}
+
+std::string_view ChunkedReader::leftover() const noexcept {
+    return done() ? std::string_view(buffer.data() + pos, end - pos) : std::string_view();
+}
+
+ChunkedWriter::ChunkedWriter(Port& port, size_t chunkSize) :
+    port(port), chunkSize(std::max<size_t>(chunkSize, 1)),
+    buffer(headerSpace + this->chunkSize + 2) {}
+
+void ChunkedWriter::write(std::string_view data) {
+    while (!data.empty()) {
+        const auto size = std::min(data.size(), chunkSize - filled);
+        std::copy_n(data.data(), size, payload() + filled);
+        filled += size;
+        data.remove_prefix(size);
+        if (filled == chunkSize)
+            send_chunk();
+    }
+}
+
+void ChunkedWriter::flush() {
+    if (filled > 0)
+        send_chunk();
+}
+
+void ChunkedWriter::finish() {
+    flush();
+    port.write("0\r\n\r\n");
+}
+
+void ChunkedWriter::send_chunk() {
+    // the size line is written backwards, right before the payload
+    constexpr char digits[] = "0123456789abcdef";
+    auto start = payload();
+    *--start = '\n';
+    *--start = '\r';
+    auto size = filled;
+    do {
+        *--start = digits[size & 0xf];
+        size >>= 4;
+    } while (size != 0);
+    payload()[filled] = '\r';
+    payload()[filled + 1] = '\n';
+    port.write({ start, static_cast<size_t>(payload() + filled + 2 - start) });
+    filled = 0;
+}
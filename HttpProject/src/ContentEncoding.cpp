@@ -0,0 +1,295 @@
+#include <ContentEncoding.h>
+#include <HttpHeaders.h>
+#include <MappedFile.h>
+#include <Port.h>
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <list>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <zlib.h>
+
+std::string_view coding_name(ContentCoding coding) noexcept {
+    switch (coding) {
+    case ContentCoding::Gzip:
+        return "gzip";
+    case ContentCoding::Deflate:
+        return "deflate";
+    default:
+        return "identity";
+    }
+}
+
+/// @return `s` without leading and trailing spaces and tabs
+static std::string_view trim(std::string_view s) noexcept {
+    const auto start = s.find_first_not_of(" \t");
+    if (start == s.npos)
+        return {};
+    return s.substr(start, s.find_last_not_of(" \t") + 1 - start);
+}
+
+/**
+* Parses the weight of an `Accept-Encoding` element, a number from 0 to 1 with up to
+* three decimals
+* @return the weight in thousandths, 0 if it is malformed
+*/
+static int parse_weight(std::string_view q) noexcept {
+    if (q.empty() || (q[0] != '0' && q[0] != '1'))
+        return 0;
+    auto weight = (q[0] - '0') * 1000;
+    if (q.size() > 1) {
+        if (q[1] != '.' || q.size() > 5)
+            return 0;
+        auto scale = 100;
+        for (const auto c : q.substr(2)) {
+            if (c < '0' || c > '9')
+                return 0;
+            weight += (c - '0') * scale;
+            scale /= 10;
+        }
+    }
+    return weight > 1000 ? 0 : weight;
+}
+
+ContentCoding negotiate_coding(std::string_view acceptEncoding) noexcept {
+    // -1 for codings not listed
+    int gzip = -1, deflate = -1, any = -1;
+    while (!acceptEncoding.empty()) {
+        const auto comma = acceptEncoding.find(',');
+        auto element = acceptEncoding.substr(0, comma);
+        acceptEncoding = comma == acceptEncoding.npos ? std::string_view()
+            : acceptEncoding.substr(comma + 1);
+        auto weight = 1000;
+        const auto semicolon = element.find(';');
+        if (semicolon != element.npos) {
+            const auto param = trim(element.substr(semicolon + 1));
+            if (param.size() >= 2 && detail::ascii_lower(param[0]) == 'q' && param[1] == '=')
+                weight = parse_weight(trim(param.substr(2)));
+            element = element.substr(0, semicolon);
+        }
+        element = trim(element);
+        if (detail::iequals(element, "gzip") || detail::iequals(element, "x-gzip"))
+            gzip = weight;
+        else if (detail::iequals(element, "deflate"))
+            deflate = weight;
+        else if (element == "*")
+            any = weight;
+    }
+    if (gzip < 0)
+        gzip = any;
+    if (deflate < 0)
+        deflate = any;
+    if (gzip > 0 && gzip >= deflate)
+        return ContentCoding::Gzip;
+    return deflate > 0 ? ContentCoding::Deflate : ContentCoding::Identity;
+}
+
+/// @return true if `s` starts with `prefix` ignoring ascii case
+static bool istarts_with(std::string_view s, std::string_view prefix) noexcept {
+    return s.size() >= prefix.size() && detail::iequals(s.substr(0, prefix.size()), prefix);
+}
+
+/// @return true if `s` ends with `suffix` ignoring ascii case
+static bool iends_with(std::string_view s, std::string_view suffix) noexcept {
+    return s.size() >= suffix.size() && detail::iequals(s.substr(s.size() - suffix.size()), suffix);
+}
+
+bool compressible_type(std::string_view contentType) noexcept {
+    const auto type = trim(contentType.substr(0, contentType.find(';')));
+    if (istarts_with(type, "text/"))
+        return true;
+    return detail::iequals(type, "application/json") || detail::iequals(type, "application/javascript")
+        || detail::iequals(type, "application/xml") || detail::iequals(type, "application/wasm")
+        || iends_with(type, "+json") || iends_with(type, "+xml");
+}
+
+struct Compressor::State {
+    z_stream stream{};
+    int level;
+    /// true while a compressor uses the thread's state
+    bool inUse = false;
+
+    State(ContentCoding coding, int level) : level(level) {
+        // 16 more window bits asks for the gzip wrapper instead of the zlib one
+        const auto windowBits = coding == ContentCoding::Gzip ? 15 + 16 : 15;
+        if (deflateInit2(&stream, level, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+            throw std::runtime_error("Failed to initialize zlib");
+    }
+
+    ~State() {
+        deflateEnd(&stream);
+    }
+
+    State(const State&) = delete;
+    State& operator=(const State&) = delete;
+};
+
+Compressor::Compressor(ContentCoding coding, int level) {
+    if (coding == ContentCoding::Identity)
+        throw std::invalid_argument("Identity isn't a compressed coding");
+    if (level < 1 || level > 9)
+        throw std::invalid_argument("Compression level must be from 1 to 9");
+    // the states of the calling thread, created on first use
+    thread_local std::unique_ptr<State> states[2];
+    auto& shared = states[coding == ContentCoding::Gzip ? 0 : 1];
+    if (!shared)
+        shared = std::make_unique<State>(coding, level);
+    if (shared->inUse) {
+        owned = std::make_unique<State>(coding, level);
+        state = owned.get();
+        return;
+    }
+    state = shared.get();
+    state->inUse = true;
+    deflateReset(&state->stream);
+    if (state->level != level) {
+        deflateParams(&state->stream, level, Z_DEFAULT_STRATEGY);
+        state->level = level;
+    }
+}
+
+Compressor::~Compressor() {
+    if (!owned)
+        state->inUse = false;
+}
+
+size_t Compressor::compress(std::string_view& input, char* out, size_t size, Flush flush) {
+    if (finished || size == 0)
+        return 0;
+    auto& stream = state->stream;
+    // zlib doesn't write through next_in, it only lacks const for old compilers
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+    const auto given = static_cast<uInt>(std::min<size_t>(input.size(), UINT32_MAX));
+    stream.avail_in = given;
+    stream.next_out = reinterpret_cast<Bytef*>(out);
+    stream.avail_out = static_cast<uInt>(std::min<size_t>(size, UINT32_MAX));
+    const auto mode = flush == Flush::Finish ? Z_FINISH
+        : flush == Flush::Sync ? Z_SYNC_FLUSH : Z_NO_FLUSH;
+    size_t written = 0;
+    // without flushing, deflate may take all of the input without writing anything
+    while (written == 0) {
+        const auto consumedBefore = stream.avail_in;
+        const auto ret = deflate(&stream, mode);
+        written = size - stream.avail_out;
+        if (ret == Z_STREAM_END) {
+            finished = true;
+            break;
+        }
+        // Z_BUF_ERROR is no progress, such as flushing twice
+        if (ret != Z_OK && ret != Z_BUF_ERROR)
+            throw std::runtime_error("Failed to compress: " + std::to_string(ret));
+        if (stream.avail_in == 0 || consumedBefore == stream.avail_in)
+            break;
+    }
+    input.remove_prefix(given - stream.avail_in);
+    return written;
+}
+
+void Compressor::compress_all(std::string_view input, std::string& out) {
+    out.resize(deflateBound(&state->stream, static_cast<uLong>(input.size())));
+    size_t size = 0;
+    while (!finished) {
+        if (size == out.size())
+            out.resize(out.size() * 2);
+        size += compress(input, out.data() + size, out.size() - size, Flush::Finish);
+    }
+    out.resize(size);
+}
+
+CompressedChunkedWriter::CompressedChunkedWriter(Port& port, ContentCoding coding,
+    int level, size_t chunkSize) : chunked(port, chunkSize), compressor(coding, level) {}
+
+void CompressedChunkedWriter::compress(std::string_view data, Compressor::Flush flush) {
+    chunked.write_from([this, &data, flush](char* buffer, size_t size) {
+        return compressor.compress(data, buffer, size, flush);
+    });
+}
+
+void CompressedChunkedWriter::write(std::string_view data) {
+    compress(data, Compressor::Flush::None);
+}
+
+void CompressedChunkedWriter::flush() {
+    compress({}, Compressor::Flush::Sync);
+    chunked.flush();
+}
+
+void CompressedChunkedWriter::finish() {
+    compress({}, Compressor::Flush::Finish);
+    chunked.finish();
+}
+
+struct CompressedFiles::Impl {
+    /// mapping of the file, part of it and coding
+    using Key = std::tuple<const MappedFile*, uint64_t, uint64_t, ContentCoding>;
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const noexcept {
+            auto hash = std::hash<const void*>()(std::get<0>(key));
+            hash = hash * 31 + std::hash<uint64_t>()(std::get<1>(key));
+            hash = hash * 31 + std::hash<uint64_t>()(std::get<2>(key));
+            return hash * 31 + static_cast<size_t>(std::get<3>(key));
+        }
+    };
+
+    struct Entry {
+        /// the file, to tell a copy of a closed file from one of a new file at the same address
+        std::weak_ptr<const MappedFile> file;
+        std::shared_ptr<const std::string> data;
+        std::list<Key>::iterator order;
+    };
+
+    size_t maxBytes;
+    std::mutex mu;
+    std::unordered_map<Key, Entry, KeyHash> entries;
+    /// keys from oldest to newest
+    std::list<Key> order;
+    size_t bytes = 0;
+
+    void erase(std::unordered_map<Key, Entry, KeyHash>::iterator it) {
+        bytes -= it->second.data->size();
+        order.erase(it->second.order);
+        entries.erase(it);
+    }
+};
+
+CompressedFiles::CompressedFiles(size_t maxBytes) : pimpl(std::make_unique<Impl>()) {
+    pimpl->maxBytes = maxBytes;
+}
+
+CompressedFiles::~CompressedFiles() = default;
+
+std::shared_ptr<const std::string> CompressedFiles::get(
+    const std::shared_ptr<const MappedFile>& file, uint64_t offset, uint64_t size,
+    ContentCoding coding, int level)
+{
+    const Impl::Key key(file.get(), offset, size, coding);
+    {
+        std::lock_guard lock(pimpl->mu);
+        const auto it = pimpl->entries.find(key);
+        if (it != pimpl->entries.end()) {
+            if (it->second.file.lock() == file)
+                return it->second.data;
+            pimpl->erase(it);
+        }
+    }
+    // compressed without the lock, two threads may both compress a file seen for the first time
+    auto data = std::make_shared<std::string>();
+    Compressor(coding, level).compress_all(
+        file->data().substr(static_cast<size_t>(offset), static_cast<size_t>(size)), *data);
+    if (data->size() > pimpl->maxBytes)
+        return data;
+    std::lock_guard lock(pimpl->mu);
+    if (const auto it = pimpl->entries.find(key); it != pimpl->entries.end())
+        pimpl->erase(it);
+    while (!pimpl->order.empty() && pimpl->bytes + data->size() > pimpl->maxBytes)
+        pimpl->erase(pimpl->entries.find(pimpl->order.front()));
+    pimpl->order.push_back(key);
+    pimpl->entries.emplace(key, Impl::Entry{ file, data, std::prev(pimpl->order.end()) });
+    pimpl->bytes += data->size();
+    return data;
+}
@@ -0,0 +1,303 @@
+#include <FdSet.h>
+#include <stdexcept>
+#include <string>
+#include <algorithm>
+#include <utility>
+#ifdef __linux__
+#include <poll.h>
+#endif
+#undef min
+#undef max
+
+#ifdef __linux__
+constexpr unsigned char memberFlag = 1;
+constexpr unsigned char readyFlag = 2;
+constexpr size_t minEventCapacity = 64;
+
+/// @return the epoll events corresponding to a type of set
+constexpr unsigned events_of(SetType type) {
+    switch (type) {
+    case SetType::Read:
+        return EPOLLIN | EPOLLRDHUP;
+    case SetType::Write:
+        return EPOLLOUT;
+    default:
+        return EPOLLPRI;
+    }
+}
+
+/// @return a timeout for epoll_wait in milliseconds, rounded up so a
+///     timeout smaller than a millisecond doesn't cause a busy loop
+int to_epoll_timeout(std::optional<std::chrono::microseconds> timeout) {
+    if (!timeout)
+        return -1;
+    const auto ms = std::chrono::ceil<std::chrono::milliseconds>(*timeout).count();
+    return static_cast<int>(std::clamp<decltype(ms)>(ms, 0, INT32_MAX));
+}
+
+FdSet::FdSet(Trigger trigger) : epollFd(epoll_create1(EPOLL_CLOEXEC)),
+    registered(events_of(SetType::Read) | (trigger == Trigger::Edge ? EPOLLET : 0)),
+    trigger(trigger)
+{
+    if (epollFd < 0)
+        throw std::runtime_error("Could not create epoll instance: "
+            + std::to_string(lastError));
+}
+
+FdSet::~FdSet() {
+    if (epollFd >= 0)
+        close(epollFd);
+}
+
+FdSet::FdSet(FdSet&& other) noexcept : epollFd(std::exchange(other.epollFd, -1)),
+    registered(other.registered), flags(std::move(other.flags)),
+    events(std::move(other.events)), readyFds(std::move(other.readyFds)),
+    trigger(other.trigger) {}
+
+FdSet& FdSet::operator=(FdSet&& other) noexcept {
+    std::swap(epollFd, other.epollFd);
+    std::swap(registered, other.registered);
+    std::swap(flags, other.flags);
+    std::swap(events, other.events);
+    std::swap(readyFds, other.readyFds);
+    std::swap(trigger, other.trigger);
+    return *this;
+}
+
+void FdSet::reset() {
+    const auto newFd = epoll_create1(EPOLL_CLOEXEC);
+    if (newFd < 0)
+        throw std::runtime_error("Could not create epoll instance: "
+            + std::to_string(lastError));
+    close(epollFd);
+    epollFd = newFd;
+    flags.clear();
+    readyFds.clear();
+}
+
+bool FdSet::is_set(unsigned long long fd) const noexcept {
+    return fd < flags.size() && (flags[fd] & readyFlag);
+}
+
+void FdSet::add(unsigned long long fd) {
+    epoll_event ev{};
+    ev.events = registered;
+    ev.data.fd = static_cast<int>(fd);
+    // a closed fd is removed from epoll by the kernel, so always re-register
+    // instead of trusting the member flag
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, ev.data.fd, &ev) != 0 && errno != EEXIST)
+        throw std::runtime_error("Could not add fd to set: " + std::to_string(lastError));
+    if (fd >= flags.size())
+        flags.resize(std::max<size_t>(fd + 1, flags.size() * 2));
+    flags[fd] |= memberFlag;
+}
+
+void FdSet::remove(unsigned long long fd) {
+    if (fd >= flags.size() || !(flags[fd] & memberFlag))
+        return;
+    // the fd may have already been closed which removes it from epoll
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, static_cast<int>(fd), nullptr);
+    if (flags[fd] & readyFlag)
+        readyFds.erase(std::find(readyFds.begin(), readyFds.end(),
+            static_cast<socket_t>(fd)));
+    flags[fd] = 0;
+}
+
+void FdSet::clear_ready() noexcept {
+    for (auto fd : readyFds)
+        flags[fd] &= ~readyFlag;
+    readyFds.clear();
+}
+
+/**
+* Changes the events all fds in the set are registered with.
+* Only happens when a set is waited on with a different set type than the last wait
+*/
+void reregister(int epollFd, const std::vector<unsigned char>& flags,
+    unsigned events)
+{
+    for (size_t fd = 0; fd < flags.size(); ++fd) {
+        if (flags[fd] & memberFlag) {
+            epoll_event ev{};
+            ev.events = events;
+            ev.data.fd = static_cast<int>(fd);
+            epoll_ctl(epollFd, EPOLL_CTL_MOD, ev.data.fd, &ev);
+        }
+    }
+}
+
+void FdSet::watch(SetType type) {
+    const auto mask = events_of(type) | (trigger == Trigger::Edge ? EPOLLET : 0);
+    if (mask != registered) {
+        reregister(epollFd, flags, mask);
+        registered = mask;
+    }
+}
+
+/**
+* Collects ready events from an epoll instance into the ready list of its set
+* @return the amount of new ready fds
+*/
+size_t collect(int epollFd, std::vector<epoll_event>& events,
+    std::vector<unsigned char>& flags, std::vector<socket_t>& readyFds, int timeout)
+{
+    size_t total = 0;
+    if (events.size() < minEventCapacity)
+        events.resize(minEventCapacity);
+    for (;;) {
+        const auto count = epoll_wait(epollFd, events.data(),
+            static_cast<int>(events.size()), timeout);
+        if (count < 0) {
+            if (errno == EINTR)
+                return total;
+            throw std::runtime_error("Failed to wait on fd set: "
+                + std::to_string(lastError));
+        }
+        for (auto i = 0; i < count; ++i) {
+            const auto fd = events[i].data.fd;
+            if (static_cast<size_t>(fd) < flags.size() && !(flags[fd] & readyFlag)) {
+                flags[fd] |= readyFlag;
+                readyFds.push_back(fd);
+                ++total;
+            }
+        }
+        if (static_cast<size_t>(count) < events.size())
+            break;
+        // a full batch means there may be more ready fds to collect
+        events.resize(events.size() * 2);
+        timeout = 0;
+    }
+    return total;
+}
+
+size_t FdSet::wait_for(const WaitTarget* targets, size_t count,
+    std::optional<std::chrono::microseconds> timeout)
+{
+    FdSet* sets[3];
+    unsigned masks[3] = {};
+    size_t setCount = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const auto it = std::find(sets, sets + setCount, targets[i].set);
+        const auto idx = static_cast<size_t>(it - sets);
+        if (idx == setCount)
+            sets[setCount++] = targets[i].set;
+        masks[idx] |= events_of(targets[i].type);
+    }
+    for (size_t i = 0; i < setCount; ++i) {
+        const auto set = sets[i];
+        set->clear_ready();
+        const auto mask = masks[i] | (set->trigger == Trigger::Edge ? EPOLLET : 0);
+        if (mask != set->registered) {
+            reregister(set->epollFd, set->flags, mask);
+            set->registered = mask;
+        }
+    }
+
+    if (setCount == 1) {
+        return collect(sets[0]->epollFd, sets[0]->events, sets[0]->flags,
+            sets[0]->readyFds, to_epoll_timeout(timeout));
+    }
+
+    // an epoll fd is readable when it has ready events, so poll the instances
+    // of each set, then collect from those that are ready
+    pollfd polls[3];
+    for (size_t i = 0; i < setCount; ++i)
+        polls[i] = pollfd{ sets[i]->epollFd, POLLIN, 0 };
+    if (poll(polls, setCount, to_epoll_timeout(timeout)) < 0) {
+        if (errno == EINTR)
+            return 0;
+        throw std::runtime_error("Failed to wait on fd sets: "
+            + std::to_string(lastError));
+    }
+    size_t total = 0;
+    for (size_t i = 0; i < setCount; ++i) {
+        if (polls[i].revents & POLLIN) {
+            total += collect(sets[i]->epollFd, sets[i]->events, sets[i]->flags,
+                sets[i]->readyFds, 0);
+        }
+    }
+    return total;
+}
+
+#else
+
+FdSet::FdSet(Trigger trigger) : trigger(trigger) {
+    FD_ZERO(&set);
+    FD_ZERO(&active);
+}
+
+FdSet::~FdSet() = default;
+FdSet::FdSet(FdSet&&) noexcept = default;
+FdSet& FdSet::operator=(FdSet&&) noexcept = default;
+
+void FdSet::reset() {
+    FD_ZERO(&set);
+    FD_ZERO(&active);
+    members.clear();
+    readyFds.clear();
+}
+
+bool FdSet::is_set(unsigned long long fd) const noexcept {
+    return FD_ISSET(static_cast<socket_t>(fd), &active);
+}
+
+void FdSet::add(unsigned long long fd) {
+    if (FD_ISSET(static_cast<socket_t>(fd), &set))
+        return;
+    FD_SET(static_cast<socket_t>(fd), &set);
+    members.push_back(static_cast<socket_t>(fd));
+}
+
+void FdSet::remove(unsigned long long fd) {
+    if (!FD_ISSET(static_cast<socket_t>(fd), &set))
+        return;
+    members.erase(std::find(members.begin(), members.end(), static_cast<socket_t>(fd)));
+    FD_CLR(static_cast<socket_t>(fd), &set);
+    FD_CLR(static_cast<socket_t>(fd), &active);
+    readyFds.erase(std::remove(readyFds.begin(), readyFds.end(),
+        static_cast<socket_t>(fd)), readyFds.end());
+}
+
+void FdSet::clear_ready() noexcept {
+    FD_ZERO(&active);
+    readyFds.clear();
+}
+
+/// select is given the type of activity by each wait, so there is nothing to register
+void FdSet::watch(SetType) {}
+
+/// Edge triggering is not supported by select, so the trigger mode is ignored
+size_t FdSet::wait_for(const WaitTarget* targets, size_t count,
+    std::optional<std::chrono::microseconds> timeout)
+{
+    fd_set* typed[3] = {};
+    socket_t maxFd = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const auto set = targets[i].set;
+        set->clear_ready();
+        set->active = set->set;
+        typed[static_cast<int>(targets[i].type)] = &set->active;
+        for (const auto fd : set->members)
+            maxFd = std::max(maxFd, fd);
+    }
+    timeval tv;
+    if (timeout) {
+        tv.tv_sec = static_cast<long>(timeout->count() / 1000000);
+        tv.tv_usec = static_cast<long>(timeout->count() % 1000000);
+    }
+    const auto ret = select(static_cast<int>(maxFd + 1), typed[0], typed[1], typed[2],
+        timeout ? &tv : nullptr);
+    if (ret == SOCKET_ERROR)
+        throw std::runtime_error("Failed to wait on fd sets: "
+            + std::to_string(lastError));
+    for (size_t i = 0; i < count; ++i) {
+        const auto set = targets[i].set;
+        for (const auto fd : set->members) {
+            if (FD_ISSET(fd, &set->active))
+                set->readyFds.push_back(fd);
+        }
+    }
+    return static_cast<size_t>(ret);
+}
+
+#endif
@@ -0,0 +1,379 @@
+#include <HttpClient.h>
+#include <ChunkedCodec.h>
+#include <HttpHeaders.h>
+#include <SSLSocket.h>
+#include <Socket.h>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <condition_variable>
+#include <iterator>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#undef min
+#undef max
+
+using ClientClock = std::chrono::steady_clock;
+
+/// Largest response head accepted
+constexpr size_t maxResponseHead = 64 * 1024;
+
+/// @return the value of a `Host` header for a host and port
+static std::string host_header(std::string_view host, port_t port, bool tls) {
+    std::string value;
+    // ipv6 literals are written in brackets so their colons aren't taken for the port
+    if (host.find(':') != std::string_view::npos && host.front() != '[')
+        value.append("[").append(host).append("]");
+    else
+        value.append(host);
+    if (port != (tls ? 443 : 80))
+        value.append(":").append(std::to_string(port));
+    return value;
+}
+
+/// @return true if a request with the method can be sent again without changing its effect
+static bool idempotent(HttpFrame::Protocol protocol) noexcept {
+    using P = HttpFrame::Protocol;
+    return protocol == P::GET || protocol == P::HEAD || protocol == P::PUT
+        || protocol == P::DELETE_ || protocol == P::OPTIONS || protocol == P::TRACE;
+}
+
+/**
+* Parses a response head, without its blank line, into `response`
+* @return the status code
+* @throw std::runtime_error if the head is malformed
+*/
+static int parse_head(std::string_view head, HttpResponseFrame& response) {
+    auto lineEnd = head.find("\r\n");
+    const auto statusLine = head.substr(0, lineEnd);
+    // HTTP/1.1 200 OK
+    int status = 0;
+    if (statusLine.size() < 12 || statusLine.compare(0, 5, "HTTP/") != 0
+        || !isdigit(static_cast<unsigned char>(statusLine[5])) || statusLine[6] != '.'
+        || !isdigit(static_cast<unsigned char>(statusLine[7])) || statusLine[8] != ' '
+        || std::from_chars(statusLine.data() + 9, statusLine.data() + 12, status).ec != std::errc())
+    {
+        throw std::runtime_error("Malformed status line");
+    }
+    response.set_http_version(statusLine[5] - '0', statusLine[7] - '0');
+    response.responseCode = std::string(statusLine.substr(9));
+    while (lineEnd < head.size()) {
+        const auto start = lineEnd + 2;
+        lineEnd = std::min(head.find("\r\n", start), head.size());
+        const auto line = head.substr(start, lineEnd - start);
+        const auto colon = line.find(':');
+        if (colon == std::string_view::npos || colon == 0)
+            throw std::runtime_error("Malformed header line");
+        const auto name = line.substr(0, colon);
+        auto value = line.substr(colon + 1);
+        value.remove_prefix(std::min(value.find_first_not_of(" \t"), value.size()));
+        value.remove_suffix(value.size() - (value.find_last_not_of(" \t") + 1));
+        // repeated headers are combined into one list
+        if (response.has_header(name))
+            response[name].append(", ").append(value);
+        else
+            response[name] = std::string(value);
+    }
+    return status;
+}
+
+/**
+* Reads a response from a port
+* @param head true if the response answers a HEAD request, so it has no body
+* @param[out] received set once any of the response has been read
+* @return true if the response was delimited and nothing followed it,
+*   so the connection can carry another request
+* @throw std::runtime_error if the connection fails or the response is malformed
+*/
+static bool read_response(Port& port, bool head, HttpResponseFrame& response, bool& received) {
+    std::string buffer;
+    char chunk[16 * 1024];
+    for (;;) {
+        size_t headEnd, searched = 0;
+        while ((headEnd = buffer.find("\r\n\r\n", searched)) == std::string::npos) {
+            if (buffer.size() > maxResponseHead)
+                throw std::runtime_error("Response head is too large");
+            // the terminator may straddle the data already searched and the next read
+            searched = buffer.size() < 3 ? 0 : buffer.size() - 3;
+            buffer.append(chunk, port.read_into(chunk, sizeof(chunk)));
+            received = true;
+        }
+        const auto status = parse_head(std::string_view(buffer).substr(0, headEnd), response);
+        buffer.erase(0, headEnd + 4);
+        // interim responses, such as 100 Continue, precede the real response
+        if (status / 100 == 1 && status != 101) {
+            response = HttpResponseFrame{};
+            continue;
+        }
+        if (head || status == 101 || status == 204 || status == 304)
+            return buffer.empty() && status != 101 && response.keep_alive();
+        break;
+    }
+
+    const auto encoding = response.headers().find(KnownHeader::TransferEncoding);
+    if (encoding != nullptr && has_token(*encoding, "chunked")) {
+        ChunkedReader reader(port, buffer);
+        for (auto slice = reader.read(); !slice.empty(); slice = reader.read())
+            response.content.append(slice);
+        return reader.leftover().empty() && response.keep_alive();
+    }
+    const auto length = response.headers().find(KnownHeader::ContentLength);
+    if (length == nullptr) {
+        // the body ends when the server closes the connection
+        response.content = std::move(buffer);
+        try {
+            for (;;)
+                response.content.append(chunk, port.read_into(chunk, sizeof(chunk)));
+        }
+        catch (const std::runtime_error&) {}
+        return false;
+    }
+    size_t size = 0;
+    if (std::from_chars(length->data(), length->data() + length->size(), size).ec != std::errc())
+        throw std::runtime_error("Malformed Content-Length");
+    if (buffer.size() > size) {
+        buffer.resize(size);
+        response.content = std::move(buffer);
+        return false;
+    }
+    const auto have = buffer.size();
+    response.content = std::move(buffer);
+    response.content.resize(size);
+    if (have < size)
+        port.read_into(response.content.data() + have, size - have, size - have);
+    return response.keep_alive();
+}
+
+struct HttpClient::Impl {
+    /// A connection waiting in the pool and when it was released
+    struct Idle {
+        std::unique_ptr<Port> port;
+        ClientClock::time_point since;
+    };
+
+    /// The connections to one host
+    struct Host {
+        /// idle connections, the most recently released last
+        std::vector<Idle> idle;
+        /// connections open, idle or in use
+        unsigned open = 0;
+        /// notified when a connection is released or closed
+        std::condition_variable released;
+    };
+
+    /// A connection taken from the pool
+    struct Lease {
+        Host* host;
+        std::unique_ptr<Port> port;
+        /// true if the connection carried a request before
+        bool reused;
+    };
+
+    HttpClientOptions options;
+    /// guards everything below
+    mutable std::mutex mu;
+    std::unordered_map<std::string, std::unique_ptr<Host>> hosts;
+    ClientClock::time_point nextSweep;
+
+    std::atomic<uint64_t> connects{ 0 }, reuses{ 0 }, stale{ 0 }, evictions{ 0 };
+
+    explicit Impl(HttpClientOptions&& options) : options(std::move(options)) {
+        this->options.maxPerHost = std::max(this->options.maxPerHost, 1u);
+        nextSweep = ClientClock::now() + this->options.idleTimeout;
+    }
+
+    /// @return true if an idle connection is still open and has nothing unread
+    static bool healthy(Port& port) noexcept {
+        try {
+            // a closed connection throws, and data before any request means the
+            // server sent something, such as a timeout response, before closing
+            char byte;
+            return port.try_read_into(&byte, 1) == 0;
+        }
+        catch (const std::runtime_error&) {
+            return false;
+        }
+    }
+
+    /**
+    * Takes an idle connection to a host or opens a new one,
+    * waiting for one to be released if the host is at its limit
+    */
+    Lease acquire(const std::string& key, const std::string& name, port_t port, bool tls) {
+        const auto deadline = ClientClock::now() + options.acquireTimeout;
+        std::unique_lock lock(mu);
+        auto& slot = hosts[key];
+        if (!slot)
+            slot = std::make_unique<Host>();
+        auto& host = *slot;
+        for (;;) {
+            while (!host.idle.empty()) {
+                auto idle = std::move(host.idle.back());
+                host.idle.pop_back();
+                const auto expired = ClientClock::now() - idle.since >= options.idleTimeout;
+                // the check reads from the socket, so it is done without holding the lock
+                lock.unlock();
+                if (!expired && healthy(*idle.port)) {
+                    ++reuses;
+                    return { &host, std::move(idle.port), true };
+                }
+                ++(expired ? evictions : stale);
+                idle.port.reset();
+                lock.lock();
+                --host.open;
+            }
+            if (host.open < options.maxPerHost)
+                break;
+            const auto ready = host.released.wait_until(lock, deadline, [&]() {
+                return !host.idle.empty() || host.open < options.maxPerHost;
+            });
+            if (!ready)
+                throw std::runtime_error("Timed out waiting for a connection to " + key);
+        }
+        ++host.open;
+        lock.unlock();
+        try {
+            ++connects;
+            return { &host, open(name, port, tls), false };
+        }
+        catch (...) {
+            close(host);
+            throw;
+        }
+    }
+
+    /// Opens a connection to a host
+    std::unique_ptr<Port> open(const std::string& name, port_t port, bool tls) const {
+        if (tls)
+            return std::make_unique<SSLSocket>(name, port, options.tls);
+        auto sock = std::make_unique<TcpSocket>(name, port);
+        // requests are written whole, so Nagle's algorithm would only delay them
+        sock->set_nodelay(true);
+        return sock;
+    }
+
+    /// Returns a connection to the pool, or closes it if `port` is null
+    void release(Host& host, std::unique_ptr<Port> port) {
+        if (!port) {
+            close(host);
+            return;
+        }
+        const auto now = ClientClock::now();
+        bool sweepDue;
+        {
+            std::lock_guard lock(mu);
+            if (host.idle.size() < options.maxIdlePerHost)
+                host.idle.push_back({ std::move(port), now });
+            else
+                --host.open;
+            host.released.notify_one();
+            sweepDue = now >= nextSweep;
+        }
+        // closes the connection without holding the lock, if it wasn't kept
+        port.reset();
+        if (sweepDue)
+            sweep(now);
+    }
+
+    /// Counts a connection of a host as closed
+    void close(Host& host) {
+        std::lock_guard lock(mu);
+        --host.open;
+        host.released.notify_one();
+    }
+
+    /**
+    * Closes the connections idle longer than the timeout
+    * @return the amount of connections closed
+    */
+    size_t sweep(ClientClock::time_point now) {
+        std::vector<std::unique_ptr<Port>> expired;
+        {
+            std::lock_guard lock(mu);
+            nextSweep = now + options.idleTimeout / 2;
+            for (auto it = hosts.begin(); it != hosts.end();) {
+                auto& host = *it->second;
+                // the connections released first are at the front
+                const auto fresh = std::find_if(host.idle.begin(), host.idle.end(),
+                    [&](const Idle& idle) { return now - idle.since < options.idleTimeout; });
+                for (auto idle = host.idle.begin(); idle != fresh; ++idle)
+                    expired.push_back(std::move(idle->port));
+                host.open -= static_cast<unsigned>(fresh - host.idle.begin());
+                host.idle.erase(host.idle.begin(), fresh);
+                host.released.notify_all();
+                // no thread refers to a host without a connection open to it
+                it = host.open == 0 ? hosts.erase(it) : std::next(it);
+            }
+        }
+        evictions += expired.size();
+        return expired.size();
+    }
+};
+
+HttpClient::HttpClient(HttpClientOptions options) :
+    pimpl(std::make_unique<Impl>(std::move(options))) {}
+
+HttpClient::~HttpClient() = default;
+
+HttpResponseFrame HttpClient::request(std::string_view host, port_t port,
+    HttpRequestFrame& request, bool tls)
+{
+    if (!request.has_header(KnownHeader::Host))
+        request[KnownHeader::Host] = host_header(host, port, tls);
+    if (!request.content.empty() && !request.has_header(KnownHeader::ContentLength)
+        && !request.has_header(KnownHeader::TransferEncoding))
+    {
+        request[KnownHeader::ContentLength] = std::to_string(request.content.size());
+    }
+    std::string name(host);
+    if (name.size() > 2 && name.front() == '[' && name.back() == ']')
+        name = name.substr(1, name.size() - 2);
+    // names are case insensitive
+    std::string key(tls ? "https://" : "http://");
+    std::transform(name.begin(), name.end(), std::back_inserter(key), [](unsigned char c) {
+        return static_cast<char>(std::tolower(c));
+    });
+    key.append(":").append(std::to_string(port));
+
+    for (;;) {
+        auto lease = pimpl->acquire(key, name, port, tls);
+        auto received = false;
+        try {
+            write_frame(*lease.port, request);
+            HttpResponseFrame response;
+            const auto reusable = read_response(*lease.port,
+                request.protocol == HttpFrame::Protocol::HEAD, response, received)
+                && request.keep_alive();
+            pimpl->release(*lease.host, reusable ? std::move(lease.port) : nullptr);
+            return response;
+        }
+        catch (...) {
+            pimpl->release(*lease.host, nullptr);
+            // the server may have closed a reused connection just before the request
+            if (!lease.reused || received || !idempotent(request.protocol))
+                throw;
+        }
+    }
+}
+
+size_t HttpClient::evict_idle() {
+    return pimpl->sweep(ClientClock::now());
+}
+
+size_t HttpClient::idle_count() const {
+    std::lock_guard lock(pimpl->mu);
+    size_t count = 0;
+    for (const auto& [key, host] : pimpl->hosts)
+        count += host->idle.size();
+    return count;
+}
+
+HttpClient::Stats HttpClient::stats() const noexcept {
+    return { pimpl->connects.load(), pimpl->reuses.load(), pimpl->stale.load(),
+        pimpl->evictions.load() };
+}
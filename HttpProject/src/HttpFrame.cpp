@@ -0,0 +1,216 @@
+#include <HttpFrame.h>
+#include <HttpRequestFrame.h>
+#include <HttpResponseFrame.h>
+#include <MappedFile.h>
+#include <Port.h>
+#include <algorithm>
+#include <stdexcept>
+
+constexpr std::string_view protocolNames[] = {
+    "GET", "POST", "HEAD", "PUT", "DELETE", "PATCH", "OPTIONS", "CONNECT", "TRACE"
+};
+
+std::string_view protocol_name(HttpFrame::Protocol protocol) noexcept {
+    return protocolNames[static_cast<int>(protocol)];
+}
+
+std::optional<HttpFrame::Protocol> protocol_from_name(std::string_view name) noexcept {
+    // method names are case sensitive
+    const auto it = std::find(std::begin(protocolNames), std::end(protocolNames), name);
+    if (it == std::end(protocolNames))
+        return {};
+    return static_cast<HttpFrame::Protocol>(it - std::begin(protocolNames));
+}
+
+/// @return true if `c` may be part of a token, such as a header name (RFC 9110 5.6.2)
+static constexpr bool is_tchar(char c) noexcept {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')
+        || std::string_view("!#$%&'*+-.^_`|~").find(c) != std::string_view::npos;
+}
+
+/// @throws std::invalid_argument if `name` isn't a token, so it can't be a header name
+static void check_header_name(std::string_view name) {
+    if (name.empty() || !std::all_of(name.begin(), name.end(), is_tchar))
+        throw std::invalid_argument("Invalid header name: " + std::string(name));
+}
+
+/// @throws std::invalid_argument if a header value has a line break or NUL, which would
+///   let it end the header and add lines of its own to the message
+static void check_header_value(std::string_view name, std::string_view value) {
+    if (value.find_first_of(std::string_view("\r\n\0", 3)) != std::string_view::npos)
+        throw std::invalid_argument("Invalid value of header " + std::string(name));
+}
+
+std::string& HttpFrame::operator[](std::string_view header) {
+    check_header_name(header);
+    return headerData[header];
+}
+
+std::string& HttpFrame::operator[](KnownHeader header) noexcept {
+    return headerData[header];
+}
+
+bool HttpFrame::has_header(std::string_view header) const noexcept {
+    return headerData.find(header) != nullptr;
+}
+
+bool HttpFrame::has_header(KnownHeader header) const noexcept {
+    return headerData.find(header) != nullptr;
+}
+
+const std::string& HttpFrame::get(std::string_view header) const {
+    const auto value = headerData.find(header);
+    if (value == nullptr)
+        throw std::out_of_range("Missing header: " + std::string(header));
+    return *value;
+}
+
+const std::string& HttpFrame::get(KnownHeader header) const {
+    const auto value = headerData.find(header);
+    if (value == nullptr)
+        throw std::out_of_range("Missing header: " + std::string(known_header_name(header)));
+    return *value;
+}
+
+std::pair<int, int> HttpFrame::http_version() const noexcept {
+    return { versionMajor, versionMinor };
+}
+
+void HttpFrame::set_http_version(int major, int minor) noexcept {
+    versionMajor = major;
+    versionMinor = minor;
+}
+
+bool HttpFrame::keep_alive() const noexcept {
+    const auto connection = headerData.find(KnownHeader::Connection);
+    if (versionMajor > 1 || (versionMajor == 1 && versionMinor >= 1))
+        return connection == nullptr || !has_token(*connection, "close");
+    return connection != nullptr && has_token(*connection, "keep-alive");
+}
+
+std::string HttpFrame::compose() {
+    std::vector<std::string_view> views;
+    compose_views(views);
+    size_t size = 0;
+    for (const auto view : views)
+        size += view.size();
+    std::string out;
+    out.reserve(size);
+    for (const auto view : views)
+        out.append(view);
+    return out;
+}
+
+void HttpFrame::check_headers() const {
+    headerData.for_each([](std::string_view name, const std::string& value) {
+        check_header_value(name, value);
+        });
+}
+
+void HttpFrame::compose_headers(std::vector<std::string_view>& out) const {
+    headerData.for_each([&out](std::string_view name, const std::string& value) {
+        // values are set through references, so they are checked when they are sent
+        check_header_value(name, value);
+        out.insert(out.end(), { name, ": ", value, "\r\n" });
+        });
+    out.emplace_back("\r\n");
+}
+
+constexpr std::string_view versionDigits[] = {
+    "0", "1", "2", "3", "4", "5", "6", "7", "8", "9"
+};
+
+/// Appends the pieces of `HTTP/major.minor` to `out`
+/// @throws std::invalid_argument if the version can't be written as two digits
+static void compose_version(std::vector<std::string_view>& out, std::pair<int, int> version) {
+    const auto [major, minor] = version;
+    if (major < 0 || major > 9 || minor < 0 || minor > 9)
+        throw std::invalid_argument("Invalid HTTP version");
+    out.insert(out.end(), { "HTTP/", versionDigits[major], ".", versionDigits[minor] });
+}
+
+void HttpRequestFrame::compose_views(std::vector<std::string_view>& out) const {
+    if (path.empty())
+        throw std::invalid_argument("Request has no path");
+    out.insert(out.end(), { protocol_name(protocol), " ", path });
+    if (http_version() == std::pair(1, 1))
+        out.emplace_back(" HTTP/1.1\r\n");
+    else {
+        out.emplace_back(" ");
+        compose_version(out, http_version());
+        out.emplace_back("\r\n");
+    }
+    compose_headers(out);
+    if (!content.empty())
+        out.emplace_back(content);
+}
+
+/// Status lines of the responses with a precomposed HTTP/1.1 status line
+constexpr std::pair<std::string_view, std::string_view> statusLines[] = {
+    { HttpResponse::ok, HttpStatusLine::ok },
+    { HttpResponse::created, HttpStatusLine::created },
+    { HttpResponse::bad, HttpStatusLine::bad },
+    { HttpResponse::forbidden, HttpStatusLine::forbidden },
+    { HttpResponse::unauth, HttpStatusLine::unauth },
+    { HttpResponse::not_found, HttpStatusLine::not_found },
+    { HttpResponse::not_allow, HttpStatusLine::not_allow },
+    { HttpResponse::not_implement, HttpStatusLine::not_implement },
+    { HttpResponse::switch_proto, HttpStatusLine::switch_proto },
+    { HttpResponse::too_large, HttpStatusLine::too_large },
+    { HttpResponse::server_error, HttpStatusLine::server_error },
+    { HttpResponse::partial, HttpStatusLine::partial },
+    { HttpResponse::not_modified, HttpStatusLine::not_modified },
+    { HttpResponse::range_not_satisfiable, HttpStatusLine::range_not_satisfiable },
+};
+
+void HttpResponseFrame::compose_views(std::vector<std::string_view>& out) const {
+    if (responseCode.empty())
+        throw std::invalid_argument("Response has no response code");
+    const auto line = http_version() == std::pair(1, 1)
+        ? std::find_if(std::begin(statusLines), std::end(statusLines),
+            [this](const auto& status) { return status.first == responseCode; })
+        : std::end(statusLines);
+    if (line != std::end(statusLines))
+        out.emplace_back(line->second);
+    else {
+        compose_version(out, http_version());
+        out.insert(out.end(), { " ", responseCode, "\r\n" });
+    }
+    compose_headers(out);
+    if (!content.empty())
+        out.emplace_back(content);
+    if (fileBody.file != nullptr && fileBody.size > 0) {
+        out.push_back(fileBody.file->data().substr(static_cast<size_t>(fileBody.offset),
+            static_cast<size_t>(fileBody.size)));
+    }
+}
+
+/// @return the total size of the views
+static size_t views_size(const std::vector<std::string_view>& views) noexcept {
+    size_t size = 0;
+    for (const auto view : views)
+        size += view.size();
+    return size;
+}
+
+size_t write_frame(Port& port, const HttpFrame& frame) {
+    // reused so writing a frame doesn't allocate once the thread has written one
+    thread_local std::vector<std::string_view> views;
+    views.clear();
+    frame.compose_views(views);
+    port.writev(views.data(), views.size());
+    return views_size(views);
+}
+
+size_t write_frame(Port& port, const HttpResponseFrame& frame) {
+    const auto& body = frame.fileBody;
+    if (body.file == nullptr || body.size == 0)
+        return write_frame(port, static_cast<const HttpFrame&>(frame));
+    thread_local std::vector<std::string_view> views;
+    views.clear();
+    frame.compose_views(views);
+    // the last view is the mapped file, which the port may send another way
+    port.writev(views.data(), views.size() - 1);
+    port.send_file(*body.file, body.offset, body.size);
+    return views_size(views);
+}
@@ -0,0 +1,103 @@
+#include <HttpHeaders.h>
+#include <algorithm>
+
+std::string& HttpHeaders::operator[](std::string_view name) {
+    if (const auto knownHeader = known_header(name))
+        return (*this)[*knownHeader];
+    const auto hash = header_hash(name);
+    if (const auto entry = find_entry(name, hash))
+        return const_cast<std::string&>(entry->value);
+    if (inlineCount < inlineCapacity) {
+        auto& entry = inlineEntries[inlineCount];
+        inlineHashes[inlineCount++] = hash;
+        entry.name.assign(name);
+        entry.value.clear();
+        return entry.value;
+    }
+    spillHashes.push_back(hash);
+    spillEntries.push_back({ std::string(name), std::string() });
+    return spillEntries.back().value;
+}
+
+std::string& HttpHeaders::operator[](KnownHeader header) noexcept {
+    const auto index = static_cast<size_t>(header);
+    if (!(knownMask & (1u << index))) {
+        knownMask |= 1u << index;
+        known[index].clear();
+    }
+    return known[index];
+}
+
+const HttpHeaders::Entry* HttpHeaders::find_entry(std::string_view name,
+    uint32_t hash) const noexcept
+{
+    for (size_t i = 0; i < inlineCount; ++i) {
+        if (inlineHashes[i] == hash && detail::iequals(inlineEntries[i].name, name))
+            return &inlineEntries[i];
+    }
+    for (size_t i = 0; i < spillHashes.size(); ++i) {
+        if (spillHashes[i] == hash && detail::iequals(spillEntries[i].name, name))
+            return &spillEntries[i];
+    }
+    return nullptr;
+}
+
+const std::string* HttpHeaders::find(std::string_view name) const noexcept {
+    if (const auto knownHeader = known_header(name))
+        return find(*knownHeader);
+    const auto entry = find_entry(name, header_hash(name));
+    return entry == nullptr ? nullptr : &entry->value;
+}
+
+const std::string* HttpHeaders::find(KnownHeader header) const noexcept {
+    const auto index = static_cast<size_t>(header);
+    return knownMask & (1u << index) ? &known[index] : nullptr;
+}
+
+bool HttpHeaders::erase(std::string_view name) noexcept {
+    if (const auto knownHeader = known_header(name))
+        return erase(*knownHeader);
+    const auto entry = find_entry(name, header_hash(name));
+    if (entry == nullptr)
+        return false;
+    if (entry >= inlineEntries.data() && entry < inlineEntries.data() + inlineCount) {
+        // fill the gap with the last inline header, then with the first spilled one
+        const auto index = static_cast<size_t>(entry - inlineEntries.data());
+        std::swap(inlineEntries[index], inlineEntries[inlineCount - 1]);
+        inlineHashes[index] = inlineHashes[inlineCount - 1];
+        --inlineCount;
+        if (!spillEntries.empty()) {
+            std::swap(inlineEntries[inlineCount], spillEntries.back());
+            inlineHashes[inlineCount++] = spillHashes.back();
+            spillEntries.pop_back();
+            spillHashes.pop_back();
+        }
+    }
+    else {
+        const auto index = static_cast<size_t>(entry - spillEntries.data());
+        spillEntries.erase(spillEntries.begin() + index);
+        spillHashes.erase(spillHashes.begin() + index);
+    }
+    return true;
+}
+
+bool HttpHeaders::erase(KnownHeader header) noexcept {
+    const auto bit = 1u << static_cast<size_t>(header);
+    const auto present = (knownMask & bit) != 0;
+    knownMask &= ~bit;
+    return present;
+}
+
+size_t HttpHeaders::size() const noexcept {
+    size_t count = 0;
+    for (auto mask = knownMask; mask != 0; mask &= mask - 1)
+        ++count;
+    return count + inlineCount + spillEntries.size();
+}
+
+void HttpHeaders::clear() noexcept {
+    knownMask = 0;
+    inlineCount = 0;
+    spillHashes.clear();
+    spillEntries.clear();
+}
@@ -0,0 +1,368 @@
+#include <HttpRequestParser.h>
+#include <HttpRequestFrame.h>
+#include <HttpHeaders.h>
+#include <Port.h>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <cctype>
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define HTTP_PARSER_SSE2
+#if defined(__GNUC__)
+#define HTTP_PARSER_AVX2
+#endif
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#undef min
+#undef max
+
+/// Smallest amount of bytes the buffer grows by
+constexpr size_t minGrowth = 4096;
+
+/// @return true if `c` ends a line or isn't allowed in a request head
+inline bool is_line_end(unsigned char c) noexcept {
+    return (c < 0x20 && c != '\t') || c == 0x7f;
+}
+
+/// @return the index of the lowest set bit of a non-zero mask
+inline unsigned lowest_bit(unsigned mask) noexcept {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return index;
+#else
+    return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+
+const char* find_line_end_scalar(const char* begin, const char* end) noexcept {
+    for (; begin < end; ++begin) {
+        if (is_line_end(static_cast<unsigned char>(*begin)))
+            return begin;
+    }
+    return end;
+}
+
+#ifdef HTTP_PARSER_SSE2
+const char* find_line_end_sse2(const char* begin, const char* end) noexcept {
+    const auto space = _mm_set1_epi8(0x20);
+    const auto tab = _mm_set1_epi8('\t');
+    const auto del = _mm_set1_epi8(0x7f);
+    for (; end - begin >= 16; begin += 16) {
+        const auto chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+        // unsigned chars >= 0x20 are unchanged by max(c, 0x20)
+        const auto printable = _mm_cmpeq_epi8(_mm_max_epu8(chars, space), chars);
+        const auto allowed = _mm_or_si128(printable, _mm_cmpeq_epi8(chars, tab));
+        const auto mask = (~static_cast<unsigned>(_mm_movemask_epi8(allowed)) & 0xFFFF)
+            | static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(chars, del)));
+        if (mask != 0)
+            return begin + lowest_bit(mask);
+    }
+    return find_line_end_scalar(begin, end);
+}
+#endif
+
+#ifdef HTTP_PARSER_AVX2
+__attribute__((target("avx2")))
+const char* find_line_end_avx2(const char* begin, const char* end) noexcept {
+    const auto space = _mm256_set1_epi8(0x20);
+    const auto tab = _mm256_set1_epi8('\t');
+    const auto del = _mm256_set1_epi8(0x7f);
+    for (; end - begin >= 32; begin += 32) {
+        const auto chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+        const auto printable = _mm256_cmpeq_epi8(_mm256_max_epu8(chars, space), chars);
+        const auto allowed = _mm256_or_si256(printable, _mm256_cmpeq_epi8(chars, tab));
+        const auto mask = ~static_cast<unsigned>(_mm256_movemask_epi8(allowed))
+            | static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chars, del)));
+        if (mask != 0)
+            return begin + lowest_bit(mask);
+    }
+    return find_line_end_sse2(begin, end);
+}
+#endif
+
+using find_line_end_t = const char* (*)(const char*, const char*) noexcept;
+
+/// @return the fastest implementation of `find_line_end` supported by the cpu
+find_line_end_t select_find_line_end() noexcept {
+#if defined(HTTP_PARSER_AVX2)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return &find_line_end_avx2;
+#endif
+#if defined(HTTP_PARSER_SSE2)
+    return &find_line_end_sse2;
+#else
+    return &find_line_end_scalar;
+#endif
+}
+
+const char* find_line_end(const char* begin, const char* end) noexcept {
+    static const auto impl = select_find_line_end();
+    return impl(begin, end);
+}
+
+HttpRequestParser::HttpRequestParser(size_t maxHeadSize) :
+    capacity(0), used(0), maxHeadSize(maxHeadSize)
+{
+    reset();
+}
+
+HttpRequestParser::~HttpRequestParser() = default;
+HttpRequestParser::HttpRequestParser(HttpRequestParser&&) noexcept = default;
+HttpRequestParser& HttpRequestParser::operator=(HttpRequestParser&&) noexcept = default;
+
+std::pair<char*, size_t> HttpRequestParser::prepare(size_t minSpace) {
+    if (capacity - used < minSpace) {
+        const auto newCapacity = std::max({ capacity * 2, used + minSpace, minGrowth });
+        // not make_unique, which would zero the buffer
+        std::unique_ptr<char[]> newBuffer(new char[newCapacity]);
+        if (used > 0)
+            std::memcpy(newBuffer.get(), buffer.get(), used);
+        buffer = std::move(newBuffer);
+        capacity = newCapacity;
+    }
+    return { buffer.get() + used, capacity - used };
+}
+
+void HttpRequestParser::commit(size_t bytes) noexcept {
+    used += std::min(bytes, capacity - used);
+}
+
+void HttpRequestParser::feed(std::string_view data) {
+    if (data.empty())
+        return;
+    const auto [space, size] = prepare(data.size());
+    std::memcpy(space, data.data(), data.size());
+    commit(data.size());
+}
+
+size_t HttpRequestParser::read_from(Port& port) {
+    const auto [space, size] = prepare();
+    const auto read = port.try_read_into(space, size);
+    commit(read);
+    return read;
+}
+
+HttpRequestParser::Status HttpRequestParser::fail(Error e) noexcept {
+    state = State::Error;
+    err = e;
+    return Status::Error;
+}
+
+HttpRequestParser::Status HttpRequestParser::parse() {
+    if (state == State::Done)
+        return Status::Done;
+    else if (state == State::Error)
+        return Status::Error;
+    const auto base = buffer.get();
+    const auto limit = std::min(used, maxHeadSize);
+    for (;;) {
+        const auto found = find_line_end(base + scanPos, base + limit);
+        if (found == base + limit || (*found == '\r' && found + 1 == base + limit)) {
+            // a trailing CR is rescanned once the next byte arrives
+            scanPos = found - base;
+            return used >= maxHeadSize ? fail(Error::TooLarge) : Status::Incomplete;
+        }
+        auto lineEnd = static_cast<size_t>(found - base);
+        if (*found == '\r') {
+            if (found[1] != '\n')
+                return fail(Error::BadCharacter);
+            scanPos = lineEnd + 2;
+        }
+        else if (*found == '\n')
+            scanPos = lineEnd + 1;
+        else
+            return fail(Error::BadCharacter);
+
+        if (!parse_line(lineEnd))
+            return Status::Error;
+        lineStart = scanPos;
+        if (state == State::Done) {
+            headEnd = static_cast<uint32_t>(scanPos);
+            return Status::Done;
+        }
+    }
+}
+
+bool HttpRequestParser::parse_line(size_t end) {
+    const std::string_view line(buffer.get() + lineStart, end - lineStart);
+    if (state == State::RequestLine) {
+        // empty lines before a request are ignored
+        return line.empty() || parse_request_line(line);
+    }
+    else if (line.empty()) {
+        state = State::Done;
+        return true;
+    }
+    return parse_header(line);
+}
+
+bool HttpRequestParser::parse_request_line(std::string_view line) {
+    constexpr std::string_view versionPrefix = "HTTP/";
+    constexpr auto versionLen = versionPrefix.size() + 3;
+    const auto methodEnd = line.find(' ');
+    const auto pathEnd = methodEnd == std::string_view::npos
+        ? std::string_view::npos : line.find(' ', methodEnd + 1);
+    if (methodEnd == 0 || pathEnd == std::string_view::npos || pathEnd == methodEnd + 1
+        || line.size() - pathEnd - 1 != versionLen)
+    {
+        fail(Error::BadRequestLine);
+        return false;
+    }
+    const auto version = line.substr(pathEnd + 1);
+    if (version.substr(0, versionPrefix.size()) != versionPrefix
+        || !isdigit(static_cast<unsigned char>(version[5])) || version[6] != '.'
+        || !isdigit(static_cast<unsigned char>(version[7])))
+    {
+        fail(Error::BadRequestLine);
+        return false;
+    }
+    methodLen = static_cast<uint32_t>(methodEnd);
+    pathStart = static_cast<uint32_t>(lineStart + methodEnd + 1);
+    pathLen = static_cast<uint32_t>(pathEnd - methodEnd - 1);
+    versionMajor = static_cast<uint8_t>(version[5] - '0');
+    versionMinor = static_cast<uint8_t>(version[7] - '0');
+    state = State::Headers;
+    return true;
+}
+
+bool HttpRequestParser::parse_header(std::string_view line) {
+    const auto colon = line.find(':');
+    // a line starting with whitespace continues the last header (obsolete line folding)
+    // and whitespace isn't allowed between the name and colon
+    if (colon == 0 || colon == std::string_view::npos
+        || std::any_of(line.begin(), line.begin() + colon, [](char c) {
+            return c == ' ' || c == '\t';
+            }))
+    {
+        fail(Error::BadHeader);
+        return false;
+    }
+    auto valueStart = colon + 1;
+    auto valueEnd = line.size();
+    while (valueStart < valueEnd && (line[valueStart] == ' ' || line[valueStart] == '\t'))
+        ++valueStart;
+    while (valueEnd > valueStart && (line[valueEnd - 1] == ' ' || line[valueEnd - 1] == '\t'))
+        --valueEnd;
+    if (const auto known = known_header(line.substr(0, colon))) {
+        auto& slot = knownSlots[static_cast<size_t>(*known)];
+        if (slot == 0 && headers.size() < UINT16_MAX)
+            slot = static_cast<uint16_t>(headers.size() + 1);
+    }
+    headers.push_back({ static_cast<uint32_t>(lineStart),
+        static_cast<uint32_t>(colon),
+        static_cast<uint32_t>(lineStart + valueStart),
+        static_cast<uint32_t>(valueEnd - valueStart) });
+    return true;
+}
+
+HttpRequestParser::Error HttpRequestParser::error() const noexcept {
+    return err;
+}
+
+std::string_view HttpRequestParser::method() const noexcept {
+    return { buffer.get() + pathStart - methodLen - 1, methodLen };
+}
+
+std::string_view HttpRequestParser::path() const noexcept {
+    return { buffer.get() + pathStart, pathLen };
+}
+
+std::pair<int, int> HttpRequestParser::http_version() const noexcept {
+    return { versionMajor, versionMinor };
+}
+
+size_t HttpRequestParser::header_count() const noexcept {
+    return headers.size();
+}
+
+HttpRequestParser::Header HttpRequestParser::header(size_t index) const noexcept {
+    const auto& slot = headers[index];
+    return { { buffer.get() + slot.name, slot.nameLen },
+        { buffer.get() + slot.value, slot.valueLen } };
+}
+
+std::optional<std::string_view> HttpRequestParser::find(std::string_view name) const noexcept {
+    for (const auto& slot : headers) {
+        if (slot.nameLen == name.size()
+            && detail::iequals({ buffer.get() + slot.name, slot.nameLen }, name))
+        {
+            return std::string_view(buffer.get() + slot.value, slot.valueLen);
+        }
+    }
+    return {};
+}
+
+std::optional<std::string_view> HttpRequestParser::find(KnownHeader known) const noexcept {
+    const auto slot = knownSlots[static_cast<size_t>(known)];
+    if (slot == 0)
+        return {};
+    return header(slot - 1).value;
+}
+
+size_t HttpRequestParser::head_size() const noexcept {
+    return headEnd;
+}
+
+std::string_view HttpRequestParser::buffered_body() const noexcept {
+    return { buffer.get() + headEnd, used - headEnd };
+}
+
+void HttpRequestParser::fill(HttpRequestFrame& frame) const {
+    const auto protocol = protocol_from_name(method());
+    if (!protocol)
+        throw std::invalid_argument("Unknown HTTP method: " + std::string(method()));
+    frame.protocol = *protocol;
+    frame.path.assign(path());
+    frame.set_http_version(versionMajor, versionMinor);
+    for (size_t i = 0; i < headers.size(); ++i) {
+        const auto [name, value] = header(i);
+        auto& frameValue = frame[name];
+        // repeated headers are equivalent to one header with a comma separated list
+        if (!frameValue.empty())
+            frameValue.append(", ");
+        frameValue.append(value);
+    }
+}
+
+void HttpRequestParser::consume(size_t bodySize) noexcept {
+    if (state != State::Done) {
+        reset();
+        return;
+    }
+    const auto discard = headEnd + std::min(bodySize, used - headEnd);
+    const auto remaining = used - discard;
+    if (remaining > 0)
+        std::memmove(buffer.get(), buffer.get() + discard, remaining);
+    reset();
+    used = remaining;
+}
+
+void HttpRequestParser::reset() noexcept {
+    used = 0;
+    scanPos = 0;
+    lineStart = 0;
+    state = State::RequestLine;
+    err = Error::None;
+    methodLen = pathStart = pathLen = 0;
+    headEnd = 0;
+    versionMajor = versionMinor = 0;
+    headers.clear();
+    knownSlots.fill(0);
+}
+
+void HttpRequestParser::shrink(size_t maxCapacity) noexcept {
+    if (used == 0 && capacity > maxCapacity) {
+        buffer.reset();
+        capacity = 0;
+    }
+}
+
+size_t HttpRequestParser::size() const noexcept {
+    return used;
+}
@@ -0,0 +1,979 @@
+#include <HttpServer.h>
+#include <Address.h>
+#include <ChunkedCodec.h>
+#include <ContentEncoding.h>
+#include <FdSet.h>
+#include <HttpRequestParser.h>
+#include <MappedFile.h>
+#include <ResponseCache.h>
+#include <SSLAcceptor.h>
+#include <Socket.h>
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <list>
+#include <memory_resource>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+#undef min
+#undef max
+
+/// Max amount of connections accepted per wakeup of a plain listener
+constexpr auto maxAcceptBatch = 1024;
+
+/// Most closed connections a worker keeps for reuse by new connections
+constexpr size_t maxSpareConnections = 256;
+
+/// Largest parser buffer or request content a connection kept for reuse holds on to
+constexpr size_t maxSpareBuffer = 64 * 1024;
+
+/// Most bytes read from one connection per wakeup, so the others are served in between
+constexpr size_t maxReadPerWakeup = 256 * 1024;
+
+/// How often a worker wakes up without activity, so handshakes and idle connections
+/// can time out
+constexpr auto idleWakeup = std::chrono::milliseconds(1000);
+
+/**
+* Pins the calling thread to the `index`th cpu it is allowed to run on, modulo
+* the amount of such cpus. Does nothing on platforms without thread affinity
+*/
+static void pin_thread(unsigned index) {
+#ifdef __linux__
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+        return;
+    const auto count = static_cast<unsigned>(CPU_COUNT(&allowed));
+    if (count == 0)
+        return;
+    index %= count;
+    for (unsigned cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &allowed) && index-- == 0) {
+            cpu_set_t pinned;
+            CPU_ZERO(&pinned);
+            CPU_SET(cpu, &pinned);
+            pthread_setaffinity_np(pthread_self(), sizeof(pinned), &pinned);
+            return;
+        }
+    }
+#else
+    static_cast<void>(index);
+#endif
+}
+
+/// @return false for the status codes of responses which never have a body
+static bool has_body(std::string_view responseCode) noexcept {
+    return !responseCode.empty() && responseCode[0] != '1'
+        && responseCode.substr(0, 3) != "204" && responseCode.substr(0, 3) != "304";
+}
+
+struct HttpServer::Worker {
+    using Clock = std::chrono::steady_clock;
+
+    /// A client connection and its request in progress
+    struct Connection {
+        std::unique_ptr<Port> port;
+        HttpRequestParser parser;
+        ChunkedDecoder chunked;
+        /// bytes after the request head that are decoded into the request content
+        size_t bodyUsed = 0;
+        HttpRequestFrame request;
+        /// amount of requests answered on the connection
+        unsigned requests = 0;
+        Clock::time_point lastActive;
+        /// position of the connection in the worker's idle list
+        std::pmr::list<socket_t>::iterator idlePos;
+        /// responses the socket hasn't taken yet, from `unsentPos`, followed by `unsentFile`
+        std::string unsent;
+        size_t unsentPos = 0;
+        HttpResponseFrame::FileBody unsentFile;
+        /// true if the connection waits to be writable instead of readable
+        bool waitingWrite = false;
+        /// true to close the connection once its responses are sent
+        bool closeAfterSend = false;
+        /// true if the connection is in the worker's backlog
+        bool backlogged = false;
+
+        explicit Connection(size_t maxHeadSize) : parser(maxHeadSize) {}
+
+        /// @return true if the socket hasn't taken all of the responses yet
+        bool sending() const noexcept {
+            return unsentPos < unsent.size() || unsentFile.size > 0;
+        }
+
+        /// Clears the connection for reuse, keeping the capacity of its buffers
+        void reset() noexcept {
+            port.reset();
+            parser.reset();
+            parser.shrink(maxSpareBuffer);
+            chunked.reset();
+            bodyUsed = 0;
+            requests = 0;
+            if (request.content.capacity() > maxSpareBuffer)
+                std::string().swap(request.content);
+            request.content.clear();
+            if (unsent.capacity() > maxSpareBuffer)
+                std::string().swap(unsent);
+            unsent.clear();
+            unsentPos = 0;
+            unsentFile = {};
+            waitingWrite = false;
+            closeAfterSend = false;
+            backlogged = false;
+        }
+    };
+    using ConnectionMap = std::pmr::unordered_map<socket_t, std::unique_ptr<Connection>>;
+
+    enum class BodyStatus {
+        Incomplete, Done, TooLarge, Malformed, Unsupported
+    };
+
+    const ServerOptions& options;
+    const HttpHandler& handler;
+    unsigned index;
+    socket_t stopFd;
+    std::optional<TcpSocket> listener;
+    std::optional<SSLAcceptor> acceptor;
+    FdSet set;
+    /// connections whose responses wait for the socket, which aren't read meanwhile
+    FdSet writeSet;
+    size_t writers = 0;
+    /// nodes of the connection map and idle list, which only this worker's thread uses,
+    /// so they are allocated without locking and reused as connections come and go
+    std::pmr::unsynchronized_pool_resource nodePool;
+    ConnectionMap connections{ &nodePool };
+    /// connections from least to most recently active, to find idle ones without a scan
+    std::pmr::list<socket_t> idle{ &nodePool };
+    /// closed connections, whose parser buffers and request frames are reset instead
+    /// of freed, so new connections don't allocate them again
+    std::vector<std::unique_ptr<Connection>> spare;
+    /// when the current batch of ready fds was reported
+    Clock::time_point now;
+    std::vector<SSLSocket> handshaken;
+    /// copy of the ready fds of the last wait, which are invalidated by removing fds
+    std::vector<socket_t> readyScratch, writableScratch;
+    /// connections which stopped reading at `maxReadPerWakeup` or were just read again
+    /// after sending, and are served without waiting for the socket, which doesn't
+    /// report data a TLS connection already decrypted
+    std::vector<socket_t> backlog, backlogScratch;
+    HttpResponseFrame response;
+    /// true if `response` holds a response which hasn't been sent or batched yet
+    bool responsePending = false;
+    /// responses to pipelined requests, which are sent together in one write
+    std::string batch;
+    std::vector<std::string_view> batchViews;
+    /// response from the cache which hasn't been sent or batched yet
+    std::shared_ptr<const CachedResponse> cachedPending;
+    /// true to send only the head of `cachedPending`
+    bool cachedHeadOnly = false;
+    /// `Connection` header line inserted into `cachedPending`
+    std::string_view cachedConnection;
+    std::string cacheKey;
+    /// compressed copies of file bodies shared by the workers, or null
+    CompressedFiles* compressedFiles;
+    /// the compressed body, swapped with the response's content
+    std::string compressed;
+    /// compressed copy of the file body of `response`, sent after it without copying
+    /// it into the response
+    std::shared_ptr<const std::string> sharedBody;
+    /// requests until the next timed request, which is timed when this is 1
+    unsigned timingCountdown;
+    /// all workers of the server, whose metrics are added up to answer the metrics path
+    const std::vector<std::unique_ptr<Worker>>& workers;
+
+    /// metrics written only by this worker's thread, away from other workers' metrics
+    struct alignas(64) {
+        MetricCounter accepted, closed, handshakes, handshakeFailures;
+        MetricCounter bytesRead, bytesWritten, requests, cacheHits;
+        MetricHistogram acceptTime, handshakeTime, parseTime, handlerTime;
+    } metrics;
+
+    Worker(const ServerOptions& options, const HttpHandler& handler, unsigned index,
+        socket_t stopFd, const std::vector<std::unique_ptr<Worker>>& workers,
+        CompressedFiles* compressedFiles) :
+        options(options), handler(handler), index(index), stopFd(stopFd),
+        compressedFiles(compressedFiles), timingCountdown(options.timingInterval),
+        workers(workers)
+    {
+        const Address addr(options.port);
+        if (options.tls) {
+            acceptor.emplace(addr, options.tls, std::chrono::seconds(10), true);
+            if (options.timingInterval != 0) {
+                acceptor->record_accepts(&metrics.acceptTime);
+                acceptor->record_handshakes(&metrics.handshakeTime);
+            }
+        }
+        else {
+            listener.emplace(addr, true);
+        }
+    }
+
+    /// Adds the metrics of this worker to `out`, from any thread
+    void add_metrics(ServerMetrics& out) const {
+        out.connectionsAccepted += metrics.accepted.get();
+        out.connectionsClosed += metrics.closed.get();
+        out.handshakes += metrics.handshakes.get();
+        out.handshakeFailures += metrics.handshakeFailures.get();
+        out.bytesRead += metrics.bytesRead.get();
+        out.bytesWritten += metrics.bytesWritten.get();
+        out.requests += metrics.requests.get();
+        out.cacheHits += metrics.cacheHits.get();
+        out.acceptTime += metrics.acceptTime.snapshot();
+        out.handshakeTime += metrics.handshakeTime.snapshot();
+        out.parseTime += metrics.parseTime.snapshot();
+        out.handlerTime += metrics.handlerTime.snapshot();
+    }
+
+    void run() {
+        if (options.pinThreads)
+            pin_thread(index);
+        set.add(stopFd);
+        writeSet.watch(SetType::Write);
+        if (acceptor)
+            acceptor->add_to_fd(set);
+        else
+            set.add(listener->handle());
+        const auto wakeup = std::min<std::chrono::microseconds>(idleWakeup, options.idleTimeout);
+        for (;;) {
+            const auto waitedWrite = writers > 0;
+            const auto timeout = backlog.empty() ? wakeup : std::chrono::microseconds(0);
+            if (waitedWrite)
+                FdSet::wait(timeout, ReadSet{ set }, WriteSet{ writeSet });
+            else
+                FdSet::wait(timeout, ReadSet{ set });
+            now = Clock::now();
+            backlogScratch.swap(backlog);
+            backlog.clear();
+            for (const auto fd : backlogScratch) {
+                const auto it = connections.find(fd);
+                if (it == connections.end())
+                    continue;
+                it->second->backlogged = false;
+                // a connection waiting to send is backlogged again once it has sent
+                if (!it->second->waitingWrite)
+                    serve(it);
+            }
+            readyScratch.assign(set.ready().begin(), set.ready().end());
+            writableScratch.clear();
+            if (waitedWrite)
+                writableScratch.assign(writeSet.ready().begin(), writeSet.ready().end());
+            for (const auto fd : writableScratch) {
+                if (const auto it = connections.find(fd); it != connections.end())
+                    on_writable(it);
+            }
+            // the acceptor also has work when nothing is ready, as handshakes may time out
+            auto acceptorReady = readyScratch.empty();
+            for (const auto fd : readyScratch) {
+                if (fd == stopFd)
+                    return;
+                if (listener && fd == static_cast<socket_t>(listener->handle()))
+                    accept_tcp();
+                else if (const auto it = connections.find(fd); it != connections.end())
+                    serve(it);
+                else
+                    acceptorReady = true;
+            }
+            if (acceptor && acceptorReady)
+                accept_tls();
+            close_idle();
+        }
+    }
+
+    /// Closes the connections which have been idle for longer than the idle timeout
+    void close_idle() {
+        while (!idle.empty()) {
+            const auto it = connections.find(idle.front());
+            if (now - it->second->lastActive < options.idleTimeout)
+                return;
+            close_connection(it);
+        }
+    }
+
+    void close_connection(ConnectionMap::iterator it) {
+        metrics.closed.add();
+        if (it->second->waitingWrite) {
+            writeSet.remove(it->first);
+            --writers;
+        }
+        else {
+            set.remove(it->first);
+        }
+        idle.erase(it->second->idlePos);
+        if (it->second->backlogged)
+            std::erase(backlog, it->first);
+        auto conn = std::move(it->second);
+        connections.erase(it);
+        conn->reset();
+        if (spare.size() < maxSpareConnections)
+            spare.push_back(std::move(conn));
+    }
+
+    void accept_tcp() {
+        const auto timed = options.timingInterval != 0;
+        for (auto i = 0; i < maxAcceptBatch; ++i) {
+            const auto start = timed ? Clock::now() : Clock::time_point();
+            auto sock = listener->try_accept();
+            if (!sock)
+                return;
+            if (timed)
+                metrics.acceptTime.record(Clock::now() - start);
+            // responses are written whole, so Nagle's algorithm would only delay them
+            sock->set_nodelay(true);
+            const auto fd = static_cast<socket_t>(sock->handle());
+            add_connection(fd, std::make_unique<TcpSocket>(std::move(*sock)));
+        }
+    }
+
+    void accept_tls() {
+        handshaken.clear();
+        acceptor->accept(handshaken, std::chrono::microseconds(0));
+        const auto stats = acceptor->stats();
+        metrics.handshakes.set(stats.completed);
+        metrics.handshakeFailures.set(stats.failed + stats.timedOut);
+        for (auto& sock : handshaken) {
+            const auto fd = static_cast<socket_t>(sock.handle());
+            const auto it = add_connection(fd, std::make_unique<SSLSocket>(std::move(sock)));
+            // the request may have arrived as early data, which is already read
+            serve(it);
+        }
+    }
+
+    ConnectionMap::iterator add_connection(socket_t fd,
+        std::unique_ptr<Port>&& port)
+    {
+        metrics.accepted.add();
+        set.add(fd);
+        std::unique_ptr<Connection> conn;
+        if (spare.empty()) {
+            conn = std::make_unique<Connection>(options.maxHeadSize);
+        }
+        else {
+            conn = std::move(spare.back());
+            spare.pop_back();
+        }
+        conn->port = std::move(port);
+        conn->lastActive = now;
+        conn->idlePos = idle.insert(idle.end(), fd);
+        return connections.insert_or_assign(fd, std::move(conn)).first;
+    }
+
+    /// Reads from a ready connection and answers the requests it completes
+    void serve(ConnectionMap::iterator it) {
+        auto& conn = *it->second;
+        auto keepOpen = false;
+        try {
+            keepOpen = on_readable(it->first, conn);
+        }
+        catch (const std::runtime_error&) {} // the client closed the connection or it failed
+        responsePending = false;
+        cachedPending.reset();
+        sharedBody.reset();
+        batch.clear();
+        if (!keepOpen && !conn.sending()) {
+            close_connection(it);
+            return;
+        }
+        if (conn.sending()) {
+            // the rest is sent once the client reads, and its next requests wait until then
+            conn.closeAfterSend = !keepOpen;
+            conn.waitingWrite = true;
+            set.remove(it->first);
+            writeSet.add(it->first);
+            ++writers;
+        }
+        conn.lastActive = now;
+        idle.splice(idle.end(), idle, conn.idlePos);
+    }
+
+    /// Sends more of the responses of a writable connection, which is read again once they are sent
+    void on_writable(ConnectionMap::iterator it) {
+        auto& conn = *it->second;
+        if (!conn.waitingWrite)
+            return;
+        size_t sent;
+        try {
+            sent = send_unsent(conn);
+        }
+        catch (const std::runtime_error&) {
+            close_connection(it);
+            return;
+        }
+        metrics.bytesWritten.add(sent);
+        if (conn.sending()) {
+            // a client which stops reading is closed once it has been idle for the timeout
+            if (sent > 0) {
+                conn.lastActive = now;
+                idle.splice(idle.end(), idle, conn.idlePos);
+            }
+            return;
+        }
+        if (conn.closeAfterSend) {
+            close_connection(it);
+            return;
+        }
+        conn.waitingWrite = false;
+        writeSet.remove(it->first);
+        --writers;
+        set.add(it->first);
+        add_backlog(it->first, conn);
+        conn.lastActive = now;
+        idle.splice(idle.end(), idle, conn.idlePos);
+    }
+
+    /**
+    * Sends what the socket of a connection takes of its unsent responses
+    * @return the amount of bytes sent
+    */
+    static size_t send_unsent(Connection& conn) {
+        size_t sent = 0;
+        if (conn.unsentPos < conn.unsent.size()) {
+            const auto rest = std::string_view(conn.unsent).substr(conn.unsentPos);
+            const auto written = conn.port->try_writev(&rest, 1);
+            sent += written;
+            conn.unsentPos += written;
+            if (conn.unsentPos < conn.unsent.size())
+                return sent;
+            conn.unsent.clear();
+            conn.unsentPos = 0;
+        }
+        auto& file = conn.unsentFile;
+        if (file.size > 0) {
+            const auto written = conn.port->try_send_file(*file.file, file.offset, file.size);
+            sent += static_cast<size_t>(written);
+            file.offset += written;
+            file.size -= written;
+            if (file.size == 0)
+                file = {};
+        }
+        return sent;
+    }
+
+    /// Serves a connection again on the next wakeup, whether or not its socket is ready
+    void add_backlog(socket_t fd, Connection& conn) {
+        if (!conn.backlogged) {
+            conn.backlogged = true;
+            backlog.push_back(fd);
+        }
+    }
+
+    /// @return false if the connection should be closed
+    bool on_readable(socket_t fd, Connection& conn) {
+        auto peerClosed = false;
+        size_t received = 0;
+        // the most a request and its body may take, and so the most buffered at once
+        const auto maxBuffered = options.maxHeadSize + options.maxBodySize;
+        try {
+            for (;;) {
+                const auto buffered = conn.parser.size();
+                if (buffered >= maxBuffered)
+                    break;
+                if (received >= maxReadPerWakeup) {
+                    add_backlog(fd, conn);
+                    break;
+                }
+                const auto [buffer, space] = conn.parser.prepare();
+                const auto wanted = std::min({ space, maxBuffered - buffered,
+                    maxReadPerWakeup - received });
+                const auto read = conn.port->try_read_into(buffer, wanted);
+                conn.parser.commit(read);
+                received += read;
+                if (read < wanted)
+                    break;
+            }
+        }
+        catch (const std::runtime_error&) {
+            metrics.bytesRead.add(received);
+            // a client may close its side right after sending its last requests
+            if (conn.parser.size() == 0)
+                throw;
+            peerClosed = true;
+        }
+        if (!peerClosed)
+            metrics.bytesRead.add(received);
+        auto keepOpen = true;
+        // answers every complete request in the buffer, as clients may pipeline requests
+        while (keepOpen) {
+            const auto timed = timingCountdown == 1;
+            const auto parseStart = timed ? Clock::now() : Clock::time_point();
+            const auto status = conn.parser.parse();
+            if (status == HttpRequestParser::Status::Incomplete)
+                break;
+            if (timed)
+                metrics.parseTime.record(Clock::now() - parseStart);
+            timingCountdown = timingCountdown > 1 ? timingCountdown - 1 : options.timingInterval;
+            if (status == HttpRequestParser::Status::Error) {
+                queue_error(HttpResponse::bad);
+                keepOpen = false;
+                break;
+            }
+            const auto body = read_body(conn);
+            if (body == BodyStatus::Incomplete)
+                break;
+            if (body != BodyStatus::Done) {
+                queue_error(body == BodyStatus::TooLarge ? HttpResponse::too_large
+                    : body == BodyStatus::Malformed ? HttpResponse::bad
+                    : HttpResponse::not_implement);
+                keepOpen = false;
+                break;
+            }
+            keepOpen = respond(conn, timed);
+            conn.parser.consume(conn.bodyUsed);
+            conn.chunked.reset();
+            conn.bodyUsed = 0;
+            conn.request.content.clear();
+        }
+        // a request this large can't complete, such as one with chunk headers padding its body
+        if (keepOpen && conn.parser.size() >= maxBuffered) {
+            queue_error(HttpResponse::too_large);
+            keepOpen = false;
+        }
+        metrics.bytesWritten.add(flush(conn));
+        return keepOpen && !peerClosed;
+    }
+
+    /// Decodes the buffered body of the parsed request into the request's content
+    BodyStatus read_body(Connection& conn) {
+        const auto buffered = conn.parser.buffered_body();
+        if (const auto encoding = conn.parser.find(KnownHeader::TransferEncoding)) {
+            if (!detail::iequals(*encoding, "chunked"))
+                return BodyStatus::Unsupported;
+            auto input = buffered.substr(conn.bodyUsed);
+            while (!input.empty()
+                && conn.chunked.status() == ChunkedDecoder::Status::Incomplete)
+            {
+                const auto slice = conn.chunked.decode(input);
+                if (conn.request.content.size() + slice.size() > options.maxBodySize)
+                    return BodyStatus::TooLarge;
+                conn.request.content.append(slice);
+            }
+            conn.bodyUsed = buffered.size() - input.size();
+            switch (conn.chunked.status()) {
+            case ChunkedDecoder::Status::Done:
+                return BodyStatus::Done;
+            case ChunkedDecoder::Status::Error:
+                return BodyStatus::Malformed;
+            default:
+                return BodyStatus::Incomplete;
+            }
+        }
+        const auto length = conn.parser.find(KnownHeader::ContentLength);
+        if (!length)
+            return BodyStatus::Done;
+        size_t size;
+        const auto end = length->data() + length->size();
+        if (const auto [ptr, err] = std::from_chars(length->data(), end, size);
+            err != std::errc() || ptr != end)
+        {
+            return BodyStatus::Malformed;
+        }
+        if (size > options.maxBodySize)
+            return BodyStatus::TooLarge;
+        if (buffered.size() < size)
+            return BodyStatus::Incomplete;
+        conn.request.content.assign(buffered.substr(0, size));
+        conn.bodyUsed = size;
+        return BodyStatus::Done;
+    }
+
+    /// Prepares the response frame for a new response, batching the pending one
+    void reset_response(const char* code) {
+        if (responsePending || cachedPending)
+            batch_response();
+        response.headers().clear();
+        response.content.clear();
+        response.fileBody = {};
+        response.responseCode = code;
+        response.set_http_version(1, 1);
+    }
+
+    /// Copies the pending response into the batch, so the frame can be reused
+    void batch_response() {
+        batchViews.clear();
+        if (responsePending)
+            response_views(batchViews);
+        else
+            cached_views(batchViews);
+        for (const auto view : batchViews)
+            batch.append(view);
+        responsePending = false;
+        cachedPending.reset();
+        sharedBody.reset();
+    }
+
+    /// Appends the pending response with its shared body to `out`
+    void response_views(std::vector<std::string_view>& out) const {
+        response.compose_views(out);
+        if (sharedBody)
+            out.push_back(*sharedBody);
+    }
+
+    /// Appends the pending cached response with its `Connection` header to `out`
+    void cached_views(std::vector<std::string_view>& out) const {
+        out.push_back(cachedPending->head());
+        if (!cachedConnection.empty())
+            out.push_back(cachedConnection);
+        const auto tail = cachedPending->tail();
+        out.push_back(cachedHeadOnly ? tail.substr(0, 2) : tail);
+    }
+
+    /// @return true if the connection persists after the response to its current request
+    bool keep_alive(Connection& conn, bool responseAllows) const {
+        return conn.request.keep_alive() && responseAllows
+            && (options.maxRequestsPerConnection == 0
+                || ++conn.requests < options.maxRequestsPerConnection);
+    }
+
+    /// @return the `Connection` header a response needs, or an empty view if it needs none
+    static std::string_view connection_header(const Connection& conn, bool keepAlive) noexcept {
+        if (!keepAlive)
+            return "Connection: close\r\n";
+        if (conn.request.http_version() < std::pair(1, 1))
+            return "Connection: keep-alive\r\n";
+        return {};
+    }
+
+    /// Answers a request whose response is cached, without calling the handler
+    /// @return false if the connection should be closed after the response
+    bool respond_cached(Connection& conn, std::shared_ptr<const CachedResponse>&& cached) {
+        metrics.cacheHits.add();
+        const auto keepAlive = keep_alive(conn, true);
+        const auto connection = connection_header(conn, keepAlive);
+        if (const auto match = conn.request.headers().find("If-None-Match");
+            match && etag_matches(*match, cached->etag))
+        {
+            response.responseCode = HttpResponse::not_modified;
+            response["ETag"] = cached->etag;
+            if (!connection.empty())
+                response[KnownHeader::Connection] = keepAlive ? "keep-alive" : "close";
+            queue();
+            return keepAlive;
+        }
+        cachedPending = std::move(cached);
+        cachedConnection = connection;
+        cachedHeadOnly = conn.request.protocol == HttpFrame::Protocol::HEAD;
+        metrics.requests.add();
+        return keepAlive;
+    }
+
+    /**
+    * Calls the handler for the complete request of `conn` and queues its response
+    * @param timed true to time the handler for the metrics
+    * @return false if the connection should be closed after the response
+    */
+    bool respond(Connection& conn, bool timed) {
+        reset_response(HttpResponse::ok);
+        conn.request.headers().clear();
+        try {
+            conn.parser.fill(conn.request);
+        }
+        catch (const std::invalid_argument&) {
+            queue_error(HttpResponse::not_implement); // unknown method
+            return false;
+        }
+        const auto metricsRequest = is_metrics_request(conn.request);
+        auto coding = ContentCoding::Identity;
+        if (options.compression.enabled) {
+            if (const auto accept = conn.request.headers().find("Accept-Encoding"))
+                coding = negotiate_coding(*accept);
+        }
+        const auto& cache = options.cache;
+        const auto cacheable = cache && !metricsRequest && conn.request.content.empty()
+            && cache->make_key(conn.request, cacheKey);
+        if (cacheable) {
+            // each coding of a response is stored separately, so it is compressed once
+            if (coding != ContentCoding::Identity)
+                cacheKey.append("\nContent-Encoding: ").append(coding_name(coding));
+            if (auto cached = cache->find(cacheKey, now))
+                return respond_cached(conn, std::move(cached));
+        }
+        if (metricsRequest) {
+            respond_metrics();
+        }
+        else {
+            const auto handlerStart = timed ? Clock::now() : Clock::time_point();
+            try {
+                handler(conn.request, response);
+                response.check_headers();
+            }
+            catch (const std::exception&) {
+                reset_response(HttpResponse::server_error);
+            }
+            if (timed)
+                metrics.handlerTime.record(Clock::now() - handlerStart);
+        }
+        // the headers and tag of the compressed representation are needed to match
+        // `If-None-Match`, but the body is only compressed if it is sent
+        const auto compress = options.compression.enabled && label_compressed(coding);
+        if (not_modified(conn.request)) {
+            response.responseCode = HttpResponse::not_modified;
+            response.headers().erase(KnownHeader::ContentLength);
+            response.content.clear();
+            response.fileBody = {};
+        }
+        else {
+            if (compress)
+                compress_body(coding);
+            if (!response.has_header(KnownHeader::ContentLength) && has_body(response.responseCode)) {
+                response[KnownHeader::ContentLength] =
+                    std::to_string(response.content.size() + response.fileBody.size);
+            }
+            // a shared body is already kept by the compressed files
+            if (cacheable && conn.request.protocol == HttpFrame::Protocol::GET && !sharedBody
+                && ResponseCache::cacheable(response))
+            {
+                cache->store(cacheKey, response, now);
+            }
+        }
+        const auto keepAlive = keep_alive(conn, response.keep_alive());
+        if (!keepAlive)
+            response[KnownHeader::Connection] = "close";
+        else if (conn.request.http_version() < std::pair(1, 1))
+            response[KnownHeader::Connection] = "keep-alive";
+        if (conn.request.protocol == HttpFrame::Protocol::HEAD) {
+            response.content.clear();
+            response.fileBody = {};
+            sharedBody.reset();
+        }
+        queue();
+        return keepAlive;
+    }
+
+    /// @return true if the response is a 200 response whose ETag matches the request's `If-None-Match`
+    bool not_modified(const HttpRequestFrame& request) const {
+        if (response.responseCode != HttpResponse::ok)
+            return false;
+        const auto match = request.headers().find("If-None-Match");
+        const auto etag = match ? response.headers().find("ETag") : nullptr;
+        return etag && etag_matches(*match, *etag);
+    }
+
+    /**
+    * Marks a 200 response with a body worth compressing as varying by `Accept-Encoding`,
+    * and unless `coding` is the identity, gives it the headers and tag of its body
+    * compressed with `coding`
+    * @return true if the body has to be compressed with `compress_body`
+    */
+    bool label_compressed(ContentCoding coding) {
+        const auto& file = response.fileBody;
+        const auto size = response.content.size() + file.size;
+        const auto type = response.headers().find(KnownHeader::ContentType);
+        if (response.responseCode != HttpResponse::ok || size < options.compression.minSize
+            || !type || !compressible_type(*type) || response.has_header("Content-Encoding")
+            || (file.file && !response.content.empty()))
+        {
+            return false;
+        }
+        auto& vary = response["Vary"];
+        if (!has_token(vary, "Accept-Encoding") && vary != "*")
+            vary.append(vary.empty() ? "Accept-Encoding" : ", Accept-Encoding");
+        if (coding == ContentCoding::Identity)
+            return false;
+        response["Content-Encoding"] = coding_name(coding);
+        // byte ranges are of the uncompressed body, which isn't what is sent
+        response.headers().erase("Accept-Ranges");
+        // the compressed body is a different representation, so it needs its own tag
+        if (const auto etag = response.headers().find("ETag");
+            etag && etag->size() >= 2 && etag->back() == '"')
+        {
+            auto& tag = response["ETag"];
+            tag.insert(tag.size() - 1, std::string("-").append(coding_name(coding)));
+        }
+        return true;
+    }
+
+    /// Compresses the body of a response labelled by `label_compressed` with `coding`
+    void compress_body(ContentCoding coding) {
+        const auto& file = response.fileBody;
+        const auto level = options.compression.level;
+        size_t size;
+        if (file.file && compressedFiles) {
+            // sent from the shared copy, like a cached response
+            sharedBody = compressedFiles->get(file.file, file.offset, file.size, coding, level);
+            size = sharedBody->size();
+        }
+        else {
+            const auto body = file.file ? file.file->data().substr(
+                static_cast<size_t>(file.offset), static_cast<size_t>(file.size))
+                : std::string_view(response.content);
+            Compressor(coding, level).compress_all(body, compressed);
+            response.content.swap(compressed);
+            size = response.content.size();
+        }
+        response.fileBody = {};
+        response[KnownHeader::ContentLength] = std::to_string(size);
+    }
+
+    /// @return true if the request is for the metrics path, ignoring its query
+    bool is_metrics_request(const HttpRequestFrame& request) const noexcept {
+        if (options.metricsPath.empty() || (request.protocol != HttpFrame::Protocol::GET
+            && request.protocol != HttpFrame::Protocol::HEAD))
+        {
+            return false;
+        }
+        const std::string_view path(request.path);
+        return path.substr(0, path.find('?')) == options.metricsPath;
+    }
+
+    /// Fills the response with the metrics of all workers
+    void respond_metrics() {
+        ServerMetrics total;
+        for (const auto& worker : workers)
+            worker->add_metrics(total);
+        response[KnownHeader::ContentType] = "text/plain; version=0.0.4";
+        response["Cache-Control"] = "no-store";
+        total.write_prometheus(response.content);
+    }
+
+    /// Queues an error response without a body, after which the connection is closed
+    void queue_error(const char* code) {
+        reset_response(code);
+        // assigned by count, as GCC 12 warns of overlapping copies in the assignment of
+        // a literal to the freshly cleared slot when optimizing
+        response[KnownHeader::ContentLength].assign(1, '0');
+        response[KnownHeader::Connection] = "close";
+        queue();
+    }
+
+    void queue() {
+        metrics.requests.add();
+        responsePending = true;
+    }
+
+    /**
+    * Sends the queued responses with one write, without waiting for the socket.
+    * What the socket doesn't take is kept in the connection until it is writable
+    * @return the amount of bytes written
+    */
+    size_t flush(Connection& conn) {
+        HttpResponseFrame::FileBody file;
+        if ((responsePending || cachedPending) && batch.empty()) {
+            batchViews.clear();
+            // a lone response is sent straight from the frame without copying it
+            if (responsePending)
+                response_views(batchViews);
+            else
+                cached_views(batchViews);
+            // the last view is the mapped file, which the port may send another way
+            if (responsePending && response.fileBody.file && response.fileBody.size > 0) {
+                file = response.fileBody;
+                batchViews.pop_back();
+            }
+        }
+        else {
+            if (responsePending || cachedPending)
+                batch_response();
+            if (batch.empty())
+                return 0;
+            batchViews.assign(1, batch);
+        }
+        const auto written = conn.port->try_writev(batchViews.data(), batchViews.size());
+        auto skip = written;
+        for (const auto view : batchViews) {
+            if (skip >= view.size()) {
+                skip -= view.size();
+            }
+            else {
+                conn.unsent.append(view.substr(skip));
+                skip = 0;
+            }
+        }
+        conn.unsentFile = std::move(file);
+        if (!conn.unsent.empty())
+            return written;
+        return written + send_unsent(conn);
+    }
+};
+
+struct HttpServer::Impl {
+    ServerOptions options;
+    HttpHandler handler;
+    /// the second socket is closed to stop the workers, whose first socket then reports
+    /// end of file to all of them
+    socket_t stopPair[2];
+    std::unique_ptr<CompressedFiles> compressedFiles;
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+
+    Impl(const ServerOptions& options, HttpHandler&& handler) :
+        options(options), handler(std::move(handler))
+    {
+        if (options.compression.enabled
+            && (options.compression.level < 1 || options.compression.level > 9))
+        {
+            throw std::invalid_argument("Compression level must be from 1 to 9");
+        }
+        socket_pair(stopPair);
+        if (options.compression.enabled && options.compression.maxCachedBytes > 0)
+            compressedFiles = std::make_unique<CompressedFiles>(options.compression.maxCachedBytes);
+        auto count = options.threads;
+        if (count == 0)
+            count = std::max(std::thread::hardware_concurrency(), 1u);
+        try {
+            for (unsigned i = 0; i < count; ++i) {
+                workers.push_back(std::make_unique<Worker>(this->options, this->handler, i,
+                    stopPair[0], workers, compressedFiles.get()));
+            }
+        }
+        catch (...) {
+            close_sock(stopPair[0]);
+            close_sock(stopPair[1]);
+            throw;
+        }
+    }
+
+    ~Impl() {
+        stop();
+        close_sock(stopPair[0]);
+    }
+
+    void stop() {
+        if (stopPair[1] != INVALID_SOCKET) {
+            close_sock(stopPair[1]);
+            stopPair[1] = INVALID_SOCKET;
+        }
+        for (auto& thread : threads)
+            thread.join();
+        threads.clear();
+    }
+};
+
+HttpServer::HttpServer(const ServerOptions& options, HttpHandler handler) :
+    pimpl(std::make_unique<Impl>(options, std::move(handler))) {}
+
+HttpServer::~HttpServer() = default;
+
+void HttpServer::start() {
+    if (!pimpl->threads.empty() || pimpl->stopPair[1] == INVALID_SOCKET)
+        throw std::logic_error("Server is already started or stopped");
+    for (auto& worker : pimpl->workers)
+        pimpl->threads.emplace_back([&worker]() { worker->run(); });
+}
+
+void HttpServer::stop() {
+    pimpl->stop();
+}
+
+unsigned HttpServer::thread_count() const noexcept {
+    return static_cast<unsigned>(pimpl->workers.size());
+}
+
+std::vector<HttpServer::Stats> HttpServer::stats() const {
+    std::vector<Stats> stats;
+    for (const auto& worker : pimpl->workers)
+        stats.push_back({ worker->metrics.accepted.get(), worker->metrics.requests.get() });
+    return stats;
+}
+
+ServerMetrics HttpServer::metrics() const {
+    ServerMetrics total;
+    for (const auto& worker : pimpl->workers)
+        worker->add_metrics(total);
+    return total;
+}
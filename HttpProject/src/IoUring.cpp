@@ -0,0 +1,484 @@
+#include <IoUring.h>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+/// The group of the provided buffers, rings only have one
+constexpr uint16_t bufferGroup = 0;
+
+static int ring_setup(unsigned entries, io_uring_params& params) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+}
+
+static int ring_enter(int fd, unsigned submit, unsigned waitFor, unsigned flags,
+    const void* arg, size_t argSize)
+{
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, submit, waitFor, flags,
+        arg, argSize));
+}
+
+static int ring_register(int fd, unsigned opcode, const void* arg, unsigned count) {
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, count));
+}
+
+/// Maps part of a ring's memory
+static void* map_ring(int fd, size_t size, off_t offset) {
+    const auto memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+        fd, offset);
+    if (memory == MAP_FAILED)
+        throw std::runtime_error("Could not map io_uring: " + std::to_string(errno));
+    return memory;
+}
+
+template<class T>
+T* at(void* base, uint32_t offset) noexcept {
+    return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+}
+
+struct IoUring::Impl {
+    int fd = -1;
+    void* sqRing = nullptr;
+    size_t sqRingSize = 0;
+    void* cqRing = nullptr;
+    size_t cqRingSize = 0;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqesSize = 0;
+
+    std::atomic<unsigned>* sqHead;
+    std::atomic<unsigned>* sqTail;
+    unsigned* sqArray;
+    unsigned sqMask;
+    unsigned sqEntries;
+    /// queued entries which haven't been submitted
+    unsigned unsubmitted = 0;
+    /// completions taken off the queue to make room for submissions, handed out first by `next`
+    std::deque<IoUring::Completion> reaped;
+
+    std::atomic<unsigned>* cqHead;
+    std::atomic<unsigned>* cqTail;
+    unsigned cqMask;
+    io_uring_cqe* cqes;
+
+    /// the ring of provided buffers, followed by the buffers
+    io_uring_buf_ring* bufferRing = nullptr;
+    size_t bufferRingSize = 0;
+    char* buffers = nullptr;
+    unsigned bufferCount = 0;
+    unsigned bufferSize = 0;
+    uint16_t bufferTail = 0;
+
+    char* fixedBuffer = nullptr;
+    size_t fixedSize = 0;
+
+    Impl(unsigned entries, unsigned bufferCount, unsigned bufferSize, size_t fixedSize) {
+        if (bufferCount == 0 || (bufferCount & (bufferCount - 1)) != 0 || bufferCount > 32768)
+            throw std::invalid_argument("The amount of provided buffers must be a power of 2");
+        io_uring_params params{};
+        // multishot operations complete many times, so completions get more room
+        params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_COOP_TASKRUN;
+        params.cq_entries = entries * 4;
+        fd = ring_setup(entries, params);
+        if (fd < 0 && errno == EINVAL) {
+            params = {};
+            params.flags = IORING_SETUP_CQSIZE;
+            params.cq_entries = entries * 4;
+            fd = ring_setup(entries, params);
+        }
+        if (fd < 0)
+            throw std::runtime_error("Could not create io_uring: " + std::to_string(errno));
+        try {
+            // timeouts are passed with the wait, and sockets are polled instead of
+            // taking a worker thread
+            const auto required = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP
+                | IORING_FEAT_FAST_POLL | IORING_FEAT_EXT_ARG;
+            if ((params.features & required) != required)
+                throw std::runtime_error("io_uring lacks required features");
+            map(params);
+            provide_buffers(bufferCount, bufferSize);
+            if (!probe_multishot_receive())
+                throw std::runtime_error("io_uring lacks multishot receives");
+            if (fixedSize > 0)
+                register_fixed(fixedSize);
+        }
+        catch (...) {
+            unmap();
+            throw;
+        }
+    }
+
+    ~Impl() {
+        unmap();
+    }
+
+    void map(const io_uring_params& params) {
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        // both rings share one mapping
+        sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+        sqRing = cqRing = map_ring(fd, sqRingSize, IORING_OFF_SQ_RING);
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = static_cast<io_uring_sqe*>(map_ring(fd, sqesSize, IORING_OFF_SQES));
+
+        sqHead = at<std::atomic<unsigned>>(sqRing, params.sq_off.head);
+        sqTail = at<std::atomic<unsigned>>(sqRing, params.sq_off.tail);
+        sqArray = at<unsigned>(sqRing, params.sq_off.array);
+        sqMask = *at<unsigned>(sqRing, params.sq_off.ring_mask);
+        sqEntries = *at<unsigned>(sqRing, params.sq_off.ring_entries);
+        cqHead = at<std::atomic<unsigned>>(cqRing, params.cq_off.head);
+        cqTail = at<std::atomic<unsigned>>(cqRing, params.cq_off.tail);
+        cqMask = *at<unsigned>(cqRing, params.cq_off.ring_mask);
+        cqes = at<io_uring_cqe>(cqRing, params.cq_off.cqes);
+    }
+
+    void provide_buffers(unsigned count, unsigned size) {
+        bufferCount = count;
+        bufferSize = size;
+        // the buffer ring has to be page aligned, which a mapping is
+        bufferRingSize = count * sizeof(io_uring_buf) + static_cast<size_t>(count) * size;
+        const auto memory = mmap(nullptr, bufferRingSize, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED)
+            throw std::runtime_error("Could not allocate provided buffers: "
+                + std::to_string(errno));
+        bufferRing = static_cast<io_uring_buf_ring*>(memory);
+        buffers = static_cast<char*>(memory) + count * sizeof(io_uring_buf);
+        io_uring_buf_reg reg{};
+        reg.ring_addr = reinterpret_cast<uint64_t>(bufferRing);
+        reg.ring_entries = count;
+        reg.bgid = bufferGroup;
+        if (ring_register(fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+            throw std::runtime_error("Could not register provided buffers: "
+                + std::to_string(errno));
+        for (unsigned i = 0; i < count; ++i)
+            add_buffer(static_cast<uint16_t>(i));
+        publish_buffers();
+    }
+
+    void register_fixed(size_t size) {
+        const auto memory = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED)
+            throw std::runtime_error("Could not allocate fixed buffer: " + std::to_string(errno));
+        fixedBuffer = static_cast<char*>(memory);
+        fixedSize = size;
+        const iovec iov{ memory, size };
+        // registering pins the pages, which fails past the memlock limit,
+        // and the ring is still usable without a fixed buffer
+        if (ring_register(fd, IORING_REGISTER_BUFFERS, &iov, 1) < 0) {
+            munmap(fixedBuffer, fixedSize);
+            fixedBuffer = nullptr;
+            fixedSize = 0;
+        }
+    }
+
+    void unmap() noexcept {
+        if (fd >= 0)
+            close(fd);
+        if (sqes != nullptr)
+            munmap(sqes, sqesSize);
+        if (sqRing != nullptr)
+            munmap(sqRing, sqRingSize);
+        if (bufferRing != nullptr)
+            munmap(bufferRing, bufferRingSize);
+        if (fixedBuffer != nullptr)
+            munmap(fixedBuffer, fixedSize);
+    }
+
+    /// Adds a buffer to the provided buffers, which the kernel sees once they are published
+    void add_buffer(uint16_t id) noexcept {
+        // in C++ the empty struct __DECLARE_FLEX_ARRAY puts before `bufs` takes up space,
+        // so the buffers are found without it
+        auto& buf = reinterpret_cast<io_uring_buf*>(bufferRing)[bufferTail & (bufferCount - 1)];
+        buf.addr = reinterpret_cast<uint64_t>(buffers + static_cast<size_t>(id) * bufferSize);
+        buf.len = bufferSize;
+        buf.bid = id;
+        ++bufferTail;
+    }
+
+    void publish_buffers() noexcept {
+        // the tail shares its place with the reserved field of the first buffer
+        reinterpret_cast<std::atomic<uint16_t>*>(&bufferRing->tail)->store(bufferTail,
+            std::memory_order_release);
+    }
+
+    /**
+    * Tries a multishot receive on a socket pair whose peer has closed, which completes at
+    * once, as the probe of operations doesn't cover the flags of an operation
+    * @return true if the kernel accepts multishot receives, which came last of what rings use
+    */
+    bool probe_multishot_receive() {
+        int pair[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, pair) != 0)
+            throw std::runtime_error("Could not create a socket pair: " + std::to_string(errno));
+        close(pair[1]);
+        auto& sqe = next_sqe();
+        sqe.opcode = IORING_OP_RECV;
+        sqe.fd = pair[0];
+        sqe.ioprio = IORING_RECV_MULTISHOT;
+        sqe.flags = IOSQE_BUFFER_SELECT;
+        sqe.buf_group = bufferGroup;
+        IoUring::Completion completion{};
+        while (!take(completion))
+            enter(1, IORING_ENTER_GETEVENTS, nullptr);
+        close(pair[0]);
+        if (completion.hasBuffer) {
+            add_buffer(completion.buffer);
+            publish_buffers();
+        }
+        return completion.result != -EINVAL;
+    }
+
+    /// @return the amount of queued entries which the kernel hasn't taken
+    unsigned queued() const noexcept {
+        return sqTail->load(std::memory_order_relaxed) + unsubmitted
+            - sqHead->load(std::memory_order_acquire);
+    }
+
+    /// @return a cleared submission entry, submitting the queued entries if the queue is full
+    io_uring_sqe& next_sqe() {
+        // entries the kernel didn't take when they were submitted still hold their places
+        while (queued() >= sqEntries) {
+            if (enter(0, 0, nullptr))
+                continue;
+            // the kernel takes no entries while completions wait for room in their queue,
+            // so they are set aside, or it is out of memory until operations complete
+            if (!take_all())
+                enter(1, IORING_ENTER_GETEVENTS, nullptr);
+            take_all();
+        }
+        const auto tail = sqTail->load(std::memory_order_relaxed) + unsubmitted;
+        const auto index = tail & sqMask;
+        sqArray[index] = index;
+        auto& sqe = sqes[index];
+        std::memset(&sqe, 0, sizeof(sqe));
+        ++unsubmitted;
+        return sqe;
+    }
+
+    /**
+    * Submits the queued entries, waiting for `waitFor` completions
+    * @return false if the kernel took no entries, as it has completions which don't fit
+    *   the completion queue until completions are taken (EBUSY) or is out of memory (EAGAIN).
+    *   The entries stay queued and are submitted with the next call
+    */
+    bool enter(unsigned waitFor, unsigned flags, const io_uring_getevents_arg* arg) {
+        // the kernel reads entries up to the tail, including any it didn't take last time
+        const auto tail = sqTail->load(std::memory_order_relaxed) + unsubmitted;
+        sqTail->store(tail, std::memory_order_release);
+        unsubmitted = 0;
+        const auto toSubmit = tail - sqHead->load(std::memory_order_acquire);
+        if (ring_enter(fd, toSubmit, waitFor, flags, arg, arg == nullptr ? 0 : sizeof(*arg)) < 0
+            // a timeout or signal ends the wait, and with a full completion queue the
+            // caller takes completions before the rest is submitted
+            && errno != ETIME && errno != EINTR && errno != EBUSY && errno != EAGAIN)
+        {
+            throw std::runtime_error("Failed to submit to io_uring: " + std::to_string(errno));
+        }
+        return toSubmit == 0 || queued() < toSubmit;
+    }
+
+    /**
+    * Takes the oldest completion off the completion queue
+    * @return false if the queue is empty
+    */
+    bool take(IoUring::Completion& completion) noexcept {
+        const auto head = cqHead->load(std::memory_order_relaxed);
+        if (head == cqTail->load(std::memory_order_acquire))
+            return false;
+        const auto& cqe = cqes[head & cqMask];
+        completion.tag = cqe.user_data;
+        completion.result = cqe.res;
+        completion.hasBuffer = (cqe.flags & IORING_CQE_F_BUFFER) != 0;
+        completion.buffer = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+        completion.more = (cqe.flags & IORING_CQE_F_MORE) != 0;
+        cqHead->store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+    * Moves the completions on the completion queue to `reaped`
+    * @return false if there were none
+    */
+    bool take_all() {
+        IoUring::Completion completion;
+        const auto before = reaped.size();
+        while (take(completion))
+            reaped.push_back(completion);
+        return reaped.size() > before;
+    }
+};
+
+bool IoUring::supported() noexcept {
+    static const auto isSupported = []() {
+        try {
+            IoUring ring(8, 8, 64, 0);
+            return true;
+        }
+        catch (...) {
+            return false;
+        }
+    }();
+    return isSupported;
+}
+
+IoUring::IoUring(unsigned entries, unsigned bufferCount, unsigned bufferSize,
+    size_t fixedSize) :
+    pimpl(std::make_unique<Impl>(entries, bufferCount, bufferSize, fixedSize)) {}
+
+IoUring::~IoUring() = default;
+
+void IoUring::accept(int fd, uint64_t tag) {
+    auto& sqe = pimpl->next_sqe();
+    sqe.opcode = IORING_OP_ACCEPT;
+    sqe.fd = fd;
+    sqe.ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe.accept_flags = SOCK_CLOEXEC;
+    sqe.user_data = tag;
+}
+
+void IoUring::receive(int fd, uint64_t tag) {
+    auto& sqe = pimpl->next_sqe();
+    sqe.opcode = IORING_OP_RECV;
+    sqe.fd = fd;
+    sqe.ioprio = IORING_RECV_MULTISHOT;
+    sqe.flags = IOSQE_BUFFER_SELECT;
+    sqe.buf_group = bufferGroup;
+    sqe.user_data = tag;
+}
+
+void IoUring::send(int fd, const char* data, size_t size, uint64_t tag) {
+    auto& sqe = pimpl->next_sqe();
+    sqe.opcode = IORING_OP_SEND;
+    sqe.fd = fd;
+    sqe.addr = reinterpret_cast<uint64_t>(data);
+    sqe.len = static_cast<uint32_t>(std::min<size_t>(size, UINT32_MAX));
+    sqe.msg_flags = MSG_NOSIGNAL;
+    sqe.user_data = tag;
+}
+
+void IoUring::write_fixed(int fd, const char* data, size_t size, uint64_t tag) {
+    auto& sqe = pimpl->next_sqe();
+    sqe.opcode = IORING_OP_WRITE_FIXED;
+    sqe.fd = fd;
+    sqe.addr = reinterpret_cast<uint64_t>(data);
+    sqe.len = static_cast<uint32_t>(std::min<size_t>(size, UINT32_MAX));
+    sqe.buf_index = 0;
+    sqe.user_data = tag;
+}
+
+void IoUring::poll(int fd, bool writable, bool multishot, uint64_t tag) {
+    auto& sqe = pimpl->next_sqe();
+    sqe.opcode = IORING_OP_POLL_ADD;
+    sqe.fd = fd;
+    sqe.poll32_events = writable ? POLLOUT : POLLIN;
+    sqe.len = multishot ? IORING_POLL_ADD_MULTI : 0;
+    sqe.user_data = tag;
+}
+
+void IoUring::cancel(uint64_t target, uint64_t tag) {
+    auto& sqe = pimpl->next_sqe();
+    sqe.opcode = IORING_OP_ASYNC_CANCEL;
+    sqe.fd = -1;
+    sqe.addr = target;
+    sqe.user_data = tag;
+}
+
+void IoUring::submit(unsigned waitFor, std::optional<std::chrono::microseconds> timeout) {
+    if (waitFor == 0 || !timeout) {
+        pimpl->enter(waitFor, IORING_ENTER_GETEVENTS, nullptr);
+        return;
+    }
+    __kernel_timespec ts{};
+    ts.tv_sec = timeout->count() / 1000000;
+    ts.tv_nsec = (timeout->count() % 1000000) * 1000;
+    io_uring_getevents_arg arg{};
+    arg.ts = reinterpret_cast<uint64_t>(&ts);
+    pimpl->enter(waitFor, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg);
+}
+
+bool IoUring::next(Completion& completion) noexcept {
+    // completions set aside while queueing are older than the ones on the queue
+    if (!pimpl->reaped.empty()) {
+        completion = pimpl->reaped.front();
+        pimpl->reaped.pop_front();
+        return true;
+    }
+    return pimpl->take(completion);
+}
+
+const char* IoUring::buffer(uint16_t id) const noexcept {
+    return pimpl->buffers + static_cast<size_t>(id) * pimpl->bufferSize;
+}
+
+void IoUring::recycle(uint16_t id) noexcept {
+    pimpl->add_buffer(id);
+    pimpl->publish_buffers();
+}
+
+char* IoUring::fixed() const noexcept {
+    return pimpl->fixedBuffer;
+}
+
+size_t IoUring::fixed_size() const noexcept {
+    return pimpl->fixedSize;
+}
+#else
+struct IoUring::Impl {};
+
+bool IoUring::supported() noexcept {
+    return false;
+}
+
+IoUring::IoUring(unsigned, unsigned, unsigned, size_t) {
+    throw std::runtime_error("io_uring is only available on Linux");
+}
+
+IoUring::~IoUring() = default;
+
+void IoUring::accept(int, uint64_t) {}
+
+void IoUring::receive(int, uint64_t) {}
+
+void IoUring::send(int, const char*, size_t, uint64_t) {}
+
+void IoUring::write_fixed(int, const char*, size_t, uint64_t) {}
+
+void IoUring::poll(int, bool, bool, uint64_t) {}
+
+void IoUring::cancel(uint64_t, uint64_t) {}
+
+void IoUring::submit(unsigned, std::optional<std::chrono::microseconds>) {}
+
+bool IoUring::next(Completion&) noexcept {
+    return false;
+}
+
+const char* IoUring::buffer(uint16_t) const noexcept {
+    return nullptr;
+}
+
+void IoUring::recycle(uint16_t) noexcept {}
+
+char* IoUring::fixed() const noexcept {
+    return nullptr;
+}
+
+size_t IoUring::fixed_size() const noexcept {
+    return 0;
+}
+#endif
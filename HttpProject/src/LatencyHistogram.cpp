@@ -0,0 +1,89 @@
+#include <LatencyHistogram.h>
+#include <algorithm>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+/// buckets per power of two above `subBucketCount`
+constexpr uint64_t subBucketHalfCount = LatencyHistogram::subBucketCount / 2;
+
+/// @return the position of the highest set bit of a nonzero value
+static unsigned highest_bit(uint64_t value) noexcept {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return static_cast<unsigned>(index);
+#else
+    return 63 - static_cast<unsigned>(__builtin_clzll(value));
+#endif
+}
+
+size_t LatencyHistogram::bucket_index(uint64_t value) noexcept {
+    value = std::min(value, maxValue);
+    if (value < subBucketCount)
+        return static_cast<size_t>(value);
+    // the top subBucketBits bits of the value select its bucket within its power of two
+    const auto shift = highest_bit(value) - (subBucketBits - 1);
+    return static_cast<size_t>(shift * subBucketHalfCount + (value >> shift));
+}
+
+uint64_t LatencyHistogram::bucket_max(size_t index) noexcept {
+    if (index < subBucketCount)
+        return index;
+    const auto shift = index / subBucketHalfCount - 1;
+    const auto sub = index - shift * subBucketHalfCount;
+    return ((sub + 1) << shift) - 1;
+}
+
+LatencyHistogram::LatencyHistogram() : counts(bucket_index(maxValue) + 1) {}
+
+void LatencyHistogram::record(uint64_t nanoseconds) noexcept {
+    ++counts[bucket_index(nanoseconds)];
+    ++total;
+    minValue = std::min(minValue, nanoseconds);
+    maxSeen = std::max(maxSeen, nanoseconds);
+    sum += static_cast<double>(nanoseconds);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) noexcept {
+    for (size_t i = 0; i < counts.size(); ++i)
+        counts[i] += other.counts[i];
+    total += other.total;
+    minValue = std::min(minValue, other.minValue);
+    maxSeen = std::max(maxSeen, other.maxSeen);
+    sum += other.sum;
+}
+
+void LatencyHistogram::reset() noexcept {
+    std::fill(counts.begin(), counts.end(), 0);
+    total = 0;
+    minValue = UINT64_MAX;
+    maxSeen = 0;
+    sum = 0;
+}
+
+uint64_t LatencyHistogram::min() const noexcept {
+    return total == 0 ? 0 : minValue;
+}
+
+uint64_t LatencyHistogram::max() const noexcept {
+    return maxSeen;
+}
+
+double LatencyHistogram::mean() const noexcept {
+    return total == 0 ? 0 : sum / static_cast<double>(total);
+}
+
+uint64_t LatencyHistogram::percentile(double percentile) const noexcept {
+    if (total == 0)
+        return 0;
+    const auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(
+        std::min(percentile, 100.0) / 100 * static_cast<double>(total) + 0.5));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts.size(); ++i) {
+        seen += counts[i];
+        if (seen >= rank)
+            return std::min(bucket_max(i), maxSeen);
+    }
+    return maxSeen;
+}
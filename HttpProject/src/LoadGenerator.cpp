@@ -0,0 +1,348 @@
+#include <LoadGenerator.h>
+#include <Address.h>
+#include <ChunkedCodec.h>
+#include <FdSet.h>
+#include <HttpHeaders.h>
+#include <SSLSocket.h>
+#include <Socket.h>
+#include <algorithm>
+#include <charconv>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#undef min
+#undef max
+
+using LoadClock = std::chrono::steady_clock;
+
+/// Longest a load thread waits for responses before checking the time again
+constexpr auto maxLoadWait = std::chrono::milliseconds(20);
+
+/// A connection of a load thread and the response it is waiting for
+struct LoadConnection {
+    std::unique_ptr<Port> port;
+    socket_t fd = 0;
+    /// data received which isn't part of a complete response yet
+    std::string buffer;
+    /// true while a request is unanswered
+    bool waiting = false;
+    /// when the unanswered request was sent, or was scheduled to be in an open loop
+    LoadClock::time_point sent;
+    /// when the next request is scheduled in an open loop
+    LoadClock::time_point next;
+
+    /// size of the response head, 0 until the head is complete
+    size_t headSize = 0;
+    int status = 0;
+    /// size of the body, when it has a `Content-Length`
+    uint64_t bodySize = 0;
+    bool chunked = false;
+    /// true if the body ends when the server closes the connection
+    bool untilClose = false;
+    /// true if the server closes the connection after the response
+    bool closeAfter = false;
+    ChunkedDecoder decoder;
+    /// bytes after the head already given to the decoder
+    size_t decoded = 0;
+
+    /// Forgets the response in progress and any data received for it
+    void reset_response() noexcept {
+        buffer.clear();
+        headSize = 0;
+        chunked = untilClose = closeAfter = false;
+        decoder.reset();
+        decoded = 0;
+    }
+};
+
+/// Sends requests over a share of the connections of a load test
+class LoadThread {
+    const LoadOptions& options;
+    const Address& address;
+    LoadResult& result;
+    FdSet set;
+    std::vector<LoadConnection> connections;
+    std::unordered_map<socket_t, size_t> byFd;
+    /// time between two requests of one connection in an open loop
+    std::chrono::nanoseconds interval{ 0 };
+    bool headRequests;
+
+    /// Opens the connection at `index`, replacing its port
+    void connect(size_t index) {
+        auto& conn = connections[index];
+        if (conn.port) {
+            conn.port->remove_from_fd(set);
+            byFd.erase(conn.fd);
+            conn.port.reset();
+        }
+        conn.reset_response();
+        conn.waiting = false;
+        if (options.tls) {
+            auto sock = std::make_unique<SSLSocket>(address);
+            conn.fd = static_cast<socket_t>(sock->handle());
+            conn.port = std::move(sock);
+        }
+        else {
+            auto sock = std::make_unique<TcpSocket>(address);
+            // requests are written whole, so Nagle's algorithm would only delay them
+            sock->set_nodelay(true);
+            conn.fd = static_cast<socket_t>(sock->handle());
+            conn.port = std::move(sock);
+        }
+        conn.port->add_to_fd(set);
+        byFd[conn.fd] = index;
+    }
+
+    /// Reopens a connection after it failed or the server closed it
+    void reconnect(size_t index) {
+        ++result.reconnects;
+        try {
+            connect(index);
+        }
+        catch (const std::runtime_error&) {
+            // connect already left the connection without a port, it is retried later
+            ++result.failures;
+            connections[index].next = LoadClock::now() + maxLoadWait;
+        }
+    }
+
+    void send(LoadConnection& conn, LoadClock::time_point sent) {
+        conn.sent = sent;
+        conn.waiting = true;
+        conn.port->write(options.request);
+    }
+
+    /**
+    * Parses the head of the buffered response
+    * @return false if the head is incomplete
+    */
+    bool parse_head(LoadConnection& conn) {
+        const auto end = conn.buffer.find("\r\n\r\n");
+        if (end == std::string::npos)
+            return false;
+        conn.headSize = end + 4;
+        conn.bodySize = 0;
+        conn.chunked = conn.untilClose = conn.closeAfter = false;
+        const std::string_view head(conn.buffer.data(), end + 2);
+        // HTTP/1.1 200 OK
+        if (head.size() < 12
+            || std::from_chars(head.data() + 9, head.data() + 12, conn.status).ec != std::errc())
+        {
+            throw std::runtime_error("Malformed status line");
+        }
+        auto hasLength = false;
+        for (auto pos = head.find("\r\n") + 2; pos < head.size();) {
+            const auto lineEnd = head.find("\r\n", pos);
+            const auto line = head.substr(pos, lineEnd - pos);
+            pos = lineEnd + 2;
+            const auto colon = line.find(':');
+            if (colon == std::string_view::npos)
+                continue;
+            const auto name = line.substr(0, colon);
+            auto value = line.substr(colon + 1);
+            value.remove_prefix(std::min(value.find_first_not_of(" \t"), value.size()));
+            if (detail::iequals(name, "Content-Length")) {
+                hasLength = std::from_chars(value.data(), value.data() + value.size(),
+                    conn.bodySize).ec == std::errc();
+            }
+            else if (detail::iequals(name, "Transfer-Encoding")) {
+                conn.chunked = has_token(value, "chunked");
+            }
+            else if (detail::iequals(name, "Connection")) {
+                conn.closeAfter = has_token(value, "close");
+            }
+        }
+        if (headRequests || conn.status / 100 == 1 || conn.status == 204 || conn.status == 304) {
+            conn.chunked = false;
+            conn.bodySize = 0;
+        }
+        else if (!conn.chunked && !hasLength) {
+            conn.untilClose = true;
+        }
+        return true;
+    }
+
+    /**
+    * Removes a complete response from the front of the buffer
+    * @return false if the buffered response is incomplete
+    */
+    bool take_response(LoadConnection& conn) {
+        if (conn.headSize == 0 && !parse_head(conn))
+            return false;
+        size_t size;
+        if (conn.chunked) {
+            std::string_view input(conn.buffer);
+            input.remove_prefix(conn.headSize + conn.decoded);
+            const auto before = input.size();
+            while (!input.empty() && conn.decoder.status() == ChunkedDecoder::Status::Incomplete)
+                conn.decoder.decode(input);
+            conn.decoded += before - input.size();
+            if (conn.decoder.status() == ChunkedDecoder::Status::Error)
+                throw std::runtime_error("Malformed chunked body");
+            if (conn.decoder.status() != ChunkedDecoder::Status::Done)
+                return false;
+            size = conn.headSize + conn.decoded;
+        }
+        else if (conn.untilClose) {
+            return false;
+        }
+        else {
+            size = conn.headSize + conn.bodySize;
+            if (conn.buffer.size() < size)
+                return false;
+        }
+        conn.buffer.erase(0, size);
+        conn.headSize = 0;
+        conn.decoder.reset();
+        conn.decoded = 0;
+        return true;
+    }
+
+    /// Records the answer to the request of a connection
+    void answered(LoadConnection& conn, LoadClock::time_point now) {
+        result.latency.record(now - conn.sent);
+        ++result.responses;
+        if (conn.status >= 400)
+            ++result.errorResponses;
+        conn.waiting = false;
+    }
+
+    /// Reads the available data of a connection and handles the responses it completes
+    void on_readable(size_t index, LoadClock::time_point now) {
+        auto& conn = connections[index];
+        char buffer[16 * 1024];
+        try {
+            try {
+                // a single read, which doesn't wait as the connection is readable. Reads which
+                // find the connection closed throw and drop what they read before, so reading
+                // until no data is left would lose the end of a response delimited by the close.
+                // The set is level triggered, so data left unread wakes the next wait
+                conn.buffer.append(buffer, conn.port->read_into(buffer, sizeof(buffer)));
+            }
+            catch (const std::runtime_error&) {
+                // a body delimited by the connection closing is complete
+                if (conn.waiting && conn.untilClose) {
+                    answered(conn, now);
+                    reconnect(index);
+                    return;
+                }
+                throw;
+            }
+            while (conn.waiting && take_response(conn)) {
+                answered(conn, now);
+                if (conn.closeAfter) {
+                    reconnect(index);
+                    return;
+                }
+            }
+        }
+        catch (const std::runtime_error&) {
+            if (conn.waiting)
+                ++result.failures;
+            reconnect(index);
+        }
+    }
+public:
+    LoadThread(const LoadOptions& options, const Address& address, LoadResult& result,
+        unsigned connectionCount) : options(options), address(address), result(result),
+        connections(connectionCount), headRequests(options.request.rfind("HEAD ", 0) == 0)
+    {
+        if (options.rate > 0) {
+            interval = std::chrono::nanoseconds(static_cast<int64_t>(
+                1e9 * options.connections / options.rate));
+        }
+        for (size_t i = 0; i < connections.size(); ++i)
+            connect(i);
+    }
+
+    /// Sends requests from `start` until `end`
+    void run(LoadClock::time_point start, LoadClock::time_point end) {
+        // spreads the first requests of an open loop over one interval
+        for (size_t i = 0; i < connections.size(); ++i)
+            connections[i].next = start + interval * i / connections.size();
+        for (auto now = LoadClock::now(); now < end; now = LoadClock::now()) {
+            auto wake = now + maxLoadWait;
+            for (size_t i = 0; i < connections.size(); ++i) {
+                auto& conn = connections[i];
+                if (conn.waiting)
+                    continue;
+                if ((interval.count() != 0 || !conn.port) && conn.next > now) {
+                    wake = std::min(wake, conn.next);
+                    continue;
+                }
+                try {
+                    if (!conn.port)
+                        connect(i);
+                    // a late request still counts from its scheduled time
+                    send(conn, interval.count() == 0 ? now : conn.next);
+                    conn.next += interval;
+                }
+                catch (const std::runtime_error&) {
+                    ++result.failures;
+                    if (conn.port)
+                        reconnect(i);
+                    conn.next = now + maxLoadWait;
+                }
+            }
+            const auto timeout = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::min(wake, end) - now);
+            FdSet::wait(std::max(timeout, std::chrono::microseconds(0)), ReadSet{ set });
+            now = LoadClock::now();
+            // reconnecting changes the set, so the ready fds are copied
+            const std::vector<socket_t> ready(set.ready().begin(), set.ready().end());
+            for (const auto fd : ready) {
+                if (const auto it = byFd.find(fd); it != byFd.end())
+                    on_readable(it->second, now);
+            }
+        }
+    }
+};
+
+LoadResult run_load(const LoadOptions& options) {
+    if (options.connections == 0 || options.threads == 0)
+        throw std::invalid_argument("A load test needs at least one connection and thread");
+    const Address address(options.host, options.port);
+    const auto threadCount = std::min(options.threads, options.connections);
+    std::vector<LoadResult> results(threadCount);
+    std::vector<std::unique_ptr<LoadThread>> loadThreads;
+    for (unsigned i = 0; i < threadCount; ++i) {
+        const auto share = options.connections / threadCount
+            + (i < options.connections % threadCount ? 1 : 0);
+        loadThreads.push_back(std::make_unique<LoadThread>(options, address, results[i], share));
+    }
+
+    const auto start = LoadClock::now();
+    const auto end = start + options.duration;
+    std::vector<std::thread> threads;
+    std::vector<std::exception_ptr> errors(threadCount);
+    for (unsigned i = 0; i < threadCount; ++i) {
+        threads.emplace_back([&, i]() {
+            try {
+                loadThreads[i]->run(start, end);
+            }
+            catch (...) {
+                errors[i] = std::current_exception();
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    for (const auto& error : errors) {
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+    LoadResult total;
+    total.elapsed = LoadClock::now() - start;
+    for (const auto& result : results) {
+        total.responses += result.responses;
+        total.errorResponses += result.errorResponses;
+        total.failures += result.failures;
+        total.reconnects += result.reconnects;
+        total.latency.merge(result.latency);
+    }
+    return total;
+}
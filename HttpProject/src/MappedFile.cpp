@@ -0,0 +1,65 @@
+#include <MappedFile.h>
+#include <cerrno>
+#include <stdexcept>
+#ifdef WIN32
+#include <fstream>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef WIN32
+MappedFile::MappedFile(const std::string& path) {
+    struct _stat64 info;
+    if (_stat64(path.c_str(), &info) != 0 || (info.st_mode & _S_IFREG) == 0)
+        throw std::runtime_error("Failed to open file: " + path);
+    std::ifstream in(path, std::ios::binary);
+    length = static_cast<size_t>(info.st_size);
+    mapping = new char[length];
+    if (!in.read(mapping, static_cast<std::streamsize>(length))) {
+        delete[] mapping;
+        throw std::runtime_error("Failed to read file: " + path);
+    }
+    modifiedNs = static_cast<int64_t>(info.st_mtime) * 1000000000;
+}
+
+MappedFile::~MappedFile() {
+    delete[] mapping;
+}
+#else
+MappedFile::MappedFile(const std::string& path) {
+    file = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file < 0)
+        throw std::runtime_error("Failed to open file " + path + ": " + std::to_string(errno));
+    struct stat info;
+    if (fstat(file, &info) != 0 || !S_ISREG(info.st_mode)) {
+        close(file);
+        throw std::runtime_error("Not a regular file: " + path);
+    }
+    length = static_cast<size_t>(info.st_size);
+#ifdef __APPLE__
+    modifiedNs = static_cast<int64_t>(info.st_mtimespec.tv_sec) * 1000000000
+        + info.st_mtimespec.tv_nsec;
+#else
+    modifiedNs = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+    // empty files can't be mapped, and have no data to map
+    if (length == 0)
+        return;
+    const auto address = mmap(nullptr, length, PROT_READ, MAP_SHARED, file, 0);
+    if (address == MAP_FAILED) {
+        close(file);
+        throw std::runtime_error("Failed to map file " + path + ": " + std::to_string(errno));
+    }
+    mapping = static_cast<char*>(address);
+}
+
+MappedFile::~MappedFile() {
+    if (mapping != nullptr)
+        munmap(mapping, length);
+    close(file);
+}
+#endif
@@ -0,0 +1,108 @@
+#include <Metrics.h>
+#include <algorithm>
+#include <cstdio>
+#include <string_view>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#undef min
+#undef max
+
+MetricHistogram::Snapshot& MetricHistogram::Snapshot::operator+=(
+    const Snapshot& other) noexcept
+{
+    for (size_t i = 0; i < buckets.size(); ++i)
+        buckets[i] += other.buckets[i];
+    count += other.count;
+    sum += other.sum;
+    return *this;
+}
+
+size_t MetricHistogram::bucket_index(std::chrono::nanoseconds duration) noexcept {
+    // whole microseconds, rounded up, so a bucket holds the durations up to its bound
+    const auto micros = (static_cast<uint64_t>(std::max<int64_t>(duration.count(), 0)) + 999)
+        / 1000;
+    if (micros <= 1)
+        return 0;
+#ifdef _MSC_VER
+    unsigned long bit;
+    _BitScanReverse64(&bit, micros - 1);
+    const size_t index = bit + 1;
+#else
+    const size_t index = 64 - static_cast<size_t>(__builtin_clzll(micros - 1));
+#endif
+    return std::min(index, boundedBuckets);
+}
+
+MetricHistogram::Snapshot MetricHistogram::snapshot() const noexcept {
+    Snapshot snapshot;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        snapshot.buckets[i] = buckets[i].get();
+        snapshot.count += snapshot.buckets[i];
+    }
+    snapshot.sum = sum.get();
+    return snapshot;
+}
+
+/// Appends the help and type comments of a metric
+static void write_header(std::string& out, std::string_view name, std::string_view type,
+    std::string_view help)
+{
+    out.append("# HELP ").append(name).append(" ").append(help).append("\n");
+    out.append("# TYPE ").append(name).append(" ").append(type).append("\n");
+}
+
+/// Appends a metric with a single value
+static void write_metric(std::string& out, std::string_view name, std::string_view type,
+    std::string_view help, uint64_t value)
+{
+    write_header(out, name, type, help);
+    out.append(name).append(" ").append(std::to_string(value)).append("\n");
+}
+
+/// Appends the cumulative buckets, sum and count of a histogram in seconds
+static void write_histogram(std::string& out, std::string_view name, std::string_view help,
+    const MetricHistogram::Snapshot& histogram)
+{
+    write_header(out, name, "histogram", help);
+    char number[32];
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i < MetricHistogram::boundedBuckets; ++i) {
+        cumulative += histogram.buckets[i];
+        std::snprintf(number, sizeof(number), "%.9g", MetricHistogram::bucket_bound(i));
+        out.append(name).append("_bucket{le=\"").append(number).append("\"} ")
+            .append(std::to_string(cumulative)).append("\n");
+    }
+    out.append(name).append("_bucket{le=\"+Inf\"} ")
+        .append(std::to_string(histogram.count)).append("\n");
+    std::snprintf(number, sizeof(number), "%.9f", static_cast<double>(histogram.sum) * 1e-9);
+    out.append(name).append("_sum ").append(number).append("\n");
+    out.append(name).append("_count ").append(std::to_string(histogram.count)).append("\n");
+}
+
+void ServerMetrics::write_prometheus(std::string& out) const {
+    write_metric(out, "http_connections_accepted_total", "counter",
+        "Connections accepted.", connectionsAccepted);
+    write_metric(out, "http_connections_active", "gauge",
+        "Connections currently open.", active_connections());
+    write_metric(out, "http_tls_handshakes_total", "counter",
+        "TLS handshakes which finished.", handshakes);
+    write_metric(out, "http_tls_handshake_failures_total", "counter",
+        "TLS handshakes which failed or timed out.", handshakeFailures);
+    write_metric(out, "http_received_bytes_total", "counter",
+        "Bytes read from connections.", bytesRead);
+    write_metric(out, "http_sent_bytes_total", "counter",
+        "Bytes written to connections.", bytesWritten);
+    write_metric(out, "http_requests_total", "counter",
+        "Requests answered.", requests);
+    write_metric(out, "http_cache_hits_total", "counter",
+        "Requests answered from the response cache.", cacheHits);
+    write_histogram(out, "http_accept_duration_seconds",
+        "Time spent in accept() for each accepted connection.", acceptTime);
+    write_histogram(out, "http_tls_handshake_duration_seconds",
+        "Time from accepting a TLS connection to finishing its handshake.", handshakeTime);
+    write_histogram(out, "http_request_parse_duration_seconds",
+        "Time spent parsing request heads.", parseTime);
+    write_histogram(out, "http_handler_duration_seconds",
+        "Time spent in the request handler.", handlerTime);
+}
@@ -1,6 +1,18 @@
 #include <Networking.h>
+#include <Address.h>
+#include <algorithm>
+#include <cerrno>
 #include <stdexcept>
 #include <string>
+#include <vector>
+#ifdef WIN32
+#define poll WSAPoll
+#else
+#include <pthread.h>
+#include <signal.h>
+#endif
+#undef min
+#undef max
 
 void sock_block(socket_t sock, bool blocking) {
 #ifdef WIN32
@@ -18,3 +30,237 @@ void sock_block(socket_t sock, bool blocking) {
         std::runtime_error("Could not set sock flag: " +
             std::to_string(ret));
 }
+
+void close_sock(socket_t sock) {
+#ifdef WIN32
+    closesocket(sock);
+#else
+    close(sock);
+#endif
+}
+
+#ifdef WIN32
+SigpipeGuard::SigpipeGuard() noexcept = default;
+SigpipeGuard::~SigpipeGuard() = default;
+#else
+/// @return a signal set of only SIGPIPE
+static sigset_t sigpipe_set() noexcept {
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGPIPE);
+    return set;
+}
+
+SigpipeGuard::SigpipeGuard() noexcept {
+    const auto pipeSet = sigpipe_set();
+    sigset_t pending, old;
+    sigpending(&pending);
+    wasPending = sigismember(&pending, SIGPIPE) == 1;
+    pthread_sigmask(SIG_BLOCK, &pipeSet, &old);
+    wasBlocked = sigismember(&old, SIGPIPE) == 1;
+}
+
+SigpipeGuard::~SigpipeGuard() {
+    // the error of the guarded write is kept for the caller
+    const auto err = errno;
+    const auto pipeSet = sigpipe_set();
+    sigset_t pending;
+    sigpending(&pending);
+    if (!wasPending && sigismember(&pending, SIGPIPE) == 1) {
+        // returns at once, since the signal is pending
+        int sig;
+        sigwait(&pipeSet, &sig);
+    }
+    if (!wasBlocked)
+        pthread_sigmask(SIG_UNBLOCK, &pipeSet, nullptr);
+    errno = err;
+}
+#endif
+
+void socket_pair(socket_t (&sockets)[2]) {
+#ifdef WIN32
+    Address loopback("127.0.0.1", 0);
+    const auto listener = listen_socket(loopback);
+    // the listener's port was picked by the system
+    auto [addr, sz] = loopback.addr_mut();
+    getsockname(listener, addr, &sz);
+    try {
+        sockets[0] = connect_socket(loopback);
+    }
+    catch (...) {
+        close_sock(listener);
+        throw;
+    }
+    sockets[1] = accept(listener, nullptr, nullptr);
+    const auto err = lastError;
+    close_sock(listener);
+    if (sockets[1] == INVALID_SOCKET) {
+        close_sock(sockets[0]);
+        throw std::runtime_error("Failed to create socket pair: " + std::to_string(err));
+    }
+#else
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+        throw std::runtime_error("Failed to create socket pair: " + std::to_string(lastError));
+    sockets[0] = fds[0];
+    sockets[1] = fds[1];
+#endif
+}
+
+socket_t listen_socket(const Address& addr, bool reusePort) {
+    const auto s = socket(addr.family(), SOCK_STREAM, 0);
+    if (s == INVALID_SOCKET)
+        throw std::runtime_error("Failed to create server sock: " + std::to_string(lastError));
+    const int on = 1;
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&on), sizeof(on));
+#ifdef SO_REUSEPORT
+    if (reusePort && setsockopt(s, SOL_SOCKET, SO_REUSEPORT,
+        reinterpret_cast<const char*>(&on), sizeof(on)) == SOCKET_ERROR)
+    {
+        close_sock(s);
+        throw std::runtime_error("Failed to set SO_REUSEPORT: " + std::to_string(lastError));
+    }
+#else
+    static_cast<void>(reusePort);
+#endif
+    const auto [sockAddr, sz] = addr.addr();
+    if (bind(s, sockAddr, sz) == SOCKET_ERROR) {
+        const auto err = lastError;
+        close_sock(s);
+        throw std::runtime_error("Failed to bind sock: " + std::to_string(err));
+    }
+    if (listen(s, SOMAXCONN) == SOCKET_ERROR) {
+        const auto err = lastError;
+        close_sock(s);
+        throw std::runtime_error("Failed to listen sock: " + std::to_string(err));
+    }
+    return s;
+}
+
+
+socket_t connect_socket(const Address& addr) {
+    const auto s = socket(addr.family(), SOCK_STREAM, 0);
+    if (s == INVALID_SOCKET)
+        throw std::runtime_error("Failed to create sock: " + std::to_string(lastError));
+    const auto [sockAddr, sz] = addr.addr();
+    if (connect(s, sockAddr, sz) == SOCKET_ERROR) {
+        const auto err = lastError;
+        close_sock(s);
+        throw std::runtime_error("Connect client failed: " + std::to_string(err));
+    }
+    return s;
+}
+
+/// @return the order to try addresses in, alternating families from the first address's
+static std::vector<size_t> interleave_families(const Address* addresses, size_t count) {
+    std::vector<size_t> first, other;
+    for (size_t i = 0; i < count; ++i)
+        (addresses[i].family() == addresses[0].family() ? first : other).push_back(i);
+    std::vector<size_t> order;
+    for (size_t i = 0; i < std::max(first.size(), other.size()); ++i) {
+        if (i < first.size())
+            order.push_back(first[i]);
+        if (i < other.size())
+            order.push_back(other[i]);
+    }
+    return order;
+}
+
+/// @return true if a non-blocking connect is still in progress
+static bool connect_pending() noexcept {
+#ifdef WIN32
+    return lastError == WSAEWOULDBLOCK;
+#else
+    return lastError == EINPROGRESS;
+#endif
+}
+
+socket_t connect_socket(const Address* addresses, size_t count, size_t& connected,
+    std::chrono::milliseconds attemptDelay, std::chrono::milliseconds timeout)
+{
+    using Clock = std::chrono::steady_clock;
+    if (count == 0)
+        throw std::runtime_error("Connect client failed: no addresses");
+    const auto order = interleave_families(addresses, count);
+    size_t next = 0;
+    // the attempts in progress and the index of their addresses
+    std::vector<pollfd> attempts;
+    std::vector<size_t> attempted;
+    const auto closeAll = [&]() {
+        for (const auto& attempt : attempts)
+            close_sock(attempt.fd);
+    };
+    auto lastErr = 0;
+    const auto deadline = Clock::now() + timeout;
+    auto nextStart = Clock::now();
+    for (;;) {
+        auto now = Clock::now();
+        // starts the next attempt once it's due or nothing else is in progress
+        if (next < order.size() && (now >= nextStart || attempts.empty())) {
+            const auto& addr = addresses[order[next]];
+            const auto index = order[next++];
+            const auto s = socket(addr.family(), SOCK_STREAM, 0);
+            if (s == INVALID_SOCKET) {
+                lastErr = lastError;
+                continue;
+            }
+            sock_block(s, false);
+            const auto [sockAddr, sz] = addr.addr();
+            if (connect(s, sockAddr, sz) == 0) {
+                closeAll();
+                sock_block(s, true);
+                connected = index;
+                return s;
+            }
+            if (!connect_pending()) {
+                lastErr = lastError;
+                close_sock(s);
+                continue;
+            }
+            attempts.push_back({ s, POLLOUT, 0 });
+            attempted.push_back(index);
+            nextStart = now + attemptDelay;
+        }
+        if (attempts.empty())
+            throw std::runtime_error("Connect client failed: " + std::to_string(lastErr));
+        if (now >= deadline) {
+            closeAll();
+            throw std::runtime_error("Connect client failed: timed out");
+        }
+        auto wakeup = deadline;
+        if (next < order.size())
+            wakeup = std::min(wakeup, nextStart);
+        const auto wait = std::chrono::ceil<std::chrono::milliseconds>(wakeup - now);
+        if (poll(attempts.data(), static_cast<unsigned>(attempts.size()),
+            static_cast<int>(std::max<std::chrono::milliseconds::rep>(wait.count(), 0))) < 0)
+        {
+            if (lastError == EINTR)
+                continue;
+            closeAll();
+            throw std::runtime_error("Connect client failed: " + std::to_string(lastError));
+        }
+        for (size_t i = 0; i < attempts.size();) {
+            if (attempts[i].revents == 0) {
+                ++i;
+                continue;
+            }
+            const auto s = attempts[i].fd;
+            int err = 0;
+            socklen_t size = sizeof(err);
+            getsockopt(s, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&err), &size);
+            if (err == 0) {
+                connected = attempted[i];
+                attempts.erase(attempts.begin() + static_cast<ptrdiff_t>(i));
+                closeAll();
+                sock_block(s, true);
+                return s;
+            }
+            lastErr = err;
+            close_sock(s);
+            attempts.erase(attempts.begin() + static_cast<ptrdiff_t>(i));
+            attempted.erase(attempted.begin() + static_cast<ptrdiff_t>(i));
+            // a failed attempt lets the next one start at once
+            nextStart = Clock::now();
+        }
+    }
+}
\ No newline at end of file
@@ -1,4 +1,31 @@
 #include <Port.h>
+#include <MappedFile.h>
+
+void Port::writev(const std::string_view* buffers, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        if (!buffers[i].empty())
+            write(buffers[i]);
+    }
+}
+
+void Port::send_file(const MappedFile& file, uint64_t offset, uint64_t size) {
+    if (size > 0)
+        write(file.data().substr(static_cast<size_t>(offset), static_cast<size_t>(size)));
+}
+
+size_t Port::try_writev(const std::string_view* buffers, size_t count) {
+    writev(buffers, count);
+    size_t size = 0;
+    for (size_t i = 0; i < count; ++i)
+        size += buffers[i].size();
+    return size;
+}
+
+uint64_t Port::try_send_file(const MappedFile& file, uint64_t offset, uint64_t size) {
+    send_file(file, offset, size);
+    return size;
+}
+
 /*
 std::unique_ptr<Port> make_port()
 {
@@ -0,0 +1,257 @@
+#include <Resolver.h>
+#include <Networking.h>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#undef min
+#undef max
+
+using ResolverClock = std::chrono::steady_clock;
+
+/// @return the addresses of a name from getaddrinfo, with port 0
+static std::vector<Address> lookup_addresses(const std::string& name) {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* results = nullptr;
+    const auto ret = getaddrinfo(name.c_str(), nullptr, &hints, &results);
+    if (ret != 0)
+        throw std::runtime_error("Failed to resolve " + name + ": " + gai_strerror(ret));
+    std::vector<Address> addresses;
+    for (auto info = results; info != nullptr; info = info->ai_next) {
+        if (info->ai_family != AF_INET && info->ai_family != AF_INET6)
+            continue;
+        Address address(info->ai_addr, static_cast<socklen_t>(info->ai_addrlen));
+        if (std::find(addresses.begin(), addresses.end(), address) == addresses.end())
+            addresses.push_back(address);
+    }
+    freeaddrinfo(results);
+    if (addresses.empty())
+        throw std::runtime_error("Failed to resolve " + name + ": no addresses");
+    return addresses;
+}
+
+struct Resolver::Impl {
+    /// The outcome of resolving a name
+    struct Entry {
+        /// the addresses with port 0, or empty if the name couldn't be resolved
+        std::vector<Address> addresses;
+        /// why the name couldn't be resolved
+        std::string error;
+        ResolverClock::time_point expires;
+    };
+
+    /// A caller waiting for a lookup
+    struct Waiter {
+        unsigned short port;
+        Callback callback;
+    };
+
+    ResolverOptions options;
+    mutable std::shared_mutex cacheMu;
+    std::unordered_map<std::string, Entry> cache;
+
+    /// guards everything below
+    std::mutex lookupMu;
+    std::condition_variable wake;
+    /// callers waiting for each name being looked up
+    std::unordered_map<std::string, std::vector<Waiter>> waiting;
+    /// names which no thread is looking up yet
+    std::deque<std::string> queue;
+    std::vector<std::thread> threads;
+    /// threads waiting for a name to look up
+    unsigned idle = 0;
+    bool stopping = false;
+
+    std::atomic<uint64_t> hits{ 0 }, misses{ 0 }, lookups{ 0 };
+
+    explicit Impl(ResolverOptions&& options) : options(std::move(options)) {
+        if (!this->options.lookup)
+            this->options.lookup = &lookup_addresses;
+        this->options.threads = std::max(this->options.threads, 1u);
+    }
+
+    /**
+    * Calls `callback` with the cached outcome of a name
+    * @return false if the name isn't cached or has expired
+    */
+    bool find(const std::string& name, unsigned short port, const Callback& callback) {
+        std::vector<Address> addresses;
+        std::string error;
+        {
+            std::shared_lock lock(cacheMu);
+            const auto it = cache.find(name);
+            if (it == cache.end() || it->second.expires <= ResolverClock::now())
+                return false;
+            addresses = it->second.addresses;
+            error = it->second.error;
+        }
+        ++hits;
+        complete(callback, std::move(addresses), error, port);
+        return true;
+    }
+
+    /// Calls a callback with the addresses of a name, or the error resolving it
+    static void complete(const Callback& callback, std::vector<Address> addresses,
+        const std::string& error, unsigned short port)
+    {
+        if (addresses.empty()) {
+            callback({}, std::make_exception_ptr(std::runtime_error(error)));
+            return;
+        }
+        for (auto& address : addresses)
+            address.set_port(port);
+        callback(std::move(addresses), nullptr);
+    }
+
+    /// Queues a lookup of a name for `callback`, unless one is already in progress
+    void enqueue(std::string&& name, unsigned short port, Callback&& callback) {
+        std::lock_guard lock(lookupMu);
+        auto& waiters = waiting[name];
+        waiters.push_back({ port, std::move(callback) });
+        if (waiters.size() > 1)
+            return;
+        queue.push_back(std::move(name));
+        // threads are started as lookups overlap, so a process which only resolves
+        // now and then doesn't keep a pool of idle threads
+        if (idle == 0 && threads.size() < options.threads)
+            threads.emplace_back([this]() { run(); });
+        else
+            wake.notify_one();
+    }
+
+    /// Looks up queued names until the resolver is destroyed
+    void run() {
+        std::unique_lock lock(lookupMu);
+        for (;;) {
+            ++idle;
+            wake.wait(lock, [this]() { return stopping || !queue.empty(); });
+            --idle;
+            // queued names are still looked up while stopping, so every callback is called
+            if (queue.empty())
+                return;
+            auto name = std::move(queue.front());
+            queue.pop_front();
+            lock.unlock();
+            resolve(name);
+            lock.lock();
+        }
+    }
+
+    /// Looks up a name, caches the outcome and calls the callers waiting for it
+    void resolve(const std::string& name) {
+        ++lookups;
+        Entry entry;
+        try {
+            entry.addresses = options.lookup(name);
+            if (entry.addresses.empty())
+                throw std::runtime_error("Failed to resolve " + name + ": no addresses");
+            entry.expires = ResolverClock::now() + options.ttl;
+        }
+        catch (const std::runtime_error& e) {
+            entry.addresses.clear();
+            entry.error = e.what();
+            entry.expires = ResolverClock::now() + options.negativeTtl;
+        }
+        store(name, entry);
+        std::vector<Waiter> waiters;
+        {
+            std::lock_guard lock(lookupMu);
+            const auto it = waiting.find(name);
+            waiters = std::move(it->second);
+            waiting.erase(it);
+        }
+        for (const auto& waiter : waiters)
+            complete(waiter.callback, entry.addresses, entry.error, waiter.port);
+    }
+
+    /// Caches the outcome of a lookup, evicting the names closest to expiring if full
+    void store(const std::string& name, const Entry& entry) {
+        std::unique_lock lock(cacheMu);
+        if (options.maxEntries == 0)
+            return;
+        if (cache.size() >= options.maxEntries && cache.find(name) == cache.end()) {
+            const auto now = ResolverClock::now();
+            for (auto it = cache.begin(); it != cache.end();)
+                it = it->second.expires <= now ? cache.erase(it) : std::next(it);
+            if (cache.size() >= options.maxEntries) {
+                cache.erase(std::min_element(cache.begin(), cache.end(),
+                    [](const auto& a, const auto& b) {
+                        return a.second.expires < b.second.expires;
+                    }));
+            }
+        }
+        cache.insert_or_assign(name, entry);
+    }
+
+    void stop() {
+        {
+            std::lock_guard lock(lookupMu);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& thread : threads)
+            thread.join();
+    }
+};
+
+Resolver::Resolver(ResolverOptions options) :
+    pimpl(std::make_unique<Impl>(std::move(options))) {}
+
+Resolver::~Resolver() {
+    pimpl->stop();
+}
+
+std::vector<Address> Resolver::resolve(std::string_view name, unsigned short port) {
+    return resolve_async(name, port).get();
+}
+
+void Resolver::resolve_async(std::string_view name, unsigned short port, Callback callback) {
+    std::string key(name);
+    // names are case insensitive
+    std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c) {
+        return static_cast<char>(std::tolower(c));
+    });
+    if (pimpl->find(key, port, callback))
+        return;
+    ++pimpl->misses;
+    pimpl->enqueue(std::move(key), port, std::move(callback));
+}
+
+std::future<std::vector<Address>> Resolver::resolve_async(std::string_view name,
+    unsigned short port)
+{
+    auto promise = std::make_shared<std::promise<std::vector<Address>>>();
+    auto future = promise->get_future();
+    resolve_async(name, port, [promise](std::vector<Address> addresses,
+        std::exception_ptr error)
+    {
+        if (error)
+            promise->set_exception(error);
+        else
+            promise->set_value(std::move(addresses));
+    });
+    return future;
+}
+
+void Resolver::clear() {
+    std::unique_lock lock(pimpl->cacheMu);
+    pimpl->cache.clear();
+}
+
+Resolver::Stats Resolver::stats() const noexcept {
+    return { pimpl->hits.load(), pimpl->misses.load(), pimpl->lookups.load() };
+}
+
+Resolver& Resolver::shared() {
+    static Resolver resolver;
+    return resolver;
+}
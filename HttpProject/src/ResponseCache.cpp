@@ -0,0 +1,250 @@
+#include <ResponseCache.h>
+#include <algorithm>
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+/// @return a strong entity tag of a response's content: its quoted 64 bit FNV-1a hash
+static std::string content_etag(std::string_view content) {
+    uint64_t hash = 14695981039346656037ull;
+    for (const auto c : content) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+    constexpr char digits[] = "0123456789abcdef";
+    std::string etag(18, '"');
+    for (size_t i = 16; i > 0; --i, hash >>= 4)
+        etag[i] = digits[hash & 0xf];
+    return etag;
+}
+
+/// @return an entity tag without its weakness indicator
+static std::string_view opaque_tag(std::string_view etag) noexcept {
+    return etag.substr(0, 2) == "W/" ? etag.substr(2) : etag;
+}
+
+bool etag_matches(std::string_view ifNoneMatch, std::string_view etag) noexcept {
+    const auto tag = opaque_tag(etag);
+    size_t pos = 0;
+    for (;;) {
+        pos = ifNoneMatch.find_first_not_of(" \t,", pos);
+        if (pos == std::string_view::npos)
+            return false;
+        if (ifNoneMatch[pos] == '*')
+            return true;
+        // tags are quoted and may contain commas, so they are found by their quotes
+        const auto start = ifNoneMatch.substr(pos, 2) == "W/" ? pos + 2 : pos;
+        if (start >= ifNoneMatch.size() || ifNoneMatch[start] != '"')
+            return false;
+        const auto end = ifNoneMatch.find('"', start + 1);
+        if (end == std::string_view::npos)
+            return false;
+        if (ifNoneMatch.substr(start, end + 1 - start) == tag)
+            return true;
+        pos = end + 1;
+    }
+}
+
+struct ResponseCache::Impl {
+    struct Node {
+        std::string key;
+        std::shared_ptr<const CachedResponse> response;
+        /// set by lookups, cleared by the clock hand, which evicts the node if it is still clear
+        std::atomic<bool> referenced{ true };
+
+        Node(std::string_view key, std::shared_ptr<const CachedResponse>&& response) :
+            key(key), response(std::move(response)) {}
+    };
+
+    /// Part of the cache, aligned so the counters of neighbouring shards don't share cache lines
+    struct alignas(64) Shard {
+        std::shared_mutex mu;
+        /// nodes in clock order, guarded by mu
+        std::list<Node> ring;
+        /// the nodes by key, guarded by mu
+        std::unordered_map<std::string_view, std::list<Node>::iterator> index;
+        /// next node the clock looks at, guarded by mu
+        std::list<Node>::iterator hand = ring.end();
+        /// size of the responses in the shard, guarded by mu
+        size_t bytes = 0;
+        std::atomic<uint64_t> hits{ 0 }, misses{ 0 }, stores{ 0 }, evictions{ 0 };
+    };
+
+    CacheOptions options;
+    /// Cookie is one of the varying headers, so requests with cookies can be cached
+    bool varyCookie;
+    size_t shardCount;
+    size_t shardBytes;
+    std::unique_ptr<Shard[]> shards;
+
+    explicit Impl(CacheOptions&& opts) : options(std::move(opts)) {
+        varyCookie = std::any_of(options.varyHeaders.begin(), options.varyHeaders.end(),
+            [](const std::string& name) { return detail::iequals(name, "Cookie"); });
+        shardCount = 1;
+        while (shardCount < options.shards)
+            shardCount *= 2;
+        shardBytes = options.maxBytes / shardCount;
+        shards = std::make_unique<Shard[]>(shardCount);
+    }
+
+    Shard& shard_of(std::string_view key) noexcept {
+        return shards[std::hash<std::string_view>()(key) & (shardCount - 1)];
+    }
+
+    /// Removes a node, advancing the hand if it points at it
+    static void remove(Shard& shard, std::list<Node>::iterator it) {
+        if (shard.hand == it)
+            ++shard.hand;
+        shard.bytes -= it->response->bytes.size();
+        shard.index.erase(it->key);
+        shard.ring.erase(it);
+        shard.evictions.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /// Evicts nodes until `size` more bytes fit in the shard
+    void make_space(Shard& shard, size_t size, Clock::time_point now) {
+        while (!shard.ring.empty() && shard.bytes + size > shardBytes) {
+            if (shard.hand == shard.ring.end())
+                shard.hand = shard.ring.begin();
+            auto& node = *shard.hand;
+            if (node.response->expires > now && node.referenced.load(std::memory_order_relaxed)) {
+                // a second chance, the node is evicted if it isn't used before the hand returns
+                node.referenced.store(false, std::memory_order_relaxed);
+                ++shard.hand;
+            }
+            else {
+                remove(shard, shard.hand);
+            }
+        }
+    }
+};
+
+ResponseCache::ResponseCache(CacheOptions options) :
+    pimpl(std::make_unique<Impl>(std::move(options))) {}
+
+ResponseCache::~ResponseCache() = default;
+
+const CacheOptions& ResponseCache::options() const noexcept {
+    return pimpl->options;
+}
+
+bool ResponseCache::make_key(const HttpRequestFrame& request, std::string& key) const {
+    if (request.protocol != HttpFrame::Protocol::GET
+        && request.protocol != HttpFrame::Protocol::HEAD)
+    {
+        return false;
+    }
+    // responses for one user must not be served to another
+    if (request.headers().find("Authorization")
+        || (!pimpl->varyCookie && request.headers().find("Cookie")))
+    {
+        return false;
+    }
+    // HEAD requests are answered with the head of the response to GET
+    key.assign("GET ");
+    key.append(request.path);
+    for (const auto& name : pimpl->options.varyHeaders) {
+        key.push_back('\n');
+        if (const auto value = request.headers().find(name))
+            key.append(*value);
+    }
+    return true;
+}
+
+bool ResponseCache::cacheable(const HttpResponseFrame& response) noexcept {
+    if (response.responseCode != HttpResponse::ok || response.fileBody.file
+        || response.headers().find("Set-Cookie") || response.has_header(KnownHeader::Connection))
+    {
+        return false;
+    }
+    const auto control = response.headers().find("Cache-Control");
+    return !control || !(has_token(*control, "no-store") || has_token(*control, "private")
+        || has_token(*control, "no-cache"));
+}
+
+std::shared_ptr<const CachedResponse> ResponseCache::find(std::string_view key,
+    Clock::time_point now)
+{
+    auto& shard = pimpl->shard_of(key);
+    std::shared_lock lock(shard.mu);
+    const auto it = shard.index.find(key);
+    if (it == shard.index.end() || it->second->response->expires <= now) {
+        shard.misses.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    auto& node = *it->second;
+    // only writes the flag when it changes, so hot entries don't bounce their cache line
+    if (!node.referenced.load(std::memory_order_relaxed))
+        node.referenced.store(true, std::memory_order_relaxed);
+    shard.hits.fetch_add(1, std::memory_order_relaxed);
+    return node.response;
+}
+
+std::shared_ptr<const CachedResponse> ResponseCache::store(std::string_view key,
+    HttpResponseFrame& response, Clock::time_point now)
+{
+    auto& etag = response["ETag"];
+    if (etag.empty())
+        etag = content_etag(response.content);
+    auto cached = std::make_shared<CachedResponse>();
+    cached->etag = etag;
+    cached->expires = now + pimpl->options.ttl;
+    thread_local std::vector<std::string_view> views;
+    views.clear();
+    response.compose_views(views);
+    size_t size = 0;
+    for (const auto view : views)
+        size += view.size();
+    if (size > pimpl->shardBytes)
+        return nullptr;
+    cached->bytes.reserve(size);
+    for (const auto view : views)
+        cached->bytes.append(view);
+    cached->headSize = cached->bytes.size() - response.content.size() - 2;
+
+    auto& shard = pimpl->shard_of(key);
+    std::unique_lock lock(shard.mu);
+    shard.stores.fetch_add(1, std::memory_order_relaxed);
+    if (const auto it = shard.index.find(key); it != shard.index.end()) {
+        shard.bytes -= it->second->response->bytes.size();
+        it->second->response = cached;
+        it->second->referenced.store(true, std::memory_order_relaxed);
+        shard.bytes += size;
+        pimpl->make_space(shard, 0, now);
+        return cached;
+    }
+    pimpl->make_space(shard, size, now);
+    // new nodes go behind the hand, so they are looked at last
+    const auto it = shard.ring.emplace(shard.hand, key, cached);
+    shard.index.emplace(it->key, it);
+    shard.bytes += size;
+    return cached;
+}
+
+void ResponseCache::clear() {
+    for (size_t i = 0; i < pimpl->shardCount; ++i) {
+        auto& shard = pimpl->shards[i];
+        std::unique_lock lock(shard.mu);
+        shard.index.clear();
+        shard.ring.clear();
+        shard.hand = shard.ring.end();
+        shard.bytes = 0;
+    }
+}
+
+ResponseCache::Stats ResponseCache::stats() const {
+    Stats stats{};
+    for (size_t i = 0; i < pimpl->shardCount; ++i) {
+        auto& shard = pimpl->shards[i];
+        std::shared_lock lock(shard.mu);
+        stats.hits += shard.hits.load(std::memory_order_relaxed);
+        stats.misses += shard.misses.load(std::memory_order_relaxed);
+        stats.stores += shard.stores.load(std::memory_order_relaxed);
+        stats.evictions += shard.evictions.load(std::memory_order_relaxed);
+        stats.entries += shard.index.size();
+        stats.bytes += shard.bytes;
+    }
+    return stats;
+}
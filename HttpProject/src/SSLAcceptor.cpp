@@ -0,0 +1,249 @@
+#include <SSLAcceptor.h>
+#include <openssl/ssl.h>
+#include "Address.h"
+#include "FdSet.h"
+#include "Metrics.h"
+#include "Networking.h"
+#include <algorithm>
+#include <deque>
+#include <stdexcept>
+#include <unordered_map>
+#undef min
+#undef max
+
+using Clock = std::chrono::steady_clock;
+
+/// Max amount of connections accepted per wakeup of the listener
+constexpr auto maxAcceptBatch = 1024;
+
+/// A connection whose handshake is in progress
+struct PendingHandshake {
+    SSLSocket sock;
+    Clock::time_point deadline;
+    bool wantWrite; //< true if the connection is in the write set instead of the read set
+};
+
+struct SSLAcceptor::Impl {
+    SSLSocket listener;
+    socket_t listenFd;
+    std::chrono::milliseconds handshakeTimeout;
+    FdSet readSet, writeSet;
+    size_t writers;
+    std::unordered_map<socket_t, PendingHandshake> pending;
+    /// handshake deadlines in the order connections were accepted, which is also
+    /// the order they expire in. Entries of finished handshakes are skipped when expiring
+    std::deque<std::pair<Clock::time_point, socket_t>> deadlines;
+    /// copy of the ready fds of the last wait, which are invalidated by removing fds
+    std::vector<socket_t> readyScratch;
+    Stats stats;
+    MetricHistogram* handshakeTimes = nullptr;
+    MetricHistogram* acceptTimes = nullptr;
+
+    Impl(SSLSocket&& listener, std::chrono::milliseconds handshakeTimeout) :
+        listener(std::move(listener)), listenFd(static_cast<socket_t>(this->listener.handle())),
+        handshakeTimeout(handshakeTimeout), writers(0), stats{}
+    {
+        readSet.add(listenFd);
+        // the write set is only waited on by other sets through add_to_fd
+        writeSet.watch(SetType::Write);
+    }
+
+    /// Stops tracking the handshake of `it`, removing its fd from the wait sets
+    /// @return the connection
+    SSLSocket release(std::unordered_map<socket_t, PendingHandshake>::iterator it) {
+        if (it->second.wantWrite) {
+            writeSet.remove(it->first);
+            --writers;
+        }
+        else
+            readSet.remove(it->first);
+        auto sock = std::move(it->second.sock);
+        pending.erase(it);
+        return sock;
+    }
+
+    /**
+    * Continues the handshake of a pending connection, moving it to `out` if it finishes
+    * or dropping it if it fails
+    */
+    void step(std::unordered_map<socket_t, PendingHandshake>::iterator it,
+        std::vector<SSLSocket>& out)
+    {
+        int want;
+        try {
+            want = it->second.sock.step_accept();
+        }
+        catch (const std::runtime_error&) {
+            ++stats.failed;
+            release(it);
+            return;
+        }
+        if (want == SSL_ERROR_NONE) {
+            ++stats.completed;
+            // connections were accepted a handshake timeout before their deadline
+            if (handshakeTimes != nullptr)
+                handshakeTimes->record(Clock::now() - (it->second.deadline - handshakeTimeout));
+            out.push_back(release(it));
+            return;
+        }
+        const auto wantWrite = want == SSL_ERROR_WANT_WRITE;
+        auto& conn = it->second;
+        if (conn.wantWrite != wantWrite) {
+            auto& from = conn.wantWrite ? writeSet : readSet;
+            auto& to = wantWrite ? writeSet : readSet;
+            from.remove(it->first);
+            to.add(it->first);
+            conn.wantWrite = wantWrite;
+            wantWrite ? ++writers : --writers;
+        }
+    }
+
+    /// Accepts every pending connection and starts their handshakes
+    void accept_all(std::vector<SSLSocket>& out) {
+        for (auto i = 0; i < maxAcceptBatch; ++i) {
+            const auto start = acceptTimes != nullptr ? Clock::now() : Clock::time_point();
+            auto sock = listener.try_accept();
+            if (!sock)
+                break;
+            ++stats.accepted;
+            const auto fd = static_cast<socket_t>(sock->handle());
+            const auto accepted = Clock::now();
+            if (acceptTimes != nullptr)
+                acceptTimes->record(accepted - start);
+            const auto deadline = accepted + handshakeTimeout;
+            const auto it = pending.emplace(fd,
+                PendingHandshake{ std::move(*sock), deadline, false }).first;
+            readSet.add(fd);
+            deadlines.emplace_back(deadline, fd);
+            // the client hello has usually arrived with the connection already
+            step(it, out);
+        }
+    }
+
+    /// Drops every connection whose handshake deadline has passed
+    void expire(Clock::time_point now) {
+        while (!deadlines.empty() && deadlines.front().first <= now) {
+            const auto [deadline, fd] = deadlines.front();
+            deadlines.pop_front();
+            const auto it = pending.find(fd);
+            // the fd may have been reused by a newer connection
+            if (it != pending.end() && it->second.deadline == deadline) {
+                ++stats.timedOut;
+                release(it);
+            }
+        }
+    }
+
+    /**
+    * Waits for activity, until `end` at the latest
+    * @return true if the write set was waited on
+    */
+    bool wait(std::optional<Clock::time_point> end) {
+        if (!deadlines.empty())
+            end = end ? std::min(*end, deadlines.front().first) : deadlines.front().first;
+        if (!end) {
+            if (writers == 0)
+                FdSet::wait(ReadSet{ readSet });
+            else
+                FdSet::wait(ReadSet{ readSet }, WriteSet{ writeSet });
+            return writers > 0;
+        }
+        const auto timeout = std::max(std::chrono::ceil<std::chrono::microseconds>(
+            *end - Clock::now()), std::chrono::microseconds(0));
+        if (writers == 0)
+            FdSet::wait(timeout, ReadSet{ readSet });
+        else
+            FdSet::wait(timeout, ReadSet{ readSet }, WriteSet{ writeSet });
+        return writers > 0;
+    }
+
+    /// Handles the fds of `set` that were ready after the last wait
+    void process(const FdSet& set, std::vector<SSLSocket>& out) {
+        readyScratch.assign(set.ready().begin(), set.ready().end());
+        for (const auto fd : readyScratch) {
+            if (fd == listenFd)
+                accept_all(out);
+            else {
+                const auto it = pending.find(fd);
+                if (it != pending.end())
+                    step(it, out);
+            }
+        }
+    }
+};
+
+SSLAcceptor::SSLAcceptor(const Address& addr, std::shared_ptr<TlsContext> ctx,
+    std::chrono::milliseconds handshakeTimeout, bool reusePort)
+{
+    if (ctx == nullptr || !ctx->is_server())
+        throw std::invalid_argument("Expected a server TlsContext");
+    SSLSocket listener(listen_socket(addr, reusePort), nullptr, std::move(ctx), Address(addr));
+    sock_block(static_cast<socket_t>(listener.handle()), false);
+    pimpl = std::make_unique<Impl>(std::move(listener), handshakeTimeout);
+}
+
+SSLAcceptor::~SSLAcceptor() = default;
+SSLAcceptor::SSLAcceptor(SSLAcceptor&&) noexcept = default;
+SSLAcceptor& SSLAcceptor::operator=(SSLAcceptor&&) noexcept = default;
+
+size_t SSLAcceptor::accept(std::vector<SSLSocket>& out,
+    std::optional<std::chrono::microseconds> timeout)
+{
+    const auto before = out.size();
+    std::optional<Clock::time_point> end;
+    if (timeout)
+        end = Clock::now() + *timeout;
+    for (;;) {
+        const auto waitedWrite = pimpl->wait(end);
+        pimpl->process(pimpl->readSet, out);
+        if (waitedWrite)
+            pimpl->process(pimpl->writeSet, out);
+        const auto now = Clock::now();
+        pimpl->expire(now);
+        if (out.size() > before || (end && now >= *end))
+            return out.size() - before;
+    }
+}
+
+void SSLAcceptor::add_to_fd(FdSet& fd) const {
+#ifdef __linux__
+    fd.add(static_cast<unsigned long long>(pimpl->readSet.handle()));
+    fd.add(static_cast<unsigned long long>(pimpl->writeSet.handle()));
+#else
+    fd.add(pimpl->listenFd);
+#endif
+}
+
+bool SSLAcceptor::is_in_fd(const FdSet& fd) const {
+#ifdef __linux__
+    return fd.is_set(static_cast<unsigned long long>(pimpl->readSet.handle()))
+        || fd.is_set(static_cast<unsigned long long>(pimpl->writeSet.handle()));
+#else
+    return fd.is_set(pimpl->listenFd);
+#endif
+}
+
+void SSLAcceptor::remove_from_fd(FdSet& fd) const {
+#ifdef __linux__
+    fd.remove(static_cast<unsigned long long>(pimpl->readSet.handle()));
+    fd.remove(static_cast<unsigned long long>(pimpl->writeSet.handle()));
+#else
+    fd.remove(pimpl->listenFd);
+#endif
+}
+
+size_t SSLAcceptor::pending() const noexcept {
+    return pimpl->pending.size();
+}
+
+SSLAcceptor::Stats SSLAcceptor::stats() const noexcept {
+    return pimpl->stats;
+}
+
+void SSLAcceptor::record_handshakes(MetricHistogram* histogram) noexcept {
+    pimpl->handshakeTimes = histogram;
+}
+
+void SSLAcceptor::record_accepts(MetricHistogram* histogram) noexcept {
+    pimpl->acceptTimes = histogram;
+}
@@ -8,13 +8,29 @@
 #include <openssl/applink.c>
 #endif
 #include "Address.h"
+#include "Resolver.h"
 #include "Networking.h"
 #include "FdSet.h"
+#include "TlsContext.h"
+#include "Scheduler.h"
+#include "MappedFile.h"
+#include "ObjectPool.h"
 #include <stdexcept>
 #include <string>
 #include <sstream>
+#include <climits>
+#include <algorithm>
 #undef min
 #undef max
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L && !defined(OPENSSL_NO_KTLS)
+/// OpenSSL can hand connections to the kernel's TLS, which only Linux and FreeBSD have
+#define KTLS_SUPPORTED
+#include <sys/uio.h>
+
+/// Max amount of buffers to pass to a single sendmsg call
+constexpr size_t maxIov = 64;
+#endif
 struct SSLStart {
     SSLStart() {
         SSL_library_init();
@@ -29,142 +45,585 @@ std::string format(Ts&& ... args) {
     return ss.str();
 }
 
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#ifndef WIN32
+/**
+* Writes to the socket of a socket BIO with `send` and `MSG_NOSIGNAL`. OpenSSL's socket
+* BIO writes with `write`, which raises SIGPIPE once the peer has closed the connection,
+* such as a client leaving mid handshake, where this write fails with EPIPE instead
+*/
+static int send_nosignal(BIO* bio, const char* data, int size) {
+#ifdef KTLS_SUPPORTED
+    // once the kernel encrypts, OpenSSL's write passes the type of records which
+    // aren't application data, such as alerts, to the kernel
+    if (BIO_get_ktls_send(bio)) {
+        static const auto socketWrite = BIO_meth_get_write(BIO_s_socket());
+        const SigpipeGuard guard;
+        return socketWrite(bio, data, size);
+    }
+#endif
+    errno = 0;
+    const auto ret = static_cast<int>(::send(static_cast<socket_t>(BIO_get_fd(bio, nullptr)),
+        data, static_cast<size_t>(size), MSG_NOSIGNAL));
+    BIO_clear_retry_flags(bio);
+    if (ret <= 0 && BIO_sock_should_retry(ret))
+        BIO_set_retry_write(bio);
+    return ret;
+}
+
+/// @return OpenSSL's socket BIO method with writes which don't raise SIGPIPE
+static const BIO_METHOD* socket_method() {
+    static BIO_METHOD* const method = [] {
+        const auto base = BIO_s_socket();
+        const auto created = BIO_meth_new(BIO_TYPE_SOCKET, "socket without SIGPIPE");
+        if (created == nullptr)
+            throw std::runtime_error("Could not create BIO method");
+        BIO_meth_set_write(created, &send_nosignal);
+        BIO_meth_set_read(created, BIO_meth_get_read(base));
+        BIO_meth_set_ctrl(created, BIO_meth_get_ctrl(base));
+        BIO_meth_set_create(created, BIO_meth_get_create(base));
+        BIO_meth_set_destroy(created, BIO_meth_get_destroy(base));
+        return created;
+    }();
+    return method;
+}
+#endif
+
+/**
+* Attaches a socket to an ssl connection like `SSL_set_fd`, with a BIO whose writes
+* fail with EPIPE instead of raising SIGPIPE once the peer has closed the connection,
+* so the process's signal handling is left alone
+* @return false if the BIO couldn't be created
+*/
+static bool set_socket(SSL* ssl, socket_t sock) {
+#ifdef WIN32
+    return SSL_set_fd(ssl, static_cast<int>(sock)) == 1;
+#else
+#ifdef SO_NOSIGPIPE
+    const int on = 1;
+    setsockopt(sock, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+    const auto bio = BIO_new(socket_method());
+    if (bio == nullptr)
+        return false;
+    BIO_set_fd(bio, static_cast<int>(sock), BIO_NOCLOSE);
+    SSL_set_bio(ssl, bio, bio);
+    return true;
+#endif
+}
+
 struct SSLSocket::Impl {
-    SSL* ssl;
-    SSL_CTX* ctx; //< can be nullptr
+    SSL* ssl; //< nullptr for server listeners
+    std::shared_ptr<TlsContext> tls;
     socket_t sock;
     Address addr;
+    bool blocking; //< the current blocking mode of sock
+    /// early data received while accepting, returned by reads before anything else
+    std::vector<char> early;
+    size_t earlyPos;
+    bool handshaking; //< true while early data may still arrive during an accept
+    /// linked once the socket is awaited on an io_uring scheduler, which moves its
+    /// ciphertext through memory BIOs
+    RingLink ring;
+    /// true while a coroutine is sending the ciphertext in the write BIO
+    bool sending = false;
+    /// true once the kernel encrypts what is written, see `TlsContext::enable_ktls`
+    bool ktlsSend = false;
+    /// true once the kernel decrypts what is read
+    bool ktlsReceive = false;
     static SSLStart sslCtx;
 
-    Impl(SSL* ssl, SSL_CTX* ctx, socket_t sock, const Address& addr) :
-        ssl(ssl), ctx(ctx), sock(sock), addr(addr) {}
+    Impl(SSL* ssl, std::shared_ptr<TlsContext> tls, socket_t sock, const Address& addr) :
+        ssl(ssl), tls(std::move(tls)), sock(sock), addr(addr), blocking(true), earlyPos(0),
+        handshaking(false) {}
+
+    Impl(SSL* ssl, std::shared_ptr<TlsContext> tls, socket_t sock, Address&& addr) :
+        ssl(ssl), tls(std::move(tls)), sock(sock), addr(std::move(addr)), blocking(true),
+        earlyPos(0), handshaking(false) {}
+
+    // servers create one per connection, so they are pooled
+    static void* operator new(size_t) { return ObjectPool<Impl>::allocate(); }
+    static void operator delete(void* ptr) noexcept { ObjectPool<Impl>::deallocate(ptr); }
+
+    /**
+    * Sets the blocking mode of the socket, only making a syscall if the mode changes
+    * @throw std::logic_error if the socket's ciphertext has moved to an io_uring
+    */
+    void set_blocking(bool block) {
+        if (ring.linked())
+            throw std::logic_error("A socket used with an io_uring scheduler can only be awaited");
+        if (blocking != block) {
+            sock_block(sock, block);
+            blocking = block;
+        }
+    }
+
+    /**
+    * Copies buffered early data into `buffer`
+    * @return the amount of bytes copied
+    */
+    size_t read_early(char* buffer, size_t size) noexcept {
+        const auto count = std::min(size, early.size() - earlyPos);
+        std::copy_n(early.data() + earlyPos, count, buffer);
+        earlyPos += count;
+        if (earlyPos == early.size()) {
+            early = {};
+            earlyPos = 0;
+        }
+        return count;
+    }
+
+    /**
+    * Moves the connection's ciphertext to memory BIOs, which the ring fills and drains,
+    * so OpenSSL only encrypts and decrypts. Nothing is buffered by the socket BIO,
+    * so the connection can switch at any time
+    */
+    void use_memory_bio() {
+        if (ssl == nullptr || SSL_get_rbio(ssl) != SSL_get_wbio(ssl))
+            return;
+#ifdef KTLS_SUPPORTED
+        if (BIO_get_ktls_send(SSL_get_wbio(ssl)) || BIO_get_ktls_recv(SSL_get_rbio(ssl)))
+            throw std::logic_error("A connection encrypted by the kernel can't move to io_uring");
+#endif
+        const auto rbio = BIO_new(BIO_s_mem());
+        const auto wbio = BIO_new(BIO_s_mem());
+        if (rbio == nullptr || wbio == nullptr) {
+            BIO_free(rbio);
+            BIO_free(wbio);
+            throw std::runtime_error("Could not create memory BIO");
+        }
+        // an empty read BIO asks for a retry instead of reporting the end of the connection
+        BIO_set_mem_eof_return(rbio, -1);
+        SSL_set_bio(ssl, rbio, wbio);
+    }
+
+    /// Records which directions the kernel took over, once the handshake is done
+    void check_ktls() noexcept {
+#ifdef KTLS_SUPPORTED
+        ktlsSend = BIO_get_ktls_send(SSL_get_wbio(ssl));
+        ktlsReceive = BIO_get_ktls_recv(SSL_get_rbio(ssl));
+#endif
+    }
+
+#ifdef KTLS_SUPPORTED
+    /**
+    * Sends the buffers with plain syscalls, which the kernel encrypts into records.
+    * Requires `ktlsSend`
+    * @param block true to wait until all of them are sent, false to stop once the
+    *   socket takes no more
+    * @return the amount of bytes sent
+    */
+    size_t send_plain(const std::string_view* buffers, size_t count, bool block) {
+        set_blocking(block);
+        iovec iov[maxIov];
+        size_t total = 0;
+        size_t next = 0; // index of the next buffer to add to iov
+        size_t offset = 0; // amount of bytes of buffers[next] already sent
+        while (next < count) {
+            size_t iovCount = 0;
+            for (auto i = next; i < count && iovCount < maxIov; ++i) {
+                const auto skip = i == next ? offset : 0;
+                if (buffers[i].size() > skip) {
+                    iov[iovCount].iov_base = const_cast<char*>(buffers[i].data() + skip);
+                    iov[iovCount++].iov_len = buffers[i].size() - skip;
+                }
+            }
+            if (iovCount == 0)
+                break;
+            msghdr msg{};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = iovCount;
+            auto sent = sendmsg(sock, &msg, MSG_NOSIGNAL);
+            if (sent == SOCKET_ERROR) {
+                if (lastError == EINTR)
+                    continue;
+                if (!block && (lastError == EWOULDBLOCK || lastError == EAGAIN))
+                    break;
+                throw std::runtime_error(format("Failed to write ssl: ", lastError));
+            }
+            total += static_cast<size_t>(sent);
+            while (next < count && static_cast<size_t>(sent) >= buffers[next].size() - offset) {
+                sent -= buffers[next].size() - offset;
+                offset = 0;
+                ++next;
+            }
+            offset += static_cast<size_t>(sent);
+        }
+        return total;
+    }
+
+    /**
+    * Sends part of a file with `SSL_sendfile`, which the kernel encrypts. Requires `ktlsSend`
+    * @param block true to wait until all of it is sent, false to stop once the
+    *   socket takes no more
+    * @return the amount of bytes sent
+    */
+    uint64_t send_file_plain(const MappedFile& file, uint64_t offset, uint64_t size, bool block) {
+        set_blocking(block);
+        const SigpipeGuard guard;
+        uint64_t total = 0;
+        while (total < size) {
+            const auto sent = SSL_sendfile(ssl, file.fd(), static_cast<off_t>(offset + total),
+                static_cast<size_t>(size - total), 0);
+            if (sent <= 0) {
+                const auto err = SSL_get_error(ssl, static_cast<int>(sent));
+                if (!block && err == SSL_ERROR_WANT_WRITE)
+                    break;
+                throw std::runtime_error(format("Failed to send file: ", err));
+            }
+            total += static_cast<uint64_t>(sent);
+        }
+        return total;
+    }
+#endif
+
+    /**
+    * Encrypts and sends data with OpenSSL. A write which would block is retried with
+    * the same data, which may have moved (see `make_ctx`)
+    * @param block true to wait until all of it is sent, false to stop once the
+    *   socket takes no more
+    * @return the amount of bytes sent
+    */
+    size_t write_ssl(std::string_view data, bool block) {
+        set_blocking(block);
+        size_t sent = 0;
+        while (sent < data.size()) {
+            const auto ret = SSL_write(ssl, data.data() + sent,
+                static_cast<int>(std::min<size_t>(data.size() - sent, INT_MAX)));
+            if (ret <= 0) {
+                const auto err = SSL_get_error(ssl, ret);
+                if (!block && (err == SSL_ERROR_WANT_WRITE || err == SSL_ERROR_WANT_READ))
+                    break;
+                throw std::runtime_error(format("Failed to write ssl: ", err));
+            }
+            sent += static_cast<size_t>(ret);
+        }
+        return sent;
+    }
+
+    /**
+    * Receives plaintext which the kernel decrypted, bypassing OpenSSL.
+    * OpenSSL reads instead when the kernel doesn't decrypt the connection, when
+    * OpenSSL holds received data, and when the next record isn't application data
+    * (the kernel fails the read with EIO), such as a session ticket or an alert.
+    * A closed or failed connection is also left to OpenSSL, which reports it
+    * @return the amount of bytes received, 0 if OpenSSL must read instead, or -1 if
+    *   nothing can be received without blocking
+    */
+    long receive_plain(char* buffer, size_t size) noexcept {
+        if (!ktlsReceive || SSL_has_pending(ssl))
+            return 0;
+        for (;;) {
+            const auto ret = ::recv(sock, buffer,
+                static_cast<int>(std::min<size_t>(size, INT_MAX)), 0);
+            if (ret > 0)
+                return static_cast<long>(ret);
+            if (ret == 0)
+                return 0;
+            const auto err = lastError;
+            if (err == EINTR)
+                continue;
+            return err == EAGAIN || err == EWOULDBLOCK ? -1 : 0;
+        }
+    }
+
+    /// Receives ciphertext from the ring into the read BIO
+    Task<void> receive_ciphertext(Scheduler& scheduler);
 
-    Impl(SSL* ssl, SSL_CTX* ctx, socket_t sock, Address&& addr) :
-        ssl(ssl), ctx(ctx), sock(sock), addr(std::move(addr)) {}
+    /// Sends the ciphertext in the write BIO through the ring
+    Task<void> send_ciphertext(Scheduler& scheduler);
 };
 
-std::tuple<SSL*, SSL_CTX*> connect_client(const Address& addr, socket_t s) {
-    const auto [sockAddr, size] = addr.addr();
-    if (connect(s, sockAddr, size))
-        throw std::runtime_error(format("Connect client failed: ", lastError));
-    const auto method = TLS_client_method();
+/// Scratch space for ciphertext received through a ring, large enough for a full TLS record
+static thread_local char ringScratch[SSL3_RT_MAX_ENCRYPTED_LENGTH];
 
-    auto ctx = SSL_CTX_new(method);
-    if (ctx == NULL)
-        throw std::runtime_error(
-            format("Failed to create ssl ctx: ", ERR_get_error()));
-    const auto ssl = SSL_new(ctx);
-    if (ssl == NULL)
-        throw std::runtime_error(
-            format("Failed to create ssl: ", ERR_get_error()));
-    SSL_set_fd(ssl, static_cast<int>(s));
-    if (SSL_connect(ssl) <= 0)
-        throw std::runtime_error(
-            format("Failed to connect ssl: ", ERR_get_error()));
+Task<void> SSLSocket::Impl::receive_ciphertext(Scheduler& scheduler) {
+    // the scratch space is filled and emptied without suspending in between,
+    // so the coroutines of a thread can share it
+    const auto received = co_await scheduler.receive(ring, sock, ringScratch,
+        sizeof(ringScratch));
+    BIO_write(SSL_get_rbio(ssl), ringScratch, static_cast<int>(received));
+}
+
+Task<void> SSLSocket::Impl::send_ciphertext(Scheduler& scheduler) {
+    // the coroutine already sending takes the new ciphertext, which keeps it in order
+    if (sending)
+        co_return;
+    sending = true;
+    const auto wbio = SSL_get_wbio(ssl);
+    auto part = scheduler.take_fixed();
+    std::vector<char> fallback;
+    if (part.empty()) {
+        fallback.resize(SSL3_RT_MAX_ENCRYPTED_LENGTH);
+        part = fallback;
+    }
+    const auto fixed = fallback.empty();
+    try {
+        while (BIO_ctrl_pending(wbio) > 0) {
+            const auto size = BIO_read(wbio, part.data(), static_cast<int>(part.size()));
+            for (auto sent = 0; sent < size;) {
+                const auto data = part.data() + sent;
+                const auto count = static_cast<size_t>(size - sent);
+                const auto ret = co_await (fixed ? scheduler.write_fixed(sock, data, count)
+                    : scheduler.send(sock, data, count));
+                if (ret < 0)
+                    throw std::runtime_error(format("Failed to write ssl: ", -ret));
+                sent += ret;
+            }
+        }
+    }
+    catch (...) {
+        sending = false;
+        if (fixed)
+            scheduler.return_fixed(part);
+        throw;
+    }
+    sending = false;
+    if (fixed)
+        scheduler.return_fixed(part);
+}
 
-    return std::make_tuple(ssl, ctx);
+/// Scratch space for the vector returning reads, large enough for a full TLS record
+static thread_local char readScratch[SSL3_RT_MAX_PLAIN_LENGTH];
+/// Space to gather small buffers of a vectored write into one TLS record
+static thread_local char writeScratch[SSL3_RT_MAX_PLAIN_LENGTH];
 
+/// @return the client context used by sockets that aren't given one
+std::shared_ptr<TlsContext> default_client_context() {
+    static const auto ctx = std::make_shared<TlsContext>();
+    return ctx;
 }
 
-std::tuple<SSL*, SSL_CTX*> setup_server(const char* certFile, const char* keyFile)
-{
-    const SSL_METHOD* meth = TLS_server_method();
-    auto ctx = SSL_CTX_new(meth);
-    SSL_CTX_set_ecdh_auto(ctx, 1);
+/**
+* Writes all of `data` as early data before the handshake of `ssl` finishes
+* @return true if the data was sent, false if the session doesn't allow early data
+*/
+bool write_early(SSL* ssl, std::string_view data) {
+    const auto session = SSL_get0_session(ssl);
+    if (session == nullptr || SSL_SESSION_get_max_early_data(session) < data.size())
+        return false;
+    size_t sent = 0;
+    while (sent < data.size()) {
+        size_t written = 0;
+        if (SSL_write_early_data(ssl, data.data() + sent, data.size() - sent, &written) <= 0)
+            throw std::runtime_error(
+                format("Failed to write early data: ", SSL_get_error(ssl, 0)));
+        sent += written;
+    }
+    return true;
+}
 
-    if (SSL_CTX_use_certificate_file(ctx, certFile, SSL_FILETYPE_PEM) <= 0) {
-        ERR_print_errors_fp(stderr);
-        throw std::runtime_error(format("Could not load cert file: ", ERR_get_error()));
+/**
+* Performs a client handshake on the connected socket `s`,
+* resuming the session `newSsl` was created with if `tls` has one
+* @param earlyData data to send with the handshake if the session allows it
+* @return the ssl connection and true if `earlyData` was sent
+*/
+std::tuple<SSL*, bool> connect_client(socket_t s, const TlsContext& tls, void* newSsl,
+    std::string_view earlyData)
+{
+    const auto ssl = static_cast<SSL*>(newSsl);
+    try {
+        if (!set_socket(ssl, s))
+            throw std::runtime_error(format("Cannot set SSL fd: ", ERR_get_error()));
+        const auto sentEarly = !earlyData.empty() && tls.early_data()
+            && write_early(ssl, earlyData);
+        if (SSL_connect(ssl) <= 0)
+            throw std::runtime_error(
+                format("Failed to connect ssl: ", ERR_get_error()));
+        return std::make_tuple(ssl,
+            sentEarly && SSL_get_early_data_status(ssl) == SSL_EARLY_DATA_ACCEPTED);
     }
-    if (SSL_CTX_use_PrivateKey_file(ctx, keyFile, SSL_FILETYPE_PEM) <= 0) {
-        ERR_print_errors_fp(stderr);
-        throw std::runtime_error(format("Could not load key file: ", ERR_get_error()));
+    catch (...) {
+        SSL_free(ssl);
+        throw;
     }
-
-    const auto ssl = SSL_new(ctx);
-    return std::make_tuple(ssl, ctx);
 }
 
-SSLSocket::SSLSocket(const Address& addr) {
-    auto s = socket(addr.family(), SOCK_STREAM, 0);
-    if (s == INVALID_SOCKET)
-        throw std::runtime_error(format("Failed to create client sock: ", lastError));
-    auto [ssl, ctx] = connect_client(addr, s);
-    pimpl = std::make_unique<Impl>(ssl, ctx, s, addr);
-};
+SSLSocket::SSLSocket(const Address& addr) :
+    SSLSocket(addr, default_client_context()) {}
 
-SSLSocket::SSLSocket(const Address& addr, const char* certFile, const char* keyFile) {
-    auto s = socket(addr.family(), SOCK_STREAM, 0);
-    if (s == INVALID_SOCKET)
-        throw std::runtime_error(format("Failed to create server sock: ", lastError));
-    auto [ssl, ctx] = setup_server(certFile, keyFile);
-    const auto [sockAddr, sz] = addr.addr();
-    if (bind(s, sockAddr, sz) == SOCKET_ERROR)
-        throw std::runtime_error(format("Failed to bind sock: ", lastError));
-    if (listen(s, SOMAXCONN) == SOCKET_ERROR)
-        throw std::runtime_error(format("Failed to listen sock: ", lastError));
-    pimpl = std::make_unique<Impl>(ssl, ctx, s, addr);
-};
+SSLSocket::SSLSocket(const Address& addr, const char* certFile, const char* keyFile) :
+    SSLSocket(addr, std::make_shared<TlsContext>(certFile, keyFile)) {}
+
+SSLSocket::SSLSocket(const Address& addr, std::shared_ptr<TlsContext> ctx) {
+    if (ctx == nullptr)
+        throw std::invalid_argument("TlsContext cannot be null");
+    if (ctx->is_server()) {
+        const auto s = listen_socket(addr);
+        pimpl = std::make_unique<Impl>(nullptr, std::move(ctx), s, addr);
+    }
+    else
+        *this = SSLSocket(addr, std::move(ctx), {});
+}
+
+SSLSocket::SSLSocket(const Address& addr, std::shared_ptr<TlsContext> ctx,
+    std::string_view firstWrite)
+{
+    if (ctx == nullptr || ctx->is_server())
+        throw std::invalid_argument("Expected a client TlsContext");
+    const auto s = connect_socket(addr);
+    try {
+        const auto [ssl, sentEarly] = connect_client(s, *ctx,
+            ctx->new_ssl(addr.to_string()), firstWrite);
+        ctx->handshake_done(ssl);
+        pimpl = std::make_unique<Impl>(ssl, std::move(ctx), s, addr);
+        pimpl->check_ktls();
+        if (!sentEarly && !firstWrite.empty())
+            write(firstWrite); // rejected or not attempted, so send it normally
+    }
+    catch (...) {
+        if (pimpl)
+            SSL_free(pimpl->ssl);
+        close_sock(s);
+        throw;
+    }
+}
 
 SSLSocket::~SSLSocket() {
     if (pimpl) {
-        if (pimpl->ssl != nullptr)
+        if (pimpl->ssl != nullptr) {
+            // a connection that isn't shutdown is considered broken by OpenSSL,
+            // which would remove its session from the cache
+            if (SSL_is_init_finished(pimpl->ssl))
+                SSL_set_shutdown(pimpl->ssl, SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
             SSL_free(pimpl->ssl);
-        if (pimpl->ctx != nullptr)
-            SSL_CTX_free(pimpl->ctx);
-        if (pimpl->sock != SOCKET_ERROR) {
-#ifdef WIN32
-            closesocket(pimpl->sock);
-#else
-            close(pimpl->sock);
-#endif
         }
-
+        if (pimpl->sock != SOCKET_ERROR)
+            close_sock(pimpl->sock);
     }
 };
 
 void SSLSocket::write(std::string_view data) {
-    auto sent = decltype(data.size()){0};
-    while (sent < data.size()) {
-        auto ret = SSL_write(pimpl->ssl, data.data() + sent,
-            static_cast<int>(data.size() - sent));
-        if (ret <= 0) {
-            throw std::runtime_error(
-                format("Failed to write ssl: ", SSL_get_error(pimpl->ssl, ret)));
-            // TODO: actual execption
+#ifdef KTLS_SUPPORTED
+    if (pimpl->ktlsSend) {
+        pimpl->send_plain(&data, 1, true);
+        return;
+    }
+#endif
+    pimpl->write_ssl(data, true);
+}
+
+/**
+* Encrypts buffers with OpenSSL, gathering small buffers into full TLS records
+* @param write the function sending a record or a buffer larger than one, which
+*   returns the amount of bytes it sent
+* @return the amount of bytes sent
+*/
+template<class Write>
+static size_t gather_records(const std::string_view* buffers, size_t count, Write&& write) {
+    size_t filled = 0; // bytes gathered in writeScratch
+    size_t total = 0;
+    // a record which the socket didn't take all of ends the write
+    const auto send = [&](std::string_view data) {
+        const auto sent = write(data);
+        total += sent;
+        return sent == data.size();
+    };
+    for (size_t i = 0; i < count; ++i) {
+        auto data = buffers[i];
+        while (!data.empty()) {
+            if (filled == 0 && data.size() >= sizeof(writeScratch)) {
+                if (!send(data))
+                    return total;
+                break;
+            }
+            const auto gathered = std::min(data.size(), sizeof(writeScratch) - filled);
+            std::copy_n(data.data(), gathered, writeScratch + filled);
+            filled += gathered;
+            data.remove_prefix(gathered);
+            if (filled == sizeof(writeScratch)) {
+                if (!send({ writeScratch, filled }))
+                    return total;
+                filled = 0;
+            }
         }
-        sent += ret;
     }
+    if (filled > 0)
+        send({ writeScratch, filled });
+    return total;
 }
 
-std::vector<char> SSLSocket::read(size_t minBytes) {
-    sock_block(pimpl->sock, true);
-    size_t read = 0;
-    std::vector<char> buf(4096);
-    do {
-        if (read >= buf.size() - 1024)
-            buf.resize(buf.size() * 2);
-        auto ret = SSL_read(pimpl->ssl, &buf[read],
-            static_cast<int>(std::min(buf.size() - read, minBytes - read)));
+void SSLSocket::writev(const std::string_view* buffers, size_t count) {
+#ifdef KTLS_SUPPORTED
+    if (pimpl->ktlsSend) {
+        pimpl->send_plain(buffers, count, true);
+        return;
+    }
+#endif
+    gather_records(buffers, count, [this](std::string_view data) {
+        return pimpl->write_ssl(data, true);
+    });
+}
+
+size_t SSLSocket::try_writev(const std::string_view* buffers, size_t count) {
+#ifdef KTLS_SUPPORTED
+    if (pimpl->ktlsSend)
+        return pimpl->send_plain(buffers, count, false);
+#endif
+    return gather_records(buffers, count, [this](std::string_view data) {
+        return pimpl->write_ssl(data, false);
+    });
+}
+
+void SSLSocket::send_file(const MappedFile& file, uint64_t offset, uint64_t size) {
+#ifdef KTLS_SUPPORTED
+    if (file.fd() >= 0 && pimpl->ktlsSend) {
+        pimpl->send_file_plain(file, offset, size, true);
+        return;
+    }
+#endif
+    Port::send_file(file, offset, size);
+}
+
+uint64_t SSLSocket::try_send_file(const MappedFile& file, uint64_t offset, uint64_t size) {
+#ifdef KTLS_SUPPORTED
+    if (file.fd() >= 0 && pimpl->ktlsSend)
+        return pimpl->send_file_plain(file, offset, size, false);
+#endif
+    const auto data = file.data().substr(static_cast<size_t>(offset), static_cast<size_t>(size));
+    return try_writev(&data, 1);
+}
+
+size_t SSLSocket::read_into(char* buffer, size_t size, size_t minBytes) {
+    if (size == 0)
+        return 0;
+    pimpl->set_blocking(true);
+    minBytes = std::min(minBytes, size);
+    size_t read = pimpl->early.empty() ? 0 : pimpl->read_early(buffer, size);
+    while (read == 0 || read < minBytes) {
+        if (const auto received = pimpl->receive_plain(buffer + read, size - read);
+            received > 0)
+        {
+            read += static_cast<size_t>(received);
+            continue;
+        }
+        auto ret = SSL_read(pimpl->ssl, buffer + read,
+            static_cast<int>(std::min<size_t>(size - read, INT_MAX)));
         if (ret <= 0)
             throw std::runtime_error(
                 format("Failed to read ssl: ", SSL_get_error(pimpl->ssl, ret)));
         read += ret;
-    } while (minBytes != 0 && minBytes - read > 0);
-
-    buf.resize(read);
-    return buf;
+    }
+    return read;
 }
 
-std::vector<char> SSLSocket::try_read() {
-    sock_block(pimpl->sock, false);
-    size_t read = 0;
-    std::vector<char> buf(4096);
-    do {
-        if (read >= buf.size() - 1024)
-            buf.resize(buf.size() * 2);
-        auto ret = SSL_read(pimpl->ssl, &buf[read],
-            static_cast<int>(buf.size() - read));
+size_t SSLSocket::try_read_into(char* buffer, size_t size) {
+    pimpl->set_blocking(false);
+    size_t read = pimpl->early.empty() ? 0 : pimpl->read_early(buffer, size);
+    while (read < size) {
+        const auto received = pimpl->receive_plain(buffer + read, size - read);
+        if (received > 0) {
+            read += static_cast<size_t>(received);
+            continue;
+        }
+        if (received < 0)
+            break;
+        auto ret = SSL_read(pimpl->ssl, buffer + read,
+            static_cast<int>(std::min<size_t>(size - read, INT_MAX)));
         if (ret <= 0) {
             const auto errCode = SSL_get_error(pimpl->ssl, ret);
             if (errCode == SSL_ERROR_WANT_READ || errCode == SSL_ERROR_WANT_WRITE)
@@ -174,19 +633,70 @@ std::vector<char> SSLSocket::try_read() {
                     format("Failed to read ssl nb: ", errCode));
         }
         read += ret;
-    } while (true);
+    }
+    return read;
+}
 
-    buf.resize(read);
+std::vector<char> SSLSocket::read(size_t minBytes) {
+    if (minBytes == 0) {
+        const auto read = read_into(readScratch, sizeof(readScratch));
+        return std::vector<char>(readScratch, readScratch + read);
+    }
+    std::vector<char> buf(minBytes);
+    read_into(buf.data(), buf.size(), minBytes);
+    return buf;
+}
+
+std::vector<char> SSLSocket::try_read() {
+    std::vector<char> buf;
+    size_t read;
+    do {
+        read = try_read_into(readScratch, sizeof(readScratch));
+        buf.insert(buf.end(), readScratch, readScratch + read);
+    } while (read == sizeof(readScratch));
     return buf;
 }
 
 size_t SSLSocket::available() const noexcept {
-    return SSL_pending(pimpl->ssl);
+    const auto early = pimpl->early.size() - pimpl->earlyPos;
+    return pimpl->ssl == nullptr ? early : early + SSL_pending(pimpl->ssl);
+}
+
+SSLSocket::SSLSocket(std::string_view host, unsigned short port,
+    std::shared_ptr<TlsContext> ctx)
+{
+    if (ctx == nullptr)
+        ctx = default_client_context();
+    if (ctx->is_server())
+        throw std::invalid_argument("Expected a client TlsContext");
+    const auto addresses = Resolver::shared().resolve(host, port);
+    size_t connected = 0;
+    const auto s = connect_socket(addresses.data(), addresses.size(), connected);
+    try {
+        std::string name(host);
+        const auto ssl = static_cast<SSL*>(ctx->new_ssl(name + ':' + std::to_string(port)));
+        // ip addresses aren't sent as a server name (RFC 6066)
+        if (!Address::from_ip(host, port)
+            && SSL_set_tlsext_host_name(ssl, name.c_str()) != 1)
+        {
+            SSL_free(ssl);
+            throw std::runtime_error(format("Failed to set server name: ", ERR_get_error()));
+        }
+        connect_client(s, *ctx, ssl, {});
+        ctx->handshake_done(ssl);
+        pimpl = std::make_unique<Impl>(ssl, std::move(ctx), s, addresses[connected]);
+        pimpl->check_ktls();
+    }
+    catch (...) {
+        close_sock(s);
+        throw;
+    }
 }
 
 SSLSocket SSLSocket::accept() const {
     if (!pimpl->addr.is_server())
         throw std::runtime_error("Can only accept on a server socket");
+    pimpl->set_blocking(true);
     auto connectionAddr = pimpl->addr;
     auto [addr, sz] = connectionAddr.addr_mut();
     const auto connection = ::accept(pimpl->sock, addr, &sz);
@@ -194,27 +704,211 @@ SSLSocket SSLSocket::accept() const {
         throw std::runtime_error(
             format("Failed to accept connection: ", lastError));
     }
-    auto connectionSsl = SSL_new(pimpl->ctx);
-    if (connectionSsl == NULL) {
-        ERR_print_errors_fp(stderr);
-        throw std::runtime_error(format("Cannot make ssl connection: ",
-            ERR_get_error()));
-    }
-    if (SSL_set_fd(connectionSsl, static_cast<int>(connection)) == 0)
-        throw std::runtime_error(format("Cannot set SSL fd: ",
-            SSL_get_error(connectionSsl, 0)));
-    const auto ret = SSL_accept(connectionSsl);
-    if (ret <= 0) {
-        throw std::runtime_error(
-            format("Failed to accept ssl connection: ",
-                SSL_get_error(connectionSsl, ret)));
+    auto connectionSock = make_connection(connection, std::move(connectionAddr), true);
+    connectionSock.step_accept(); // blocks until done
+    return connectionSock;
+}
+
+std::optional<SSLSocket> SSLSocket::try_accept() const {
+    auto connectionAddr = pimpl->addr;
+    auto [addr, sz] = connectionAddr.addr_mut();
+#ifdef __linux__
+    const auto connection = ::accept4(pimpl->sock, addr, &sz, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+    const auto connection = ::accept(pimpl->sock, addr, &sz);
+#endif
+    if (connection == INVALID_SOCKET) {
+        const auto err = lastError;
+        if (err == EAGAIN || err == EWOULDBLOCK || err == ECONNABORTED || err == EINTR)
+            return {};
+        throw std::runtime_error(format("Failed to accept connection: ", err));
+    }
+#ifndef __linux__
+    sock_block(connection, false);
+#endif
+    return make_connection(connection, std::move(connectionAddr), false);
+}
+
+SSLSocket SSLSocket::make_connection(unsigned long long connection, Address&& addr,
+    bool blocking) const
+{
+    auto connectionSsl = static_cast<SSL*>(pimpl->tls->new_ssl({}));
+    SSLSocket connectionSock(connection, connectionSsl, pimpl->tls, std::move(addr));
+    connectionSock.pimpl->blocking = blocking;
+    connectionSock.pimpl->handshaking = true;
+    if (!set_socket(connectionSsl, static_cast<socket_t>(connection)))
+        throw std::runtime_error(format("Cannot set SSL fd: ", ERR_get_error()));
+    return connectionSock;
+}
+
+/**
+* @return `err` if it is an error that is resolved by waiting for the socket to
+* become readable or writable, otherwise throws
+*/
+int want_io(int err, const char* what) {
+    if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE)
+        return err;
+    throw std::runtime_error(format(what, err));
+}
+
+int SSLSocket::step_accept() {
+    const auto ssl = pimpl->ssl;
+    // early data is read until the client ends it, which happens
+    // once it has received the server's part of the handshake
+    while (pimpl->handshaking && pimpl->tls->early_data()) {
+        auto& early = pimpl->early;
+        const auto start = early.size();
+        early.resize(start + SSL3_RT_MAX_PLAIN_LENGTH);
+        size_t read = 0;
+        const auto ret = SSL_read_early_data(ssl, early.data() + start,
+            SSL3_RT_MAX_PLAIN_LENGTH, &read);
+        early.resize(start + read);
+        if (ret == SSL_READ_EARLY_DATA_ERROR)
+            return want_io(SSL_get_error(ssl, 0), "Failed to read early data: ");
+        else if (ret == SSL_READ_EARLY_DATA_FINISH) {
+            early.shrink_to_fit();
+            break;
+        }
+    }
+    pimpl->handshaking = false;
+    const auto ret = SSL_accept(ssl);
+    if (ret <= 0)
+        return want_io(SSL_get_error(ssl, ret), "Failed to accept ssl connection: ");
+    pimpl->tls->handshake_done(ssl);
+    pimpl->check_ktls();
+    return SSL_ERROR_NONE;
+}
+
+Task<SSLSocket> SSLSocket::async_accept() const {
+    if (!pimpl->addr.is_server())
+        throw std::runtime_error("Can only accept on a server socket");
+    auto& scheduler = Scheduler::current();
+    if (scheduler.uses_ring()) {
+        const auto connection = co_await scheduler.accept(pimpl->ring, pimpl->sock);
+        // multishot accepts don't return the address of the client
+        auto connectionAddr = pimpl->addr;
+        auto [addr, sz] = connectionAddr.addr_mut();
+        getpeername(static_cast<socket_t>(connection), addr, &sz);
+        auto connectionSock = make_connection(connection, std::move(connectionAddr), true);
+        connectionSock.pimpl->use_memory_bio();
+        co_return connectionSock;
+    }
+    for (;;) {
+        pimpl->set_blocking(false);
+        if (auto connection = try_accept())
+            co_return std::move(*connection);
+        co_await scheduler.readable(handle());
+    }
+}
+
+Task<void> SSLSocket::async_handshake() {
+    auto& scheduler = Scheduler::current();
+    if (scheduler.uses_ring())
+        pimpl->use_memory_bio();
+    while (pimpl->ssl != nullptr && !SSL_is_init_finished(pimpl->ssl)) {
+        const auto status = step_accept();
+        if (scheduler.uses_ring()) {
+            // with memory BIOs the handshake only waits for the client's messages
+            co_await pimpl->send_ciphertext(scheduler);
+            if (status != SSL_ERROR_NONE)
+                co_await pimpl->receive_ciphertext(scheduler);
+            continue;
+        }
+        if (status == SSL_ERROR_NONE)
+            break;
+        co_await (status == SSL_ERROR_WANT_READ ? scheduler.readable(handle())
+            : scheduler.writable(handle()));
+    }
+}
+
+Task<size_t> SSLSocket::async_read(char* buffer, size_t size) {
+    co_await async_handshake();
+    auto& scheduler = Scheduler::current();
+    if (scheduler.uses_ring()) {
+        if (!pimpl->early.empty())
+            co_return pimpl->read_early(buffer, size);
+        while (size > 0) {
+            const auto ret = SSL_read(pimpl->ssl, buffer,
+                static_cast<int>(std::min<size_t>(size, INT_MAX)));
+            if (ret > 0)
+                co_return static_cast<size_t>(ret);
+            const auto err = SSL_get_error(pimpl->ssl, ret);
+            if (err != SSL_ERROR_WANT_READ)
+                throw std::runtime_error(format("Failed to read ssl: ", err));
+            // reading can produce records to send, such as the reply to a key update
+            co_await pimpl->send_ciphertext(scheduler);
+            co_await pimpl->receive_ciphertext(scheduler);
+        }
+        co_return 0;
+    }
+    for (;;) {
+        const auto read = try_read_into(buffer, size);
+        if (read > 0 || size == 0)
+            co_return read;
+        co_await scheduler.readable(handle());
+    }
+}
+
+Task<void> SSLSocket::async_write(std::string_view data) {
+    co_await async_handshake();
+    auto& scheduler = Scheduler::current();
+    size_t sent = 0;
+    if (scheduler.uses_ring()) {
+        // the memory BIO takes everything, so the data is encrypted a part at a time
+        // to send the ciphertext while the rest is encrypted
+        constexpr size_t partSize = 64 * 1024;
+        while (sent < data.size()) {
+            const auto count = std::min(data.size() - sent, partSize);
+            const auto ret = SSL_write(pimpl->ssl, data.data() + sent, static_cast<int>(count));
+            if (ret <= 0)
+                throw std::runtime_error(
+                    format("Failed to write ssl: ", SSL_get_error(pimpl->ssl, ret)));
+            sent += static_cast<size_t>(ret);
+            co_await pimpl->send_ciphertext(scheduler);
+        }
+        co_return;
+    }
+#ifdef KTLS_SUPPORTED
+    while (pimpl->ktlsSend && sent < data.size()) {
+        pimpl->set_blocking(false);
+        const auto ret = ::send(pimpl->sock, data.data() + sent, data.size() - sent,
+            MSG_NOSIGNAL);
+        if (ret == SOCKET_ERROR) {
+            if (lastError == EWOULDBLOCK || lastError == EAGAIN)
+                co_await scheduler.writable(handle());
+            else if (lastError != EINTR)
+                throw std::runtime_error(format("Failed to write ssl: ", lastError));
+            continue;
+        }
+        sent += static_cast<size_t>(ret);
     }
-    return SSLSocket(connection, connectionSsl, std::move(connectionAddr));
+#endif
+    while (sent < data.size()) {
+        pimpl->set_blocking(false);
+        // a write which wants io is retried with the same arguments, as OpenSSL requires
+        const auto ret = SSL_write(pimpl->ssl, data.data() + sent,
+            static_cast<int>(std::min<size_t>(data.size() - sent, INT_MAX)));
+        if (ret <= 0) {
+            const auto err = want_io(SSL_get_error(pimpl->ssl, ret), "Failed to write ssl: ");
+            co_await (err == SSL_ERROR_WANT_READ ? scheduler.readable(handle())
+                : scheduler.writable(handle()));
+            continue;
+        }
+        sent += static_cast<size_t>(ret);
+    }
+}
+
+unsigned long long SSLSocket::handle() const noexcept {
+    return pimpl->sock;
+}
 
+SSLSocket::Ktls SSLSocket::ktls() const noexcept {
+    return { pimpl->ktlsSend, pimpl->ktlsReceive };
 }
 
-SSLSocket::SSLSocket(unsigned long long sock, void* ssl, Address&& addr) :
-    pimpl(std::make_unique<Impl>(reinterpret_cast<SSL*>(ssl), nullptr,
+SSLSocket::SSLSocket(unsigned long long sock, void* ssl, std::shared_ptr<TlsContext> tls,
+    Address&& addr) :
+    pimpl(std::make_unique<Impl>(reinterpret_cast<SSL*>(ssl), std::move(tls),
         static_cast<socket_t>(sock), std::move(addr))) {}
 
 SSLSocket::SSLSocket(SSLSocket&&) noexcept = default;
@@ -0,0 +1,669 @@
+#include <Scheduler.h>
+#include <IoUring.h>
+#include <Networking.h>
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+#undef min
+#undef max
+
+using SchedulerClock = std::chrono::steady_clock;
+
+#ifndef __linux__
+/// Longest a scheduler waits before checking for coroutines handed over by other
+/// threads, on platforms where it can't be woken
+constexpr auto maxSchedulerWait = std::chrono::milliseconds(10);
+#endif
+
+/// Size of the parts of a ring's fixed buffer handed out by `take_fixed`
+constexpr size_t fixedPartSize = 64 * 1024;
+
+/// The scheduler running on each thread
+static thread_local Scheduler* runningScheduler = nullptr;
+
+/// The links released by destroyed sockets, which their scheduler frees
+struct RingRegistry {
+    std::mutex mu;
+    /// null once the scheduler is destroyed
+    Scheduler* scheduler;
+    std::vector<uint64_t> released;
+#ifdef __linux__
+    int wakeFd;
+#endif
+};
+
+/**
+* What the tag of a ring operation refers to, kept in its low bits.
+* The rest of the tag is a pointer or the id of a link
+*/
+enum RingTag : uint64_t {
+    /// the poll of the eventfd which wakes the scheduler
+    WakeTag,
+    /// a coroutine to resume
+    ResumeTag,
+    /// a `RingOp`
+    OpTag,
+    /// the multishot receive of a link
+    ReceiveTag,
+    /// the multishot accept of a link
+    AcceptTag,
+    /// an operation whose completion isn't needed
+    IgnoreTag
+};
+constexpr uint64_t ringTagBits = 3;
+constexpr uint64_t ringTagMask = (1 << ringTagBits) - 1;
+
+void RingLink::release() noexcept {
+    if (!registry)
+        return;
+    std::lock_guard lock(registry->mu);
+    if (registry->scheduler != nullptr) {
+        registry->released.push_back(id);
+#ifdef __linux__
+        // the scheduler's thread frees them before it next waits, without being woken
+        if (registry->scheduler != runningScheduler) {
+            const uint64_t one = 1;
+            static_cast<void>(::write(registry->wakeFd, &one, sizeof(one)));
+        }
+#endif
+    }
+    registry.reset();
+    id = 0;
+}
+
+RingLink::~RingLink() {
+    release();
+}
+
+struct Scheduler::Impl {
+    /// Coroutine which runs a spawned task and destroys itself once the task finishes
+    struct Spawned {
+        struct promise_type;
+        using handle_t = std::coroutine_handle<promise_type>;
+
+        /// Removes the finished coroutine from the scheduler and destroys it
+        struct FinalAwaiter {
+            bool await_ready() const noexcept { return false; }
+
+            void await_suspend(handle_t coroutine) noexcept {
+                coroutine.promise().impl->finished(coroutine);
+                coroutine.destroy();
+            }
+
+            void await_resume() const noexcept {}
+        };
+
+        struct promise_type {
+            Impl* impl;
+
+            /// Takes the scheduler from the arguments of `run_task`
+            promise_type(Impl& impl, Task<void>&) noexcept : impl(&impl) {}
+
+            Spawned get_return_object() noexcept { return { handle_t::from_promise(*this) }; }
+
+            std::suspend_always initial_suspend() const noexcept { return {}; }
+
+            FinalAwaiter final_suspend() const noexcept { return {}; }
+
+            void return_void() const noexcept {}
+
+            // the coroutine catches everything the task throws
+            void unhandled_exception() const noexcept { std::terminate(); }
+        };
+
+        handle_t coroutine;
+    };
+
+    /// A coroutine sleeping until a time
+    struct Timer {
+        SchedulerClock::time_point time;
+        /// breaks ties so timers for the same time fire in the order they were set
+        uint64_t order;
+        std::coroutine_handle<> coroutine;
+
+        bool operator>(const Timer& other) const noexcept {
+            return time != other.time ? time > other.time : order > other.order;
+        }
+    };
+
+    /// The state of a linked socket
+    struct Stream {
+        /// Data received into a provided buffer
+        struct Received {
+            uint16_t buffer;
+            uint32_t size;
+        };
+
+        int fd;
+        bool accepting;
+        /// true while the multishot operation is in flight
+        bool armed = false;
+        /// true once the socket is destroyed, the stream is erased once it is disarmed
+        bool released = false;
+        /// true once the connection is closed or failed
+        bool ended = false;
+        /// -errno if the operation failed
+        int error = 0;
+        std::deque<Received> received;
+        /// amount of bytes of the first received buffer already taken
+        size_t offset = 0;
+        std::deque<int> accepted;
+        std::coroutine_handle<> waiting;
+
+        Stream(int fd, bool accepting) noexcept : fd(fd), accepting(accepting) {}
+
+        /// @return true if there is something for the socket to take
+        bool has_result() const noexcept {
+            return accepting ? !accepted.empty() || error != 0 : !received.empty() || ended;
+        }
+    };
+
+    FdSet reads, writes;
+    /// the coroutine awaiting each fd
+    std::unordered_map<unsigned long long, std::coroutine_handle<>> readers, writers;
+    /// coroutines to resume
+    std::deque<std::coroutine_handle<>> ready;
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers;
+    uint64_t timerOrder = 0;
+    /// the first exception which escaped a spawned task and hasn't been thrown by `run`
+    std::exception_ptr error;
+
+    /// null if the scheduler waits with `FdSet`
+    std::unique_ptr<IoUring> ring;
+    std::shared_ptr<RingRegistry> registry;
+    std::unordered_map<uint64_t, Stream> streams;
+    uint64_t nextStreamId = 1;
+    /// streams whose receive stopped because the provided buffers ran out
+    std::vector<uint64_t> starved;
+    /// free parts of the ring's fixed buffer
+    std::vector<char*> fixedParts;
+
+    /// guards everything below
+    std::mutex postMu;
+    /// coroutines handed over by any thread, moved to `ready` by the scheduler's thread
+    std::vector<std::coroutine_handle<>> posted;
+    /// spawned coroutines which haven't finished
+    std::unordered_set<void*> spawned;
+    std::atomic<bool> stopping{ false };
+#ifdef __linux__
+    /// readable while coroutines are posted, to wake the scheduler from its wait
+    int wakeFd;
+#endif
+
+    Impl(Scheduler& scheduler, SchedulerBackend backend) {
+#ifdef __linux__
+        wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (wakeFd < 0)
+            throw std::runtime_error("Could not create eventfd: " + std::to_string(lastError));
+        try {
+            if (backend == SchedulerBackend::IoUring
+                || (backend == SchedulerBackend::Automatic && IoUring::supported()))
+            {
+                start_ring(scheduler);
+            }
+            else
+                reads.add(static_cast<unsigned long long>(wakeFd));
+        }
+        catch (...) {
+            close(wakeFd);
+            throw;
+        }
+#else
+        if (backend == SchedulerBackend::IoUring)
+            start_ring(scheduler);
+#endif
+    }
+
+    ~Impl() {
+        // destroying a spawned coroutine destroys its task and the tasks it awaits
+        for (const auto address : spawned)
+            std::coroutine_handle<>::from_address(address).destroy();
+        if (registry) {
+            std::lock_guard lock(registry->mu);
+            registry->scheduler = nullptr;
+        }
+        for (auto& [id, stream] : streams) {
+            for (const auto fd : stream.accepted)
+                close_sock(static_cast<socket_t>(fd));
+        }
+        // closing the ring cancels its operations
+        ring.reset();
+#ifdef __linux__
+        close(wakeFd);
+#endif
+    }
+
+    void start_ring(Scheduler& scheduler) {
+        ring = std::make_unique<IoUring>();
+        registry = std::make_shared<RingRegistry>();
+        registry->scheduler = &scheduler;
+#ifdef __linux__
+        registry->wakeFd = wakeFd;
+        ring->poll(wakeFd, false, true, WakeTag);
+#endif
+        for (size_t offset = 0; offset + fixedPartSize <= ring->fixed_size();
+            offset += fixedPartSize)
+        {
+            fixedParts.push_back(ring->fixed() + offset);
+        }
+    }
+
+    static Spawned run_task(Impl& impl, Task<void> task) {
+        try {
+            co_await task;
+        }
+        catch (...) {
+            if (!impl.error)
+                impl.error = std::current_exception();
+        }
+    }
+
+    void finished(std::coroutine_handle<> coroutine) {
+        std::lock_guard lock(postMu);
+        spawned.erase(coroutine.address());
+    }
+
+    /// @return true if any spawned coroutine hasn't finished
+    bool has_tasks() {
+        std::lock_guard lock(postMu);
+        return !spawned.empty();
+    }
+
+    /// Hands a coroutine to the scheduler's thread and wakes it
+    void post(std::coroutine_handle<> coroutine) {
+        {
+            std::lock_guard lock(postMu);
+            posted.push_back(coroutine);
+        }
+        wake();
+    }
+
+    void wake() noexcept {
+#ifdef __linux__
+        const uint64_t one = 1;
+        static_cast<void>(::write(wakeFd, &one, sizeof(one)));
+#endif
+    }
+
+    void take_posted() {
+        std::lock_guard lock(postMu);
+        ready.insert(ready.end(), posted.begin(), posted.end());
+        posted.clear();
+    }
+
+    /// Resumes the coroutines awaiting the ready fds of a set
+    void resume_ready(FdSet& set,
+        std::unordered_map<unsigned long long, std::coroutine_handle<>>& waiting)
+    {
+        // removing an fd changes the ready list, so it is copied
+        const std::vector<socket_t> fds(set.ready().begin(), set.ready().end());
+        for (const auto fd : fds) {
+            const auto it = waiting.find(static_cast<unsigned long long>(fd));
+            if (it == waiting.end())
+                continue;
+            ready.push_back(it->second);
+            waiting.erase(it);
+            set.remove(static_cast<unsigned long long>(fd));
+        }
+    }
+
+    /// @return how long to wait for io, or an empty optional to wait until woken
+    std::optional<std::chrono::microseconds> wait_time() const {
+        if (!ready.empty())
+            return std::chrono::microseconds(0);
+        if (timers.empty())
+            return {};
+        return std::max(std::chrono::ceil<std::chrono::microseconds>(
+            timers.top().time - SchedulerClock::now()), std::chrono::microseconds(0));
+    }
+
+    /// Waits until an fd is ready, a timer is due or a coroutine is posted
+    void poll() {
+        if (ring)
+            poll_ring();
+        else {
+            const auto timeout = wait_time();
+#ifdef __linux__
+            if (timeout)
+                FdSet::wait(*timeout, ReadSet{ reads }, WriteSet{ writes });
+            else
+                FdSet::wait(ReadSet{ reads }, WriteSet{ writes });
+            if (reads.is_set(static_cast<unsigned long long>(wakeFd))) {
+                uint64_t count;
+                static_cast<void>(::read(wakeFd, &count, sizeof(count)));
+            }
+#else
+            const auto wait = timeout ? std::min<std::chrono::microseconds>(*timeout,
+                maxSchedulerWait) : std::chrono::microseconds(maxSchedulerWait);
+            if (readers.empty() && writers.empty())
+                std::this_thread::sleep_for(wait);
+            else
+                FdSet::wait(wait, ReadSet{ reads }, WriteSet{ writes });
+#endif
+            resume_ready(reads, readers);
+            resume_ready(writes, writers);
+        }
+        const auto now = SchedulerClock::now();
+        while (!timers.empty() && timers.top().time <= now) {
+            ready.push_back(timers.top().coroutine);
+            timers.pop();
+        }
+        take_posted();
+    }
+
+    /// Submits the queued operations, such as the cancellations of released links, without waiting
+    void flush_ring() {
+        free_released();
+        ring->submit(0);
+    }
+
+    /// Submits the operations queued since the last wait, waits and handles their completions
+    void poll_ring() {
+        free_released();
+        const auto timeout = wait_time();
+        ring->submit(timeout && timeout->count() == 0 ? 0 : 1, timeout);
+        IoUring::Completion completion;
+        while (ring->next(completion))
+            complete(completion);
+    }
+
+    void complete(const IoUring::Completion& completion) {
+        const auto tag = completion.tag & ringTagMask;
+        const auto value = completion.tag & ~ringTagMask;
+        switch (tag) {
+        case WakeTag: {
+#ifdef __linux__
+            uint64_t count;
+            static_cast<void>(::read(wakeFd, &count, sizeof(count)));
+            if (!completion.more)
+                ring->poll(wakeFd, false, true, WakeTag);
+#endif
+            break;
+        }
+        case ResumeTag:
+            ready.push_back(std::coroutine_handle<>::from_address(reinterpret_cast<void*>(value)));
+            break;
+        case OpTag: {
+            auto& op = *reinterpret_cast<RingOp*>(value);
+            op.result = completion.result;
+            ready.push_back(op.coroutine);
+            break;
+        }
+        case ReceiveTag:
+        case AcceptTag:
+            complete_stream(value >> ringTagBits, completion);
+            break;
+        default:
+            break;
+        }
+    }
+
+    void complete_stream(uint64_t id, const IoUring::Completion& completion) {
+        const auto it = streams.find(id);
+        if (it == streams.end() || it->second.released) {
+            // the socket is gone, so what the operation produced is dropped
+            if (completion.hasBuffer)
+                recycle(completion.buffer);
+            else if (completion.result >= 0 && (completion.tag & ringTagMask) == AcceptTag)
+                close_sock(static_cast<socket_t>(completion.result));
+            if (it != streams.end() && !completion.more)
+                streams.erase(it);
+            return;
+        }
+        auto& stream = it->second;
+        stream.armed = completion.more;
+        const auto result = completion.result;
+        if (stream.accepting) {
+            if (result >= 0)
+                stream.accepted.push_back(result);
+            else if (result != -ECANCELED)
+                stream.error = result;
+        }
+        else if (result > 0 && completion.hasBuffer)
+            stream.received.push_back({ completion.buffer, static_cast<uint32_t>(result) });
+        else if (result == -ENOBUFS) {
+            // the receive is armed again once a buffer is recycled
+            starved.push_back(id);
+        }
+        else if (result != -ECANCELED) {
+            stream.ended = true;
+            stream.error = result;
+        }
+        if (stream.waiting && stream.has_result())
+            ready.push_back(std::exchange(stream.waiting, {}));
+    }
+
+    /// Arms the multishot operation of a stream
+    void arm(uint64_t id, Stream& stream) {
+        const auto tag = id << ringTagBits;
+        if (stream.accepting)
+            ring->accept(stream.fd, tag | AcceptTag);
+        else
+            ring->receive(stream.fd, tag | ReceiveTag);
+        stream.armed = true;
+    }
+
+    /// Returns a provided buffer, which lets starved receives continue
+    void recycle(uint16_t buffer) {
+        ring->recycle(buffer);
+        for (const auto id : starved) {
+            const auto it = streams.find(id);
+            if (it != streams.end() && !it->second.armed && !it->second.released)
+                arm(id, it->second);
+        }
+        starved.clear();
+    }
+
+    /// Cancels the operations of the links released by destroyed sockets and frees their state
+    void free_released() {
+        std::vector<uint64_t> released;
+        {
+            std::lock_guard lock(registry->mu);
+            released.swap(registry->released);
+        }
+        for (const auto id : released) {
+            const auto it = streams.find(id);
+            if (it == streams.end())
+                continue;
+            auto& stream = it->second;
+            stream.released = true;
+            for (const auto& received : stream.received)
+                recycle(received.buffer);
+            for (const auto fd : stream.accepted)
+                close_sock(static_cast<socket_t>(fd));
+            if (!stream.armed) {
+                streams.erase(it);
+                continue;
+            }
+            // the ring holds the socket open until the operation is cancelled
+            stream.received.clear();
+            stream.accepted.clear();
+            ring->cancel((id << ringTagBits) | (stream.accepting ? AcceptTag : ReceiveTag),
+                IgnoreTag);
+        }
+    }
+
+    /// @return the stream of a link, linking it to this scheduler if it isn't linked
+    Stream& stream(RingLink& link, unsigned long long fd, bool accepting) {
+        if (!ring)
+            throw std::logic_error("The scheduler doesn't use io_uring");
+        if (link.registry != registry) {
+            link.release();
+            link.registry = registry;
+            link.id = nextStreamId++;
+            return streams.emplace(link.id,
+                Stream(static_cast<int>(fd), accepting)).first->second;
+        }
+        return streams.at(link.id);
+    }
+};
+
+Scheduler::Scheduler(SchedulerBackend backend) :
+    pimpl(std::make_unique<Impl>(*this, backend)) {}
+
+Scheduler::~Scheduler() = default;
+
+void Scheduler::spawn(Task<void> task) {
+    const auto coroutine = Impl::run_task(*pimpl, std::move(task)).coroutine;
+    {
+        std::lock_guard lock(pimpl->postMu);
+        pimpl->spawned.insert(coroutine.address());
+    }
+    pimpl->post(coroutine);
+}
+
+void Scheduler::run() {
+    const auto previous = std::exchange(runningScheduler, this);
+    auto& impl = *pimpl;
+    try {
+        impl.take_posted();
+        while (!impl.stopping && impl.has_tasks()) {
+            if (impl.ready.empty())
+                impl.poll();
+            while (!impl.ready.empty() && !impl.stopping && !impl.error) {
+                const auto coroutine = impl.ready.front();
+                impl.ready.pop_front();
+                coroutine.resume();
+            }
+            if (impl.error)
+                std::rethrow_exception(std::exchange(impl.error, nullptr));
+        }
+    }
+    catch (...) {
+        runningScheduler = previous;
+        throw;
+    }
+    runningScheduler = previous;
+    // a stop only ends the run it was called during, or the next one
+    impl.stopping = false;
+    // sockets closed by the last coroutines stay open until their operations are cancelled
+    if (impl.ring)
+        impl.flush_ring();
+}
+
+void Scheduler::stop() {
+    pimpl->stopping = true;
+    pimpl->wake();
+}
+
+void Scheduler::wait(unsigned long long fd, SetType type, std::coroutine_handle<> coroutine) {
+    if (pimpl->ring) {
+        pimpl->ring->poll(static_cast<int>(fd), type == SetType::Write, false,
+            reinterpret_cast<uint64_t>(coroutine.address()) | ResumeTag);
+        return;
+    }
+    auto& waiting = type == SetType::Write ? pimpl->writers : pimpl->readers;
+    if (!waiting.emplace(fd, coroutine).second)
+        throw std::logic_error("Another coroutine is already waiting for the fd");
+    try {
+        (type == SetType::Write ? pimpl->writes : pimpl->reads).add(fd);
+    }
+    catch (...) {
+        waiting.erase(fd);
+        throw;
+    }
+}
+
+void Scheduler::wake_at(SchedulerClock::time_point time, std::coroutine_handle<> coroutine) {
+    pimpl->timers.push({ time, pimpl->timerOrder++, coroutine });
+}
+
+void Scheduler::post(std::coroutine_handle<> coroutine) {
+    pimpl->post(coroutine);
+}
+
+bool Scheduler::ring_ready(RingLink& link, unsigned long long fd, bool accepting) {
+    auto& stream = pimpl->stream(link, fd, accepting);
+    if (stream.has_result())
+        return true;
+    if (!stream.armed)
+        pimpl->arm(link.id, stream);
+    return false;
+}
+
+void Scheduler::ring_wait(RingLink& link, std::coroutine_handle<> coroutine) {
+    auto& stream = pimpl->streams.at(link.id);
+    if (stream.waiting)
+        throw std::logic_error("Another coroutine is already waiting for the socket");
+    stream.waiting = coroutine;
+}
+
+size_t Scheduler::take_received(RingLink& link, char* buffer, size_t size) {
+    auto& stream = pimpl->streams.at(link.id);
+    size_t taken = 0;
+    while (taken < size && !stream.received.empty()) {
+        const auto received = stream.received.front();
+        const auto count = std::min(size - taken, received.size - stream.offset);
+        std::copy_n(pimpl->ring->buffer(received.buffer) + stream.offset, count, buffer + taken);
+        taken += count;
+        stream.offset += count;
+        if (stream.offset == received.size) {
+            stream.received.pop_front();
+            stream.offset = 0;
+            pimpl->recycle(received.buffer);
+        }
+    }
+    if (taken == 0 && size > 0) {
+        if (stream.error != 0)
+            throw std::runtime_error("Failed to read socket: " + std::to_string(-stream.error));
+        throw std::runtime_error("Failed to read socket: connection closed");
+    }
+    return taken;
+}
+
+unsigned long long Scheduler::take_accepted(RingLink& link) {
+    auto& stream = pimpl->streams.at(link.id);
+    if (stream.accepted.empty()) {
+        // failures such as running out of fds are reported once, the next accept tries again
+        const auto error = std::exchange(stream.error, 0);
+        throw std::runtime_error("Failed to accept connection: " + std::to_string(-error));
+    }
+    const auto fd = stream.accepted.front();
+    stream.accepted.pop_front();
+    return static_cast<unsigned long long>(fd);
+}
+
+void Scheduler::ring_send(unsigned long long fd, const char* data, size_t size, bool fixed,
+    RingOp& op)
+{
+    const auto tag = reinterpret_cast<uint64_t>(&op) | OpTag;
+    if (fixed)
+        pimpl->ring->write_fixed(static_cast<int>(fd), data, size, tag);
+    else
+        pimpl->ring->send(static_cast<int>(fd), data, size, tag);
+}
+
+bool Scheduler::uses_ring() const noexcept {
+    return pimpl->ring != nullptr;
+}
+
+std::span<char> Scheduler::take_fixed() noexcept {
+    if (pimpl->fixedParts.empty())
+        return {};
+    const auto part = pimpl->fixedParts.back();
+    pimpl->fixedParts.pop_back();
+    return { part, fixedPartSize };
+}
+
+void Scheduler::return_fixed(std::span<char> part) noexcept {
+    if (!part.empty())
+        pimpl->fixedParts.push_back(part.data());
+}
+
+Scheduler& Scheduler::current() {
+    if (runningScheduler == nullptr)
+        throw std::logic_error("No scheduler is running on this thread");
+    return *runningScheduler;
+}
@@ -0,0 +1,578 @@
+#define _WINSOCK_DEPRECATED_NO_WARNINGS
+#include <Socket.h>
+#include "Address.h"
+#include "Resolver.h"
+#include "Networking.h"
+#include "FdSet.h"
+#include "MappedFile.h"
+#include "ObjectPool.h"
+#include "Scheduler.h"
+#include <algorithm>
+#include <climits>
+#include <stdexcept>
+#include <string>
+#ifndef WIN32
+#include <sys/ioctl.h>
+#include <sys/uio.h>
+#include <poll.h>
+#endif
+#ifdef __linux__
+#include <linux/errqueue.h>
+#include <sys/sendfile.h>
+#endif
+#undef min
+#undef max
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+/// Max amount of buffers to pass to a single sendmsg call
+constexpr size_t maxIov = 64;
+
+template<class OSSock>
+struct Socket<OSSock>::Impl {
+    OSSock sock;
+    Address addr;
+    bool blocking; //< the current blocking mode of sock
+    size_t zerocopyThreshold; //< 0 if zero copy is disabled
+    ZeroCopyStats zerocopy;
+    /// linked once the socket is awaited on an io_uring scheduler
+    RingLink ring;
+
+    Impl(OSSock sock, const Address& addr) : sock(sock), addr(addr),
+        blocking(true), zerocopyThreshold(0), zerocopy{} {}
+
+    Impl(OSSock sock, Address&& addr) : sock(sock), addr(std::move(addr)),
+        blocking(true), zerocopyThreshold(0), zerocopy{} {}
+
+    /// Closes the socket, so a socket moved over another one closes the other's descriptor
+    ~Impl() {
+        if (sock != INVALID_SOCKET)
+            close_sock(sock);
+    }
+
+    Impl(const Impl&) = delete;
+    Impl& operator=(const Impl&) = delete;
+
+    // servers create one per connection, so they are pooled
+    static void* operator new(size_t) { return ObjectPool<Impl>::allocate(); }
+    static void operator delete(void* ptr) noexcept { ObjectPool<Impl>::deallocate(ptr); }
+
+    /**
+    * Sets the blocking mode of the socket, only making a syscall if the mode changes
+    * @throw std::logic_error if the socket's reads and accepts have moved to an io_uring,
+    *   since its data is only received there
+    */
+    void set_blocking(bool block) {
+        if (ring.linked())
+            throw std::logic_error("A socket used with an io_uring scheduler can only be awaited");
+        if (blocking != block) {
+            sock_block(sock, block);
+            blocking = block;
+        }
+    }
+
+    /// Sets an integral socket option
+    void set_option(int level, int option, int value) {
+        if (setsockopt(sock, level, option, reinterpret_cast<const char*>(&value),
+            sizeof(value)) == SOCKET_ERROR)
+        {
+            throw std::runtime_error("Could not set socket option: "
+                + std::to_string(lastError));
+        }
+    }
+
+    /**
+    * Sends data until all of it is sent
+    * @param flags flags to pass to send
+    */
+    void send_all(std::string_view data, int flags) {
+        set_blocking(true);
+        size_t sent = 0;
+        while (sent < data.size()) {
+            const auto ret = send(sock, data.data() + sent,
+                static_cast<int>(std::min<size_t>(data.size() - sent, INT_MAX)),
+                flags | MSG_NOSIGNAL);
+            if (ret == SOCKET_ERROR) {
+                if (lastError == EINTR)
+                    continue;
+                throw std::runtime_error("Failed to write socket: "
+                    + std::to_string(lastError));
+            }
+            sent += static_cast<size_t>(ret);
+        }
+    }
+
+    /**
+    * Handles a failed or finished recv call
+    * @return true if the recv should be retried
+    */
+    static bool check_recv(decltype(recv(0, nullptr, 0, 0)) ret) {
+        if (ret == 0)
+            throw std::runtime_error("Failed to read socket: connection closed");
+        if (ret == SOCKET_ERROR && lastError != EINTR)
+            throw std::runtime_error("Failed to read socket: "
+                + std::to_string(lastError));
+        return ret == SOCKET_ERROR;
+    }
+
+#ifndef WIN32
+    /**
+    * Sends buffers in order with as few syscalls as possible
+    * @param block true to wait until all of them are sent, false to stop once the
+    *   socket takes no more
+    * @return the amount of bytes sent
+    */
+    size_t send_buffers(const std::string_view* buffers, size_t count, bool block) {
+        set_blocking(block);
+        iovec iov[maxIov];
+        size_t total = 0;
+        size_t next = 0; // index of the next buffer to add to iov
+        size_t offset = 0; // amount of bytes of buffers[next] already sent
+        while (next < count) {
+            size_t iovCount = 0;
+            for (auto i = next; i < count && iovCount < maxIov; ++i) {
+                const auto skip = i == next ? offset : 0;
+                if (buffers[i].size() > skip) {
+                    iov[iovCount].iov_base = const_cast<char*>(buffers[i].data() + skip);
+                    iov[iovCount++].iov_len = buffers[i].size() - skip;
+                }
+            }
+            if (iovCount == 0)
+                break;
+            msghdr msg{};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = iovCount;
+            auto sent = sendmsg(sock, &msg, MSG_NOSIGNAL);
+            if (sent == SOCKET_ERROR) {
+                if (lastError == EINTR)
+                    continue;
+                if (!block && (lastError == EWOULDBLOCK || lastError == EAGAIN))
+                    break;
+                throw std::runtime_error("Failed to write socket: " + std::to_string(lastError));
+            }
+            total += static_cast<size_t>(sent);
+            // advance past fully sent buffers
+            while (next < count && static_cast<size_t>(sent) >= buffers[next].size() - offset) {
+                sent -= buffers[next].size() - offset;
+                offset = 0;
+                ++next;
+            }
+            offset += static_cast<size_t>(sent);
+        }
+        return total;
+    }
+#endif
+
+#ifdef __linux__
+    /**
+    * Sends part of a file with `sendfile`
+    * @param block true to wait until all of it is sent, false to stop once the
+    *   socket takes no more
+    * @return the amount of bytes sent
+    */
+    uint64_t send_file(const MappedFile& file, uint64_t offset, uint64_t size, bool block) {
+        set_blocking(block);
+        // sendfile has no flag to fail with EPIPE instead of raising SIGPIPE
+        const SigpipeGuard guard;
+        auto fileOffset = static_cast<off_t>(offset);
+        const auto end = fileOffset + static_cast<off_t>(size);
+        while (fileOffset < end) {
+            // sendfile advances fileOffset by the amount sent
+            const auto sent = sendfile(sock, file.fd(), &fileOffset,
+                static_cast<size_t>(end - fileOffset));
+            if (sent < 0) {
+                if (errno == EINTR)
+                    continue;
+                if (!block && (errno == EWOULDBLOCK || errno == EAGAIN))
+                    break;
+                throw std::runtime_error("Failed to send file: " + std::to_string(errno));
+            }
+            if (sent == 0)
+                throw std::runtime_error("Failed to send file: file is shorter than expected");
+        }
+        return static_cast<uint64_t>(fileOffset) - offset;
+    }
+#endif
+
+#ifdef SO_EE_ORIGIN_ZEROCOPY
+    /**
+    * Reads zero copy completion notifications from the socket's error queue
+    * @return true if any notification was read
+    */
+    bool reap_notifications() {
+        bool reaped = false;
+        for (;;) {
+            char control[128];
+            msghdr msg{};
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+            if (recvmsg(sock, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) == SOCKET_ERROR)
+                return reaped;
+            for (auto cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm)) {
+                const auto err = reinterpret_cast<const sock_extended_err*>(CMSG_DATA(cm));
+                if (err->ee_errno != 0 || err->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+                    continue;
+                // ee_info to ee_data is the inclusive range of completed send ids
+                const auto count = static_cast<uint64_t>(err->ee_data - err->ee_info) + 1;
+                zerocopy.completed += count;
+                if (err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+                    zerocopy.copied += count;
+                reaped = true;
+            }
+        }
+    }
+#endif
+};
+
+template<class OSSock>
+Socket<OSSock>::Socket(const Address& addr, bool reusePort) {
+    if (addr.is_server()) {
+        pimpl = std::make_unique<Impl>(static_cast<OSSock>(listen_socket(addr, reusePort)), addr);
+        return;
+    }
+    pimpl = std::make_unique<Impl>(static_cast<OSSock>(connect_socket(addr)), addr);
+}
+
+template<class OSSock>
+Socket<OSSock>::Socket(std::string_view host, unsigned short port) {
+    const auto addresses = Resolver::shared().resolve(host, port);
+    size_t connected = 0;
+    const auto s = connect_socket(addresses.data(), addresses.size(), connected);
+    pimpl = std::make_unique<Impl>(static_cast<OSSock>(s), addresses[connected]);
+}
+
+template<class OSSock>
+Socket<OSSock>::Socket(OSSock sock, Address&& addr) :
+    pimpl(std::make_unique<Impl>(sock, std::move(addr))) {}
+
+template<class OSSock>
+Socket<OSSock>::~Socket() = default;
+
+template<class OSSock>
+Socket<OSSock>::Socket(Socket&&) noexcept = default;
+
+template<class OSSock>
+Socket<OSSock>& Socket<OSSock>::operator=(Socket&&) noexcept = default;
+
+template<class OSSock>
+size_t Socket<OSSock>::available() const noexcept {
+#ifdef WIN32
+    u_long count = 0;
+    ioctlsocket(pimpl->sock, FIONREAD, &count);
+#else
+    int count = 0;
+    ioctl(pimpl->sock, FIONREAD, &count);
+#endif
+    return static_cast<size_t>(count);
+}
+
+template<class OSSock>
+void Socket<OSSock>::write(std::string_view data) {
+    pimpl->send_all(data, 0);
+}
+
+template<class OSSock>
+void Socket<OSSock>::send_file(const MappedFile& file, uint64_t offset, uint64_t size) {
+#ifdef __linux__
+    pimpl->send_file(file, offset, size, true);
+#else
+    Port::send_file(file, offset, size);
+#endif
+}
+
+template<class OSSock>
+uint64_t Socket<OSSock>::try_send_file(const MappedFile& file, uint64_t offset, uint64_t size) {
+#ifdef __linux__
+    return pimpl->send_file(file, offset, size, false);
+#else
+    return Port::try_send_file(file, offset, size);
+#endif
+}
+
+template<class OSSock>
+void Socket<OSSock>::writev(const std::string_view* buffers, size_t count) {
+#ifdef WIN32
+    for (size_t i = 0; i < count; ++i)
+        write(buffers[i]);
+#else
+    pimpl->send_buffers(buffers, count, true);
+#endif
+}
+
+template<class OSSock>
+size_t Socket<OSSock>::try_writev(const std::string_view* buffers, size_t count) {
+#ifdef WIN32
+    return Port::try_writev(buffers, count);
+#else
+    return pimpl->send_buffers(buffers, count, false);
+#endif
+}
+
+template<class OSSock>
+size_t Socket<OSSock>::read_into(char* buffer, size_t size, size_t minBytes) {
+    if (size == 0)
+        return 0;
+    pimpl->set_blocking(true);
+    minBytes = std::min(minBytes, size);
+    size_t read = 0;
+    do {
+        const auto ret = recv(pimpl->sock, buffer + read,
+            static_cast<int>(std::min<size_t>(size - read, INT_MAX)), 0);
+        if (!Impl::check_recv(ret))
+            read += static_cast<size_t>(ret);
+    } while (read < minBytes || read == 0);
+    return read;
+}
+
+template<class OSSock>
+size_t Socket<OSSock>::try_read_into(char* buffer, size_t size) {
+    pimpl->set_blocking(false);
+    size_t read = 0;
+    while (read < size) {
+        const auto ret = recv(pimpl->sock, buffer + read,
+            static_cast<int>(std::min<size_t>(size - read, INT_MAX)), 0);
+        if (ret == SOCKET_ERROR && (lastError == EWOULDBLOCK || lastError == EAGAIN))
+            break;
+        if (!Impl::check_recv(ret))
+            read += static_cast<size_t>(ret);
+    }
+    return read;
+}
+
+template<class OSSock>
+std::vector<char> Socket<OSSock>::read(size_t minBytes) {
+    if (minBytes == 0) {
+        char buf[4096];
+        const auto read = read_into(buf, sizeof(buf));
+        return std::vector<char>(buf, buf + read);
+    }
+    std::vector<char> buf(minBytes);
+    read_into(buf.data(), buf.size(), minBytes);
+    return buf;
+}
+
+template<class OSSock>
+std::vector<char> Socket<OSSock>::try_read() {
+    // the socket buffer can be read in one call, so only allocate once the size is known
+    std::vector<char> buf(available());
+    if (buf.empty()) {
+        char scratch[4096];
+        const auto read = try_read_into(scratch, sizeof(scratch));
+        return std::vector<char>(scratch, scratch + read);
+    }
+    buf.resize(try_read_into(buf.data(), buf.size()));
+    return buf;
+}
+
+template<class OSSock>
+Socket<OSSock> Socket<OSSock>::accept() const {
+    if (!pimpl->addr.is_server())
+        throw std::runtime_error("Can only accept on a server socket");
+    pimpl->set_blocking(true);
+    auto connectionAddr = pimpl->addr;
+    auto [addr, sz] = connectionAddr.addr_mut();
+    const auto connection = ::accept(pimpl->sock, addr, &sz);
+    if (connection == INVALID_SOCKET) {
+        throw std::runtime_error("Failed to accept connection: "
+            + std::to_string(lastError));
+    }
+    return Socket(static_cast<OSSock>(connection), std::move(connectionAddr));
+}
+
+template<class OSSock>
+std::optional<Socket<OSSock>> Socket<OSSock>::try_accept() const {
+    if (!pimpl->addr.is_server())
+        throw std::runtime_error("Can only accept on a server socket");
+    pimpl->set_blocking(false);
+    auto connectionAddr = pimpl->addr;
+    auto [addr, sz] = connectionAddr.addr_mut();
+#ifdef __linux__
+    // accepted sockets don't inherit the listener's non-blocking mode on linux
+    const auto connection = accept4(pimpl->sock, addr, &sz, SOCK_CLOEXEC);
+#else
+    const auto connection = ::accept(pimpl->sock, addr, &sz);
+#endif
+    if (connection == INVALID_SOCKET) {
+        if (lastError == EWOULDBLOCK || lastError == EAGAIN || lastError == EINTR
+            || lastError == ECONNABORTED)
+        {
+            return {};
+        }
+        throw std::runtime_error("Failed to accept connection: "
+            + std::to_string(lastError));
+    }
+    auto sock = Socket(static_cast<OSSock>(connection), std::move(connectionAddr));
+#ifndef __linux__
+    sock_block(static_cast<socket_t>(connection), true);
+#endif
+    return sock;
+}
+
+template<class OSSock>
+Task<Socket<OSSock>> Socket<OSSock>::async_accept() const {
+    auto& scheduler = Scheduler::current();
+    if (scheduler.uses_ring()) {
+        if (!pimpl->addr.is_server())
+            throw std::runtime_error("Can only accept on a server socket");
+        const auto connection = co_await scheduler.accept(pimpl->ring, pimpl->sock);
+        // multishot accepts don't return the address of the client
+        auto connectionAddr = pimpl->addr;
+        auto [addr, sz] = connectionAddr.addr_mut();
+        getpeername(static_cast<socket_t>(connection), addr, &sz);
+        co_return Socket(static_cast<OSSock>(connection), std::move(connectionAddr));
+    }
+    for (;;) {
+        if (auto connection = try_accept())
+            co_return std::move(*connection);
+        co_await Scheduler::current().readable(handle());
+    }
+}
+
+template<class OSSock>
+Task<size_t> Socket<OSSock>::async_read(char* buffer, size_t size) {
+    auto& scheduler = Scheduler::current();
+    if (scheduler.uses_ring() && size > 0)
+        co_return co_await scheduler.receive(pimpl->ring, pimpl->sock, buffer, size);
+    for (;;) {
+        const auto read = try_read_into(buffer, size);
+        if (read > 0 || size == 0)
+            co_return read;
+        co_await Scheduler::current().readable(handle());
+    }
+}
+
+template<class OSSock>
+Task<void> Socket<OSSock>::async_write(std::string_view data) {
+    auto& scheduler = Scheduler::current();
+    size_t sent = 0;
+    if (scheduler.uses_ring()) {
+        while (sent < data.size()) {
+            const auto ret = co_await scheduler.send(pimpl->sock, data.data() + sent,
+                data.size() - sent);
+            if (ret < 0)
+                throw std::runtime_error("Failed to write socket: " + std::to_string(-ret));
+            sent += static_cast<size_t>(ret);
+        }
+        co_return;
+    }
+    while (sent < data.size()) {
+        pimpl->set_blocking(false);
+        const auto ret = send(pimpl->sock, data.data() + sent,
+            static_cast<int>(std::min<size_t>(data.size() - sent, INT_MAX)), MSG_NOSIGNAL);
+        if (ret == SOCKET_ERROR) {
+            if (lastError == EWOULDBLOCK || lastError == EAGAIN)
+                co_await scheduler.writable(handle());
+            else if (lastError != EINTR)
+                throw std::runtime_error("Failed to write socket: " + std::to_string(lastError));
+            continue;
+        }
+        sent += static_cast<size_t>(ret);
+    }
+}
+
+template<class OSSock>
+unsigned long long Socket<OSSock>::handle() const noexcept {
+    return static_cast<unsigned long long>(pimpl->sock);
+}
+
+template<class OSSock>
+void Socket<OSSock>::set_nodelay(bool enable) {
+    pimpl->set_option(IPPROTO_TCP, TCP_NODELAY, enable);
+}
+
+template<class OSSock>
+void Socket<OSSock>::set_cork(bool enable) {
+#ifdef TCP_CORK
+    pimpl->set_option(IPPROTO_TCP, TCP_CORK, enable);
+#else
+    static_cast<void>(enable);
+#endif
+}
+
+template<class OSSock>
+bool Socket<OSSock>::enable_zerocopy(size_t threshold) {
+#ifdef SO_EE_ORIGIN_ZEROCOPY
+    const int on = 1;
+    if (setsockopt(pimpl->sock, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof(on)) == SOCKET_ERROR)
+        return false;
+    pimpl->zerocopyThreshold = std::max<size_t>(threshold, 1);
+    return true;
+#else
+    static_cast<void>(threshold);
+    return false;
+#endif
+}
+
+template<class OSSock>
+void Socket<OSSock>::write_zerocopy(std::string_view data) {
+#ifdef SO_EE_ORIGIN_ZEROCOPY
+    if (pimpl->zerocopyThreshold == 0 || data.size() < pimpl->zerocopyThreshold)
+        return write(data);
+    pimpl->set_blocking(true);
+    size_t sent = 0;
+    while (sent < data.size()) {
+        const auto ret = send(pimpl->sock, data.data() + sent, data.size() - sent,
+            MSG_ZEROCOPY | MSG_NOSIGNAL);
+        if (ret == SOCKET_ERROR) {
+            if (lastError == EINTR)
+                continue;
+            // the notification queue is full, completions must be read before sending more
+            if (lastError == ENOBUFS) {
+                pimpl->reap_notifications();
+                continue;
+            }
+            throw std::runtime_error("Failed to write socket: " + std::to_string(lastError));
+        }
+        // every successful zero copy send gets its own completion notification
+        ++pimpl->zerocopy.sends;
+        sent += static_cast<size_t>(ret);
+    }
+#else
+    write(data);
+#endif
+}
+
+template<class OSSock>
+size_t Socket<OSSock>::zerocopy_pending() {
+#ifdef SO_EE_ORIGIN_ZEROCOPY
+    pimpl->reap_notifications();
+#endif
+    return static_cast<size_t>(pimpl->zerocopy.sends - pimpl->zerocopy.completed);
+}
+
+template<class OSSock>
+void Socket<OSSock>::flush_zerocopy() {
+#ifdef SO_EE_ORIGIN_ZEROCOPY
+    while (zerocopy_pending() > 0) {
+        // pending error queue messages are reported as POLLERR
+        pollfd pfd{ pimpl->sock, 0, 0 };
+        if (poll(&pfd, 1, -1) == SOCKET_ERROR && lastError != EINTR)
+            throw std::runtime_error("Failed to wait for zero copy completion: "
+                + std::to_string(lastError));
+    }
+#endif
+}
+
+template<class OSSock>
+typename Socket<OSSock>::ZeroCopyStats Socket<OSSock>::zerocopy_stats() const noexcept {
+    return pimpl->zerocopy;
+}
+
+template<class OSSock>
+void Socket<OSSock>::add_to_fd(FdSet& fd) const {
+    fd.add(pimpl->sock);
+}
+
+template<class OSSock>
+bool Socket<OSSock>::is_in_fd(const FdSet& fd) const {
+    return fd.is_set(pimpl->sock);
+}
+
+template<class OSSock>
+void Socket<OSSock>::remove_from_fd(FdSet& fd) const {
+    fd.remove(pimpl->sock);
+}
+
+template class Socket<socket_t>;
@@ -0,0 +1,377 @@
+#include <StaticFiles.h>
+#include <MappedFile.h>
+#include <UrlEncoding.h>
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstdio>
+#include <list>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <sys/stat.h>
+
+constexpr std::string_view dayNames[] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+constexpr std::string_view monthNames[] = {
+    "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+};
+constexpr int64_t secondsPerDay = 24 * 60 * 60;
+
+/// @return the amount of days from 1970-01-01 to a date of the proleptic Gregorian calendar
+constexpr int64_t days_from_civil(int64_t year, int month, int day) noexcept {
+    year -= month <= 2;
+    const auto era = (year >= 0 ? year : year - 399) / 400;
+    const auto yearOfEra = year - era * 400;
+    const auto dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    const auto dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
+
+std::string format_http_date(time_t time) {
+    const auto seconds = static_cast<int64_t>(time);
+    auto days = seconds / secondsPerDay;
+    auto secondOfDay = seconds % secondsPerDay;
+    if (secondOfDay < 0) {
+        secondOfDay += secondsPerDay;
+        --days;
+    }
+    // the inverse of days_from_civil
+    const auto shifted = days + 719468;
+    const auto era = (shifted >= 0 ? shifted : shifted - 146096) / 146097;
+    const auto dayOfEra = shifted - era * 146097;
+    const auto yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524
+        - dayOfEra / 146096) / 365;
+    const auto dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    const auto monthIndex = (5 * dayOfYear + 2) / 153;
+    const auto day = dayOfYear - (153 * monthIndex + 2) / 5 + 1;
+    const auto month = monthIndex < 10 ? monthIndex + 3 : monthIndex - 9;
+    const auto year = yearOfEra + era * 400 + (month <= 2);
+    // 1970-01-01 was a Thursday
+    const auto weekday = ((days + 4) % 7 + 7) % 7;
+
+    char buffer[64];
+    const auto size = std::snprintf(buffer, sizeof(buffer), "%s, %02d %s %04lld %02d:%02d:%02d GMT",
+        dayNames[weekday].data(), static_cast<int>(day), monthNames[month - 1].data(),
+        static_cast<long long>(year), static_cast<int>(secondOfDay / 3600),
+        static_cast<int>(secondOfDay / 60 % 60), static_cast<int>(secondOfDay % 60));
+    return std::string(buffer, static_cast<size_t>(size));
+}
+
+/// @return the value of the decimal digits in `text`, or -1 if it isn't only digits
+static int parse_digits(std::string_view text) noexcept {
+    int value = 0;
+    for (const auto c : text) {
+        if (c < '0' || c > '9')
+            return -1;
+        value = value * 10 + (c - '0');
+    }
+    return value;
+}
+
+std::optional<time_t> parse_http_date(std::string_view date) noexcept {
+    // Sun, 06 Nov 1994 08:49:37 GMT
+    constexpr std::string_view layout = "ddd, dd mmm yyyy hh:mm:ss GMT";
+    if (date.size() != layout.size() || date.substr(3, 2) != ", " || date[7] != ' '
+        || date[11] != ' ' || date[16] != ' ' || date[19] != ':' || date[22] != ':'
+        || date.substr(25) != " GMT")
+    {
+        return {};
+    }
+    const auto monthName = std::find(std::begin(monthNames), std::end(monthNames),
+        date.substr(8, 3));
+    const auto day = parse_digits(date.substr(5, 2));
+    const auto year = parse_digits(date.substr(12, 4));
+    const auto hour = parse_digits(date.substr(17, 2));
+    const auto minute = parse_digits(date.substr(20, 2));
+    const auto second = parse_digits(date.substr(23, 2));
+    if (monthName == std::end(monthNames) || day < 1 || day > 31 || year < 0
+        || hour < 0 || hour > 23 || minute < 0 || minute > 59 || second < 0 || second > 60)
+    {
+        return {};
+    }
+    const auto month = static_cast<int>(monthName - std::begin(monthNames)) + 1;
+    return static_cast<time_t>(days_from_civil(year, month, day) * secondsPerDay
+        + hour * 3600 + minute * 60 + second);
+}
+
+/// @return the value of a byte position, or an empty optional if it isn't only digits
+static std::optional<uint64_t> parse_position(std::string_view text) noexcept {
+    uint64_t value;
+    const auto end = text.data() + text.size();
+    const auto [ptr, err] = std::from_chars(text.data(), end, value);
+    if (text.empty() || err != std::errc() || ptr != end)
+        return {};
+    return value;
+}
+
+std::optional<std::pair<uint64_t, uint64_t>> parse_byte_range(std::string_view range,
+    uint64_t size) noexcept
+{
+    constexpr std::string_view unit = "bytes=";
+    if (range.size() < unit.size() || !detail::iequals(range.substr(0, unit.size()), unit))
+        return {};
+    range.remove_prefix(unit.size());
+    const auto trimStart = range.find_first_not_of(" \t");
+    if (trimStart == std::string_view::npos)
+        return {};
+    range = range.substr(trimStart, range.find_last_not_of(" \t") + 1 - trimStart);
+    const auto dash = range.find('-');
+    // a list of ranges is answered with the whole resource
+    if (dash == std::string_view::npos || range.find(',') != std::string_view::npos)
+        return {};
+    const auto last = range.substr(dash + 1);
+    if (dash == 0) {
+        // the last `length` bytes
+        const auto length = parse_position(last);
+        if (!length)
+            return {};
+        const auto count = std::min(*length, size);
+        return std::pair(size - count, count);
+    }
+    const auto first = parse_position(range.substr(0, dash));
+    if (!first)
+        return {};
+    auto end = size;
+    if (!last.empty()) {
+        const auto lastPos = parse_position(last);
+        if (!lastPos || *lastPos < *first)
+            return {};
+        end = std::min(*lastPos + 1, size);
+    }
+    if (*first >= size)
+        return std::pair(*first, uint64_t(0));
+    return std::pair(*first, end - *first);
+}
+
+std::string_view content_type(std::string_view path) noexcept {
+    constexpr std::pair<std::string_view, std::string_view> types[] = {
+        { "html", "text/html; charset=utf-8" }, { "htm", "text/html; charset=utf-8" },
+        { "css", "text/css; charset=utf-8" }, { "js", "text/javascript; charset=utf-8" },
+        { "mjs", "text/javascript; charset=utf-8" }, { "json", "application/json" },
+        { "txt", "text/plain; charset=utf-8" }, { "xml", "application/xml" },
+        { "svg", "image/svg+xml" }, { "png", "image/png" }, { "jpg", "image/jpeg" },
+        { "jpeg", "image/jpeg" }, { "gif", "image/gif" }, { "webp", "image/webp" },
+        { "ico", "image/x-icon" }, { "wasm", "application/wasm" },
+        { "pdf", "application/pdf" }, { "woff", "font/woff" }, { "woff2", "font/woff2" },
+        { "mp4", "video/mp4" }, { "webm", "video/webm" }, { "mp3", "audio/mpeg" },
+    };
+    const auto dot = path.rfind('.');
+    if (dot != std::string_view::npos && path.find('/', dot) == std::string_view::npos) {
+        const auto extension = path.substr(dot + 1);
+        for (const auto& [name, type] : types) {
+            if (detail::iequals(name, extension))
+                return type;
+        }
+    }
+    return "application/octet-stream";
+}
+
+/// Type, size and modification time of a path
+struct FileInfo {
+    bool directory;
+    bool regular;
+    uint64_t size;
+    int64_t modifiedNs;
+};
+
+static std::optional<FileInfo> file_info(const std::string& path) noexcept {
+#ifdef WIN32
+    struct _stat64 info;
+    if (_stat64(path.c_str(), &info) != 0)
+        return {};
+    return FileInfo{ (info.st_mode & _S_IFDIR) != 0, (info.st_mode & _S_IFREG) != 0,
+        static_cast<uint64_t>(info.st_size), static_cast<int64_t>(info.st_mtime) * 1000000000 };
+#else
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0)
+        return {};
+#ifdef __APPLE__
+    const auto& modified = info.st_mtimespec;
+#else
+    const auto& modified = info.st_mtim;
+#endif
+    return FileInfo{ S_ISDIR(info.st_mode), S_ISREG(info.st_mode),
+        static_cast<uint64_t>(info.st_size),
+        static_cast<int64_t>(modified.tv_sec) * 1000000000 + modified.tv_nsec };
+#endif
+}
+
+struct StaticFiles::Impl {
+    struct Node {
+        std::string path;
+        std::shared_ptr<const MappedFile> file;
+        /// set by hits, cleared by the clock hand, which evicts the node if it is still clear,
+        /// so files requested once go before the ones requested again
+        std::atomic<bool> referenced{ false };
+
+        Node(const std::string& path, std::shared_ptr<const MappedFile>&& file) :
+            path(path), file(std::move(file)) {}
+    };
+
+    std::string root;
+    uint64_t maxCachedBytes;
+    std::shared_mutex mu;
+    /// mapped files in clock order, guarded by mu
+    std::list<Node> ring;
+    /// the nodes by path, guarded by mu
+    std::unordered_map<std::string_view, std::list<Node>::iterator> files;
+    /// next node the clock looks at, guarded by mu
+    std::list<Node>::iterator hand = ring.end();
+    uint64_t cachedBytes = 0; //< guarded by mu
+    std::atomic<uint64_t> hits{ 0 }, misses{ 0 };
+
+    Impl(std::string&& root, uint64_t maxCachedBytes) :
+        root(std::move(root)), maxCachedBytes(maxCachedBytes) {}
+
+    /**
+    * Maps a request target to a path in the root directory
+    * @return false if the target doesn't name a path in the root directory
+    */
+    bool resolve(std::string_view target, std::string& path) const {
+        target = target.substr(0, target.find_first_of("?#"));
+        if (target.empty() || target.front() != '/')
+            return false;
+        path.assign(root);
+        const auto start = path.size();
+        path.append(target);
+        path.resize(start + url_decode_in_place(path.data() + start, path.size() - start, false));
+        const auto decoded = std::string_view(path).substr(start);
+        // backslashes separate paths on windows
+        if (decoded.find_first_of(std::string_view("\0\\", 2)) != std::string_view::npos)
+            return false;
+        for (size_t pos = 0; pos != std::string_view::npos;) {
+            const auto next = decoded.find('/', pos + 1);
+            if (decoded.substr(pos + 1, next == std::string_view::npos
+                ? std::string_view::npos : next - pos - 1) == "..")
+            {
+                return false;
+            }
+            pos = next;
+        }
+        return true;
+    }
+
+    /// @return the cached file of a path if it is still current, otherwise the file opened again
+    std::shared_ptr<const MappedFile> open(const std::string& path, const FileInfo& info) {
+        {
+            std::shared_lock lock(mu);
+            const auto it = files.find(path);
+            if (it != files.end() && it->second->file->modified_ns() == info.modifiedNs
+                && it->second->file->size() == info.size)
+            {
+                hits.fetch_add(1, std::memory_order_relaxed);
+                auto& node = *it->second;
+                if (!node.referenced.load(std::memory_order_relaxed))
+                    node.referenced.store(true, std::memory_order_relaxed);
+                return node.file;
+            }
+        }
+        misses.fetch_add(1, std::memory_order_relaxed);
+        std::shared_ptr<const MappedFile> file = std::make_shared<MappedFile>(path);
+        if (file->size() > maxCachedBytes)
+            return file;
+        std::unique_lock lock(mu);
+        if (const auto it = files.find(path); it != files.end())
+            remove(it->second);
+        // files in use stay mapped until their responses are sent
+        while (!ring.empty() && cachedBytes + file->size() > maxCachedBytes) {
+            if (hand == ring.end())
+                hand = ring.begin();
+            if (hand->referenced.load(std::memory_order_relaxed)) {
+                // a second chance, the file is evicted if it isn't used before the hand returns
+                hand->referenced.store(false, std::memory_order_relaxed);
+                ++hand;
+            }
+            else {
+                remove(hand);
+            }
+        }
+        cachedBytes += file->size();
+        // new nodes go behind the hand, so they are looked at last
+        const auto it = ring.emplace(hand, path, std::shared_ptr(file));
+        files.emplace(it->path, it);
+        return file;
+    }
+
+    /// Removes a node, advancing the hand if it points at it
+    void remove(std::list<Node>::iterator it) {
+        if (hand == it)
+            ++hand;
+        cachedBytes -= it->file->size();
+        files.erase(it->path);
+        ring.erase(it);
+    }
+};
+
+StaticFiles::StaticFiles(std::string root, uint64_t maxCachedBytes) {
+    while (!root.empty() && root.back() == '/')
+        root.pop_back();
+    pimpl = std::make_shared<Impl>(std::move(root), maxCachedBytes);
+}
+
+void StaticFiles::operator()(const HttpRequestFrame& request, HttpResponseFrame& response) const {
+    if (request.protocol != HttpFrame::Protocol::GET
+        && request.protocol != HttpFrame::Protocol::HEAD)
+    {
+        response.responseCode = HttpResponse::not_allow;
+        response["Allow"] = "GET, HEAD";
+        return;
+    }
+    thread_local std::string path;
+    auto info = pimpl->resolve(request.path, path) ? file_info(path) : std::nullopt;
+    if (info && info->directory) {
+        if (path.back() != '/')
+            path.push_back('/');
+        path.append("index.html");
+        info = file_info(path);
+    }
+    if (!info || !info->regular) {
+        response.responseCode = HttpResponse::not_found;
+        return;
+    }
+    std::shared_ptr<const MappedFile> file;
+    try {
+        file = pimpl->open(path, *info);
+    }
+    catch (const std::runtime_error&) {
+        // the file was removed or can't be read
+        response.responseCode = HttpResponse::not_found;
+        return;
+    }
+
+    response["Last-Modified"] = format_http_date(file->modified());
+    if (const auto since = request.headers().find("If-Modified-Since")) {
+        const auto time = parse_http_date(*since);
+        if (time && file->modified() <= *time) {
+            response.responseCode = HttpResponse::not_modified;
+            return;
+        }
+    }
+    response[KnownHeader::ContentType] = content_type(path);
+    response["Accept-Ranges"] = "bytes";
+    const auto size = file->size();
+    auto range = std::pair(uint64_t(0), size);
+    if (const auto rangeHeader = request.headers().find("Range")) {
+        if (const auto requested = parse_byte_range(*rangeHeader, size)) {
+            if (requested->second == 0) {
+                response.responseCode = HttpResponse::range_not_satisfiable;
+                response["Content-Range"] = "bytes */" + std::to_string(size);
+                response[KnownHeader::ContentLength] = "0";
+                return;
+            }
+            range = *requested;
+            response.responseCode = HttpResponse::partial;
+            response["Content-Range"] = "bytes " + std::to_string(range.first) + '-'
+                + std::to_string(range.first + range.second - 1) + '/' + std::to_string(size);
+        }
+    }
+    response[KnownHeader::ContentLength] = std::to_string(range.second);
+    response.fileBody = { std::move(file), range.first, range.second };
+}
+
+StaticFiles::Stats StaticFiles::stats() const {
+    std::shared_lock lock(pimpl->mu);
+    return { pimpl->hits.load(std::memory_order_relaxed),
+        pimpl->misses.load(std::memory_order_relaxed), pimpl->cachedBytes };
+}
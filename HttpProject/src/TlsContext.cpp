@@ -0,0 +1,171 @@
+#include <TlsContext.h>
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <climits>
+#include <unordered_map>
+
+/// Max amount of sessions a server keeps in its cache
+constexpr long serverCacheSize = 20480;
+/// Max amount of early data a server accepts from a client
+constexpr uint32_t maxEarlyData = 16384;
+constexpr unsigned char sessionIdContext[] = "HttpProject";
+
+struct TlsContext::Impl {
+    SSL_CTX* ctx;
+    bool server;
+    bool earlyData;
+    std::atomic<uint64_t> handshakes{ 0 }, resumed{ 0 }, ktlsSend{ 0 }, ktlsReceive{ 0 };
+
+    std::mutex sessionMu;
+    /// last session of each server, only used by client contexts
+    std::unordered_map<std::string, SSL_SESSION*> sessions;
+
+    Impl(SSL_CTX* ctx, bool server, bool earlyData) :
+        ctx(ctx), server(server), earlyData(earlyData) {}
+
+    ~Impl() {
+        for (auto& [peer, session] : sessions)
+            SSL_SESSION_free(session);
+        SSL_CTX_free(ctx);
+    }
+
+    /// Index of the peer key of an SSL object in its ex data
+    static int peer_index() {
+        static const int index = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr,
+            [](void*, void* ptr, CRYPTO_EX_DATA*, int, long, void*) {
+                delete static_cast<std::string*>(ptr);
+            });
+        return index;
+    }
+
+    /**
+    * Called by OpenSSL when a client receives a new session, which for TLS 1.3
+    * happens after the handshake
+    * @return 1 to take ownership of the session
+    */
+    static int on_new_session(SSL* ssl, SSL_SESSION* session) {
+        const auto peer = static_cast<std::string*>(SSL_get_ex_data(ssl, peer_index()));
+        const auto self = static_cast<Impl*>(SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl)));
+        if (peer == nullptr || self == nullptr || !SSL_SESSION_is_resumable(session))
+            return 0;
+        std::lock_guard lock(self->sessionMu);
+        auto& cached = self->sessions[*peer];
+        if (cached != nullptr)
+            SSL_SESSION_free(cached);
+        cached = session;
+        return 1;
+    }
+};
+
+/// @return a new ssl context with settings shared by clients and servers
+SSL_CTX* make_ctx(const SSL_METHOD* method) {
+    const auto ctx = SSL_CTX_new(method);
+    if (ctx == nullptr)
+        throw std::runtime_error("Failed to create ssl ctx: "
+            + std::to_string(ERR_get_error()));
+    SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+    // a write which would block is retried from wherever the caller keeps the unsent data
+    SSL_CTX_set_mode(ctx, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+    return ctx;
+}
+
+TlsContext::TlsContext(bool earlyData) {
+    const auto ctx = make_ctx(TLS_client_method());
+    pimpl = std::make_unique<Impl>(ctx, false, earlyData);
+    SSL_CTX_set_app_data(ctx, pimpl.get());
+    // sessions are cached by peer address in `sessions` instead of by OpenSSL
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_sess_set_new_cb(ctx, &Impl::on_new_session);
+}
+
+TlsContext::TlsContext(const char* certFile, const char* keyFile, bool earlyData) {
+    const auto ctx = make_ctx(TLS_server_method());
+    pimpl = std::make_unique<Impl>(ctx, true, earlyData);
+    SSL_CTX_set_app_data(ctx, pimpl.get());
+    SSL_CTX_set_ecdh_auto(ctx, 1);
+
+    if (SSL_CTX_use_certificate_file(ctx, certFile, SSL_FILETYPE_PEM) <= 0) {
+        ERR_print_errors_fp(stderr);
+        throw std::runtime_error("Could not load cert file: "
+            + std::to_string(ERR_get_error()));
+    }
+    if (SSL_CTX_use_PrivateKey_file(ctx, keyFile, SSL_FILETYPE_PEM) <= 0) {
+        ERR_print_errors_fp(stderr);
+        throw std::runtime_error("Could not load key file: "
+            + std::to_string(ERR_get_error()));
+    }
+
+    // the server cache resumes TLS 1.2 session ids and is used by OpenSSL
+    // to reject replayed early data. Session tickets are enabled by default
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+    SSL_CTX_sess_set_cache_size(ctx, serverCacheSize);
+    SSL_CTX_set_session_id_context(ctx, sessionIdContext, sizeof(sessionIdContext) - 1);
+    if (earlyData)
+        SSL_CTX_set_max_early_data(ctx, maxEarlyData);
+}
+
+TlsContext::~TlsContext() = default;
+
+bool TlsContext::is_server() const noexcept {
+    return pimpl->server;
+}
+
+bool TlsContext::early_data() const noexcept {
+    return pimpl->earlyData;
+}
+
+TlsContext::Stats TlsContext::stats() const noexcept {
+    return { pimpl->handshakes.load(std::memory_order_relaxed),
+        pimpl->resumed.load(std::memory_order_relaxed),
+        pimpl->ktlsSend.load(std::memory_order_relaxed),
+        pimpl->ktlsReceive.load(std::memory_order_relaxed) };
+}
+
+void TlsContext::clear_sessions() {
+    {
+        std::lock_guard lock(pimpl->sessionMu);
+        for (auto& [peer, session] : pimpl->sessions)
+            SSL_SESSION_free(session);
+        pimpl->sessions.clear();
+    }
+    SSL_CTX_flush_sessions(pimpl->ctx, LONG_MAX);
+}
+
+bool TlsContext::enable_ktls() noexcept {
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+    SSL_CTX_set_options(pimpl->ctx, SSL_OP_ENABLE_KTLS);
+    return true;
+#else
+    return false;
+#endif
+}
+
+void* TlsContext::new_ssl(const std::string& peer) const {
+    const auto ssl = SSL_new(pimpl->ctx);
+    if (ssl == nullptr)
+        throw std::runtime_error("Failed to create ssl: " + std::to_string(ERR_get_error()));
+    if (!pimpl->server) {
+        SSL_set_ex_data(ssl, Impl::peer_index(), new std::string(peer));
+        std::lock_guard lock(pimpl->sessionMu);
+        const auto it = pimpl->sessions.find(peer);
+        if (it != pimpl->sessions.end())
+            SSL_set_session(ssl, it->second);
+    }
+    return ssl;
+}
+
+void TlsContext::handshake_done(void* ssl) const noexcept {
+    pimpl->handshakes.fetch_add(1, std::memory_order_relaxed);
+    if (SSL_session_reused(static_cast<SSL*>(ssl)))
+        pimpl->resumed.fetch_add(1, std::memory_order_relaxed);
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+    if (BIO_get_ktls_send(SSL_get_wbio(static_cast<SSL*>(ssl))))
+        pimpl->ktlsSend.fetch_add(1, std::memory_order_relaxed);
+    if (BIO_get_ktls_recv(SSL_get_rbio(static_cast<SSL*>(ssl))))
+        pimpl->ktlsReceive.fetch_add(1, std::memory_order_relaxed);
+#endif
+}
@@ -0,0 +1,245 @@
+#include <UrlEncoding.h>
+#include <HttpRequestFrame.h>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define URL_ENCODING_SSE2
+#if defined(__GNUC__)
+#define URL_ENCODING_AVX2
+#endif
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+/// @return table of the values of hex digits, with -1 for other characters
+constexpr std::array<int8_t, 256> make_hex_values() noexcept {
+    std::array<int8_t, 256> table{};
+    for (auto& value : table)
+        value = -1;
+    for (auto c = 0; c < 10; ++c)
+        table['0' + c] = static_cast<int8_t>(c);
+    for (auto c = 0; c < 6; ++c) {
+        table['a' + c] = static_cast<int8_t>(c + 10);
+        table['A' + c] = static_cast<int8_t>(c + 10);
+    }
+    return table;
+}
+
+constexpr auto hexValues = make_hex_values();
+
+/// @return the index of the lowest set bit of a non-zero mask
+inline unsigned lowest_set_bit(unsigned mask) noexcept {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return index;
+#else
+    return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+
+/// Finds the first `%`, or `+` if `plus`, in [begin, end)
+/// @return a pointer to the character or `end` if there is none
+const char* find_escape_scalar(const char* begin, const char* end, bool plus) noexcept {
+    for (; begin < end; ++begin) {
+        if (*begin == '%' || (plus && *begin == '+'))
+            return begin;
+    }
+    return end;
+}
+
+#ifdef URL_ENCODING_SSE2
+const char* find_escape_sse2(const char* begin, const char* end, bool plus) noexcept {
+    const auto percent = _mm_set1_epi8('%');
+    // searching for '%' twice is the same as not searching for '+'
+    const auto second = _mm_set1_epi8(plus ? '+' : '%');
+    for (; end - begin >= 16; begin += 16) {
+        const auto chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+        const auto mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_or_si128(
+            _mm_cmpeq_epi8(chars, percent), _mm_cmpeq_epi8(chars, second))));
+        if (mask != 0)
+            return begin + lowest_set_bit(mask);
+    }
+    return find_escape_scalar(begin, end, plus);
+}
+#endif
+
+#ifdef URL_ENCODING_AVX2
+__attribute__((target("avx2")))
+const char* find_escape_avx2(const char* begin, const char* end, bool plus) noexcept {
+    const auto percent = _mm256_set1_epi8('%');
+    const auto second = _mm256_set1_epi8(plus ? '+' : '%');
+    for (; end - begin >= 32; begin += 32) {
+        const auto chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+        const auto mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_or_si256(
+            _mm256_cmpeq_epi8(chars, percent), _mm256_cmpeq_epi8(chars, second))));
+        if (mask != 0)
+            return begin + lowest_set_bit(mask);
+    }
+    return find_escape_sse2(begin, end, plus);
+}
+#endif
+
+using find_escape_t = const char* (*)(const char*, const char*, bool) noexcept;
+
+/// @return the fastest implementation of `find_escape` supported by the cpu
+find_escape_t select_find_escape() noexcept {
+#if defined(URL_ENCODING_AVX2)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return &find_escape_avx2;
+#endif
+#if defined(URL_ENCODING_SSE2)
+    return &find_escape_sse2;
+#else
+    return &find_escape_scalar;
+#endif
+}
+
+size_t url_decode_in_place(char* data, size_t size, bool plusIsSpace) noexcept {
+    static const auto find_escape = select_find_escape();
+    /// bytes checked one at a time after an escape, since escapes are often close together
+    constexpr ptrdiff_t probeSize = 8;
+    const char* in = data;
+    const char* const end = data + size;
+    auto out = data;
+    while (in < end) {
+        const auto probeEnd = in + std::min(end - in, probeSize);
+        while (in < probeEnd && *in != '%' && !(plusIsSpace && *in == '+'))
+            *out++ = *in++;
+        if (in == probeEnd) {
+            const auto escape = find_escape(in, end, plusIsSpace);
+            const auto run = static_cast<size_t>(escape - in);
+            // until the first escape the data is already in place
+            if (out != in)
+                std::memmove(out, in, run);
+            out += run;
+            in = escape;
+            if (in == end)
+                break;
+        }
+        if (*in == '+') {
+            *out++ = ' ';
+            ++in;
+            continue;
+        }
+        const auto high = end - in >= 3 ? hexValues[static_cast<unsigned char>(in[1])] : -1;
+        const auto low = end - in >= 3 ? hexValues[static_cast<unsigned char>(in[2])] : -1;
+        if ((high | low) >= 0) {
+            *out++ = static_cast<char>(high << 4 | low);
+            in += 3;
+        }
+        else
+            *out++ = *in++;
+    }
+    return static_cast<size_t>(out - data);
+}
+
+/// @return table of the characters which are encoded as themselves
+constexpr std::array<bool, 256> make_unreserved(std::string_view symbols) noexcept {
+    std::array<bool, 256> table{};
+    for (auto c = '0'; c <= '9'; ++c)
+        table[static_cast<unsigned char>(c)] = true;
+    for (auto c = 'a'; c <= 'z'; ++c) {
+        table[static_cast<unsigned char>(c)] = true;
+        table[static_cast<unsigned char>(c - 'a' + 'A')] = true;
+    }
+    for (const auto c : symbols)
+        table[static_cast<unsigned char>(c)] = true;
+    return table;
+}
+
+/// characters a form keeps, from the HTML form encoding algorithm
+constexpr auto formUnreserved = make_unreserved("*-._");
+/// characters a URI keeps, from RFC 3986
+constexpr auto uriUnreserved = make_unreserved("-._~");
+
+void url_encode(std::string_view data, std::string& out, bool form) {
+    constexpr char digits[] = "0123456789ABCDEF";
+    const auto& unreserved = form ? formUnreserved : uriUnreserved;
+    out.reserve(out.size() + data.size());
+    auto runStart = data.begin();
+    for (auto it = data.begin(); it != data.end(); ++it) {
+        const auto c = static_cast<unsigned char>(*it);
+        if (unreserved[c])
+            continue;
+        out.append(runStart, it);
+        runStart = it + 1;
+        if (form && c == ' ')
+            out.push_back('+');
+        else {
+            const char escape[] = { '%', digits[c >> 4], digits[c & 0xf] };
+            out.append(escape, sizeof(escape));
+        }
+    }
+    out.append(runStart, data.end());
+}
+
+std::string url_encode(std::string_view data, bool form) {
+    std::string out;
+    url_encode(data, out, form);
+    return out;
+}
+
+std::string_view query_string(std::string_view path) noexcept {
+    const auto start = path.find('?');
+    if (start == std::string_view::npos)
+        return {};
+    const auto query = path.substr(start + 1);
+    return query.substr(0, query.find('#'));
+}
+
+void QueryParams::parse(std::string_view data) {
+    storage.assign(data.begin(), data.end());
+    parse_in_place(storage.data(), storage.size());
+}
+
+void QueryParams::parse_in_place(char* data, size_t size) {
+    params.clear();
+    const auto end = data + size;
+    while (data < end) {
+        const auto paramEnd = std::find(data, end, '&');
+        if (paramEnd != data) {
+            const auto keyEnd = std::find(data, paramEnd, '=');
+            const auto valueStart = keyEnd == paramEnd ? paramEnd : keyEnd + 1;
+            const auto keySize = url_decode_in_place(data, keyEnd - data);
+            const auto valueSize = url_decode_in_place(valueStart, paramEnd - valueStart);
+            params.push_back({ { data, keySize }, { valueStart, valueSize } });
+        }
+        data = paramEnd == end ? end : paramEnd + 1;
+    }
+}
+
+void QueryParams::parse_query(const HttpRequestFrame& frame) {
+    parse(query_string(frame.path));
+}
+
+bool QueryParams::parse_form(HttpRequestFrame& frame) {
+    constexpr std::string_view formType = "application/x-www-form-urlencoded";
+    const auto type = frame.headers().find(KnownHeader::ContentType);
+    // the media type may be followed by parameters such as a charset
+    const auto mediaType = type == nullptr ? std::string_view()
+        : std::string_view(*type).substr(0, type->find_first_of("; \t"));
+    if (!detail::iequals(mediaType, formType)) {
+        params.clear();
+        return false;
+    }
+    parse_in_place(frame.content.data(), frame.content.size());
+    return true;
+}
+
+std::optional<std::string_view> QueryParams::find(std::string_view key) const noexcept {
+    const auto it = std::find_if(params.begin(), params.end(),
+        [key](const Param& param) { return param.key == key; });
+    if (it == params.end())
+        return {};
+    return it->value;
+}
+
+void QueryParams::clear() noexcept {
+    params.clear();
+}
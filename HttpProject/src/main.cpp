@@ -1,5 +1,129 @@
+#include <HttpServer.h>
+#include <ResponseCache.h>
+#include <StaticFiles.h>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+/// Prints how to run the server
+void print_usage(const char* program) {
+    std::cerr << "Usage: " << program << " [options]\n"
+        << "  --port <port>      port to listen on, 8080 by default\n"
+        << "  --threads <count>  worker threads, one per cpu by default\n"
+        << "  --pin              pin each worker thread to its own cpu\n"
+        << "  --max-requests <n> requests per connection, 1000 by default, 0 for no limit\n"
+        << "  --idle-timeout <s> seconds before an idle connection is closed, 30 by default\n"
+        << "  --cert <file>      certificate to serve HTTPS with, requires --key\n"
+        << "  --key <file>       private key of the certificate\n"
+        << "  --ktls             let the kernel encrypt HTTPS connections when it can\n"
+        << "  --root <dir>       serve the files in a directory\n"
+        << "  --cache <mb>       cache responses in up to this many megabytes\n"
+        << "  --cache-ttl <s>    seconds a response is served from the cache, 60 by default\n"
+        << "  --metrics <path>   path serving Prometheus metrics, /metrics by default\n"
+        << "  --no-metrics       pass every path to the handler\n";
+}
+
+/// Answers every request with a short description of it
+void default_handler(const HttpRequestFrame& request, HttpResponseFrame& response) {
+    response[KnownHeader::ContentType] = "text/plain";
+    response.content.append(protocol_name(request.protocol));
+    response.content += ' ';
+    response.content += request.path;
+    response.content += '\n';
+}
 
 int main(int argc, char ** argv) {
     // argv[0] is the path to executable, rest of arguments follow
+    ServerOptions options;
+    options.metricsPath = "/metrics";
+    const char* cert = nullptr;
+    const char* key = nullptr;
+    const char* root = nullptr;
+    auto ktls = false;
+    size_t cacheMegabytes = 0;
+    CacheOptions cacheOptions;
+    try {
+        for (auto i = 1; i < argc; ++i) {
+            const auto has_value = i + 1 < argc;
+            if (std::strcmp(argv[i], "--port") == 0 && has_value)
+                options.port = static_cast<port_t>(std::stoul(argv[++i]));
+            else if (std::strcmp(argv[i], "--threads") == 0 && has_value)
+                options.threads = static_cast<unsigned>(std::stoul(argv[++i]));
+            else if (std::strcmp(argv[i], "--pin") == 0)
+                options.pinThreads = true;
+            else if (std::strcmp(argv[i], "--max-requests") == 0 && has_value)
+                options.maxRequestsPerConnection = static_cast<unsigned>(std::stoul(argv[++i]));
+            else if (std::strcmp(argv[i], "--idle-timeout") == 0 && has_value)
+                options.idleTimeout = std::chrono::seconds(std::stoul(argv[++i]));
+            else if (std::strcmp(argv[i], "--cert") == 0 && has_value)
+                cert = argv[++i];
+            else if (std::strcmp(argv[i], "--key") == 0 && has_value)
+                key = argv[++i];
+            else if (std::strcmp(argv[i], "--ktls") == 0)
+                ktls = true;
+            else if (std::strcmp(argv[i], "--root") == 0 && has_value)
+                root = argv[++i];
+            else if (std::strcmp(argv[i], "--cache") == 0 && has_value)
+                cacheMegabytes = std::stoul(argv[++i]);
+            else if (std::strcmp(argv[i], "--cache-ttl") == 0 && has_value)
+                cacheOptions.ttl = std::chrono::seconds(std::stoul(argv[++i]));
+            else if (std::strcmp(argv[i], "--metrics") == 0 && has_value)
+                options.metricsPath = argv[++i];
+            else if (std::strcmp(argv[i], "--no-metrics") == 0)
+                options.metricsPath.clear();
+            else
+                throw std::invalid_argument(argv[i]);
+        }
+        if ((cert == nullptr) != (key == nullptr))
+            throw std::invalid_argument("--cert and --key must be given together");
+    }
+    catch (const std::logic_error& e) {
+        std::cerr << "Invalid argument: " << e.what() << '\n';
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    try {
+        if (cert != nullptr) {
+            options.tls = std::make_shared<TlsContext>(cert, key);
+            if (ktls && !options.tls->enable_ktls())
+                std::cerr << "OpenSSL was built without kTLS, encrypting in user space\n";
+        }
+#ifndef WINDOWS
+        // the workers inherit the mask, so only the main thread handles these signals
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGTERM);
+        pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+        // a write to a closed connection should fail instead of ending the process
+        std::signal(SIGPIPE, SIG_IGN);
+#endif
+        if (cacheMegabytes > 0) {
+            cacheOptions.maxBytes = cacheMegabytes * 1024 * 1024;
+            options.cache = std::make_shared<ResponseCache>(std::move(cacheOptions));
+        }
+        HttpHandler handler = &default_handler;
+        if (root != nullptr)
+            handler = StaticFiles(root);
+        HttpServer server(options, std::move(handler));
+        server.start();
+        std::cout << "Listening on port " << options.port << " with "
+            << server.thread_count() << " threads" << std::endl;
+#ifndef WINDOWS
+        int signal;
+        sigwait(&signals, &signal);
+#else
+        std::cin.get();
+#endif
+        server.stop();
+    }
+    catch (const std::runtime_error& e) {
+        std::cerr << e.what() << '\n';
+        return EXIT_FAILURE;
+    }
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,154 @@
+/// \file Tests reading messages from and coalescing writes to a buffered port
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "MockPort.h"
+#include <BufferedPort.h>
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+using namespace testing;
+using namespace std::chrono_literals;
+
+class BufferedPortTest : public testing::Test {
+protected:
+    NiceMock<MockPort> port;
+    /// data the port hasn't returned yet
+    std::string unread;
+    /// the data of every write to the port
+    std::vector<std::string> writes;
+    /// amount of calls which read from the port
+    size_t reads = 0;
+
+    std::default_random_engine randEng{ std::random_device{}() };
+    std::uniform_int_distribution<size_t> sizeGenerator{ 1, 50 };
+public:
+    BufferedPortTest() {
+        // returns the unread data in pieces of random size, at least `minBytes` of it
+        ON_CALL(port, read_into(_, _, _)).WillByDefault(
+            [this](char* buffer, size_t size, size_t minBytes) {
+                if (unread.empty())
+                    throw std::runtime_error("closed");
+                ++reads;
+                const auto read = std::min({ size, unread.size(),
+                    std::max(minBytes, sizeGenerator(randEng)) });
+                std::copy_n(unread.begin(), read, buffer);
+                unread.erase(0, read);
+                return read;
+            });
+        ON_CALL(port, write(_)).WillByDefault([this](std::string_view data) {
+            writes.emplace_back(data);
+            });
+    }
+};
+
+TEST_F(BufferedPortTest, readsUntilDelimiter) {
+    const std::string body(1000, 'b');
+    unread = "GET / HTTP/1.1\r\nContent-Length: 1000\r\n\r\n" + body +
+        "GET /next HTTP/1.1\r\n\r\nextra";
+    BufferedPort buffered(port, { .readBufferSize = 64 });
+    ASSERT_EQ(buffered.read_until("\r\n\r\n"), "GET / HTTP/1.1\r\nContent-Length: 1000\r\n\r\n");
+    ASSERT_EQ(buffered.read_exact(body.size()), body);
+    ASSERT_EQ(buffered.read_until("\r\n\r\n"), "GET /next HTTP/1.1\r\n\r\n");
+    // peeking doesn't consume the data
+    ASSERT_EQ(buffered.peek(5), "extra");
+    ASSERT_EQ(buffered.available(), 5);
+    char data[10];
+    ASSERT_EQ(buffered.read_into(data, sizeof(data)), 5);
+    ASSERT_EQ(std::string_view(data, 5), "extra");
+    ASSERT_THROW(buffered.read_until("\r\n"), std::runtime_error);
+}
+
+TEST_F(BufferedPortTest, limitsMessageSize) {
+    unread = std::string(200, 'x') + "\r\n";
+    BufferedPort buffered(port, { .readBufferSize = 16, .maxMessageSize = 100 });
+    ASSERT_THROW(buffered.read_until("\r\n"), std::runtime_error);
+    ASSERT_THROW(buffered.read_exact(101), std::invalid_argument);
+    ASSERT_THROW(buffered.peek(101), std::invalid_argument);
+    // the data stays readable
+    ASSERT_EQ(buffered.read_exact(100), std::string(100, 'x'));
+}
+
+TEST_F(BufferedPortTest, readsLargeDataDirectly) {
+    unread = std::string(10000, 'x');
+    BufferedPort buffered(port, { .readBufferSize = 100 });
+    ASSERT_EQ(buffered.peek(1).front(), 'x');
+    std::vector<char> data(unread.size() + 1);
+    const auto read = buffered.read_into(data.data(), data.size(), 9000);
+    ASSERT_GE(read, 9000);
+    ASSERT_EQ(static_cast<size_t>(std::count(data.begin(), data.begin() + read, 'x')), read);
+    // only the peek went through the read buffer
+    ASSERT_EQ(reads, 2);
+}
+
+TEST_F(BufferedPortTest, coalescesWrites) {
+    BufferedPort buffered(port, { .flushSize = 100 });
+    buffered.write("HTTP/1.1 200 OK\r\n");
+    buffered.write("Content-Length: 5\r\n\r\n");
+    buffered.write("hello");
+    ASSERT_THAT(writes, IsEmpty());
+    ASSERT_EQ(buffered.pending(), 43);
+    buffered.flush();
+    ASSERT_THAT(writes, ElementsAre("HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nhello"));
+    ASSERT_EQ(buffered.pending(), 0);
+
+    // reaching the flush size sends the buffered output along with the write
+    writes.clear();
+    std::string expected;
+    for (auto i = 0; i < 10; ++i) {
+        const std::string data(15, static_cast<char>('a' + i));
+        buffered.write(data);
+        if (i < 7)
+            expected += data;
+    }
+    ASSERT_EQ(std::accumulate(writes.begin(), writes.end(), std::string()), expected);
+    ASSERT_EQ(buffered.pending(), 45);
+
+    // a large write goes straight through once the output is flushed
+    buffered.flush();
+    ASSERT_EQ(buffered.pending(), 0);
+    writes.clear();
+    buffered.write(std::string(500, 'z'));
+    ASSERT_THAT(writes, ElementsAre(std::string(500, 'z')));
+}
+
+TEST_F(BufferedPortTest, corks) {
+    BufferedPort buffered(port, { .flushSize = 10 });
+    buffered.cork();
+    buffered.cork();
+    for (auto i = 0; i < 10; ++i)
+        buffered.write("0123456789");
+    buffered.uncork();
+    ASSERT_THAT(writes, IsEmpty());
+    buffered.uncork();
+    ASSERT_EQ(writes.size(), 1);
+    ASSERT_EQ(writes[0].size(), 100);
+}
+
+TEST_F(BufferedPortTest, flushesByDeadline) {
+    BufferedPort buffered(port, { .flushDelay = std::chrono::microseconds(20ms) });
+    ASSERT_FALSE(buffered.flush_deadline());
+    const auto start = BufferedPort::clock::now();
+    buffered.write("first");
+    ASSERT_FALSE(buffered.flush_if_due());
+    ASSERT_GE(*buffered.flush_deadline(), start + 20ms);
+    std::this_thread::sleep_until(*buffered.flush_deadline());
+    // the next write sends the output which waited
+    buffered.write(" second");
+    ASSERT_THAT(writes, ElementsAre("first second"));
+    ASSERT_FALSE(buffered.flush_deadline());
+}
+
+TEST_F(BufferedPortTest, flushesBeforeBlockingRead) {
+    unread = "response\r\n";
+    BufferedPort buffered(port);
+    buffered.write("request\r\n");
+    {
+        InSequence sequence;
+        EXPECT_CALL(port, write(_));
+        EXPECT_CALL(port, read_into(_, _, _)).Times(AtLeast(1));
+    }
+    ASSERT_EQ(buffered.read_until("\r\n"), "response\r\n");
+}
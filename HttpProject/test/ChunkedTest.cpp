@@ -2,6 +2,8 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include "MockPort.h"
+#include <ChunkedCodec.h>
+#include <algorithm>
 #include <sstream>
 #include <random>
 using namespace testing;
@@ -52,8 +54,14 @@ public:
             ss << "\r\n";
         } while (rand() % 2);
         ss << "0\r\n\r\n";
-        return { std::istream_iterator<char>(ss), 
-            std::istream_iterator<char>() };
+        const auto message = ss.str();
+        return { message.begin(), message.end() };
+    }
+
+    /// @return the chunked body of a message from `getMessage`
+    static std::string_view body(const std::vector<char>& message) {
+        const std::string_view view(message.data(), message.size());
+        return view.substr(view.find("\r\n\r\n") + 4);
     }
 };
 
@@ -62,17 +70,146 @@ public:
 * @param str a non-owning view of the message being sent
 * @return true if `str` is chunked
 */
-bool isMsgChunked(std::string_view) {
-    //TODO:
-    return true;
+bool isMsgChunked(std::string_view str) {
+    ChunkedDecoder decoder;
+    while (!str.empty() && decoder.status() == ChunkedDecoder::Status::Incomplete)
+        decoder.decode(str);
+    return str.empty() && decoder.status() == ChunkedDecoder::Status::Done;
+}
+
+/// @return the payload of a chunked body
+std::string decodeAll(std::string_view str) {
+    ChunkedDecoder decoder;
+    std::string payload;
+    while (!str.empty() && decoder.status() == ChunkedDecoder::Status::Incomplete)
+        payload.append(decoder.decode(str));
+    return payload;
 }
 
 TEST_F(ChunkedMockTestFixture, parseChunked) {
-    ASSERT_THAT(port.read(), Not(IsEmpty()));
-    //TODO
+    for (auto i = 0; i < 100; ++i) {
+        const auto message = port.read();
+        ASSERT_THAT(message, Not(IsEmpty()));
+        auto data = body(message);
+
+        // the body arrives in pieces which split chunks at any point
+        ChunkedDecoder decoder;
+        std::vector<char> payload;
+        while (!data.empty()) {
+            auto piece = data.substr(0, sizeGenerator(randEng) / 8 + 1);
+            data.remove_prefix(piece.size());
+            while (!piece.empty()) {
+                const auto slice = decoder.decode(piece);
+                payload.insert(payload.end(), slice.begin(), slice.end());
+                ASSERT_NE(decoder.status(), ChunkedDecoder::Status::Error);
+            }
+        }
+        ASSERT_EQ(decoder.status(), ChunkedDecoder::Status::Done);
+        ASSERT_THAT(payload, ContainerEq(lastReadPayload));
+    }
+}
+
+TEST_F(ChunkedMockTestFixture, readChunked) {
+    const auto message = port.read();
+    const auto data = body(message);
+    const auto next = std::string_view("GET / HTTP/1.1\r\n\r\n");
+    std::string unread = std::string(data.substr(100)).append(next);
+    EXPECT_CALL(port, read_into(_, _, _)).WillRepeatedly(
+        [this, &unread](char* buffer, size_t size, size_t) {
+            const auto read = std::min<size_t>(
+                { size, unread.size(), static_cast<size_t>(sizeGenerator(randEng)) });
+            std::copy_n(unread.begin(), read, buffer);
+            unread.erase(0, read);
+            return read;
+        });
+
+    // the start of the body was read with the head
+    ChunkedReader reader(port, data.substr(0, 100), 1024);
+    std::vector<char> payload;
+    for (auto slice = reader.read(); !slice.empty(); slice = reader.read()) {
+        ASSERT_LE(slice.size(), 1024);
+        payload.insert(payload.end(), slice.begin(), slice.end());
+    }
+    ASSERT_TRUE(reader.done());
+    ASSERT_THAT(payload, ContainerEq(lastReadPayload));
+    ASSERT_EQ(std::string(reader.leftover()).append(unread), next);
+}
+
+TEST(ChunkedDecoderTest, extensionsAndTrailers) {
+    ASSERT_EQ(decodeAll("5;name=value\r\nhello\r\n6 ; x\r\n world\r\n0\r\n"
+        "Expires: never\r\nX-Trailer: 1\r\n\r\n"), "hello world");
+    ASSERT_TRUE(isMsgChunked("A\r\n0123456789\r\n0\r\n\r\n"));
+    ASSERT_FALSE(isMsgChunked("A\r\n0123456789\r\n0\r\n\r\nextra"));
+    ASSERT_FALSE(isMsgChunked("A\r\n0123456789\r\n"));
+}
+
+TEST(ChunkedDecoderTest, malformed) {
+    const std::pair<std::string, ChunkedDecoder::Error> bodies[] = {
+        { "\r\n", ChunkedDecoder::Error::BadSize },
+        { "g\r\n", ChunkedDecoder::Error::BadSize },
+        { "-1\r\n", ChunkedDecoder::Error::BadSize },
+        { "10000000000000000\r\n", ChunkedDecoder::Error::BadSize },
+        { "5\r\nhello0\r\n\r\n", ChunkedDecoder::Error::BadTerminator },
+        { "5\rhello\r\n0\r\n\r\n", ChunkedDecoder::Error::BadTerminator },
+        { "0\r\n\r0", ChunkedDecoder::Error::BadTerminator },
+        { "1;" + std::string(10000, 'x'), ChunkedDecoder::Error::TooLarge },
+    };
+    for (const auto& [body, error] : bodies) {
+        std::string_view str = body;
+        ChunkedDecoder decoder;
+        while (!str.empty() && decoder.status() == ChunkedDecoder::Status::Incomplete)
+            decoder.decode(str);
+        ASSERT_EQ(decoder.status(), ChunkedDecoder::Status::Error);
+        ASSERT_EQ(decoder.error(), error);
+        // the decoder stops at the error
+        ASSERT_THAT(str, Not(IsEmpty()));
+    }
 }
 
 TEST_F(ChunkedMockTestFixture, writeChunked) {
-    EXPECT_CALL(port, write(Truly(isMsgChunked)));
-    port.write("TODO");
+    std::string written;
+    EXPECT_CALL(port, write(_)).WillRepeatedly([&written](std::string_view data) {
+        // every write is a whole chunk
+        ASSERT_THAT(data, EndsWith("\r\n"));
+        written.append(data);
+        });
+    std::string payload;
+    {
+        ChunkedWriter writer(port, 1000);
+        for (auto i = 0; i < 50; ++i) {
+            const std::string data(static_cast<size_t>(sizeGenerator(randEng)),
+                static_cast<char>(asciiGenerator(randEng)));
+            writer.write(data);
+            payload += data;
+        }
+        writer.finish();
+    }
+    ASSERT_TRUE(isMsgChunked(written));
+    ASSERT_EQ(decodeAll(written), payload);
+    // every chunk but the last is full
+    ASSERT_THAT(written, StartsWith("3e8\r\n"));
+}
+
+TEST_F(ChunkedMockTestFixture, writeFromProducer) {
+    constexpr size_t bodySize = 100000;
+    std::vector<size_t> writeSizes;
+    std::string written;
+    EXPECT_CALL(port, write(_)).WillRepeatedly([&](std::string_view data) {
+        writeSizes.push_back(data.size());
+        written.append(data);
+        });
+    ChunkedWriter writer(port);
+    size_t produced = 0;
+    writer.write_from([&produced](char* buffer, size_t size) {
+        size = std::min(size, bodySize - produced);
+        std::fill_n(buffer, size, 'x');
+        produced += size;
+        return size;
+        });
+    writer.finish();
+
+    ASSERT_EQ(decodeAll(written), std::string(bodySize, 'x'));
+    // full chunks, including their framing, are the size of a TLS record
+    ASSERT_EQ(writeSizes.size(), bodySize / ChunkedWriter::recordChunkSize + 2);
+    ASSERT_THAT(std::vector(writeSizes.begin(), writeSizes.end() - 2), Each(16384));
 }
\ No newline at end of file
@@ -0,0 +1,297 @@
+/// \file Tests negotiating content codings and compressing response bodies
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "MockPort.h"
+#include "TestServer.h"
+#include <ContentEncoding.h>
+#include <HttpServer.h>
+#include <MappedFile.h>
+#include <ResponseCache.h>
+#include <StaticFiles.h>
+#include <Socket.h>
+#include <Address.h>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <zlib.h>
+using namespace testing;
+namespace fs = std::filesystem;
+
+/// @return the decompressed data of a gzip or zlib stream
+std::string inflateAll(std::string_view data) {
+    z_stream stream{};
+    // 32 more window bits detects the gzip and zlib wrappers
+    if (inflateInit2(&stream, 15 + 32) != Z_OK)
+        throw std::runtime_error("inflateInit2 failed");
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    stream.avail_in = static_cast<uInt>(data.size());
+    std::string out;
+    int ret;
+    do {
+        char buffer[4096];
+        stream.next_out = reinterpret_cast<Bytef*>(buffer);
+        stream.avail_out = sizeof(buffer);
+        ret = inflate(&stream, Z_NO_FLUSH);
+        out.append(buffer, sizeof(buffer) - stream.avail_out);
+    } while (ret == Z_OK);
+    inflateEnd(&stream);
+    if (ret != Z_STREAM_END)
+        throw std::runtime_error("stream is incomplete or corrupt");
+    return out;
+}
+
+/// @return text which compresses well
+std::string makeText(size_t size) {
+    std::mt19937 rng(7);
+    const std::string_view words[] = { "request ", "response ", "header ", "body ", "port " };
+    std::string text;
+    while (text.size() < size)
+        text += words[rng() % 5];
+    text.resize(size);
+    return text;
+}
+
+TEST(ContentCodingTest, negotiates) {
+    ASSERT_EQ(negotiate_coding("gzip, deflate, br"), ContentCoding::Gzip);
+    ASSERT_EQ(negotiate_coding("deflate, gzip"), ContentCoding::Gzip);
+    ASSERT_EQ(negotiate_coding("deflate"), ContentCoding::Deflate);
+    ASSERT_EQ(negotiate_coding("gzip;q=0.5, deflate;q=0.8"), ContentCoding::Deflate);
+    ASSERT_EQ(negotiate_coding(" GZIP ; q=1.0 "), ContentCoding::Gzip);
+    ASSERT_EQ(negotiate_coding("x-gzip"), ContentCoding::Gzip);
+    ASSERT_EQ(negotiate_coding("*"), ContentCoding::Gzip);
+    ASSERT_EQ(negotiate_coding("gzip;q=0, *"), ContentCoding::Deflate);
+    ASSERT_EQ(negotiate_coding("gzip;q=0, deflate;q=0"), ContentCoding::Identity);
+    ASSERT_EQ(negotiate_coding("br, identity"), ContentCoding::Identity);
+    ASSERT_EQ(negotiate_coding("gzip;q=2"), ContentCoding::Identity);
+    ASSERT_EQ(negotiate_coding(""), ContentCoding::Identity);
+    ASSERT_EQ(coding_name(ContentCoding::Deflate), "deflate");
+
+    ASSERT_TRUE(compressible_type("text/html; charset=utf-8"));
+    ASSERT_TRUE(compressible_type("application/json"));
+    ASSERT_TRUE(compressible_type("image/svg+xml"));
+    ASSERT_FALSE(compressible_type("image/png"));
+    ASSERT_FALSE(compressible_type("application/octet-stream"));
+}
+
+TEST(CompressorTest, compressesBodies) {
+    const auto text = makeText(100000);
+    for (const auto coding : { ContentCoding::Gzip, ContentCoding::Deflate }) {
+        std::string compressed;
+        Compressor(coding, 6).compress_all(text, compressed);
+        ASSERT_LT(compressed.size(), text.size() / 4);
+        ASSERT_EQ(inflateAll(compressed), text);
+        // gzip streams start with its magic number, zlib streams with 0x78
+        ASSERT_EQ(static_cast<unsigned char>(compressed[0]),
+            coding == ContentCoding::Gzip ? 0x1f : 0x78);
+
+        // the thread's state is reset for the next compressor, at another level
+        std::string fast;
+        Compressor(coding, 1).compress_all(text, fast);
+        ASSERT_EQ(inflateAll(fast), text);
+    }
+    ASSERT_THROW(Compressor(ContentCoding::Identity), std::invalid_argument);
+    ASSERT_THROW(Compressor(ContentCoding::Gzip, 0), std::invalid_argument);
+}
+
+TEST(CompressorTest, streamsConcurrently) {
+    const auto first = makeText(50000), second = makeText(20000) + "second";
+    // the second compressor gets its own state while the first uses the thread's
+    Compressor a(ContentCoding::Gzip), b(ContentCoding::Gzip);
+    std::string outA, outB;
+    char buffer[1000];
+    std::string_view inA = first, inB = second;
+    while (!inA.empty() || !inB.empty()) {
+        outA.append(buffer, a.compress(inA, buffer, sizeof(buffer), Compressor::Flush::None));
+        outB.append(buffer, b.compress(inB, buffer, sizeof(buffer), Compressor::Flush::None));
+    }
+    for (auto [compressor, out] : { std::pair(&a, &outA), std::pair(&b, &outB) }) {
+        std::string_view empty;
+        while (!compressor->done())
+            out->append(buffer, compressor->compress(empty, buffer, sizeof(buffer),
+                Compressor::Flush::Finish));
+    }
+    ASSERT_EQ(inflateAll(outA), first);
+    ASSERT_EQ(inflateAll(outB), second);
+}
+
+TEST(CompressorTest, writesChunked) {
+    NiceMock<MockPort> port;
+    std::string written;
+    ON_CALL(port, write(_)).WillByDefault([&written](std::string_view data) {
+        written.append(data);
+        });
+    const auto text = makeText(200000);
+    CompressedChunkedWriter writer(port, ContentCoding::Gzip, 6, 1000);
+    for (size_t i = 0; i < text.size(); i += 777)
+        writer.write(std::string_view(text).substr(i, 777));
+    writer.finish();
+
+    // decodes the chunks
+    std::string_view input = written;
+    ChunkedDecoder decoder;
+    std::string compressed;
+    while (decoder.status() == ChunkedDecoder::Status::Incomplete && !input.empty())
+        compressed.append(decoder.decode(input));
+    ASSERT_EQ(decoder.status(), ChunkedDecoder::Status::Done);
+    ASSERT_EQ(inflateAll(compressed), text);
+}
+
+TEST(CompressorTest, flushesChunked) {
+    NiceMock<MockPort> port;
+    std::string written;
+    ON_CALL(port, write(_)).WillByDefault([&written](std::string_view data) {
+        written.append(data);
+        });
+    CompressedChunkedWriter writer(port, ContentCoding::Deflate);
+    writer.write("first part");
+    ASSERT_THAT(written, IsEmpty());
+    // what was flushed can be decompressed before the stream ends
+    writer.flush();
+    std::string_view input = written;
+    ChunkedDecoder decoder;
+    std::string compressed;
+    while (!input.empty())
+        compressed.append(decoder.decode(input));
+    z_stream stream{};
+    inflateInit(&stream);
+    stream.next_in = reinterpret_cast<Bytef*>(compressed.data());
+    stream.avail_in = static_cast<uInt>(compressed.size());
+    char buffer[100];
+    stream.next_out = reinterpret_cast<Bytef*>(buffer);
+    stream.avail_out = sizeof(buffer);
+    ASSERT_EQ(inflate(&stream, Z_SYNC_FLUSH), Z_OK);
+    inflateEnd(&stream);
+    ASSERT_EQ(std::string_view(buffer, sizeof(buffer) - stream.avail_out), "first part");
+}
+
+class CompressedFilesTest : public testing::Test {
+protected:
+    fs::path root = fs::temp_directory_path() /
+        ("ContentEncodingTest" + std::to_string(std::random_device()()));
+
+    void writeFile(const fs::path& path, std::string_view data) {
+        std::ofstream(path, std::ios::binary).write(data.data(), data.size());
+    }
+public:
+    CompressedFilesTest() {
+        fs::create_directories(root);
+    }
+
+    ~CompressedFilesTest() {
+        fs::remove_all(root);
+    }
+};
+
+TEST_F(CompressedFilesTest, keepsCopies) {
+    const auto text = makeText(10000);
+    writeFile(root / "a.txt", text);
+    auto file = std::make_shared<const MappedFile>((root / "a.txt").string());
+    CompressedFiles files(4000);
+    const auto first = files.get(file, 0, file->size(), ContentCoding::Gzip, 6);
+    ASSERT_EQ(inflateAll(*first), text);
+    ASSERT_EQ(files.get(file, 0, file->size(), ContentCoding::Gzip, 6), first);
+    // parts and codings have their own copies
+    const auto part = files.get(file, 100, 200, ContentCoding::Deflate, 6);
+    ASSERT_EQ(inflateAll(*part), text.substr(100, 200));
+    ASSERT_EQ(files.get(file, 100, 200, ContentCoding::Deflate, 6), part);
+
+    // a new mapping of the file gets a new copy
+    file = std::make_shared<const MappedFile>((root / "a.txt").string());
+    ASSERT_NE(files.get(file, 0, file->size(), ContentCoding::Gzip, 6), first);
+
+    // copies beyond the limit push out the oldest
+    CompressedFiles limited(first->size() + 1);
+    const auto kept = limited.get(file, 0, file->size(), ContentCoding::Gzip, 6);
+    ASSERT_EQ(limited.get(file, 0, file->size(), ContentCoding::Gzip, 6), kept);
+    limited.get(file, 100, 200, ContentCoding::Deflate, 6);
+    ASSERT_NE(limited.get(file, 0, file->size(), ContentCoding::Gzip, 6), kept);
+}
+
+/// Sends a request and reads its response, which must have a Content-Length
+Response exchange(Port& port, std::string_view request) {
+    port.write(request);
+    return readResponse(port);
+}
+
+TEST_F(CompressedFilesTest, serverCompressesResponses) {
+    const auto text = makeText(50000);
+    writeFile(root / "page.html", text);
+    writeFile(root / "small.txt", "too small to compress");
+    writeFile(root / "image.png", text);
+    ServerOptions options;
+    options.port = nextPort();
+    options.threads = 1;
+    options.compression.enabled = true;
+    options.cache = std::make_shared<ResponseCache>();
+    StaticFiles files(root.string());
+    HttpServer server(options, [&files](const HttpRequestFrame& request, HttpResponseFrame& response) {
+        if (request.path == "/generated") {
+            response[KnownHeader::ContentType] = "application/json";
+            response["ETag"] = "\"v1\"";
+            response.content = "[" + makeText(5000) + "]";
+            return;
+        }
+        files(request, response);
+        });
+    server.start();
+    TcpSocket client(::Address("127.0.0.1", options.port));
+
+    // ranges are of the file as it is, so they aren't compressed
+    const auto range = exchange(client,
+        "GET /page.html HTTP/1.1\r\nAccept-Encoding: gzip\r\nRange: bytes=0-99\r\n\r\n");
+    ASSERT_EQ(range.body, text.substr(0, 100));
+
+    const std::string gzipRequest = "GET /page.html HTTP/1.1\r\nAccept-Encoding: gzip, deflate\r\n\r\n";
+    Response gzip;
+    for (auto i = 0; i < 2; ++i) {
+        gzip = ::exchange(client, gzipRequest);
+        ASSERT_EQ(gzip.header("Content-Encoding"), "gzip");
+        ASSERT_EQ(gzip.header("Vary"), "Accept-Encoding");
+        ASSERT_EQ(gzip.header("Accept-Ranges"), "");
+        ASSERT_EQ(inflateAll(gzip.body), text);
+    }
+    // the compressed copy is batched with a pipelined HEAD request, which gets the same head
+    client.write(gzipRequest + "HEAD /page.html HTTP/1.1\r\nAccept-Encoding: gzip, deflate\r\n\r\n");
+    std::string pipelined;
+    while (pipelined.size() < 2 * gzip.head.size() + gzip.body.size()) {
+        const auto read = client.read(0);
+        pipelined.append(read.begin(), read.end());
+    }
+    ASSERT_EQ(pipelined, gzip.head + gzip.body + gzip.head);
+    const auto deflate = exchange(client, "GET /page.html HTTP/1.1\r\nAccept-Encoding: deflate\r\n\r\n");
+    ASSERT_EQ(deflate.header("Content-Encoding"), "deflate");
+    ASSERT_EQ(inflateAll(deflate.body), text);
+    const auto identity = exchange(client, "GET /page.html HTTP/1.1\r\n\r\n");
+    ASSERT_EQ(identity.header("Content-Encoding"), "");
+    ASSERT_EQ(identity.header("Vary"), "Accept-Encoding");
+    ASSERT_EQ(identity.body, text);
+
+    // small bodies and binary types are sent as they are
+    const auto small = exchange(client, "GET /small.txt HTTP/1.1\r\nAccept-Encoding: gzip\r\n\r\n");
+    ASSERT_EQ(small.body, "too small to compress");
+    const auto image = exchange(client, "GET /image.png HTTP/1.1\r\nAccept-Encoding: gzip\r\n\r\n");
+    ASSERT_EQ(image.body, text);
+
+    // the tag of the compressed representation is matched before anything is compressed
+    const auto deflateNotModified = exchange(client,
+        "GET /generated HTTP/1.1\r\nAccept-Encoding: deflate\r\nIf-None-Match: \"v1-deflate\"\r\n\r\n");
+    ASSERT_EQ(deflateNotModified.head.rfind("HTTP/1.1 304 ", 0), 0);
+    ASSERT_EQ(deflateNotModified.header("ETag"), "\"v1-deflate\"");
+    ASSERT_EQ(deflateNotModified.header("Content-Length"), "");
+
+    // handler responses get a tag of their own per coding, and are cached per coding
+    const auto generated = exchange(client, "GET /generated HTTP/1.1\r\nAccept-Encoding: gzip\r\n\r\n");
+    ASSERT_EQ(generated.header("ETag"), "\"v1-gzip\"");
+    ASSERT_EQ(inflateAll(generated.body), "[" + makeText(5000) + "]");
+    const auto cached = exchange(client, "GET /generated HTTP/1.1\r\nAccept-Encoding: gzip\r\n\r\n");
+    ASSERT_EQ(cached.body, generated.body);
+    const auto plain = exchange(client, "GET /generated HTTP/1.1\r\n\r\n");
+    ASSERT_EQ(plain.header("ETag"), "\"v1\"");
+    ASSERT_EQ(plain.body, "[" + makeText(5000) + "]");
+    const auto notModified = exchange(client,
+        "GET /generated HTTP/1.1\r\nAccept-Encoding: gzip\r\nIf-None-Match: \"v1-gzip\"\r\n\r\n");
+    ASSERT_EQ(notModified.head.rfind("HTTP/1.1 304 ", 0), 0);
+    ASSERT_GE(options.cache->stats().hits, 2);
+}
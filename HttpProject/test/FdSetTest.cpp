@@ -0,0 +1,147 @@
+/// \file Tests waiting for activity on sets of file descriptors
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <FdSet.h>
+#include <Networking.h>
+#include <array>
+#include <cstring>
+#include <vector>
+using namespace std::chrono_literals;
+
+/// A connected pair of unix sockets which are closed on destruction
+struct SockPair {
+    std::array<socket_t, 2> fds;
+
+    SockPair() {
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds.data()) != 0)
+            throw std::runtime_error("Could not create socket pair");
+    }
+
+    ~SockPair() {
+        close(fds[0]);
+        close(fds[1]);
+    }
+
+    SockPair(const SockPair&) = delete;
+    SockPair& operator=(const SockPair&) = delete;
+
+    /// Sends a message from the second socket to the first
+    void send_to_first(const char* msg = "hello") {
+        ASSERT_GT(::write(fds[1], msg, strlen(msg)), 0);
+    }
+
+    /// Reads all pending data on the first socket
+    void drain_first() {
+        char buf[256];
+        sock_block(fds[0], false);
+        while (::read(fds[0], buf, sizeof(buf)) > 0);
+    }
+};
+
+TEST(FdSetTest, levelTriggered) {
+    SockPair pair;
+    FdSet set;
+    set.add(pair.fds[0]);
+    ASSERT_EQ(FdSet::wait(10ms, ReadSet{ set }), 0);
+    ASSERT_FALSE(set.is_set(pair.fds[0]));
+
+    pair.send_to_first();
+    ASSERT_EQ(FdSet::wait(ReadSet{ set }), 1);
+    ASSERT_TRUE(set.is_set(pair.fds[0]));
+    ASSERT_THAT(set.ready(), testing::ElementsAre(pair.fds[0]));
+    // still reported since the data hasn't been read
+    ASSERT_EQ(FdSet::wait(10ms, ReadSet{ set }), 1);
+
+    pair.drain_first();
+    ASSERT_EQ(FdSet::wait(10ms, ReadSet{ set }), 0);
+    ASSERT_FALSE(set.is_set(pair.fds[0]));
+    ASSERT_TRUE(set.ready().empty());
+}
+
+TEST(FdSetTest, edgeTriggered) {
+    SockPair pair;
+    FdSet set(Trigger::Edge);
+    set.add(pair.fds[0]);
+
+    pair.send_to_first();
+    ASSERT_EQ(FdSet::wait(ReadSet{ set }), 1);
+    ASSERT_TRUE(set.is_set(pair.fds[0]));
+    // not reported again until there is new activity
+    ASSERT_EQ(FdSet::wait(10ms, ReadSet{ set }), 0);
+    ASSERT_FALSE(set.is_set(pair.fds[0]));
+
+    pair.send_to_first();
+    ASSERT_EQ(FdSet::wait(10ms, ReadSet{ set }), 1);
+    ASSERT_TRUE(set.is_set(pair.fds[0]));
+}
+
+TEST(FdSetTest, multipleSets) {
+    SockPair readPair, writePair;
+    FdSet reads, writes;
+    reads.add(readPair.fds[0]);
+    writes.add(writePair.fds[0]);
+
+    // an empty socket buffer can always be written to
+    ASSERT_EQ(FdSet::wait(ReadSet{ reads }, WriteSet{ writes }), 1);
+    ASSERT_TRUE(writes.is_set(writePair.fds[0]));
+    ASSERT_FALSE(reads.is_set(readPair.fds[0]));
+
+    readPair.send_to_first();
+    ASSERT_EQ(FdSet::wait(10ms, WriteSet{ writes }, ReadSet{ reads }), 2);
+    ASSERT_TRUE(reads.is_set(readPair.fds[0]));
+    ASSERT_TRUE(writes.is_set(writePair.fds[0]));
+}
+
+#ifdef __linux__
+TEST(FdSetTest, watchThroughHandle) {
+    SockPair pair;
+    FdSet writes, outer;
+    writes.watch(SetType::Write);
+    writes.add(pair.fds[0]);
+    outer.add(writes.handle());
+    // an empty socket buffer can be written to, which the inner set reports to the outer one
+    ASSERT_EQ(FdSet::wait(10ms, ReadSet{ outer }), 1);
+    ASSERT_TRUE(outer.is_set(writes.handle()));
+}
+#endif
+
+TEST(FdSetTest, removeAndReset) {
+    SockPair a, b;
+    FdSet set;
+    set.add(a.fds[0]);
+    set.add(b.fds[0]);
+    a.send_to_first();
+    b.send_to_first();
+    ASSERT_EQ(FdSet::wait(ReadSet{ set }), 2);
+
+    set.remove(a.fds[0]);
+    ASSERT_FALSE(set.is_set(a.fds[0]));
+    ASSERT_THAT(set.ready(), testing::ElementsAre(b.fds[0]));
+    ASSERT_EQ(FdSet::wait(10ms, ReadSet{ set }), 1);
+    ASSERT_TRUE(set.is_set(b.fds[0]));
+
+    set.reset();
+    ASSERT_FALSE(set.is_set(b.fds[0]));
+    ASSERT_EQ(FdSet::wait(10ms, ReadSet{ set }), 0);
+}
+
+TEST(FdSetTest, beyondSelectLimit) {
+    std::vector<std::unique_ptr<SockPair>> pairs;
+    FdSet set;
+    while (pairs.empty() || pairs.back()->fds[0] < FD_SETSIZE + 64) {
+        pairs.push_back(std::make_unique<SockPair>());
+        set.add(pairs.back()->fds[0]);
+    }
+    pairs.back()->send_to_first();
+    pairs[pairs.size() / 2]->send_to_first();
+
+    ASSERT_EQ(FdSet::wait(ReadSet{ set }), 2);
+    ASSERT_TRUE(set.is_set(pairs.back()->fds[0]));
+    ASSERT_TRUE(set.is_set(pairs[pairs.size() / 2]->fds[0]));
+    ASSERT_FALSE(set.is_set(pairs.front()->fds[0]));
+}
+
+static_assert(is_wait_sets_v<ReadSet, WriteSet, ErrorSet>);
+static_assert(!is_wait_sets_v<ReadSet, ReadSet>);
+static_assert(!is_wait_sets_v<int>);
+static_assert(!is_wait_sets_v<>);
@@ -0,0 +1,158 @@
+/// \file Tests sending requests over pooled client connections
+#include <gtest/gtest.h>
+#include "TestServer.h"
+#include <HttpClient.h>
+#include <HttpServer.h>
+#include <Socket.h>
+#include <Address.h>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+/// @return a request for a path
+HttpRequestFrame get(std::string path) {
+    HttpRequestFrame request;
+    request.path = std::move(path);
+    return request;
+}
+
+class HttpClientTest : public ServerTest {
+protected:
+    /// @return the connections the server accepted
+    uint64_t connections() const {
+        uint64_t count = 0;
+        for (const auto& stats : server->stats())
+            count += stats.connections;
+        return count;
+    }
+};
+
+TEST_F(HttpClientTest, reusesConnections) {
+    start();
+    HttpClient client;
+    for (auto i = 0; i < 5; ++i) {
+        auto request = get("/again");
+        const auto response = client.request("localhost", options.port, request);
+        ASSERT_EQ(response.responseCode, HttpResponse::ok);
+        ASSERT_EQ(response.content, "GET /again ");
+        ASSERT_EQ(request.get(KnownHeader::Host), "localhost:" + std::to_string(options.port));
+    }
+    HttpRequestFrame post;
+    post.protocol = HttpFrame::Protocol::POST;
+    post.path = "/form";
+    post.content = "hello";
+    ASSERT_EQ(client.request("LOCALHOST", options.port, post).content, "POST /form hello");
+    ASSERT_EQ(post.get(KnownHeader::ContentLength), "5");
+
+    auto head = get("/head");
+    head.protocol = HttpFrame::Protocol::HEAD;
+    const auto response = client.request("localhost", options.port, head);
+    ASSERT_EQ(response.get(KnownHeader::ContentLength), "11");
+    ASSERT_TRUE(response.content.empty());
+
+    const auto stats = client.stats();
+    ASSERT_EQ(stats.connects, 1);
+    ASSERT_EQ(stats.reuses, 6);
+    ASSERT_EQ(connections(), 1);
+    ASSERT_EQ(client.idle_count(), 1);
+}
+
+TEST_F(HttpClientTest, replacesClosedConnections) {
+    options.idleTimeout = 100ms;
+    start();
+    HttpClient client;
+    auto request = get("/first");
+    client.request("127.0.0.1", options.port, request);
+    // the server closes the idle connection, which the check before reuse finds
+    std::this_thread::sleep_for(400ms);
+    request = get("/second");
+    ASSERT_EQ(client.request("127.0.0.1", options.port, request).content, "GET /second ");
+    const auto stats = client.stats();
+    ASSERT_EQ(stats.connects, 2);
+    ASSERT_EQ(stats.stale, 1);
+    ASSERT_EQ(stats.reuses, 0);
+}
+
+TEST_F(HttpClientTest, limitsConnectionsPerHost) {
+    start();
+    HttpClientOptions clientOptions;
+    clientOptions.maxPerHost = 2;
+    HttpClient client(clientOptions);
+    std::atomic<int> answered{ 0 };
+    std::vector<std::thread> threads;
+    for (auto i = 0; i < 8; ++i) {
+        threads.emplace_back([&]() {
+            for (auto j = 0; j < 10; ++j) {
+                auto request = get("/limit");
+                if (client.request("127.0.0.1", options.port, request).content == "GET /limit ")
+                    ++answered;
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    ASSERT_EQ(answered, 80);
+    ASSERT_LE(client.stats().connects, 2);
+    ASSERT_LE(connections(), 2);
+    ASSERT_LE(client.idle_count(), 2);
+}
+
+TEST_F(HttpClientTest, evictsIdleConnections) {
+    start();
+    HttpClientOptions clientOptions;
+    clientOptions.idleTimeout = 50ms;
+    HttpClient client(clientOptions);
+    auto request = get("/");
+    client.request("127.0.0.1", options.port, request);
+    ASSERT_EQ(client.idle_count(), 1);
+    ASSERT_EQ(client.evict_idle(), 0);
+    std::this_thread::sleep_for(100ms);
+    ASSERT_EQ(client.evict_idle(), 1);
+    ASSERT_EQ(client.idle_count(), 0);
+    ASSERT_EQ(client.stats().evictions, 1);
+}
+
+TEST_F(HttpClientTest, reusesTlsConnections) {
+    options.tls = std::make_shared<TlsContext>("data/cert.pem", "data/key.pem");
+    start();
+    HttpClient client;
+    for (auto i = 0; i < 3; ++i) {
+        auto request = get("/secure");
+        ASSERT_EQ(client.request("localhost", options.port, request, true).content,
+            "GET /secure ");
+    }
+    ASSERT_EQ(client.stats().connects, 1);
+    ASSERT_EQ(connections(), 1);
+}
+
+TEST(HttpClientResponseTest, readsChunkedAndUnframedBodies) {
+    const auto port = nextPort();
+    TcpSocket listener(Address{ port });
+    std::thread server([&listener]() {
+        auto connection = listener.accept();
+        connection.read(0);
+        connection.write("HTTP/1.1 100 Continue\r\n\r\nHTTP/1.1 200 OK\r\n"
+            "Transfer-Encoding: chunked\r\nX-Tag: a\r\nX-Tag: b\r\n\r\n"
+            "3\r\nhel\r\n2\r\nlo\r\n0\r\n\r\n");
+        connection.read(0);
+        // a body without a length ends when the connection closes
+        connection.write("HTTP/1.1 404 Not Found\r\n\r\nmissing");
+    });
+    HttpClient client;
+    auto request = get("/chunked");
+    const auto chunked = client.request("127.0.0.1", port, request);
+    ASSERT_EQ(chunked.content, "hello");
+    ASSERT_EQ(chunked.get("x-tag"), "a, b");
+    request = get("/closed");
+    const auto closed = client.request("127.0.0.1", port, request);
+    ASSERT_EQ(closed.responseCode, HttpResponse::not_found);
+    ASSERT_EQ(closed.content, "missing");
+    server.join();
+    ASSERT_EQ(client.idle_count(), 0);
+    ASSERT_EQ(client.stats().connects, 1);
+}
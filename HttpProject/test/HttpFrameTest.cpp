@@ -0,0 +1,125 @@
+/// \file Tests composing HTTP frames
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include "MockPort.h"
+#include <HttpRequestFrame.h>
+#include <HttpResponseFrame.h>
+#include <numeric>
+#include <string>
+#include <vector>
+using namespace testing;
+
+/// @return the concatenation of `views`
+std::string join(const std::vector<std::string_view>& views) {
+    return std::accumulate(views.begin(), views.end(), std::string(),
+        [](std::string out, std::string_view view) { return out.append(view); });
+}
+
+TEST(HttpFrameTest, responseViews) {
+    HttpResponseFrame frame;
+    frame.responseCode = HttpResponse::not_found;
+    frame[KnownHeader::ContentType] = "text/plain";
+    frame.content = std::string(100000, 'x');
+    std::vector<std::string_view> views;
+    frame.compose_views(views);
+    ASSERT_EQ(join(views), frame.compose());
+
+    // the status line is precomposed and the body isn't copied
+    ASSERT_EQ(views.front(), HttpStatusLine::not_found);
+    ASSERT_EQ(views.back().data(), frame.content.data());
+    ASSERT_EQ(views.back().size(), frame.content.size());
+}
+
+TEST(HttpFrameTest, uncommonResponses) {
+    HttpResponseFrame frame;
+    frame.responseCode = "418 I'm a teapot";
+    ASSERT_EQ(frame.compose(), "HTTP/1.1 418 I'm a teapot\r\n\r\n");
+    frame.responseCode = HttpResponse::ok;
+    frame.set_http_version(1, 0);
+    ASSERT_EQ(frame.compose(), "HTTP/1.0 200 OK\r\n\r\n");
+    frame.set_http_version(10, 0);
+    ASSERT_THROW(frame.compose(), std::invalid_argument);
+    frame.set_http_version(1, 1);
+    frame.responseCode.clear();
+    ASSERT_THROW(frame.compose(), std::invalid_argument);
+}
+
+TEST(HttpFrameTest, rejectsHeaderInjection) {
+    HttpResponseFrame frame;
+    frame.responseCode = HttpResponse::ok;
+    ASSERT_THROW(frame["X-Name\r\nSet-Cookie"], std::invalid_argument);
+    ASSERT_THROW(frame["X Name"], std::invalid_argument);
+    ASSERT_THROW(frame[""], std::invalid_argument);
+    ASSERT_FALSE(frame.has_header("X Name"));
+    frame["X-Echo"] = "a\r\nSet-Cookie: id=1";
+    ASSERT_THROW(frame.check_headers(), std::invalid_argument);
+    ASSERT_THROW(frame.compose(), std::invalid_argument);
+    std::vector<std::string_view> views;
+    ASSERT_THROW(frame.compose_views(views), std::invalid_argument);
+    frame["X-Echo"] = std::string("a\0b", 3);
+    ASSERT_THROW(frame.compose(), std::invalid_argument);
+    frame["X-Echo"] = "a\nb";
+    ASSERT_THROW(frame.compose(), std::invalid_argument);
+    // tabs and other visible characters are allowed in values
+    frame["X-Echo"] = "a\tb, \"c\"; d=e";
+    ASSERT_EQ(frame.compose(), "HTTP/1.1 200 OK\r\nX-Echo: a\tb, \"c\"; d=e\r\n\r\n");
+
+    HttpRequestFrame request;
+    request.path = "/";
+    request["Host"] = "a\rb";
+    ASSERT_THROW(request.compose(), std::invalid_argument);
+}
+
+TEST(HttpFrameTest, requestViews) {
+    HttpRequestFrame frame;
+    frame.protocol = HttpFrame::Protocol::POST;
+    frame.path = "/upload";
+    frame[KnownHeader::Host] = "localhost";
+    frame["Content-Length"] = "4";
+    frame.content = "data";
+    const auto expected = "POST /upload HTTP/1.1\r\n"
+        "Host: localhost\r\n"
+        "Content-Length: 4\r\n"
+        "\r\n"
+        "data";
+    std::vector<std::string_view> views;
+    frame.compose_views(views);
+    ASSERT_EQ(join(views), expected);
+    ASSERT_EQ(frame.compose(), expected);
+
+    frame.set_http_version(1, 0);
+    frame.content.clear();
+    frame.headers().clear();
+    ASSERT_EQ(frame.compose(), "POST /upload HTTP/1.0\r\n\r\n");
+}
+
+TEST(HttpFrameTest, writeFrame) {
+    HttpResponseFrame frame;
+    frame.responseCode = HttpResponse::ok;
+    frame[KnownHeader::ContentLength] = "5";
+    frame.content = "hello";
+    MockPort port;
+    std::string written;
+    EXPECT_CALL(port, write(_)).WillRepeatedly([&written](std::string_view data) {
+        ASSERT_FALSE(data.empty());
+        written.append(data);
+        });
+    write_frame(port, frame);
+    ASSERT_EQ(written, frame.compose());
+}
+
+TEST(HttpFrameTest, keepAlive) {
+    HttpRequestFrame frame;
+    ASSERT_TRUE(frame.keep_alive());
+    frame[KnownHeader::Connection] = "Upgrade, Close";
+    ASSERT_FALSE(frame.keep_alive());
+    frame[KnownHeader::Connection] = "closed";
+    ASSERT_TRUE(frame.keep_alive());
+
+    frame.set_http_version(1, 0);
+    ASSERT_FALSE(frame.keep_alive());
+    frame[KnownHeader::Connection] = " keep-alive ";
+    ASSERT_TRUE(frame.keep_alive());
+    frame.headers().clear();
+    ASSERT_FALSE(frame.keep_alive());
+}
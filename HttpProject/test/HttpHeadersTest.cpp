@@ -0,0 +1,115 @@
+/// \file Tests the header storage of HTTP frames
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <HttpHeaders.h>
+#include <HttpRequestFrame.h>
+#include <HttpResponseFrame.h>
+#include <HttpRequestParser.h>
+#include <string>
+#include <vector>
+using namespace testing;
+
+static_assert(known_header("content-length") == KnownHeader::ContentLength);
+static_assert(known_header("HOST") == KnownHeader::Host);
+static_assert(!known_header("Hosts"));
+static_assert(!known_header("Content-Lengtz"));
+static_assert(header_hash("Content-Type") == header_hash("content-TYPE"));
+
+TEST(HttpHeadersTest, knownHeaders) {
+    HttpHeaders headers;
+    ASSERT_EQ(headers.find(KnownHeader::Host), nullptr);
+    headers["host"] = "localhost";
+    ASSERT_EQ(*headers.find(KnownHeader::Host), "localhost");
+    ASSERT_EQ(*headers.find("HOST"), "localhost");
+    headers[KnownHeader::ContentLength] = "10";
+    ASSERT_EQ(*headers.find("Content-Length"), "10");
+    ASSERT_EQ(headers.size(), 2);
+
+    ASSERT_TRUE(headers.erase("Host"));
+    ASSERT_FALSE(headers.erase(KnownHeader::Host));
+    ASSERT_EQ(headers.find("host"), nullptr);
+    // re-adding a removed header starts empty
+    ASSERT_THAT(headers[KnownHeader::Host], IsEmpty());
+}
+
+TEST(HttpHeadersTest, otherHeaders) {
+    HttpHeaders headers;
+    // more headers than fit inline
+    for (auto i = 0; i < 20; ++i)
+        headers["X-Header-" + std::to_string(i)] = std::to_string(i);
+    ASSERT_EQ(headers.size(), 20);
+    for (auto i = 0; i < 20; ++i) {
+        const auto value = headers.find("x-header-" + std::to_string(i));
+        ASSERT_NE(value, nullptr);
+        ASSERT_EQ(*value, std::to_string(i));
+    }
+    ASSERT_EQ(headers.find("X-Header-20"), nullptr);
+
+    // erase from the inline headers and the spilled ones
+    ASSERT_TRUE(headers.erase("X-HEADER-3"));
+    ASSERT_TRUE(headers.erase("X-Header-15"));
+    ASSERT_FALSE(headers.erase("X-Header-15"));
+    ASSERT_EQ(headers.size(), 18);
+    for (auto i = 0; i < 20; ++i) {
+        const auto value = headers.find("X-Header-" + std::to_string(i));
+        if (i == 3 || i == 15)
+            ASSERT_EQ(value, nullptr);
+        else
+            ASSERT_EQ(*value, std::to_string(i));
+    }
+    headers["x-header-0"] += "0";
+    ASSERT_EQ(*headers.find("X-Header-0"), "00");
+
+    headers.clear();
+    ASSERT_EQ(headers.size(), 0);
+    ASSERT_EQ(headers.find("X-Header-0"), nullptr);
+}
+
+TEST(HttpHeadersTest, forEach) {
+    HttpHeaders headers;
+    headers["Accept"] = "*/*";
+    headers["connection"] = "close";
+    headers["Host"] = "a";
+    std::vector<std::pair<std::string, std::string>> all;
+    headers.for_each([&all](std::string_view name, const std::string& value) {
+        all.emplace_back(name, value);
+        });
+    // known headers come first, with their canonical names
+    ASSERT_THAT(all, ElementsAre(Pair("Host", "a"), Pair("Connection", "close"),
+        Pair("Accept", "*/*")));
+}
+
+TEST(HttpHeadersTest, frameApi) {
+    HttpResponseFrame frame;
+    frame.responseCode = HttpResponse::ok;
+    frame["Content-Type"] = "text/plain";
+    frame[KnownHeader::ContentLength] = "2";
+    frame["X-Custom"] = "yes";
+    frame.content = "hi";
+    ASSERT_TRUE(frame.has_header("content-type"));
+    ASSERT_TRUE(frame.has_header(KnownHeader::ContentType));
+    ASSERT_FALSE(frame.has_header(KnownHeader::Host));
+    ASSERT_EQ(frame.get(KnownHeader::ContentLength), "2");
+    ASSERT_EQ(frame.get("x-custom"), "yes");
+    ASSERT_THROW(frame.get("Missing"), std::out_of_range);
+    ASSERT_THROW(frame.get(KnownHeader::Host), std::out_of_range);
+    ASSERT_EQ(frame.compose(), "HTTP/1.1 200 OK\r\n"
+        "Content-Length: 2\r\n"
+        "Content-Type: text/plain\r\n"
+        "X-Custom: yes\r\n"
+        "\r\n"
+        "hi");
+}
+
+TEST(HttpHeadersTest, parserKnownHeaders) {
+    HttpRequestParser parser;
+    parser.feed("GET / HTTP/1.1\r\nhost: a\r\nX-A: b\r\nHOST: c\r\n\r\n");
+    ASSERT_EQ(parser.parse(), HttpRequestParser::Status::Done);
+    ASSERT_EQ(parser.find(KnownHeader::Host), "a");
+    ASSERT_FALSE(parser.find(KnownHeader::Connection));
+    parser.consume();
+    parser.feed("GET / HTTP/1.1\r\nConnection: close\r\n\r\n");
+    ASSERT_EQ(parser.parse(), HttpRequestParser::Status::Done);
+    ASSERT_FALSE(parser.find(KnownHeader::Host));
+    ASSERT_EQ(parser.find(KnownHeader::Connection), "close");
+}
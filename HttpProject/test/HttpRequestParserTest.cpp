@@ -0,0 +1,228 @@
+/// \file Tests the incremental parsing of HTTP request heads
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include "MockPort.h"
+#include <HttpRequestParser.h>
+#include <HttpRequestFrame.h>
+#include <cstring>
+#include <string>
+using namespace testing;
+using Status = HttpRequestParser::Status;
+
+constexpr std::string_view simpleRequest =
+    "GET /index.html?q=1 HTTP/1.1\r\n"
+    "Host: 127.0.0.1\r\n"
+    "Accept: */*\r\n"
+    "Content-Length:  5 \r\n"
+    "\r\n"
+    "hello";
+
+/// Asserts the parser holds `simpleRequest`
+void expectSimpleRequest(const HttpRequestParser& parser) {
+    EXPECT_EQ(parser.method(), "GET");
+    EXPECT_EQ(parser.path(), "/index.html?q=1");
+    EXPECT_EQ(parser.http_version(), std::make_pair(1, 1));
+    ASSERT_EQ(parser.header_count(), 3);
+    EXPECT_EQ(parser.header(0).name, "Host");
+    EXPECT_EQ(parser.header(0).value, "127.0.0.1");
+    EXPECT_EQ(parser.header(2).name, "Content-Length");
+    EXPECT_EQ(parser.header(2).value, "5");
+    EXPECT_EQ(parser.buffered_body(), "hello");
+    EXPECT_EQ(parser.head_size(), simpleRequest.size() - 5);
+}
+
+TEST(HttpRequestParserTest, parseWhole) {
+    HttpRequestParser parser;
+    parser.feed(simpleRequest);
+    ASSERT_EQ(parser.parse(), Status::Done);
+    expectSimpleRequest(parser);
+    // stays done until consumed
+    ASSERT_EQ(parser.parse(), Status::Done);
+}
+
+TEST(HttpRequestParserTest, splitAtEveryByte) {
+    for (size_t split = 0; split < simpleRequest.size() - 5; ++split) {
+        HttpRequestParser parser;
+        parser.feed(simpleRequest.substr(0, split));
+        ASSERT_EQ(parser.parse(), Status::Incomplete) << "split at " << split;
+        parser.feed(simpleRequest.substr(split));
+        ASSERT_EQ(parser.parse(), Status::Done) << "split at " << split;
+        expectSimpleRequest(parser);
+    }
+}
+
+TEST(HttpRequestParserTest, byteByByte) {
+    HttpRequestParser parser;
+    for (size_t i = 0; i < simpleRequest.size() - 5; ++i) {
+        ASSERT_EQ(parser.parse(), Status::Incomplete);
+        parser.feed(simpleRequest.substr(i, 1));
+    }
+    ASSERT_EQ(parser.parse(), Status::Done);
+    parser.feed("hello");
+    expectSimpleRequest(parser);
+}
+
+TEST(HttpRequestParserTest, pipelined) {
+    HttpRequestParser parser;
+    parser.feed(std::string(simpleRequest) + std::string(simpleRequest)
+        + "POST /submit HTTP/1.0\r\n\r\n");
+    for (auto i = 0; i < 2; ++i) {
+        ASSERT_EQ(parser.parse(), Status::Done);
+        EXPECT_EQ(parser.path(), "/index.html?q=1");
+        parser.consume(5);
+    }
+    ASSERT_EQ(parser.parse(), Status::Done);
+    EXPECT_EQ(parser.method(), "POST");
+    EXPECT_EQ(parser.path(), "/submit");
+    EXPECT_EQ(parser.http_version(), std::make_pair(1, 0));
+    EXPECT_EQ(parser.header_count(), 0);
+    parser.consume();
+    ASSERT_EQ(parser.size(), 0);
+    ASSERT_EQ(parser.parse(), Status::Incomplete);
+}
+
+TEST(HttpRequestParserTest, findIgnoresCase) {
+    HttpRequestParser parser;
+    parser.feed(simpleRequest);
+    ASSERT_EQ(parser.parse(), Status::Done);
+    EXPECT_EQ(parser.find("host"), "127.0.0.1");
+    EXPECT_EQ(parser.find("CONTENT-LENGTH"), "5");
+    EXPECT_FALSE(parser.find("Transfer-Encoding"));
+    // differs only in the 0x20 bit from a header name character
+    EXPECT_FALSE(parser.find("Host\x1a"));
+}
+
+TEST(HttpRequestParserTest, lineEndings) {
+    HttpRequestParser parser;
+    parser.feed("\r\n\nGET / HTTP/1.1\nHost: a\n\n");
+    ASSERT_EQ(parser.parse(), Status::Done);
+    EXPECT_EQ(parser.path(), "/");
+    EXPECT_EQ(parser.find("Host"), "a");
+    EXPECT_THAT(parser.buffered_body(), IsEmpty());
+}
+
+TEST(HttpRequestParserTest, longHeaders) {
+    // values longer than the SIMD block sizes with the line end at every offset
+    for (size_t len = 0; len < 100; ++len) {
+        HttpRequestParser parser;
+        const std::string value(len, 'v');
+        parser.feed("GET / HTTP/1.1\r\nCookie: " + value + "\r\nX-Tab:\ta\tb\t\r\n\r\n");
+        ASSERT_EQ(parser.parse(), Status::Done);
+        ASSERT_EQ(parser.find("cookie"), value);
+        ASSERT_EQ(parser.find("x-tab"), "a\tb");
+    }
+}
+
+TEST(HttpRequestParserTest, errors) {
+    const std::pair<std::string, HttpRequestParser::Error> cases[] = {
+        { "GET /\r\n\r\n", HttpRequestParser::Error::BadRequestLine },
+        { "GET  HTTP/1.1\r\n\r\n", HttpRequestParser::Error::BadRequestLine },
+        { " / HTTP/1.1\r\n\r\n", HttpRequestParser::Error::BadRequestLine },
+        { "GET / HTTQ/1.1\r\n\r\n", HttpRequestParser::Error::BadRequestLine },
+        { "GET / HTTP/1.11\r\n\r\n", HttpRequestParser::Error::BadRequestLine },
+        { "GET / HTTP/1.1\r\nHost\r\n\r\n", HttpRequestParser::Error::BadHeader },
+        { "GET / HTTP/1.1\r\nHost : a\r\n\r\n", HttpRequestParser::Error::BadHeader },
+        { "GET / HTTP/1.1\r\n: a\r\n\r\n", HttpRequestParser::Error::BadHeader },
+        { "GET / HTTP/1.1\r\nA: b\r\n c\r\n\r\n", HttpRequestParser::Error::BadHeader },
+        { "GET / HTTP/1.1\r\nA: b\rc\r\n\r\n", HttpRequestParser::Error::BadCharacter },
+        { std::string("GET / HTTP/1.1\r\nA: b\0c\r\n\r\n", 27),
+            HttpRequestParser::Error::BadCharacter },
+        { "GET / HTTP/1.1\r\nA: b\x7f\r\n\r\n", HttpRequestParser::Error::BadCharacter },
+    };
+    for (const auto& [request, error] : cases) {
+        HttpRequestParser parser;
+        parser.feed(request);
+        ASSERT_EQ(parser.parse(), Status::Error) << request;
+        ASSERT_EQ(parser.error(), error) << request;
+        ASSERT_EQ(parser.parse(), Status::Error);
+    }
+}
+
+TEST(HttpRequestParserTest, obsTextAllowed) {
+    HttpRequestParser parser;
+    parser.feed("GET / HTTP/1.1\r\nX-Name: caf\xc3\xa9\r\n\r\n");
+    ASSERT_EQ(parser.parse(), Status::Done);
+    ASSERT_EQ(parser.find("x-name"), "caf\xc3\xa9");
+}
+
+TEST(HttpRequestParserTest, tooLarge) {
+    HttpRequestParser parser(64);
+    parser.feed("GET / HTTP/1.1\r\nCookie: ");
+    ASSERT_EQ(parser.parse(), Status::Incomplete);
+    parser.feed(std::string(64, 'a'));
+    ASSERT_EQ(parser.parse(), Status::Error);
+    ASSERT_EQ(parser.error(), HttpRequestParser::Error::TooLarge);
+
+    // a body past the limit is fine
+    HttpRequestParser bodyParser(64);
+    bodyParser.feed("GET / HTTP/1.1\r\n\r\n" + std::string(100, 'b'));
+    ASSERT_EQ(bodyParser.parse(), Status::Done);
+    ASSERT_EQ(bodyParser.buffered_body().size(), 100);
+}
+
+TEST(HttpRequestParserTest, fillFrame) {
+    HttpRequestParser parser;
+    parser.feed("POST /form HTTP/1.0\r\nAccept: a\r\nHost: b\r\naccept: c\r\n\r\n");
+    ASSERT_EQ(parser.parse(), Status::Done);
+    HttpRequestFrame frame;
+    parser.fill(frame);
+    EXPECT_EQ(frame.protocol, HttpFrame::Protocol::POST);
+    EXPECT_EQ(frame.path, "/form");
+    EXPECT_EQ(frame.http_version(), std::make_pair(1, 0));
+    EXPECT_EQ(frame.get("Host"), "b");
+    EXPECT_EQ(frame.get("ACCEPT"), "a, c");
+
+    HttpRequestParser unknown;
+    unknown.feed("BREW /pot HTTP/1.1\r\n\r\n");
+    ASSERT_EQ(unknown.parse(), Status::Done);
+    ASSERT_THROW(unknown.fill(frame), std::invalid_argument);
+}
+
+TEST(HttpRequestParserTest, readFromPort) {
+    MockPort port;
+    size_t offset = 0;
+    EXPECT_CALL(port, try_read_into(_, _)).WillRepeatedly(
+        Invoke([&offset](char* buffer, size_t size) {
+            // at most 7 bytes per read
+            const auto count = std::min({ size, size_t{ 7 }, simpleRequest.size() - offset });
+            std::memcpy(buffer, simpleRequest.data() + offset, count);
+            offset += count;
+            return count;
+        }));
+    HttpRequestParser parser;
+    while (parser.parse() == Status::Incomplete)
+        ASSERT_GT(parser.read_from(port), 0);
+    parser.read_from(port);
+    expectSimpleRequest(parser);
+}
+
+TEST(HttpRequestParserTest, shrink) {
+    HttpRequestParser parser;
+    parser.feed(std::string(200 * 1024, 'a'));
+    // a buffer holding data is kept
+    parser.shrink(64 * 1024);
+    ASSERT_EQ(parser.size(), 200 * 1024);
+    parser.reset();
+    ASSERT_GE(parser.prepare(1).second, 200 * 1024);
+    parser.shrink(64 * 1024);
+    ASSERT_LE(parser.prepare(1).second, 64 * 1024);
+    parser.feed(simpleRequest);
+    ASSERT_EQ(parser.parse(), Status::Done);
+    expectSimpleRequest(parser);
+}
+
+TEST(HttpRequestParserTest, findLineEnd) {
+    std::string data(200, 'a');
+    for (size_t i = 0; i < data.size(); ++i) {
+        for (const char c : { '\r', '\n', '\0', '\x1f', '\x7f' }) {
+            data[i] = c;
+            ASSERT_EQ(find_line_end(data.data(), data.data() + data.size()), data.data() + i);
+            data[i] = 'a';
+        }
+        data[i] = '\t';
+        ASSERT_EQ(find_line_end(data.data(), data.data() + data.size()), data.data() + data.size());
+        data[i] = static_cast<char>(0x80);
+        ASSERT_EQ(find_line_end(data.data(), data.data() + data.size()), data.data() + data.size());
+        data[i] = 'a';
+    }
+}
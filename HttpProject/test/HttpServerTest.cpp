@@ -0,0 +1,381 @@
+/// \file Tests serving requests with the multi-threaded server
+#include <gtest/gtest.h>
+#include "TestServer.h"
+#include <HttpServer.h>
+#include <SSLSocket.h>
+#include <Socket.h>
+#include <Address.h>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+class HttpServerTest : public ServerTest {
+protected:
+    /// Sends a request over a new plain connection
+    Response request(std::string_view data, bool head = false) {
+        TcpSocket client(Address("127.0.0.1", options.port));
+        client.write(data);
+        return readResponse(client, head);
+    }
+};
+
+TEST_F(HttpServerTest, servesRequests) {
+    start();
+    ASSERT_EQ(server->thread_count(), 2);
+    const auto response = request("GET /hello HTTP/1.1\r\nHost: test\r\n\r\n");
+    ASSERT_EQ(response.head.rfind("HTTP/1.1 200 OK\r\n", 0), 0);
+    ASSERT_EQ(response.head.find("Connection:"), std::string::npos);
+    ASSERT_EQ(response.body, "GET /hello ");
+
+    // the length of the body a GET would have been answered with
+    const auto head = request("HEAD /hello HTTP/1.1\r\n\r\n", true);
+    ASSERT_NE(head.head.find("Content-Length: 12\r\n"), std::string::npos);
+    ASSERT_TRUE(head.body.empty());
+}
+
+TEST_F(HttpServerTest, readsBodies) {
+    start();
+    ASSERT_EQ(request("POST /form HTTP/1.1\r\nContent-Length: 5\r\n\r\nhello").body,
+        "POST /form hello");
+    ASSERT_EQ(request("POST /form HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+        "3\r\nhel\r\n2\r\nlo\r\n0\r\n\r\n").body, "POST /form hello");
+
+    // a body split across writes
+    TcpSocket client(Address("127.0.0.1", options.port));
+    client.write("PUT /split HTTP/1.1\r\nContent-Length: 6\r\n\r\nab");
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    client.write("cdef");
+    ASSERT_EQ(readResponse(client).body, "PUT /split abcdef");
+}
+
+TEST_F(HttpServerTest, answersErrors) {
+    options.maxBodySize = 4;
+    start();
+    ASSERT_EQ(request("POST / HTTP/1.1\r\nContent-Length: 5\r\n\r\nhello").head.rfind(
+        "HTTP/1.1 413 ", 0), 0);
+    ASSERT_EQ(request("GET /\r\n\r\n").head.rfind("HTTP/1.1 400 ", 0), 0);
+    ASSERT_EQ(request("BREW / HTTP/1.1\r\n\r\n").head.rfind("HTTP/1.1 501 ", 0), 0);
+    ASSERT_EQ(request("POST / HTTP/1.1\r\nTransfer-Encoding: gzip\r\n\r\n").head.rfind(
+        "HTTP/1.1 501 ", 0), 0);
+    ASSERT_EQ(request("GET /throw HTTP/1.1\r\n\r\n").head.rfind("HTTP/1.1 500 ", 0), 0);
+    // a header value which would split the response isn't sent
+    const auto split = request("GET /inject HTTP/1.1\r\n\r\n");
+    ASSERT_EQ(split.head.rfind("HTTP/1.1 500 ", 0), 0);
+    ASSERT_EQ(split.head.find("Set-Cookie"), std::string::npos);
+}
+
+TEST_F(HttpServerTest, spreadsConnections) {
+    options.threads = 4;
+    start();
+    for (auto i = 0; i < 64; ++i)
+        ASSERT_EQ(request("GET / HTTP/1.1\r\n\r\n").body, "GET / ");
+
+    uint64_t total = 0;
+    auto busyWorkers = 0;
+    for (const auto& stats : server->stats()) {
+        total += stats.requests;
+        busyWorkers += stats.connections > 0;
+    }
+    ASSERT_EQ(total, 64);
+    // the kernel hashes connections across the listeners, so more than one gets work
+    ASSERT_GT(busyWorkers, 1);
+}
+
+TEST_F(HttpServerTest, servesTls) {
+    options.tls = std::make_shared<TlsContext>("data/cert.pem", "data/key.pem");
+    start();
+    for (auto i = 0; i < 4; ++i) {
+        SSLSocket client(Address("127.0.0.1", options.port));
+        client.write("GET /secure HTTP/1.1\r\n\r\n");
+        ASSERT_EQ(readResponse(client).body, "GET /secure ");
+    }
+}
+
+TEST_F(HttpServerTest, stopsAndRestarts) {
+    start();
+    server->stop();
+    ASSERT_THROW(server->start(), std::logic_error);
+    // the port is free again once the server is destroyed
+    server.reset();
+    server = std::make_unique<HttpServer>(options, &echoHandler);
+    server->start();
+    ASSERT_EQ(request("GET / HTTP/1.1\r\n\r\n").body, "GET / ");
+}
+
+TEST_F(HttpServerTest, keepsConnectionsAlive) {
+    start();
+    TcpSocket client(Address("127.0.0.1", options.port));
+    for (auto i = 0; i < 3; ++i) {
+        client.write("GET /again HTTP/1.1\r\n\r\n");
+        ASSERT_EQ(readResponse(client).body, "GET /again ");
+    }
+    client.write("GET /last HTTP/1.1\r\nConnection: close\r\n\r\n");
+    const auto last = readResponse(client);
+    ASSERT_NE(last.head.find("Connection: close\r\n"), std::string::npos);
+    ASSERT_THROW(client.read(0), std::runtime_error);
+
+    // HTTP/1.0 connections only persist when asked to
+    ASSERT_NE(request("GET / HTTP/1.0\r\n\r\n").head.find("Connection: close\r\n"),
+        std::string::npos);
+    TcpSocket old(Address("127.0.0.1", options.port));
+    for (auto i = 0; i < 2; ++i) {
+        old.write("GET / HTTP/1.0\r\nConnection: Keep-Alive\r\n\r\n");
+        ASSERT_NE(readResponse(old).head.find("Connection: keep-alive\r\n"),
+            std::string::npos);
+    }
+
+    uint64_t connections = 0, requests = 0;
+    for (const auto& stats : server->stats()) {
+        connections += stats.connections;
+        requests += stats.requests;
+    }
+    ASSERT_EQ(connections, 3);
+    ASSERT_EQ(requests, 7);
+}
+
+TEST_F(HttpServerTest, answersPipelinedRequests) {
+    start();
+    TcpSocket client(Address("127.0.0.1", options.port));
+    client.write("GET /1 HTTP/1.1\r\n\r\n"
+        "POST /2 HTTP/1.1\r\nContent-Length: 4\r\n\r\nbody"
+        "HEAD /3 HTTP/1.1\r\n\r\n"
+        "PUT /4 HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n4\r\ndata\r\n0\r\n\r\n"
+        "GET /5 HTT");
+    std::string buffered;
+    ASSERT_EQ(readResponse(client, buffered).body, "GET /1 ");
+    ASSERT_EQ(readResponse(client, buffered).body, "POST /2 body");
+    ASSERT_TRUE(readResponse(client, buffered, true).body.empty());
+    ASSERT_EQ(readResponse(client, buffered).body, "PUT /4 data");
+    ASSERT_TRUE(buffered.empty());
+    // the rest of a request split across reads
+    client.write("P/1.1\r\n\r\n");
+    ASSERT_EQ(readResponse(client, buffered).body, "GET /5 ");
+}
+
+TEST_F(HttpServerTest, limitsConnections) {
+    options.maxRequestsPerConnection = 2;
+    options.idleTimeout = std::chrono::milliseconds(100);
+    start();
+    TcpSocket client(Address("127.0.0.1", options.port));
+    client.write("GET / HTTP/1.1\r\n\r\nGET / HTTP/1.1\r\n\r\nGET / HTTP/1.1\r\n\r\n");
+    std::string buffered;
+    ASSERT_EQ(readResponse(client, buffered).head.find("Connection:"), std::string::npos);
+    ASSERT_NE(readResponse(client, buffered).head.find("Connection: close\r\n"),
+        std::string::npos);
+    // the third request isn't answered
+    ASSERT_TRUE(buffered.empty());
+    ASSERT_THROW(client.read(0), std::runtime_error);
+
+    TcpSocket idle(Address("127.0.0.1", options.port));
+    idle.write("GET / HTTP/1.1\r\n");
+    const auto start = std::chrono::steady_clock::now();
+    ASSERT_THROW(idle.read(0), std::runtime_error);
+    ASSERT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(90));
+}
+
+/// Size of the body of /large, more than the socket buffers of a loopback connection hold
+constexpr size_t largeSize = 32 * 1024 * 1024;
+
+/// Answers /large with a body of `largeSize`, and other paths as `echoHandler` does
+void largeHandler(const HttpRequestFrame& request, HttpResponseFrame& response) {
+    if (request.path == "/large")
+        response.content.assign(largeSize, 'x');
+    else
+        echoHandler(request, response);
+}
+
+TEST_F(HttpServerTest, servesOthersWhileClientsDontRead) {
+    options.threads = 1;
+    for (const auto tls : { false, true }) {
+        if (tls)
+            options.tls = std::make_shared<TlsContext>("data/cert.pem", "data/key.pem");
+        start(&largeHandler);
+        const auto connect = [this, tls]() -> std::unique_ptr<Port> {
+            if (tls)
+                return std::make_unique<SSLSocket>(Address("127.0.0.1", options.port));
+            return std::make_unique<TcpSocket>(Address("127.0.0.1", options.port));
+        };
+        auto slow = connect();
+        slow->write("GET /large HTTP/1.1\r\n\r\nGET /next HTTP/1.1\r\n\r\n");
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        // sent while the responses wait for the client, so it is read once they are sent
+        slow->write("GET /later HTTP/1.1\r\n\r\n");
+
+        // a worker blocked on writing to the slow client would never answer
+        auto other = connect();
+        other->write("GET /hello HTTP/1.1\r\n\r\n");
+        std::string answer;
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (answer.find("GET /hello ") == std::string::npos
+            && std::chrono::steady_clock::now() < deadline)
+        {
+            const auto read = other->try_read();
+            answer.append(read.begin(), read.end());
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        ASSERT_NE(answer.find("GET /hello "), std::string::npos);
+
+        std::string buffered;
+        ASSERT_EQ(readResponse(*slow, buffered).body.size(), largeSize);
+        ASSERT_EQ(readResponse(*slow, buffered).body, "GET /next ");
+        ASSERT_EQ(readResponse(*slow, buffered).body, "GET /later ");
+        server.reset();
+    }
+}
+
+TEST_F(HttpServerTest, closesClientsWhichDontRead) {
+    options.threads = 1;
+    options.idleTimeout = std::chrono::milliseconds(200);
+    start(&largeHandler);
+    TcpSocket slow(Address("127.0.0.1", options.port));
+    slow.write("GET /large HTTP/1.1\r\n\r\n");
+    std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+    const auto metrics = server->metrics();
+    ASSERT_EQ(metrics.connectionsClosed, 1);
+    ASSERT_LT(metrics.bytesWritten, largeSize);
+}
+
+TEST_F(HttpServerTest, answersLongPipelines) {
+    options.threads = 1;
+    const std::string padding(1000, 'p');
+    std::string requests;
+    for (auto i = 0; i < 1000; ++i)
+        requests += "GET /" + std::to_string(i) + " HTTP/1.1\r\nX-Pad: " + padding + "\r\n\r\n";
+    for (const auto tls : { false, true }) {
+        if (tls)
+            options.tls = std::make_shared<TlsContext>("data/cert.pem", "data/key.pem");
+        start();
+        std::unique_ptr<Port> client;
+        if (tls)
+            client = std::make_unique<SSLSocket>(Address("127.0.0.1", options.port));
+        else
+            client = std::make_unique<TcpSocket>(Address("127.0.0.1", options.port));
+        // more than is read per wakeup, which is read on the next ones
+        client->write(requests);
+        std::string buffered;
+        for (auto i = 0; i < 1000; ++i)
+            ASSERT_EQ(readResponse(*client, buffered).body, "GET /" + std::to_string(i) + " ");
+        server.reset();
+    }
+}
+
+TEST_F(HttpServerTest, limitsBufferedRequests) {
+    // the body is within the limit, but its chunk headers make it too large to buffer
+    std::string request = "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n";
+    for (auto i = 0; i < 500; ++i)
+        request += "1\r\nx\r\n";
+    // exactly the request is buffered, so none of it is left unread when the server closes
+    options.maxHeadSize = 1024;
+    options.maxBodySize = request.size() - options.maxHeadSize;
+    start();
+    TcpSocket client(Address("127.0.0.1", options.port));
+    client.write(request);
+    const auto response = readResponse(client);
+    ASSERT_EQ(response.head.compare(0, 12, "HTTP/1.1 413"), 0);
+    ASSERT_THROW(client.read(0), std::runtime_error);
+
+    // other connections are still served
+    TcpSocket other(Address("127.0.0.1", options.port));
+    other.write("GET /next HTTP/1.1\r\n\r\n");
+    ASSERT_EQ(readResponse(other).body, "GET /next ");
+}
+
+TEST_F(HttpServerTest, reusesConnections) {
+    options.threads = 1;
+    start();
+    const std::string large(300 * 1024, 'x');
+    ASSERT_EQ(request("POST /large HTTP/1.1\r\nContent-Length: " + std::to_string(large.size())
+        + "\r\n\r\n" + large).body, "POST /large " + large);
+    {
+        // a client leaving in the middle of a request
+        TcpSocket client(Address("127.0.0.1", options.port));
+        client.write("POST /partial HTTP/1.1\r\nContent-Length: 10\r\n\r\nabc");
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    // new connections get the closed connections' state without any of their data
+    for (auto i = 0; i < 20; ++i) {
+        const auto path = "/request" + std::to_string(i);
+        ASSERT_EQ(request("POST " + path + " HTTP/1.1\r\nContent-Length: 2\r\n\r\nok").body,
+            "POST " + path + " ok");
+    }
+    ASSERT_EQ(server->stats()[0].connections, 22);
+}
+
+TEST_F(HttpServerTest, servesMetrics) {
+    options.metricsPath = "/metrics";
+    options.timingInterval = 1;
+    start();
+    for (auto i = 0; i < 3; ++i)
+        ASSERT_EQ(request("GET /counted HTTP/1.1\r\n\r\n").body, "GET /counted ");
+    // the handler still answers other methods on the metrics path
+    ASSERT_EQ(request("POST /metrics HTTP/1.1\r\nContent-Length: 2\r\n\r\nok").body,
+        "POST /metrics ok");
+
+    const auto response = request("GET /metrics?format=text HTTP/1.1\r\n\r\n");
+    ASSERT_NE(response.head.find("Content-Type: text/plain; version=0.0.4\r\n"),
+        std::string::npos);
+    ASSERT_NE(response.body.find("\nhttp_connections_accepted_total 5\n"), std::string::npos);
+    // the metrics request is counted once it is answered
+    ASSERT_NE(response.body.find("\nhttp_requests_total 4\n"), std::string::npos);
+    ASSERT_NE(response.body.find("\nhttp_handler_duration_seconds_count 4\n"),
+        std::string::npos);
+    ASSERT_NE(response.body.find("\nhttp_request_parse_duration_seconds_count 5\n"),
+        std::string::npos);
+
+    const auto metrics = server->metrics();
+    ASSERT_EQ(metrics.requests, 5);
+    ASSERT_EQ(metrics.connectionsAccepted, 5);
+    // the last connection may not have been closed yet
+    ASSERT_GE(metrics.active_connections(), 0);
+    ASSERT_LE(metrics.active_connections(), 1);
+    ASSERT_GT(metrics.bytesRead, 5 * 20);
+    // the metrics response may still be being written
+    ASSERT_GE(metrics.bytesWritten, 4 * 40);
+    ASSERT_EQ(metrics.handlerTime.count, 4);
+    ASSERT_EQ(metrics.acceptTime.count, 5);
+    ASSERT_EQ(metrics.handshakes, 0);
+}
+
+TEST_F(HttpServerTest, timesHandshakes) {
+    options.tls = std::make_shared<TlsContext>("data/cert.pem", "data/key.pem");
+    options.threads = 1;
+    start();
+    for (auto i = 0; i < 2; ++i) {
+        SSLSocket client(Address("127.0.0.1", options.port));
+        client.write("GET / HTTP/1.1\r\n\r\n");
+        readResponse(client);
+    }
+    const auto metrics = server->metrics();
+    ASSERT_EQ(metrics.handshakes, 2);
+    ASSERT_EQ(metrics.handshakeFailures, 0);
+    ASSERT_EQ(metrics.handshakeTime.count, 2);
+    ASSERT_GT(metrics.handshakeTime.sum, 0);
+    // accept() is timed apart from the handshake
+    ASSERT_EQ(metrics.acceptTime.count, 2);
+    ASSERT_GT(metrics.acceptTime.sum, 0);
+
+    // without timings only the counters are kept
+    server.reset();
+    options.timingInterval = 0;
+    start();
+    SSLSocket client(Address("127.0.0.1", options.port));
+    client.write("GET / HTTP/1.1\r\n\r\n");
+    readResponse(client);
+    const auto untimed = server->metrics();
+    ASSERT_EQ(untimed.requests, 1);
+    ASSERT_EQ(untimed.acceptTime.count, 0);
+    ASSERT_EQ(untimed.handshakeTime.count, 0);
+    ASSERT_EQ(untimed.parseTime.count, 0);
+    ASSERT_EQ(untimed.handlerTime.count, 0);
+}
+
+TEST(ReusePortTest, sharesPort) {
+    const auto listen = [](port_t port, bool reusePort) { TcpSocket listener(Address(port), reusePort); };
+    const auto port = nextPort();
+    TcpSocket first(Address(port), true);
+    ASSERT_NO_THROW(listen(port, true));
+    const auto other = nextPort();
+    TcpSocket exclusive{ Address(other) };
+    ASSERT_THROW(listen(other, false), std::runtime_error);
+}
\ No newline at end of file
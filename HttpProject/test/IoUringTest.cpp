@@ -0,0 +1,175 @@
+/// \file Tests running socket operations on an io_uring
+#include <gtest/gtest.h>
+#include "TestServer.h"
+#include <IoUring.h>
+#include <Socket.h>
+#include <Address.h>
+#include <chrono>
+#include <cerrno>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+class IoUringTest : public testing::Test {
+protected:
+    void SetUp() override {
+        if (!IoUring::supported())
+            GTEST_SKIP() << "io_uring isn't supported";
+    }
+
+    /// @return the completions of the ring until `count` have been taken
+    static std::vector<IoUring::Completion> complete(IoUring& ring, size_t count) {
+        std::vector<IoUring::Completion> completions;
+        IoUring::Completion completion;
+        while (completions.size() < count) {
+            ring.submit(1, std::chrono::microseconds(1s));
+            const auto before = completions.size();
+            while (ring.next(completion))
+                completions.push_back(completion);
+            if (completions.size() == before)
+                break; // timed out
+        }
+        return completions;
+    }
+};
+
+TEST_F(IoUringTest, acceptsAndReceivesMultishot) {
+    const auto port = nextPort();
+    TcpSocket listener(Address{ port });
+    IoUring ring;
+    ring.accept(static_cast<int>(listener.handle()), 1);
+    std::vector<TcpSocket> clients;
+    for (auto i = 0; i < 3; ++i)
+        clients.emplace_back(Address("127.0.0.1", port));
+    const auto accepted = complete(ring, 3);
+    ASSERT_EQ(accepted.size(), 3);
+    for (size_t i = 0; i < accepted.size(); ++i) {
+        ASSERT_EQ(accepted[i].tag, 1);
+        ASSERT_GE(accepted[i].result, 0);
+        // the accept stays armed
+        ASSERT_TRUE(accepted[i].more);
+        ring.receive(accepted[i].result, 10 + i);
+    }
+    for (size_t i = 0; i < clients.size(); ++i)
+        clients[i].write("message " + std::to_string(i));
+    const auto received = complete(ring, 3);
+    ASSERT_EQ(received.size(), 3);
+    for (const auto& completion : received) {
+        ASSERT_TRUE(completion.hasBuffer) << completion.result;
+        ASSERT_TRUE(completion.more);
+        const std::string_view data(ring.buffer(completion.buffer),
+            static_cast<size_t>(completion.result));
+        ASSERT_EQ(data, "message " + std::to_string(completion.tag - 10));
+        ring.recycle(completion.buffer);
+    }
+    for (const auto& completion : accepted)
+        close(completion.result);
+}
+
+TEST_F(IoUringTest, recyclesProvidedBuffers) {
+    const auto port = nextPort();
+    TcpSocket listener(Address{ port });
+    TcpSocket client(Address("127.0.0.1", port));
+    auto connection = listener.accept();
+    // far less room than the data sent, so the buffers are reused
+    IoUring ring(8, 2, 16, 0);
+    std::string sent;
+    for (auto i = 0; i < 100; ++i)
+        sent += std::to_string(i) + ' ';
+    client.write(sent);
+    ring.receive(static_cast<int>(connection.handle()), 1);
+    std::string received;
+    while (received.size() < sent.size()) {
+        const auto completions = complete(ring, 1);
+        ASSERT_FALSE(completions.empty());
+        auto rearm = false;
+        for (const auto& completion : completions) {
+            if (completion.hasBuffer) {
+                received.append(ring.buffer(completion.buffer),
+                    static_cast<size_t>(completion.result));
+                ring.recycle(completion.buffer);
+            }
+            else
+                ASSERT_EQ(completion.result, -ENOBUFS);
+            // the receive stops once the buffers run out
+            rearm = !completion.more;
+        }
+        if (rearm)
+            ring.receive(static_cast<int>(connection.handle()), 1);
+    }
+    ASSERT_EQ(received, sent);
+}
+
+TEST_F(IoUringTest, sendsAndWritesFixed) {
+    const auto port = nextPort();
+    TcpSocket listener(Address{ port });
+    TcpSocket client(Address("127.0.0.1", port));
+    auto connection = listener.accept();
+    IoUring ring;
+    ASSERT_NE(ring.fixed(), nullptr);
+    const std::string_view fixed = "from the fixed buffer";
+    std::copy(fixed.begin(), fixed.end(), ring.fixed());
+    ring.send(static_cast<int>(connection.handle()), "sent ", 5, 1);
+    ring.submit(1);
+    ring.write_fixed(static_cast<int>(connection.handle()), ring.fixed(), fixed.size(), 2);
+    const auto completions = complete(ring, 2);
+    ASSERT_EQ(completions.size(), 2);
+    ASSERT_EQ(completions[0].result, 5);
+    ASSERT_EQ(completions[1].result, static_cast<int>(fixed.size()));
+    const auto read = client.read(5 + fixed.size());
+    ASSERT_EQ(std::string(read.begin(), read.end()), "sent from the fixed buffer");
+}
+
+TEST_F(IoUringTest, queuesPastFullQueues) {
+    const auto port = nextPort();
+    TcpSocket listener(Address{ port });
+    TcpSocket client(Address("127.0.0.1", port));
+    auto connection = listener.accept();
+    // many times the room of both queues, with no completion taken while queueing
+    IoUring ring(4, 8, 64, 0);
+    const std::string data(100, 'x');
+    for (auto i = 0; i < 100; ++i)
+        ring.send(static_cast<int>(connection.handle()), data.data() + i, 1, i);
+    const auto completions = complete(ring, 100);
+    ASSERT_EQ(completions.size(), 100);
+    std::vector<bool> seen(100);
+    for (const auto& completion : completions) {
+        ASSERT_EQ(completion.result, 1);
+        ASSERT_LT(completion.tag, 100);
+        ASSERT_FALSE(seen[completion.tag]);
+        seen[completion.tag] = true;
+    }
+    ASSERT_EQ(client.read(100).size(), 100);
+}
+
+TEST_F(IoUringTest, cancelsAndPolls) {
+    const auto port = nextPort();
+    TcpSocket listener(Address{ port });
+    TcpSocket client(Address("127.0.0.1", port));
+    auto connection = listener.accept();
+    IoUring ring;
+    ring.receive(static_cast<int>(connection.handle()), 1);
+    ring.poll(static_cast<int>(connection.handle()), true, false, 2);
+    ring.submit(0);
+    ring.cancel(1, 3);
+    auto completions = complete(ring, 3);
+    ASSERT_EQ(completions.size(), 3);
+    for (const auto& completion : completions) {
+        ASSERT_FALSE(completion.more);
+        if (completion.tag == 1)
+            ASSERT_EQ(completion.result, -ECANCELED);
+        else if (completion.tag == 2)
+            ASSERT_NE(completion.result, 0); // the socket is writable
+        else
+            ASSERT_EQ(completion.result, 0);
+    }
+
+    // without operations the wait ends with the timeout
+    const auto start = std::chrono::steady_clock::now();
+    ring.submit(1, std::chrono::microseconds(20ms));
+    IoUring::Completion completion;
+    ASSERT_FALSE(ring.next(completion));
+    ASSERT_GE(std::chrono::steady_clock::now() - start, 15ms);
+}
@@ -0,0 +1,223 @@
+/// \file Tests the latency histogram and the load generator
+#include <gtest/gtest.h>
+#include "TestServer.h"
+#include <LatencyHistogram.h>
+#include <LoadGenerator.h>
+#include <HttpServer.h>
+#include <Socket.h>
+#include <Address.h>
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+TEST(LatencyHistogramTest, buckets) {
+    // small values have a bucket each
+    for (uint64_t value = 0; value < LatencyHistogram::subBucketCount; ++value) {
+        ASSERT_EQ(LatencyHistogram::bucket_index(value), value);
+        ASSERT_EQ(LatencyHistogram::bucket_max(value), value);
+    }
+    // every value is in the bucket whose range covers it, with a bounded error
+    for (uint64_t value = 1000; value < LatencyHistogram::maxValue; value = value * 3 / 2 + 7) {
+        const auto index = LatencyHistogram::bucket_index(value);
+        const auto max = LatencyHistogram::bucket_max(index);
+        ASSERT_GE(max, value);
+        ASSERT_LT(max - value, value / 1024 + 1) << value;
+        ASSERT_LT(LatencyHistogram::bucket_max(index - 1), value) << value;
+    }
+    // buckets cover the values without gaps
+    for (size_t index = 1; index < LatencyHistogram::bucket_index(uint64_t(1) << 24); ++index) {
+        ASSERT_EQ(LatencyHistogram::bucket_index(LatencyHistogram::bucket_max(index - 1) + 1),
+            index);
+    }
+    ASSERT_EQ(LatencyHistogram::bucket_index(UINT64_MAX),
+        LatencyHistogram::bucket_index(LatencyHistogram::maxValue));
+}
+
+TEST(LatencyHistogramTest, percentiles) {
+    LatencyHistogram histogram;
+    ASSERT_EQ(histogram.count(), 0);
+    ASSERT_EQ(histogram.percentile(50), 0);
+    ASSERT_EQ(histogram.min(), 0);
+
+    // 1 to 100 microseconds
+    for (uint64_t i = 1; i <= 100; ++i)
+        histogram.record(std::chrono::microseconds(i));
+    ASSERT_EQ(histogram.count(), 100);
+    ASSERT_EQ(histogram.min(), 1000);
+    ASSERT_EQ(histogram.max(), 100000);
+    ASSERT_DOUBLE_EQ(histogram.mean(), 50500);
+    ASSERT_NEAR(histogram.percentile(50), 50000, 50);
+    ASSERT_NEAR(histogram.percentile(99), 99000, 100);
+    ASSERT_EQ(histogram.percentile(100), 100000);
+    ASSERT_NEAR(histogram.percentile(0), 1000, 1);
+
+    // a long tail shows in the high percentiles but not the median
+    LatencyHistogram tail;
+    for (auto i = 0; i < 999; ++i)
+        tail.record(2000);
+    tail.record(std::chrono::seconds(1));
+    ASSERT_EQ(tail.percentile(50), 2000);
+    ASSERT_EQ(tail.percentile(99.9), 2000);
+    ASSERT_NEAR(tail.percentile(99.99), 1e9, 1e6);
+    ASSERT_EQ(tail.max(), 1000000000);
+}
+
+TEST(LatencyHistogramTest, mergesAndResets) {
+    LatencyHistogram first, second;
+    for (auto i = 0; i < 10; ++i) {
+        first.record(100);
+        second.record(300);
+    }
+    second.record(std::chrono::nanoseconds(-5));
+    first.merge(second);
+    ASSERT_EQ(first.count(), 21);
+    ASSERT_EQ(first.min(), 0);
+    ASSERT_EQ(first.max(), 300);
+    ASSERT_EQ(first.percentile(60), 300);
+    ASSERT_EQ(first.percentile(50), 100);
+
+    first.reset();
+    ASSERT_EQ(first.count(), 0);
+    ASSERT_EQ(first.max(), 0);
+    ASSERT_EQ(first.percentile(99), 0);
+}
+
+/// Answers every request with a short body, or 404 for /missing
+void helloHandler(const HttpRequestFrame& request, HttpResponseFrame& response) {
+    if (request.path == "/missing")
+        response.responseCode = HttpResponse::not_found;
+    response.content = "hello";
+}
+
+class LoadGeneratorTest : public testing::Test {
+protected:
+    ServerOptions serverOptions;
+    LoadOptions options;
+    std::unique_ptr<HttpServer> server;
+
+    void start() {
+        serverOptions.port = options.port = nextPort();
+        server = std::make_unique<HttpServer>(serverOptions, &helloHandler);
+        server->start();
+    }
+
+    /// @return the requests the server answered
+    uint64_t served() const {
+        uint64_t total = 0;
+        for (const auto& stats : server->stats())
+            total += stats.requests;
+        return total;
+    }
+public:
+    LoadGeneratorTest() {
+        serverOptions.threads = 2;
+        serverOptions.maxRequestsPerConnection = 0;
+        options.connections = 4;
+        options.threads = 2;
+        options.duration = std::chrono::milliseconds(300);
+    }
+};
+
+TEST_F(LoadGeneratorTest, runsClosedLoop) {
+    start();
+    const auto result = run_load(options);
+    ASSERT_GT(result.responses, 100);
+    ASSERT_EQ(result.errorResponses, 0);
+    ASSERT_EQ(result.failures, 0);
+    ASSERT_EQ(result.reconnects, 0);
+    ASSERT_EQ(result.latency.count(), result.responses);
+    ASSERT_GT(result.latency.min(), 0);
+    ASSERT_LE(result.latency.percentile(50), result.latency.max());
+    ASSERT_GE(result.elapsed, options.duration);
+    ASSERT_GT(result.throughput(), 0);
+    // requests unanswered at the end are the only ones not counted
+    ASSERT_LE(served() - result.responses, options.connections);
+}
+
+TEST_F(LoadGeneratorTest, runsOpenLoop) {
+    start();
+    options.rate = 200;
+    options.duration = std::chrono::milliseconds(500);
+    const auto result = run_load(options);
+    // 100 requests are scheduled, and the server keeps up with them
+    ASSERT_GE(result.responses, 90);
+    ASSERT_LE(result.responses, 101);
+    ASSERT_EQ(result.failures, 0);
+}
+
+TEST_F(LoadGeneratorTest, countsErrorResponses) {
+    start();
+    options.request = "GET /missing HTTP/1.1\r\n\r\n";
+    const auto result = run_load(options);
+    ASSERT_GT(result.responses, 0);
+    ASSERT_EQ(result.errorResponses, result.responses);
+
+    options.request = "HEAD / HTTP/1.1\r\n\r\n";
+    const auto head = run_load(options);
+    ASSERT_GT(head.responses, 0);
+    ASSERT_EQ(head.errorResponses, 0);
+    ASSERT_EQ(head.failures, 0);
+}
+
+TEST_F(LoadGeneratorTest, reconnects) {
+    serverOptions.maxRequestsPerConnection = 1;
+    start();
+    options.connections = 2;
+    options.threads = 1;
+    const auto result = run_load(options);
+    ASSERT_GT(result.responses, 10);
+    ASSERT_EQ(result.failures, 0);
+    // every response but the last of each connection closed its connection
+    ASSERT_GE(result.reconnects, result.responses - options.connections);
+}
+
+TEST_F(LoadGeneratorTest, runsOverTls) {
+    serverOptions.tls = std::make_shared<TlsContext>("data/cert.pem", "data/key.pem");
+    start();
+    options.tls = true;
+    const auto result = run_load(options);
+    ASSERT_GT(result.responses, 10);
+    ASSERT_EQ(result.failures, 0);
+}
+
+TEST_F(LoadGeneratorTest, readsChunkedAndClosedBodies) {
+    options.port = nextPort();
+    options.connections = 1;
+    options.threads = 1;
+    options.duration = std::chrono::milliseconds(200);
+    TcpSocket listener(Address(options.port));
+    std::atomic<bool> done = false;
+    // answers with a chunked body, then with a body ended by closing the connection
+    std::thread stub([&]() {
+        while (!done) {
+            auto client = listener.try_accept();
+            if (!client) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+            try {
+                client->read(0);
+                client->write("HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n"
+                    "3\r\nhel\r\n2\r\nlo\r\n0\r\n\r\n");
+                client->read(0);
+                client->write("HTTP/1.1 200 OK\r\n\r\nhello");
+            }
+            catch (const std::runtime_error&) {}
+        }
+    });
+    const auto result = run_load(options);
+    done = true;
+    stub.join();
+    ASSERT_GT(result.responses, 4);
+    ASSERT_EQ(result.failures, 0);
+    ASSERT_GE(result.reconnects, result.responses / 2 - 1);
+}
+
+TEST_F(LoadGeneratorTest, failsWithoutServer) {
+    options.port = nextPort();
+    ASSERT_THROW(run_load(options), std::runtime_error);
+    options.connections = 0;
+    ASSERT_THROW(run_load(options), std::invalid_argument);
+}
@@ -0,0 +1,104 @@
+/// \file Tests the counters and histograms of the server metrics
+#include <gtest/gtest.h>
+#include <Metrics.h>
+#include <string>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+TEST(MetricsTest, counts) {
+    MetricCounter counter;
+    ASSERT_EQ(counter.get(), 0);
+    counter.add();
+    counter.add(41);
+    ASSERT_EQ(counter.get(), 42);
+    counter.set(7);
+    ASSERT_EQ(counter.get(), 7);
+
+    // read while another thread adds
+    std::thread writer([&counter]() {
+        for (auto i = 0; i < 100000; ++i)
+            counter.add();
+    });
+    uint64_t last = 0;
+    for (auto i = 0; i < 1000; ++i) {
+        const auto value = counter.get();
+        ASSERT_GE(value, last);
+        last = value;
+    }
+    writer.join();
+    ASSERT_EQ(counter.get(), 100007);
+}
+
+TEST(MetricsTest, buckets) {
+    ASSERT_EQ(MetricHistogram::bucket_index(-5ns), 0);
+    ASSERT_EQ(MetricHistogram::bucket_index(0ns), 0);
+    ASSERT_EQ(MetricHistogram::bucket_index(1us), 0);
+    ASSERT_EQ(MetricHistogram::bucket_index(1001ns), 1);
+    ASSERT_EQ(MetricHistogram::bucket_index(2us), 1);
+    ASSERT_EQ(MetricHistogram::bucket_index(3us), 2);
+    ASSERT_EQ(MetricHistogram::bucket_index(4us), 2);
+    ASSERT_EQ(MetricHistogram::bucket_index(1024us), 10);
+    ASSERT_EQ(MetricHistogram::bucket_index(1025us), 11);
+    ASSERT_EQ(MetricHistogram::bucket_index(16777216us), 24);
+    ASSERT_EQ(MetricHistogram::bucket_index(20s), MetricHistogram::boundedBuckets);
+    ASSERT_EQ(MetricHistogram::bucket_index(1h), MetricHistogram::boundedBuckets);
+    // every duration is at most the bound of its bucket and above the previous bound
+    for (auto ns = 1001; ns < 100000000; ns = ns * 5 / 4) {
+        const auto index = MetricHistogram::bucket_index(std::chrono::nanoseconds(ns));
+        ASSERT_LE(ns * 1e-9, MetricHistogram::bucket_bound(index) * (1 + 1e-12));
+        ASSERT_GT(ns * 1e-9, MetricHistogram::bucket_bound(index - 1));
+    }
+}
+
+TEST(MetricsTest, snapshots) {
+    MetricHistogram first, second;
+    first.record(500ns);
+    first.record(3us);
+    second.record(3us);
+    second.record(1min);
+    auto total = first.snapshot();
+    ASSERT_EQ(total.count, 2);
+    ASSERT_EQ(total.sum, 3500);
+    total += second.snapshot();
+    ASSERT_EQ(total.count, 4);
+    ASSERT_EQ(total.buckets[0], 1);
+    ASSERT_EQ(total.buckets[2], 2);
+    ASSERT_EQ(total.buckets[MetricHistogram::boundedBuckets], 1);
+    ASSERT_EQ(total.sum, 60000006500);
+}
+
+TEST(MetricsTest, writesPrometheus) {
+    ServerMetrics metrics;
+    metrics.connectionsAccepted = 5;
+    metrics.connectionsClosed = 2;
+    metrics.requests = 12;
+    MetricHistogram handler;
+    handler.record(1500ns);
+    handler.record(1500ns);
+    handler.record(3ms);
+    metrics.handlerTime = handler.snapshot();
+
+    std::string out;
+    metrics.write_prometheus(out);
+    ASSERT_NE(out.find("# TYPE http_connections_accepted_total counter\n"
+        "http_connections_accepted_total 5\n"), std::string::npos);
+    ASSERT_NE(out.find("# TYPE http_connections_active gauge\nhttp_connections_active 3\n"),
+        std::string::npos);
+    ASSERT_NE(out.find("\nhttp_requests_total 12\n"), std::string::npos);
+    ASSERT_NE(out.find("# TYPE http_handler_duration_seconds histogram\n"), std::string::npos);
+    // buckets are cumulative
+    ASSERT_NE(out.find("http_handler_duration_seconds_bucket{le=\"1e-06\"} 0\n"
+        "http_handler_duration_seconds_bucket{le=\"2e-06\"} 2\n"), std::string::npos);
+    ASSERT_NE(out.find("http_handler_duration_seconds_bucket{le=\"0.004096\"} 3\n"),
+        std::string::npos);
+    ASSERT_NE(out.find("http_handler_duration_seconds_bucket{le=\"16.777216\"} 3\n"
+        "http_handler_duration_seconds_bucket{le=\"+Inf\"} 3\n"
+        "http_handler_duration_seconds_sum 0.003003000\n"
+        "http_handler_duration_seconds_count 3\n"), std::string::npos);
+    ASSERT_NE(out.find("http_request_parse_duration_seconds_count 0\n"), std::string::npos);
+    ASSERT_NE(out.find("# TYPE http_accept_duration_seconds histogram\n"), std::string::npos);
+    ASSERT_NE(out.find("# TYPE http_tls_handshake_duration_seconds histogram\n"),
+        std::string::npos);
+    ASSERT_EQ(out.back(), '\n');
+}
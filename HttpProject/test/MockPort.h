@@ -13,6 +13,10 @@ public:
 
     MOCK_METHOD(std::vector<char>, try_read, (), (override));
 
+    MOCK_METHOD(size_t, read_into, (char*, size_t, size_t), (override));
+
+    MOCK_METHOD(size_t, try_read_into, (char*, size_t), (override));
+
     MOCK_METHOD(void, add_to_fd, (FdSet&), (const, override));
 
     MOCK_METHOD(void, remove_from_fd, (FdSet&), (const, override));
@@ -0,0 +1,63 @@
+/// \file Tests the per-thread pool of fixed size blocks
+#include <gtest/gtest.h>
+#include <ObjectPool.h>
+#include <thread>
+#include <vector>
+
+struct Pooled {
+    char data[48];
+};
+
+TEST(ObjectPoolTest, reusesFreedBlocks) {
+    using Pool = ObjectPool<Pooled, 2>;
+    const auto a = Pool::allocate();
+    const auto b = Pool::allocate();
+    const auto c = Pool::allocate();
+    ASSERT_NE(a, b);
+    Pool::deallocate(a);
+    Pool::deallocate(b);
+    // past MaxFree blocks are freed instead of kept
+    Pool::deallocate(c);
+    const auto d = Pool::allocate();
+    const auto e = Pool::allocate();
+    ASSERT_EQ(d, b);
+    ASSERT_EQ(e, a);
+    Pool::deallocate(d);
+    Pool::deallocate(e);
+}
+
+TEST(ObjectPoolTest, freesOnOtherThreads) {
+    using Pool = ObjectPool<Pooled>;
+    std::vector<void*> blocks;
+    for (auto i = 0; i < 100; ++i)
+        blocks.push_back(Pool::allocate());
+    // blocks freed on a thread are reused by that thread, then freed when it exits
+    std::thread([&blocks]() {
+        for (const auto block : blocks)
+            Pool::deallocate(block);
+        const auto reused = Pool::allocate();
+        EXPECT_EQ(reused, blocks.back());
+        Pool::deallocate(reused);
+    }).join();
+    const auto block = Pool::allocate();
+    static_cast<Pooled*>(block)->data[0] = 'a';
+    Pool::deallocate(block);
+}
+
+TEST(ObjectPoolTest, freesAfterThreadListIsDestroyed) {
+    using Pool = ObjectPool<Pooled>;
+    /// Frees its block when the thread exits
+    struct Holder {
+        void* block = nullptr;
+        ~Holder() {
+            if (block != nullptr)
+                Pool::deallocate(block);
+        }
+    };
+    std::thread([]() {
+        // constructed before the thread's free list, so destroyed after it
+        thread_local Holder holder;
+        holder.block = Pool::allocate();
+        Pool::deallocate(Pool::allocate());
+    }).join();
+}
@@ -1,6 +1,9 @@
 /// \file Tests the parsing of URL encoded payloads in HTTP requests
 #include "MockPort.h"
 #include <gtest/gtest.h>
+#include <HttpRequestParser.h>
+#include <HttpRequestFrame.h>
+#include <UrlEncoding.h>
 #include <map>
 #include <string>
 #include <random>
@@ -47,8 +50,7 @@ protected:
 
     /// URL encodes the given parameter
     auto url_encode(const std::string& s) const {
-        //TODO
-        return s;
+        return ::url_encode(s);
     }
 
     /**
@@ -71,7 +73,7 @@ protected:
         std::stringstream ss;
         if (rand() % 2) {
             ss << "GET /index.html?" << query_params_to_str()
-                << "HTTP/1.1\r\n"
+                << " HTTP/1.1\r\n"
                 << "Host: 127.0.0.1\r\n"
                 << "Accept: */*\r\n\r\n";
         }
@@ -79,12 +81,12 @@ protected:
             const auto data = query_params_to_str();
             ss << "POST /index.html HTTP/1.1\r\n"
                 << "Host: 127.0.0.1\r\n"
-                << "Content-Type: application/x-www-form-urlencode\r\n"
+                << "Content-Type: application/x-www-form-urlencoded\r\n"
                 << "Content-Length: " << data.size() << "\r\n\r\n"
-                << data << "\r\n";
+                << data;
         }
-        return { std::istream_iterator<char>(ss), 
-            std::istream_iterator<char>() };
+        const auto message = ss.str();
+        return { message.begin(), message.end() };
     }
 public:
     QueryTestFixture() {
@@ -99,5 +101,99 @@ public:
 };
 
 TEST_F(QueryTestFixture, parseUrlEncode) {
-    ASSERT_THAT(port.read(), Not(IsEmpty()));
+    // query strings of the random params are far larger than real ones
+    HttpRequestParser parser(1 << 20);
+    QueryParams params;
+    for (auto i = 0; i < 50; ++i) {
+        const auto message = port.read();
+        ASSERT_THAT(message, Not(IsEmpty()));
+        parser.feed({ message.data(), message.size() });
+        ASSERT_EQ(parser.parse(), HttpRequestParser::Status::Done);
+        HttpRequestFrame frame;
+        parser.fill(frame);
+        if (frame.protocol == HttpFrame::Protocol::POST) {
+            frame.content = parser.buffered_body();
+            ASSERT_TRUE(params.parse_form(frame));
+        }
+        else {
+            ASSERT_FALSE(params.parse_form(frame));
+            params.parse_query(frame);
+        }
+        parser.consume(parser.buffered_body().size());
+
+        std::map<std::string, std::string> parsed;
+        for (const auto [key, value] : params)
+            parsed.emplace(key, value);
+        ASSERT_THAT(parsed, ContainerEq(lastQueryData));
+        const auto& [firstKey, firstValue] = *lastQueryData.begin();
+        ASSERT_EQ(params.find(firstKey), firstValue);
+    }
+}
+
+TEST(UrlEncodingTest, decodeInPlace) {
+    const auto decode = [](std::string s, bool plusIsSpace = true) {
+        s.resize(url_decode_in_place(s.data(), s.size(), plusIsSpace));
+        return s;
+    };
+    ASSERT_EQ(decode("a+b%20c%2Bd%2b"), "a b c+d+");
+    ASSERT_EQ(decode("a+b", false), "a+b");
+    ASSERT_EQ(decode("%41%4a%4A"), "AJJ");
+    // malformed escapes are kept
+    ASSERT_EQ(decode("100%"), "100%");
+    ASSERT_EQ(decode("%zz%4"), "%zz%4");
+    ASSERT_EQ(decode("%%41"), "%A");
+    ASSERT_EQ(decode(""), "");
+    // escapes at every offset of the SIMD blocks
+    for (size_t i = 0; i < 70; ++i) {
+        ASSERT_EQ(decode(std::string(i, 'x') + "%3D" + std::string(70 - i, 'y')),
+            std::string(i, 'x') + "=" + std::string(70 - i, 'y'));
+    }
+}
+
+TEST(UrlEncodingTest, encodeRoundTrip) {
+    std::string all;
+    for (auto c = 0; c < 256; ++c)
+        all.push_back(static_cast<char>(c));
+    for (const auto form : { true, false }) {
+        auto encoded = url_encode(all, form);
+        ASSERT_EQ(encoded.find_first_not_of(
+            "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-._~*%+"),
+            std::string::npos);
+        encoded.resize(url_decode_in_place(encoded.data(), encoded.size(), form));
+        ASSERT_EQ(encoded, all);
+    }
+    ASSERT_EQ(url_encode("a b&c=d~"), "a+b%26c%3Dd%7E");
+    ASSERT_EQ(url_encode("a b&c=d~", false), "a%20b%26c%3Dd~");
+}
+
+TEST(UrlEncodingTest, queryParams) {
+    ASSERT_EQ(query_string("/index.html?a=1&b=2#top"), "a=1&b=2");
+    ASSERT_EQ(query_string("/index.html"), "");
+
+    QueryParams params;
+    params.parse("a=1&&flag&b=&=v&c=x%3Dy&a=2");
+    ASSERT_EQ(params.size(), 6);
+    ASSERT_EQ(params.find("a"), "1");
+    ASSERT_EQ(params.find("flag"), "");
+    ASSERT_EQ(params.find("b"), "");
+    ASSERT_EQ(params.find(""), "v");
+    ASSERT_EQ(params.find("c"), "x=y");
+    ASSERT_FALSE(params.find("d"));
+    ASSERT_EQ(params[5].value, "2");
+
+    // decoding in place leaves the params in the caller's buffer
+    std::string form = "name=John+Smith&city=New%20York";
+    params.parse_in_place(form.data(), form.size());
+    ASSERT_EQ(params.find("name"), "John Smith");
+    ASSERT_GE(params[1].value.data(), form.data());
+    ASSERT_LT(params[1].value.data(), form.data() + form.size());
+
+    HttpRequestFrame frame;
+    frame.content = "a=1";
+    frame[KnownHeader::ContentType] = "Application/X-WWW-Form-Urlencoded; charset=utf-8";
+    ASSERT_TRUE(params.parse_form(frame));
+    ASSERT_EQ(params.find("a"), "1");
+    frame[KnownHeader::ContentType] = "application/x-www-form-urlencodedx";
+    ASSERT_FALSE(params.parse_form(frame));
+    ASSERT_TRUE(params.empty());
 }
\ No newline at end of file
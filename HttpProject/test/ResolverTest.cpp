@@ -0,0 +1,205 @@
+/// \file Tests parsing addresses, resolving names and racing connections to them
+#include <gtest/gtest.h>
+#include <Resolver.h>
+#include <Address.h>
+#include <Networking.h>
+#include <Socket.h>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <stdexcept>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+constexpr unsigned short portBase = 13430;
+
+/// Options whose lookups count themselves and fail only for "missing"
+ResolverOptions stub_options(std::atomic<int>& lookups) {
+    ResolverOptions options;
+    options.lookup = [&lookups](const std::string& name) {
+        ++lookups;
+        if (name == "missing")
+            throw std::runtime_error("Failed to resolve missing");
+        return std::vector<Address>{ *Address::from_ip("10.0.0.1", 0),
+            *Address::from_ip("fd00::1", 0) };
+    };
+    return options;
+}
+
+TEST(ResolverTest, parsesIps) {
+    const auto v4 = Address::from_ip("127.0.0.1", 80);
+    ASSERT_TRUE(v4);
+    ASSERT_EQ(v4->family(), AF_INET);
+    ASSERT_EQ(v4->port(), 80);
+    ASSERT_EQ(v4->to_string(), "127.0.0.1:80");
+    ASSERT_FALSE(v4->is_server());
+
+    const auto v6 = Address::from_ip("::1", 443);
+    ASSERT_TRUE(v6);
+    ASSERT_EQ(v6->family(), AF_INET6);
+    ASSERT_EQ(v6->to_string(), "[::1]:443");
+    ASSERT_EQ(Address::from_ip("[::1]", 443), v6);
+    ASSERT_NE(Address::from_ip("::1", 444), v6);
+
+    ASSERT_FALSE(Address::from_ip("localhost", 80));
+    ASSERT_FALSE(Address::from_ip("1.2.3", 80));
+    ASSERT_TRUE(Address(80).is_server());
+    ASSERT_TRUE(Address::from_ip("::", 80)->is_server());
+}
+
+TEST(ResolverTest, resolvesHostsFile) {
+    Resolver resolver;
+    const auto addresses = resolver.resolve("localhost", 8080);
+    ASSERT_FALSE(addresses.empty());
+    for (const auto& address : addresses)
+        ASSERT_EQ(address.port(), 8080);
+    ASSERT_EQ(Address("LocalHost", 80).port(), 80);
+    ASSERT_THROW(resolver.resolve("name.invalid", 80), std::runtime_error);
+}
+
+TEST(ResolverTest, caches) {
+    std::atomic<int> lookups{ 0 };
+    Resolver resolver(stub_options(lookups));
+    const auto first = resolver.resolve("example.test", 80);
+    ASSERT_EQ(first.size(), 2);
+    ASSERT_EQ(first[0].to_string(), "10.0.0.1:80");
+    ASSERT_EQ(first[1].to_string(), "[fd00::1]:80");
+    // the cached addresses get the port of each call
+    const auto second = resolver.resolve("Example.Test", 443);
+    ASSERT_EQ(second[0].to_string(), "10.0.0.1:443");
+    ASSERT_EQ(lookups, 1);
+    const auto stats = resolver.stats();
+    ASSERT_EQ(stats.hits, 1);
+    ASSERT_EQ(stats.misses, 1);
+    ASSERT_EQ(stats.lookups, 1);
+
+    resolver.clear();
+    resolver.resolve("example.test", 80);
+    ASSERT_EQ(lookups, 2);
+}
+
+TEST(ResolverTest, expires) {
+    std::atomic<int> lookups{ 0 };
+    auto options = stub_options(lookups);
+    options.ttl = 50ms;
+    options.negativeTtl = 50ms;
+    Resolver resolver(std::move(options));
+    resolver.resolve("example.test", 80);
+    ASSERT_THROW(resolver.resolve("missing", 80), std::runtime_error);
+    // failures are cached too
+    ASSERT_THROW(resolver.resolve("missing", 80), std::runtime_error);
+    resolver.resolve("example.test", 80);
+    ASSERT_EQ(lookups, 2);
+    std::this_thread::sleep_for(100ms);
+    resolver.resolve("example.test", 80);
+    ASSERT_THROW(resolver.resolve("missing", 80), std::runtime_error);
+    ASSERT_EQ(lookups, 4);
+}
+
+TEST(ResolverTest, evicts) {
+    std::atomic<int> lookups{ 0 };
+    auto options = stub_options(lookups);
+    options.maxEntries = 2;
+    Resolver resolver(std::move(options));
+    resolver.resolve("a.test", 80);
+    resolver.resolve("b.test", 80);
+    resolver.resolve("c.test", 80);
+    ASSERT_EQ(lookups, 3);
+    // a expired first, so it was evicted for c
+    resolver.resolve("c.test", 80);
+    resolver.resolve("b.test", 80);
+    ASSERT_EQ(lookups, 3);
+    resolver.resolve("a.test", 80);
+    ASSERT_EQ(lookups, 4);
+}
+
+TEST(ResolverTest, sharesLookups) {
+    std::atomic<int> lookups{ 0 };
+    std::promise<void> release;
+    auto released = release.get_future().share();
+    ResolverOptions options;
+    options.lookup = [&lookups, released](const std::string&) {
+        ++lookups;
+        released.wait();
+        return std::vector<Address>{ *Address::from_ip("10.0.0.1", 0) };
+    };
+    Resolver resolver(std::move(options));
+    std::vector<std::future<std::vector<Address>>> results;
+    for (unsigned short i = 0; i < 8; ++i)
+        results.push_back(resolver.resolve_async("slow.test", i));
+    std::atomic<int> called{ 0 };
+    resolver.resolve_async("slow.test", 99, [&called](std::vector<Address> addresses,
+        std::exception_ptr error)
+    {
+        if (!error && addresses.size() == 1 && addresses[0].port() == 99)
+            ++called;
+    });
+    release.set_value();
+    for (unsigned short i = 0; i < 8; ++i)
+        ASSERT_EQ(results[i].get().front().port(), i);
+    ASSERT_EQ(lookups, 1);
+    ASSERT_EQ(resolver.stats().misses, 9);
+    // the callback runs after the futures are set, so give it a moment
+    for (auto i = 0; i < 100 && called == 0; ++i)
+        std::this_thread::sleep_for(1ms);
+    ASSERT_EQ(called, 1);
+}
+
+TEST(ResolverTest, connectsByName) {
+    const Address serverAddr(portBase);
+    TcpSocket server(serverAddr);
+    TcpSocket client("localhost", portBase);
+    auto connection = server.accept();
+    client.write("hello");
+    ASSERT_EQ(connection.read(5).size(), 5);
+}
+
+TEST(ResolverTest, racesAddresses) {
+    // the first address refuses, so the next is tried without waiting for the delay
+    const auto listener = listen_socket(*Address::from_ip("127.0.0.1", portBase + 1));
+    const Address refused[] = { *Address::from_ip("127.0.0.1", portBase + 2),
+        *Address::from_ip("127.0.0.1", portBase + 1) };
+    size_t connected = 99;
+    auto start = std::chrono::steady_clock::now();
+    auto s = connect_socket(refused, 2, connected, 5s);
+    ASSERT_EQ(connected, 1);
+    ASSERT_LT(std::chrono::steady_clock::now() - start, 2s);
+    close_sock(s);
+
+    // an address which never answers loses to the next after the attempt delay
+    const Address silent[] = { *Address::from_ip("192.0.2.1", portBase + 1),
+        *Address::from_ip("10.255.255.1", portBase + 1),
+        *Address::from_ip("127.0.0.1", portBase + 1) };
+    start = std::chrono::steady_clock::now();
+    s = connect_socket(silent, 3, connected, 50ms);
+    ASSERT_EQ(connected, 2);
+    ASSERT_LT(std::chrono::steady_clock::now() - start, 2s);
+    close_sock(s);
+    close_sock(listener);
+
+    const Address none[] = { *Address::from_ip("127.0.0.1", portBase + 2) };
+    ASSERT_THROW(connect_socket(none, 1, connected), std::runtime_error);
+}
+
+TEST(ResolverTest, racesFamilies) {
+    socket_t listener;
+    try {
+        listener = listen_socket(*Address::from_ip("::1", portBase + 3));
+    }
+    catch (const std::runtime_error&) {
+        GTEST_SKIP() << "ipv6 is unavailable";
+    }
+    // the families alternate, so ::1 is tried second instead of after every ipv4 address
+    const Address addresses[] = { *Address::from_ip("192.0.2.1", portBase + 4),
+        *Address::from_ip("192.0.2.2", portBase + 4),
+        *Address::from_ip("192.0.2.3", portBase + 4),
+        *Address::from_ip("::1", portBase + 3) };
+    size_t connected = 99;
+    const auto start = std::chrono::steady_clock::now();
+    const auto s = connect_socket(addresses, 4, connected, 200ms);
+    ASSERT_EQ(connected, 3);
+    ASSERT_LT(std::chrono::steady_clock::now() - start, 400ms);
+    close_sock(s);
+    close_sock(listener);
+}
@@ -0,0 +1,278 @@
+/// \file Tests caching serialized responses
+#include <gtest/gtest.h>
+#include "TestServer.h"
+#include <ResponseCache.h>
+#include <HttpServer.h>
+#include <Socket.h>
+#include <Address.h>
+#include <atomic>
+#include <string>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+/// @return a GET request for a path
+HttpRequestFrame getRequest(std::string path) {
+    HttpRequestFrame request;
+    request.protocol = HttpFrame::Protocol::GET;
+    request.path = std::move(path);
+    return request;
+}
+
+/// @return a 200 response with a body and its Content-Length
+HttpResponseFrame okResponse(std::string content) {
+    HttpResponseFrame response;
+    response.responseCode = HttpResponse::ok;
+    response[KnownHeader::ContentLength] = std::to_string(content.size());
+    response.content = std::move(content);
+    return response;
+}
+
+TEST(ResponseCacheTest, etagMatches) {
+    ASSERT_TRUE(etag_matches("\"a\"", "\"a\""));
+    ASSERT_TRUE(etag_matches("*", "\"a\""));
+    ASSERT_TRUE(etag_matches("\"b\", W/\"a\"", "\"a\""));
+    ASSERT_TRUE(etag_matches("\"a,b\"", "\"a,b\""));
+    ASSERT_TRUE(etag_matches("\"a\"", "W/\"a\""));
+    ASSERT_FALSE(etag_matches("\"b\"", "\"a\""));
+    ASSERT_FALSE(etag_matches("a", "\"a\""));
+    ASSERT_FALSE(etag_matches("\"a", "\"a\""));
+    ASSERT_FALSE(etag_matches("", "\"a\""));
+}
+
+TEST(ResponseCacheTest, keys) {
+    CacheOptions options;
+    options.varyHeaders = { "Accept-Encoding" };
+    ResponseCache cache(options);
+    std::string a, b;
+    auto request = getRequest("/x?y=1");
+    ASSERT_TRUE(cache.make_key(request, a));
+    request.protocol = HttpFrame::Protocol::HEAD;
+    ASSERT_TRUE(cache.make_key(request, b));
+    ASSERT_EQ(a, b);
+    request["Accept-Encoding"] = "gzip";
+    ASSERT_TRUE(cache.make_key(request, b));
+    ASSERT_NE(a, b);
+    request["Authorization"] = "Basic eDp5";
+    ASSERT_FALSE(cache.make_key(request, b));
+    request = getRequest("/x?y=1");
+    request["Cookie"] = "id=1";
+    ASSERT_FALSE(cache.make_key(request, b));
+    request = getRequest("/x?y=1");
+    request.protocol = HttpFrame::Protocol::POST;
+    ASSERT_FALSE(cache.make_key(request, b));
+
+    auto response = okResponse("data");
+    ASSERT_TRUE(ResponseCache::cacheable(response));
+    response["Cache-Control"] = "max-age=10, private";
+    ASSERT_FALSE(ResponseCache::cacheable(response));
+    response = okResponse("data");
+    response["Set-Cookie"] = "id=1";
+    ASSERT_FALSE(ResponseCache::cacheable(response));
+    response = okResponse("data");
+    response.responseCode = HttpResponse::not_found;
+    ASSERT_FALSE(ResponseCache::cacheable(response));
+}
+
+TEST(ResponseCacheTest, storesAndExpires) {
+    CacheOptions options;
+    options.ttl = 10s;
+    ResponseCache cache(options);
+    const auto now = ResponseCache::Clock::now();
+    ASSERT_EQ(cache.find("GET /a", now), nullptr);
+
+    auto response = okResponse("hello");
+    const auto stored = cache.store("GET /a", response, now);
+    ASSERT_NE(stored, nullptr);
+    ASSERT_EQ(stored->etag, response.get("ETag"));
+    ASSERT_EQ(stored->etag.size(), 18);
+    ASSERT_EQ(stored->bytes, response.compose());
+    ASSERT_EQ(stored->tail(), "\r\nhello");
+    ASSERT_EQ(stored->head().substr(0, 17), "HTTP/1.1 200 OK\r\n");
+    ASSERT_EQ(stored->head().substr(stored->head().size() - 2), "\r\n");
+
+    ASSERT_EQ(cache.find("GET /a", now + 9s), stored);
+    ASSERT_EQ(cache.find("GET /a", now + 10s), nullptr);
+    // a handler's own entity tag is kept
+    response = okResponse("hello");
+    response["ETag"] = "\"v1\"";
+    ASSERT_EQ(cache.store("GET /a", response, now + 10s)->etag, "\"v1\"");
+    ASSERT_EQ(cache.find("GET /a", now + 11s)->etag, "\"v1\"");
+
+    const auto stats = cache.stats();
+    ASSERT_EQ(stats.hits, 2);
+    ASSERT_EQ(stats.misses, 2);
+    ASSERT_EQ(stats.stores, 2);
+    ASSERT_EQ(stats.entries, 1);
+    ASSERT_EQ(stats.bytes, cache.find("GET /a", now + 11s)->bytes.size());
+    cache.clear();
+    ASSERT_EQ(cache.find("GET /a", now), nullptr);
+    ASSERT_EQ(cache.stats().bytes, 0);
+}
+
+TEST(ResponseCacheTest, evictsUnusedEntries) {
+    CacheOptions options;
+    options.shards = 1;
+    const auto size = okResponse(std::string(100, 'x')).compose().size() + 30;
+    options.maxBytes = 4 * size;
+    ResponseCache cache(options);
+    const auto now = ResponseCache::Clock::now();
+    for (auto i = 0; i < 4; ++i) {
+        auto response = okResponse(std::string(100, 'x'));
+        cache.store("GET /" + std::to_string(i), response, now);
+    }
+    ASSERT_EQ(cache.stats().entries, 4);
+    ASSERT_EQ(cache.stats().evictions, 0);
+
+    // the first pass of the clock clears every mark, then evicts the oldest entry
+    auto response = okResponse(std::string(100, 'x'));
+    cache.store("GET /4", response, now);
+    ASSERT_EQ(cache.find("GET /0", now), nullptr);
+    ASSERT_EQ(cache.stats().evictions, 1);
+
+    // entries used since the hand passed them get a second chance
+    ASSERT_NE(cache.find("GET /1", now), nullptr);
+    response = okResponse(std::string(100, 'x'));
+    cache.store("GET /5", response, now);
+    ASSERT_NE(cache.find("GET /1", now), nullptr);
+    ASSERT_EQ(cache.find("GET /2", now), nullptr);
+    ASSERT_EQ(cache.stats().entries, 4);
+
+    // responses larger than a shard aren't stored
+    response = okResponse(std::string(4 * size, 'x'));
+    ASSERT_EQ(cache.store("GET /big", response, now), nullptr);
+    ASSERT_EQ(cache.stats().entries, 4);
+}
+
+TEST(ResponseCacheTest, concurrentLookups) {
+    ResponseCache cache;
+    const auto now = ResponseCache::Clock::now();
+    std::vector<std::thread> threads;
+    for (auto t = 0; t < 4; ++t) {
+        threads.emplace_back([&cache, now, t]() {
+            for (auto i = 0; i < 2000; ++i) {
+                const auto key = "GET /" + std::to_string((i * 7 + t) % 64);
+                if (const auto found = cache.find(key, now)) {
+                    EXPECT_EQ(found->tail(), "\r\n" + key);
+                    continue;
+                }
+                auto response = okResponse(key);
+                cache.store(key, response, now);
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    const auto stats = cache.stats();
+    ASSERT_EQ(stats.hits + stats.misses, 8000);
+    ASSERT_EQ(stats.entries, 64);
+}
+
+/// Reads from a socket until `data` ends with `end`
+std::string readUntil(TcpSocket& sock, std::string_view end, size_t count = 1) {
+    std::string data;
+    size_t found = 0;
+    for (size_t pos = 0; found < count;) {
+        const auto read = sock.read(0);
+        data.append(read.begin(), read.end());
+        while (found < count && (pos = data.find(end, pos)) != std::string::npos) {
+            pos += end.size();
+            ++found;
+        }
+        if (pos == std::string::npos)
+            pos = data.size() < end.size() ? 0 : data.size() - end.size() + 1;
+    }
+    return data;
+}
+
+TEST(ResponseCacheTest, serverAnswersFromCache) {
+    ServerOptions options;
+    options.port = nextPort();
+    options.threads = 1;
+    options.cache = std::make_shared<ResponseCache>();
+    std::atomic<int> calls{ 0 };
+    HttpServer server(options, [&calls](const HttpRequestFrame& request, HttpResponseFrame& response) {
+        ++calls;
+        if (request.path == "/private")
+            response["Cache-Control"] = "no-store";
+        response.content = "body of " + request.path;
+    });
+    server.start();
+    TcpSocket client{ Address("127.0.0.1", options.port) };
+
+    client.write("GET /a HTTP/1.1\r\n\r\n");
+    const auto first = readUntil(client, "body of /a");
+    const auto etagStart = first.find("ETag: ") + 6;
+    const auto etag = first.substr(etagStart, first.find("\r\n", etagStart) - etagStart);
+    ASSERT_EQ(etag.size(), 18);
+
+    // pipelined hits are batched with the handler's responses
+    client.write("GET /a HTTP/1.1\r\n\r\nHEAD /a HTTP/1.1\r\n\r\nGET /private HTTP/1.1\r\n\r\n"
+        "GET /a HTTP/1.1\r\n\r\n");
+    const auto pipelined = readUntil(client, "body of /a", 2);
+    ASSERT_EQ(pipelined.find("Content-Length: 10\r\nETag: " + etag + "\r\n\r\nbody of /a"
+        "HTTP/1.1 200 OK\r\n"), pipelined.find("Content-Length"));
+    ASSERT_NE(pipelined.find("body of /private"), std::string::npos);
+    ASSERT_EQ(calls, 2);
+
+    client.write("GET /a HTTP/1.1\r\nIf-None-Match: " + etag + "\r\n\r\n");
+    const auto revalidated = readUntil(client, "\r\n\r\n");
+    ASSERT_EQ(revalidated, "HTTP/1.1 304 Not Modified\r\nETag: " + etag + "\r\n\r\n");
+
+    // the connection header of a cached response depends on the request
+    client.write("GET /a HTTP/1.0\r\n\r\n");
+    const auto closing = readUntil(client, "body of /a");
+    ASSERT_NE(closing.find("Connection: close\r\n\r\nbody of /a"), std::string::npos);
+    ASSERT_EQ(calls, 2);
+
+    const auto stats = options.cache->stats();
+    ASSERT_EQ(stats.hits, 5);
+    ASSERT_EQ(stats.misses, 2);
+    ASSERT_EQ(stats.entries, 1);
+}
+
+TEST(ResponseCacheTest, serverKeepsResponsesPerCookie) {
+    ServerOptions options;
+    options.port = nextPort();
+    options.threads = 1;
+    // clients without cookies share the response, ones with cookies get their own
+    for (const auto& varyHeaders : { std::vector<std::string>{}, { "cookie" } }) {
+        CacheOptions cacheOptions;
+        cacheOptions.varyHeaders = varyHeaders;
+        options.cache = std::make_shared<ResponseCache>(std::move(cacheOptions));
+        HttpServer server(options, [](const HttpRequestFrame& request, HttpResponseFrame& response) {
+            const auto cookie = request.headers().find("Cookie");
+            response.content = "hello " + (cookie ? std::string(*cookie) : "guest") + ";";
+        });
+        server.start();
+        TcpSocket alice{ Address("127.0.0.1", options.port) };
+        TcpSocket bob{ Address("127.0.0.1", options.port) };
+        for (auto i = 0; i < 2; ++i) {
+            alice.write("GET / HTTP/1.1\r\nCookie: user=alice\r\n\r\n");
+            ASSERT_NE(readUntil(alice, ";").find("hello user=alice;"), std::string::npos);
+            bob.write("GET / HTTP/1.1\r\nCookie: user=bob\r\n\r\n");
+            ASSERT_NE(readUntil(bob, ";").find("hello user=bob;"), std::string::npos);
+        }
+        bob.write("GET / HTTP/1.1\r\n\r\n");
+        ASSERT_NE(readUntil(bob, ";").find("hello guest;"), std::string::npos);
+        const auto stats = options.cache->stats();
+        ASSERT_EQ(stats.entries, varyHeaders.empty() ? 1 : 3);
+        ASSERT_EQ(stats.hits, varyHeaders.empty() ? 0 : 2);
+        options.port = nextPort();
+    }
+}
+
+TEST(ResponseCacheTest, serverRevalidatesHandlerEtags) {
+    ServerOptions options;
+    options.port = nextPort();
+    options.threads = 1;
+    HttpServer server(options, [](const HttpRequestFrame&, HttpResponseFrame& response) {
+        response["ETag"] = "W/\"7\"";
+        response.content = "content";
+    });
+    server.start();
+    TcpSocket client{ Address("127.0.0.1", options.port) };
+    client.write("GET / HTTP/1.1\r\nIf-None-Match: \"6\", \"7\"\r\n\r\n");
+    const auto response = readUntil(client, "\r\n\r\n");
+    ASSERT_EQ(response, "HTTP/1.1 304 Not Modified\r\nETag: W/\"7\"\r\n\r\n");
+}
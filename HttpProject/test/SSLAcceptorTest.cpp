@@ -0,0 +1,134 @@
+/// \file Tests accepting ssl connections without blocking on clients
+#include <gtest/gtest.h>
+#include "TestServer.h"
+#include <SSLAcceptor.h>
+#include <SSLSocket.h>
+#include <Socket.h>
+#include <TlsContext.h>
+#include <Address.h>
+#include <Networking.h>
+#include <future>
+#include <string>
+
+using namespace std::chrono_literals;
+
+class SSLAcceptorTest : public testing::Test {
+protected:
+    std::shared_ptr<TlsContext> serverCtx;
+    std::unique_ptr<SSLAcceptor> acceptor;
+    port_t port;
+    std::vector<SSLSocket> accepted;
+
+    /// Restarts the acceptor with a new context
+    void start(std::chrono::milliseconds handshakeTimeout, bool earlyData = false) {
+        acceptor.reset();
+        port = nextPort();
+        serverCtx = std::make_shared<TlsContext>("data/cert.pem", "data/key.pem", earlyData);
+        acceptor = std::make_unique<SSLAcceptor>(Address(port), serverCtx, handshakeTimeout);
+    }
+
+    /// Accepts until `count` connections have finished their handshake or a second has passed
+    void acceptUntil(size_t count) {
+        const auto end = std::chrono::steady_clock::now() + 1s;
+        while (accepted.size() < count && std::chrono::steady_clock::now() < end)
+            acceptor->accept(accepted, 100ms);
+    }
+
+    /// Connects an ssl client on a new thread
+    std::future<SSLSocket> connectClient(std::shared_ptr<TlsContext> ctx = nullptr,
+        std::string firstWrite = {})
+    {
+        return std::async(std::launch::async, [this, ctx, firstWrite]() {
+            if (ctx == nullptr)
+                return SSLSocket(Address("127.0.0.1", port));
+            return SSLSocket(Address("127.0.0.1", port), ctx, firstWrite);
+            });
+    }
+public:
+    SSLAcceptorTest() {
+        start(10s);
+    }
+};
+
+TEST_F(SSLAcceptorTest, acceptsConnections) {
+    std::vector<std::future<SSLSocket>> clients;
+    for (auto i = 0; i < 5; ++i)
+        clients.push_back(connectClient());
+    acceptUntil(5);
+    ASSERT_EQ(accepted.size(), 5);
+
+    for (auto& fut : clients) {
+        auto client = fut.get();
+        client.write("ping");
+    }
+    for (auto& conn : accepted) {
+        const auto data = conn.read(4);
+        ASSERT_EQ(std::string(data.begin(), data.end()), "ping");
+    }
+    ASSERT_EQ(acceptor->pending(), 0);
+    ASSERT_EQ(acceptor->stats().accepted, 5);
+    ASSERT_EQ(acceptor->stats().completed, 5);
+}
+
+TEST_F(SSLAcceptorTest, slowClientDoesNotBlock) {
+    // connects but never sends its client hello
+    TcpSocket stalled(Address("127.0.0.1", port));
+    ASSERT_EQ(acceptor->accept(accepted, 50ms), 0);
+    ASSERT_EQ(acceptor->pending(), 1);
+
+    auto client = connectClient();
+    acceptUntil(1);
+    ASSERT_EQ(accepted.size(), 1);
+    client.get().write("ping");
+    ASSERT_EQ(accepted.front().read(4).size(), 4);
+    ASSERT_EQ(acceptor->pending(), 1);
+}
+
+TEST_F(SSLAcceptorTest, partialHandshake) {
+    // the start of a tls record header that never finishes
+    TcpSocket stalled(Address("127.0.0.1", port));
+    stalled.write(std::string_view("\x16\x03\x01", 3));
+    auto client = connectClient();
+    acceptUntil(1);
+    ASSERT_EQ(accepted.size(), 1);
+    client.get();
+    ASSERT_EQ(acceptor->pending(), 1);
+}
+
+TEST_F(SSLAcceptorTest, handshakeTimeout) {
+    start(50ms);
+    TcpSocket stalled(Address("127.0.0.1", port));
+    ASSERT_EQ(acceptor->accept(accepted, 200ms), 0);
+    ASSERT_EQ(acceptor->pending(), 0);
+    ASSERT_EQ(acceptor->stats().timedOut, 1);
+    // the server closed the connection
+    ASSERT_THROW(stalled.read(1), std::runtime_error);
+}
+
+TEST_F(SSLAcceptorTest, failedHandshake) {
+    TcpSocket notTls(Address("127.0.0.1", port));
+    notTls.write("GET / HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    ASSERT_EQ(acceptor->accept(accepted, 100ms), 0);
+    ASSERT_EQ(acceptor->pending(), 0);
+    ASSERT_EQ(acceptor->stats().failed, 1);
+}
+
+TEST_F(SSLAcceptorTest, earlyData) {
+    start(10s, true);
+    auto clientCtx = std::make_shared<TlsContext>(true);
+    auto first = connectClient(clientCtx, "ping");
+    acceptUntil(1);
+    ASSERT_EQ(accepted.size(), 1);
+    accepted.front().write("pong");
+    ASSERT_EQ(first.get().read(4).size(), 4); // receives the session ticket
+    ASSERT_EQ(accepted.front().read(4).size(), 4);
+
+    auto second = connectClient(clientCtx, "ping");
+    acceptUntil(2);
+    ASSERT_EQ(accepted.size(), 2);
+    ASSERT_EQ(accepted.back().available(), 4);
+    const auto data = accepted.back().read(4);
+    ASSERT_EQ(std::string(data.begin(), data.end()), "ping");
+    second.get();
+    ASSERT_EQ(serverCtx->stats().resumed, 1);
+}
@@ -0,0 +1,249 @@
+/// \file Tests running coroutines and serving connections with them on one thread
+#include <gtest/gtest.h>
+#include "TestServer.h"
+#include <Scheduler.h>
+#include <IoUring.h>
+#include <FdSet.h>
+#include <SSLSocket.h>
+#include <Socket.h>
+#include <Address.h>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+/// Runs each test with each way of waiting for sockets
+class SchedulerTest : public testing::TestWithParam<SchedulerBackend> {
+protected:
+    void SetUp() override {
+        if (GetParam() == SchedulerBackend::IoUring && !IoUring::supported())
+            GTEST_SKIP() << "io_uring isn't supported";
+    }
+};
+
+INSTANTIATE_TEST_SUITE_P(Backends, SchedulerTest,
+    testing::Values(SchedulerBackend::FdSet, SchedulerBackend::IoUring),
+    [](const testing::TestParamInfo<SchedulerBackend>& info) {
+        return info.param == SchedulerBackend::FdSet ? "FdSet" : "IoUring";
+    });
+
+Task<int> answer() {
+    co_return 42;
+}
+
+Task<int> doubled() {
+    co_return 2 * co_await answer();
+}
+
+Task<void> fails() {
+    co_await answer();
+    throw std::runtime_error("task failed");
+}
+
+TEST_P(SchedulerTest, runsTasks) {
+    Scheduler scheduler(GetParam());
+    auto result = 0;
+    auto caught = false;
+    scheduler.spawn([](int& result, bool& caught) -> Task<void> {
+        result = co_await doubled();
+        try {
+            co_await fails();
+        }
+        catch (const std::runtime_error&) {
+            caught = true;
+        }
+    }(result, caught));
+    scheduler.run();
+    ASSERT_EQ(result, 84);
+    ASSERT_TRUE(caught);
+    ASSERT_THROW(Scheduler::current(), std::logic_error);
+}
+
+TEST_P(SchedulerTest, rethrowsEscapedExceptions) {
+    Scheduler scheduler(GetParam());
+    auto finished = false;
+    scheduler.spawn(fails());
+    scheduler.spawn([](Scheduler& scheduler, bool& finished) -> Task<void> {
+        co_await scheduler.sleep_for(10ms);
+        finished = true;
+    }(scheduler, finished));
+    ASSERT_THROW(scheduler.run(), std::runtime_error);
+    ASSERT_FALSE(finished);
+    // the other tasks keep running on the next run
+    scheduler.run();
+    ASSERT_TRUE(finished);
+}
+
+TEST_P(SchedulerTest, sleeps) {
+    Scheduler scheduler(GetParam());
+    std::vector<int> woken;
+    const auto sleeper = [](Scheduler& scheduler, std::vector<int>& woken,
+        int ms) -> Task<void>
+    {
+        co_await scheduler.sleep_for(std::chrono::milliseconds(ms));
+        woken.push_back(ms);
+    };
+    const auto start = std::chrono::steady_clock::now();
+    scheduler.spawn(sleeper(scheduler, woken, 60));
+    scheduler.spawn(sleeper(scheduler, woken, 20));
+    scheduler.spawn(sleeper(scheduler, woken, 40));
+    scheduler.run();
+    ASSERT_EQ(woken, (std::vector<int>{ 20, 40, 60 }));
+    // the sleeps overlap instead of running one after another
+    ASSERT_LT(std::chrono::steady_clock::now() - start, 110ms);
+}
+
+/// Resumes the awaiting coroutine on a new thread
+struct ResumeOnNewThread {
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(std::coroutine_handle<> coroutine) {
+        std::thread([coroutine]() { coroutine.resume(); }).detach();
+    }
+
+    void await_resume() const noexcept {}
+};
+
+TEST_P(SchedulerTest, schedulesFromOtherThreads) {
+    Scheduler scheduler(GetParam());
+    std::thread::id before, away, after;
+    scheduler.spawn([](Scheduler& scheduler, std::thread::id& before, std::thread::id& away,
+        std::thread::id& after) -> Task<void>
+    {
+        before = std::this_thread::get_id();
+        co_await ResumeOnNewThread{};
+        away = std::this_thread::get_id();
+        co_await scheduler.schedule();
+        after = std::this_thread::get_id();
+    }(scheduler, before, away, after));
+    scheduler.run();
+    ASSERT_EQ(before, std::this_thread::get_id());
+    ASSERT_NE(away, std::this_thread::get_id());
+    ASSERT_EQ(after, std::this_thread::get_id());
+}
+
+/// Echoes what a connection sends until it closes
+template<class Sock>
+Task<void> echo(Sock connection, std::atomic<int>& served) {
+    char buffer[4096];
+    try {
+        for (;;) {
+            const auto read = co_await connection.async_read(buffer, sizeof(buffer));
+            co_await connection.async_write({ buffer, read });
+        }
+    }
+    catch (const std::runtime_error&) {}
+    ++served;
+}
+
+/// Accepts connections and echoes each on its own coroutine
+template<class Sock>
+Task<void> echoServer(Scheduler& scheduler, const Sock& listener, std::atomic<int>& served) {
+    for (;;)
+        scheduler.spawn(echo(co_await listener.async_accept(), served));
+}
+
+/// Connects clients which each send messages to an echo server running on one thread
+template<class Sock>
+void testEcho(SchedulerBackend backend, Sock listener, port_t port, std::atomic<int>& served) {
+    Scheduler scheduler(backend);
+    scheduler.spawn(echoServer(scheduler, listener, served));
+    std::thread loop([&scheduler]() { scheduler.run(); });
+
+    constexpr auto clientCount = 16;
+    std::vector<std::unique_ptr<Sock>> clients;
+    for (auto i = 0; i < clientCount; ++i)
+        clients.push_back(std::make_unique<Sock>(Address("127.0.0.1", port)));
+    for (auto round = 0; round < 3; ++round) {
+        for (auto i = 0; i < clientCount; ++i)
+            clients[i]->write("message " + std::to_string(i));
+        for (auto i = 0; i < clientCount; ++i) {
+            const auto expected = "message " + std::to_string(i);
+            const auto read = clients[i]->read(expected.size());
+            ASSERT_EQ(std::string(read.begin(), read.end()), expected);
+        }
+    }
+    clients.clear();
+    for (auto i = 0; i < 200 && served < clientCount; ++i)
+        std::this_thread::sleep_for(5ms);
+    scheduler.stop();
+    loop.join();
+    ASSERT_EQ(served, clientCount);
+}
+
+TEST_P(SchedulerTest, servesConnections) {
+    const auto port = nextPort();
+    std::atomic<int> served{ 0 };
+    testEcho(GetParam(), TcpSocket(Address{ port }), port, served);
+}
+
+TEST_P(SchedulerTest, servesTlsConnections) {
+    const auto port = nextPort();
+    std::atomic<int> served{ 0 };
+    testEcho(GetParam(), SSLSocket(Address{ port }, "data/cert.pem", "data/key.pem"), port, served);
+}
+
+TEST_P(SchedulerTest, writesMoreThanTheSendBuffer) {
+    const auto port = nextPort();
+    TcpSocket listener(Address{ port });
+    TcpSocket client(Address("127.0.0.1", port));
+    auto connection = listener.accept();
+    const std::string data(8 * 1024 * 1024, 'x');
+
+    Scheduler scheduler(GetParam());
+    scheduler.spawn([](TcpSocket& connection, const std::string& data) -> Task<void> {
+        co_await connection.async_write(data);
+    }(connection, data));
+    std::thread reader([&client, &data]() {
+        // reads slowly, so the writer fills the send buffer and has to wait
+        std::this_thread::sleep_for(50ms);
+        std::vector<char> buffer(data.size());
+        client.read_into(buffer.data(), buffer.size(), buffer.size());
+    });
+    scheduler.run();
+    reader.join();
+}
+
+TEST_P(SchedulerTest, closesSocketsOfFinishedCoroutines) {
+    const auto port = nextPort();
+    TcpSocket listener(Address{ port });
+    TcpSocket client(Address("127.0.0.1", port));
+    client.write("x");
+    Scheduler scheduler(GetParam());
+    scheduler.spawn([](const TcpSocket& listener) -> Task<void> {
+        auto connection = co_await listener.async_accept();
+        char buffer[16];
+        co_await connection.async_read(buffer, sizeof(buffer));
+    }(listener));
+    scheduler.run();
+    // the connection closed when its coroutine finished, even if its receive was armed
+    FdSet set;
+    client.add_to_fd(set);
+    FdSet::wait(std::chrono::microseconds(1s), ReadSet{ set });
+    ASSERT_THROW(client.try_read(), std::runtime_error);
+}
+
+TEST_P(SchedulerTest, readsTheRingOnlyOnceLinked) {
+    if (GetParam() != SchedulerBackend::IoUring)
+        GTEST_SKIP() << "only sockets used with io_uring are linked";
+    const auto port = nextPort();
+    TcpSocket listener(Address{ port });
+    TcpSocket client(Address("127.0.0.1", port));
+    auto connection = listener.accept();
+    client.write("first");
+    Scheduler scheduler(GetParam());
+    std::string read;
+    scheduler.spawn([](TcpSocket& connection, std::string& read) -> Task<void> {
+        char buffer[16];
+        const auto count = co_await connection.async_read(buffer, sizeof(buffer));
+        read.assign(buffer, count);
+    }(connection, read));
+    scheduler.run();
+    ASSERT_EQ(read, "first");
+    // later data is received by the ring, so blocking reads would miss it
+    ASSERT_THROW(connection.read(1), std::logic_error);
+}
\ No newline at end of file
@@ -1,12 +1,21 @@
 /// \file Tests the logic of remote port implementations
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
+#include "TestServer.h"
 #include <Port.h>
 #include <future>
 #include <SSLSocket.h>
+#include <Socket.h>
 #include <Networking.h>
 #include <Address.h>
+#include <FdSet.h>
+#include <MappedFile.h>
 #include <random>
+#include <filesystem>
+#include <fstream>
+#ifndef WIN32
+#include <signal.h>
+#endif
 
 constexpr auto testCount = 500;
 
@@ -14,10 +23,10 @@ constexpr auto testCount = 500;
 std::vector<char> randomBuffer(int minSize, int maxSize) {
     static auto seeder = std::random_device{};
     static auto randomEng = std::default_random_engine(seeder());
-    static auto randomGen = std::uniform_int_distribution(minSize, maxSize);
     static auto randomElemGen = std::uniform_int_distribution(0, 255);
 
-    const auto sz = randomGen(randomEng);
+    // the bounds differ between calls, so the size distribution can't be static
+    const auto sz = std::uniform_int_distribution(minSize, maxSize)(randomEng);
     std::vector<char> buf;
     std::generate_n(std::back_inserter(buf), sz, []() {
         return static_cast<char>(randomElemGen(randomEng));
@@ -52,6 +61,50 @@ struct SSLSockFactory {
     }
 };
 
+/// Ssl sockets whose contexts enable kernel TLS, which fall back to user space TLS
+/// where the kernel lacks the tls module
+struct KtlsSockFactory {
+    static std::shared_ptr<TlsContext> serverContext() {
+        static const auto ctx = [] {
+            auto ctx = std::make_shared<TlsContext>("data/cert.pem", "data/key.pem");
+            ctx->enable_ktls();
+            return ctx;
+        }();
+        return ctx;
+    }
+
+    static std::shared_ptr<TlsContext> clientContext() {
+        static const auto ctx = [] {
+            auto ctx = std::make_shared<TlsContext>();
+            ctx->enable_ktls();
+            return ctx;
+        }();
+        return ctx;
+    }
+
+    static SSLSocket makeServer(port_t port) {
+        return SSLSocket(Address(port), serverContext());
+    }
+
+    static SSLSocket makeClient(std::string_view ip, port_t port) {
+        return SSLSocket(Address(ip, port), clientContext());
+    }
+};
+
+struct TcpSockFactory {
+    static TcpSocket makeServer(port_t port) {
+        TcpSocket sock(Address{ port });
+        sock.set_nodelay(true); // inherited by accepted sockets
+        return sock;
+    }
+
+    static TcpSocket makeClient(std::string_view ip, port_t port) {
+        TcpSocket sock(Address(ip, port));
+        sock.set_nodelay(true);
+        return sock;
+    }
+};
+
 /**
 * Test fixture for testing socket types.
 *
@@ -73,13 +126,13 @@ protected:
     // serverConnection is the server's connected socket to the client
 public:
     SocketTest() {
-        static port_t port = 5430;
+        const auto port = nextPort();
         auto serverSocket = std::make_unique<fixture_sock_t>(factory_t::makeServer(port));
         auto fut = std::async(std::launch::async, [&serverSocket]() {
             return std::make_unique<fixture_sock_t>(serverSocket->accept());
             // new thread to accept the client since accept is blocking and so is connect
             });
-        client = std::make_unique<fixture_sock_t>(factory_t::makeClient("127.0.0.1", port++));
+        client = std::make_unique<fixture_sock_t>(factory_t::makeClient("127.0.0.1", port));
         serverConnection = fut.get(); // waits for accept to be done, then gets result
         server = std::unique_ptr<Port>(std::move(serverSocket));
     }
@@ -107,7 +160,9 @@ protected:
     }
 };
 
-using SocketTestTypes = testing::Types<std::pair<SSLSocket, SSLSockFactory> /*Add your socket*/>;
+using SocketTestTypes = testing::Types<std::pair<SSLSocket, SSLSockFactory>,
+    std::pair<SSLSocket, KtlsSockFactory>, std::pair<TcpSocket, TcpSockFactory>
+    /*Add your socket*/>;
 TYPED_TEST_SUITE(SocketTest, SocketTestTypes);
 
 TYPED_TEST(SocketTest, readAndWrite) {
@@ -148,9 +203,14 @@ TYPED_TEST(SocketTest, nonBlockReadWrite) {
 
 TYPED_TEST(SocketTest, interleavedRW) {
     const auto testDirection = [](auto& data, auto& sender, auto& receiver) {
-        auto midWay = data.size() / 2;
+        // at least 1 byte, since reading 0 bytes waits for any amount of data
+        auto midWay = std::max<size_t>(data.size() / 2, 1);
         sender->write({ data.data(), midWay });
         std::vector<char> recvBuffer = receiver->read(midWay);
+        if (midWay == data.size()) {
+            ASSERT_THAT(recvBuffer, testing::ContainerEq(data));
+            return;
+        }
         sender->write({ data.data() + midWay, data.size() - midWay });
         const auto rest = receiver->read(data.size() - midWay);
         recvBuffer.insert(recvBuffer.end(), rest.begin(), rest.end());
@@ -174,4 +234,228 @@ TYPED_TEST(SocketTest, chunkedRW) {
     };
 
     this->testRepititions(testDirection);
+}
+
+TYPED_TEST(SocketTest, readIntoBuffer) {
+    std::vector<char> buffer(5000);
+    const auto testDirection = [&buffer](auto& data, auto& sender, auto& receiver) {
+        sender->write({ data.data(), data.size() });
+        const auto read = receiver->read_into(buffer.data(), buffer.size(), data.size());
+        ASSERT_EQ(read, data.size());
+        ASSERT_TRUE(std::equal(data.begin(), data.end(), buffer.begin()));
+    };
+
+    this->testRepititions(testDirection);
+}
+
+TYPED_TEST(SocketTest, tryReadIntoBuffer) {
+    std::vector<char> buffer(5000);
+    ASSERT_EQ(this->client->try_read_into(buffer.data(), buffer.size()), 0);
+    const auto testDirection = [&buffer](auto& data, auto& sender, auto& receiver) {
+        sender->write({ data.data(), data.size() });
+        size_t read = 0;
+        do {
+            read += receiver->try_read_into(buffer.data() + read, data.size() - read);
+        } while (read < data.size());
+        ASSERT_TRUE(std::equal(data.begin(), data.end(), buffer.begin()));
+    };
+
+    this->testRepititions(testDirection);
+}
+
+TYPED_TEST(SocketTest, fdSetActivity) {
+    FdSet set;
+    this->serverConnection->add_to_fd(set);
+    ASSERT_EQ(FdSet::wait(std::chrono::milliseconds(10), ReadSet{ set }), 0);
+    ASSERT_FALSE(this->serverConnection->is_in_fd(set));
+
+    const auto data = randomBuffer(1, 5000);
+    this->client->write({ data.data(), data.size() });
+    ASSERT_EQ(FdSet::wait(ReadSet{ set }), 1);
+    ASSERT_TRUE(this->serverConnection->is_in_fd(set));
+    ASSERT_THAT(this->serverConnection->read(data.size()), testing::ContainerEq(data));
+
+    this->serverConnection->remove_from_fd(set);
+    ASSERT_FALSE(this->serverConnection->is_in_fd(set));
+}
+
+TYPED_TEST(SocketTest, writeAfterPeerClosed) {
+    // the writes fail instead of raising SIGPIPE, which would end the test process
+    this->serverConnection.reset();
+    const std::string data(64 * 1024, 'x');
+    ASSERT_THROW({
+        for (auto i = 0; i < 1000; ++i)
+            this->client->write(data);
+    }, std::runtime_error);
+}
+
+TYPED_TEST(SocketTest, sendFileAfterPeerClosed) {
+    // sendfile has no flag against SIGPIPE, yet it fails without the process ignoring the signal
+    const auto path = std::filesystem::temp_directory_path() / "SocketTestSendFile.bin";
+    std::ofstream(path, std::ios::binary).write(std::string(1024 * 1024, 'x').data(), 1024 * 1024);
+    const MappedFile file(path.string());
+    this->serverConnection.reset();
+    ASSERT_THROW({
+        for (auto i = 0; i < 100; ++i)
+            this->client->send_file(file, 0, file.size());
+    }, std::runtime_error);
+#ifndef WIN32
+    struct sigaction action {};
+    sigaction(SIGPIPE, nullptr, &action);
+    ASSERT_EQ(action.sa_handler, SIG_DFL);
+    sigset_t blocked;
+    pthread_sigmask(SIG_BLOCK, nullptr, &blocked);
+    ASSERT_EQ(sigismember(&blocked, SIGPIPE), 0);
+#endif
+}
+
+TYPED_TEST(SocketTest, vectoredWrite) {
+    // more buffers than fit in one sendmsg call, including empty ones and ones
+    // larger than a TLS record
+    std::vector<std::vector<char>> buffers;
+    std::vector<std::string_view> views;
+    std::vector<char> expected;
+    for (auto i = 0; i < 150; ++i) {
+        if (i % 7 == 0)
+            buffers.emplace_back();
+        else if (i % 11 == 0)
+            buffers.push_back(randomBuffer(20000, 40000));
+        else
+            buffers.push_back(randomBuffer(1, 5000));
+    }
+    for (auto& buf : buffers) {
+        views.emplace_back(buf.data(), buf.size());
+        expected.insert(expected.end(), buf.begin(), buf.end());
+    }
+
+    auto fut = std::async(std::launch::async, [this, &views]() {
+        this->client->writev(views.data(), views.size());
+        });
+    ASSERT_THAT(this->serverConnection->read(expected.size()), testing::ContainerEq(expected));
+    fut.get();
+}
+
+/// Test fixture for the tcp specific socket features
+class TcpSocketTest : public testing::Test {
+protected:
+    std::unique_ptr<TcpSocket> server, client, serverConnection;
+public:
+    TcpSocketTest() {
+        const auto port = nextPort();
+        server = std::make_unique<TcpSocket>(TcpSockFactory::makeServer(port));
+        auto fut = std::async(std::launch::async, [this]() {
+            return std::make_unique<TcpSocket>(server->accept());
+            });
+        client = std::make_unique<TcpSocket>(TcpSockFactory::makeClient("127.0.0.1", port));
+        serverConnection = fut.get();
+    }
+};
+
+TEST_F(TcpSocketTest, zeroCopyWrite) {
+    const auto supported = client->enable_zerocopy(1024);
+    const auto data = randomBuffer(100000, 200000);
+    auto fut = std::async(std::launch::async, [this, &data]() {
+        client->write_zerocopy({ data.data(), data.size() });
+        client->flush_zerocopy();
+        });
+    ASSERT_THAT(serverConnection->read(data.size()), testing::ContainerEq(data));
+    fut.get();
+
+    ASSERT_EQ(client->zerocopy_pending(), 0);
+    const auto stats = client->zerocopy_stats();
+    ASSERT_EQ(stats.sends, stats.completed);
+    if (supported)
+        ASSERT_GT(stats.sends, 0);
+    else
+        ASSERT_EQ(stats.sends, 0);
+}
+
+TEST_F(TcpSocketTest, corkedWrite) {
+    client->set_cork(true);
+    client->write("Hello ");
+    client->write("World");
+    client->set_cork(false);
+    const auto read = serverConnection->read(11);
+    ASSERT_EQ(std::string(read.begin(), read.end()), "Hello World");
+}
+
+TEST_F(TcpSocketTest, moveAssignCloses) {
+    // moving another socket over the connection closes it, which the client sees
+    *serverConnection = TcpSockFactory::makeServer(nextPort());
+    ASSERT_THROW(client->read(1), std::runtime_error);
+}
+
+TEST(KtlsTest, reportsOffload) {
+    const auto port = nextPort();
+    auto server = KtlsSockFactory::makeServer(port);
+    auto fut = std::async(std::launch::async, [&server]() { return server.accept(); });
+    auto client = KtlsSockFactory::makeClient("127.0.0.1", port);
+    auto connection = fut.get();
+
+    // whether the kernel takes over depends on its tls module and the cipher, which are
+    // the same for every connection of the test, so the reports must agree
+    const auto clientStats = KtlsSockFactory::clientContext()->stats();
+    const auto serverStats = KtlsSockFactory::serverContext()->stats();
+    ASSERT_EQ(client.ktls().send, clientStats.ktlsSend == clientStats.handshakes);
+    ASSERT_EQ(client.ktls().receive, clientStats.ktlsReceive == clientStats.handshakes);
+    ASSERT_EQ(connection.ktls().send, serverStats.ktlsSend == serverStats.handshakes);
+    ASSERT_EQ(connection.ktls().receive, serverStats.ktlsReceive == serverStats.handshakes);
+
+    const auto data = randomBuffer(100000, 200000);
+    const std::string_view parts[] = { { data.data(), 10 }, { data.data() + 10, data.size() - 10 } };
+    auto written = std::async(std::launch::async, [&]() { client.writev(parts, 2); });
+    ASSERT_THAT(connection.read(data.size()), testing::ContainerEq(data));
+    written.get();
+    connection.write("done");
+    ASSERT_THAT(client.read(4), testing::ElementsAre('d', 'o', 'n', 'e'));
+}
+
+TEST(KtlsTest, offloadedTransfers) {
+    const auto port = nextPort();
+    auto server = KtlsSockFactory::makeServer(port);
+    auto fut = std::async(std::launch::async, [&server]() { return server.accept(); });
+    auto client = KtlsSockFactory::makeClient("127.0.0.1", port);
+    auto connection = fut.get();
+    if (!client.ktls().send || !connection.ktls().send)
+        GTEST_SKIP() << "The kernel doesn't encrypt TLS, it may lack the tls module";
+
+    // sent through sendmsg on the socket, records split at the kernel's choice
+    const auto data = randomBuffer(100000, 200000);
+    const std::string_view parts[] = { { data.data(), 10 }, { data.data() + 10, data.size() - 10 } };
+    auto written = std::async(std::launch::async, [&]() { client.writev(parts, 2); });
+    ASSERT_THAT(connection.read(data.size()), testing::ContainerEq(data));
+    written.get();
+
+    // the session tickets the server sent after the handshake precede this data, and
+    // a kernel which decrypts fails reads of them with EIO so OpenSSL handles them
+    const auto reply = randomBuffer(1000, 20000);
+    connection.write({ reply.data(), reply.size() });
+    std::vector<char> received;
+    while (received.size() < reply.size()) {
+        std::vector<char> buf(reply.size() - received.size());
+        buf.resize(client.try_read_into(buf.data(), buf.size()));
+        received.insert(received.end(), buf.begin(), buf.end());
+    }
+    ASSERT_THAT(received, testing::ContainerEq(reply));
+
+    // SSL_sendfile, which the kernel encrypts without copying the file to user space
+    const auto path = std::filesystem::temp_directory_path() / "KtlsTestSendFile.bin";
+    std::ofstream(path, std::ios::binary).write(data.data(), data.size());
+    const MappedFile file(path.string());
+    written = std::async(std::launch::async, [&]() { connection.send_file(file, 10, file.size() - 10); });
+    ASSERT_THAT(client.read(data.size() - 10),
+        testing::ElementsAreArray(data.begin() + 10, data.end()));
+    written.get();
+}
+
+TEST(KtlsTest, offByDefault) {
+    const auto port = nextPort();
+    auto server = SSLSockFactory::makeServer(port);
+    auto fut = std::async(std::launch::async, [&server]() { return server.accept(); });
+    auto client = SSLSockFactory::makeClient("127.0.0.1", port);
+    auto connection = fut.get();
+    ASSERT_FALSE(client.ktls().send);
+    ASSERT_FALSE(client.ktls().receive);
+    ASSERT_FALSE(connection.ktls().send);
+    ASSERT_FALSE(connection.ktls().receive);
 }
\ No newline at end of file
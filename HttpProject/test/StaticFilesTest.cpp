@@ -0,0 +1,268 @@
+/// \file Tests serving files from a directory
+#include <gtest/gtest.h>
+#include "TestServer.h"
+#include <StaticFiles.h>
+#include <MappedFile.h>
+#include <HttpServer.h>
+#include <SSLSocket.h>
+#include <Socket.h>
+#include <Address.h>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+
+namespace fs = std::filesystem;
+
+void writeFile(const fs::path& path, std::string_view data) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+/// @return the data of a file body
+std::string body(const HttpResponseFrame& response) {
+    const auto& file = response.fileBody;
+    return std::string(file.file->data().substr(file.offset, file.size));
+}
+
+TEST(HttpDateTest, formatAndParse) {
+    ASSERT_EQ(format_http_date(784111777), "Sun, 06 Nov 1994 08:49:37 GMT");
+    ASSERT_EQ(format_http_date(0), "Thu, 01 Jan 1970 00:00:00 GMT");
+    ASSERT_EQ(format_http_date(951782400), "Tue, 29 Feb 2000 00:00:00 GMT");
+    ASSERT_EQ(parse_http_date("Sun, 06 Nov 1994 08:49:37 GMT"), 784111777);
+    for (time_t time = 0; time < 4000000000; time += 86399 * 97)
+        ASSERT_EQ(parse_http_date(format_http_date(time)), time);
+
+    ASSERT_FALSE(parse_http_date("Sunday, 06-Nov-94 08:49:37 GMT"));
+    ASSERT_FALSE(parse_http_date("Sun Nov  6 08:49:37 1994"));
+    ASSERT_FALSE(parse_http_date("Sun, 06 Nop 1994 08:49:37 GMT"));
+    ASSERT_FALSE(parse_http_date("Sun, 06 Nov 1994 25:49:37 GMT"));
+}
+
+TEST(ByteRangeTest, parse) {
+    using Range = std::pair<uint64_t, uint64_t>;
+    ASSERT_EQ(parse_byte_range("bytes=0-99", 1000), Range(0, 100));
+    ASSERT_EQ(parse_byte_range("bytes=900-", 1000), Range(900, 100));
+    ASSERT_EQ(parse_byte_range("bytes=-100", 1000), Range(900, 100));
+    ASSERT_EQ(parse_byte_range("Bytes= 10-2000 ", 1000), Range(10, 990));
+    ASSERT_EQ(parse_byte_range("bytes=-5000", 1000), Range(0, 1000));
+    // unsatisfiable
+    ASSERT_EQ(parse_byte_range("bytes=1000-", 1000)->second, 0);
+    ASSERT_EQ(parse_byte_range("bytes=-0", 1000)->second, 0);
+    // ignored
+    ASSERT_FALSE(parse_byte_range("bytes=0-1,5-6", 1000));
+    ASSERT_FALSE(parse_byte_range("bytes=9-5", 1000));
+    ASSERT_FALSE(parse_byte_range("items=0-5", 1000));
+    ASSERT_FALSE(parse_byte_range("bytes=a-5", 1000));
+    ASSERT_FALSE(parse_byte_range("bytes=5", 1000));
+}
+
+class StaticFilesTest : public testing::Test {
+protected:
+    fs::path root;
+    StaticFiles files;
+    HttpRequestFrame request;
+    HttpResponseFrame response;
+
+    /// Answers a GET request for `path` with `headers`
+    void get(std::string path, std::initializer_list<std::pair<std::string, std::string>> headers = {}) {
+        request.path = std::move(path);
+        request.headers().clear();
+        for (const auto& [name, value] : headers)
+            request[name] = value;
+        response = HttpResponseFrame();
+        response.responseCode = HttpResponse::ok;
+        files(request, response);
+    }
+public:
+    StaticFilesTest() : root(fs::temp_directory_path() / ("StaticFilesTest" +
+        std::to_string(std::random_device()()))), files((fs::create_directories(root / "docs"),
+        root.string()))
+    {
+        writeFile(root / "hello.txt", "hello world");
+        writeFile(root / "docs" / "index.html", "<p>index</p>");
+        writeFile(root / "empty.bin", "");
+        writeFile(root.parent_path() / "secret.txt", "secret");
+    }
+
+    ~StaticFilesTest() {
+        fs::remove_all(root);
+    }
+};
+
+TEST_F(StaticFilesTest, servesFiles) {
+    get("/hello.txt?version=2");
+    ASSERT_EQ(response.responseCode, HttpResponse::ok);
+    ASSERT_EQ(response.get(KnownHeader::ContentType), "text/plain; charset=utf-8");
+    ASSERT_EQ(response.get(KnownHeader::ContentLength), "11");
+    ASSERT_EQ(response.get("Accept-Ranges"), "bytes");
+    ASSERT_TRUE(parse_http_date(response.get("Last-Modified")));
+    ASSERT_EQ(body(response), "hello world");
+    ASSERT_EQ(response.compose().substr(response.compose().size() - 11), "hello world");
+
+    get("/docs");
+    ASSERT_EQ(response.responseCode, HttpResponse::ok);
+    ASSERT_EQ(body(response), "<p>index</p>");
+    ASSERT_EQ(response.get(KnownHeader::ContentType), "text/html; charset=utf-8");
+    get("/hell%6F.txt");
+    ASSERT_EQ(body(response), "hello world");
+    get("/empty.bin");
+    ASSERT_EQ(response.get(KnownHeader::ContentLength), "0");
+
+    for (const auto path : { "/missing", "/../secret.txt", "/docs/%2E%2E/../secret.txt",
+        "/hello.txt/", "hello.txt", "/hello.txt%00" })
+    {
+        get(path);
+        ASSERT_EQ(response.responseCode, HttpResponse::not_found) << path;
+    }
+
+    request.protocol = HttpFrame::Protocol::POST;
+    get("/hello.txt");
+    ASSERT_EQ(response.responseCode, HttpResponse::not_allow);
+    ASSERT_EQ(response.get("Allow"), "GET, HEAD");
+}
+
+TEST_F(StaticFilesTest, conditionalRequests) {
+    get("/hello.txt");
+    const auto modified = response.get("Last-Modified");
+    get("/hello.txt", { { "If-Modified-Since", modified } });
+    ASSERT_EQ(response.responseCode, HttpResponse::not_modified);
+    ASSERT_EQ(response.fileBody.file, nullptr);
+    ASSERT_FALSE(response.has_header(KnownHeader::ContentLength));
+
+    get("/hello.txt", { { "If-Modified-Since", format_http_date(*parse_http_date(modified) - 1) } });
+    ASSERT_EQ(response.responseCode, HttpResponse::ok);
+    get("/hello.txt", { { "If-Modified-Since", "yesterday" } });
+    ASSERT_EQ(response.responseCode, HttpResponse::ok);
+}
+
+TEST_F(StaticFilesTest, ranges) {
+    get("/hello.txt", { { "Range", "bytes=6-" } });
+    ASSERT_EQ(response.responseCode, HttpResponse::partial);
+    ASSERT_EQ(response.get("Content-Range"), "bytes 6-10/11");
+    ASSERT_EQ(response.get(KnownHeader::ContentLength), "5");
+    ASSERT_EQ(body(response), "world");
+
+    get("/hello.txt", { { "Range", "bytes=-5" } });
+    ASSERT_EQ(body(response), "world");
+
+    get("/hello.txt", { { "Range", "bytes=11-" } });
+    ASSERT_EQ(response.responseCode, HttpResponse::range_not_satisfiable);
+    ASSERT_EQ(response.get("Content-Range"), "bytes */11");
+
+    get("/hello.txt", { { "Range", "bytes=0-1,3-4" } });
+    ASSERT_EQ(response.responseCode, HttpResponse::ok);
+    ASSERT_EQ(body(response), "hello world");
+}
+
+TEST_F(StaticFilesTest, cachesFiles) {
+    get("/hello.txt");
+    get("/hello.txt");
+    const auto file = response.fileBody.file;
+    ASSERT_EQ(files.stats().hits, 1);
+    ASSERT_EQ(files.stats().misses, 1);
+    ASSERT_EQ(files.stats().cachedBytes, 11);
+
+    // a replaced file is opened again, while responses still hold the old one
+    writeFile(root / "new.txt", "hello again");
+    fs::rename(root / "new.txt", root / "hello.txt");
+    fs::last_write_time(root / "hello.txt",
+        fs::last_write_time(root / "hello.txt") + std::chrono::seconds(1));
+    get("/hello.txt");
+    ASSERT_EQ(body(response), "hello again");
+    ASSERT_EQ(file->data(), "hello world");
+    ASSERT_EQ(files.stats().misses, 2);
+    ASSERT_EQ(files.stats().cachedBytes, 11);
+
+    // files larger than the cache are served without being cached
+    StaticFiles small(root.string(), 4);
+    request.path = "/hello.txt";
+    small(request, response);
+    ASSERT_EQ(body(response), "hello again");
+    ASSERT_EQ(small.stats().cachedBytes, 0);
+}
+
+TEST_F(StaticFilesTest, evictsLeastRecentlyUsed) {
+    for (const auto name : { "a.txt", "b.txt", "c.txt" })
+        writeFile(root / name, "0123456789\n");
+    StaticFiles three(root.string(), 33);
+    const auto get = [&](const char* path) {
+        request.path = path;
+        response = HttpResponseFrame();
+        response.responseCode = HttpResponse::ok;
+        three(request, response);
+        ASSERT_EQ(response.responseCode, HttpResponse::ok);
+    };
+    get("/a.txt");
+    get("/b.txt");
+    get("/hello.txt");
+    get("/a.txt");
+    ASSERT_EQ(three.stats().hits, 1);
+    ASSERT_EQ(three.stats().cachedBytes, 33);
+
+    // b.txt is the one not requested again, so it makes space for c.txt
+    get("/c.txt");
+    ASSERT_EQ(three.stats().misses, 4);
+    ASSERT_EQ(three.stats().cachedBytes, 33);
+    get("/a.txt");
+    get("/hello.txt");
+    get("/c.txt");
+    ASSERT_EQ(three.stats().hits, 4);
+    get("/b.txt");
+    ASSERT_EQ(three.stats().misses, 5);
+}
+
+TEST_F(StaticFilesTest, sendsOverSockets) {
+    std::string large(3 * 1024 * 1024 + 17, '\0');
+    std::mt19937 rng(5);
+    for (auto& c : large)
+        c = static_cast<char>(rng());
+    writeFile(root / "large.bin", large);
+
+    for (const auto tls : { false, true }) {
+        ServerOptions options;
+        options.port = nextPort();
+        options.threads = 1;
+        if (tls)
+            options.tls = std::make_shared<TlsContext>("data/cert.pem", "data/key.pem");
+        HttpServer server(options, files);
+        server.start();
+        std::unique_ptr<Port> client;
+        if (tls)
+            client = std::make_unique<SSLSocket>(Address("127.0.0.1", options.port));
+        else
+            client = std::make_unique<TcpSocket>(Address("127.0.0.1", options.port));
+
+        client->write("GET /large.bin HTTP/1.1\r\n\r\n");
+        ASSERT_EQ(readResponse(*client).body, large);
+        client->write("GET /large.bin HTTP/1.1\r\nRange: bytes=1000000-1999999\r\n\r\n");
+        const auto [head, partial] = readResponse(*client);
+        ASSERT_EQ(head.rfind("HTTP/1.1 206 ", 0), 0);
+        ASSERT_EQ(partial, large.substr(1000000, 1000000));
+        // no body follows the headers of a HEAD response
+        client->write("HEAD /large.bin HTTP/1.1\r\n\r\nGET /hello.txt HTTP/1.1\r\n\r\n");
+        std::string rest;
+        while (rest.find("hello world") == std::string::npos) {
+            const auto read = client->read(0);
+            rest.append(read.begin(), read.end());
+        }
+        ASSERT_EQ(rest.find("Content-Length: " + std::to_string(large.size())),
+            rest.find("Content-Length: "));
+        ASSERT_EQ(rest.find("\r\n\r\nHTTP/1.1 200 OK\r\n"), rest.find("\r\n\r\n"));
+    }
+}
+
+TEST(MappedFileTest, mapsFiles) {
+    const auto path = fs::temp_directory_path() / "MappedFileTest.txt";
+    writeFile(path, "mapped data");
+    const MappedFile file(path.string());
+    ASSERT_EQ(file.data(), "mapped data");
+    ASSERT_EQ(file.size(), 11);
+    ASSERT_GE(file.fd(), 0);
+    fs::remove(path);
+    // the mapping outlives the name
+    ASSERT_EQ(file.data(), "mapped data");
+
+    ASSERT_THROW(MappedFile("/nonexistent/file"), std::runtime_error);
+    ASSERT_THROW(MappedFile(fs::temp_directory_path().string()), std::runtime_error);
+}
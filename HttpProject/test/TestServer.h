@@ -0,0 +1,113 @@
+/// \file Helpers shared by the tests which serve requests over loopback connections
+#pragma once
+#include <gtest/gtest.h>
+#include <HttpServer.h>
+#include <Networking.h>
+#include <Port.h>
+#include <Address.h>
+#include <charconv>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+/**
+* @return a port no socket listens on, picked by the system, so tests running in
+*   parallel, such as the binaries ctest runs with -j, don't take each other's ports
+*/
+inline port_t nextPort() {
+    Address addr(port_t(0));
+    const auto listener = listen_socket(addr);
+    auto [sockAddr, size] = addr.addr_mut();
+    const auto bound = getsockname(listener, sockAddr, &size);
+    close_sock(listener);
+    if (bound != 0)
+        throw std::runtime_error("Failed to read the bound port: " + std::to_string(lastError));
+    return addr.port();
+}
+
+/// A response read by a client
+struct Response {
+    std::string head, body;
+
+    /// @return the value of a header, or an empty string
+    std::string header(std::string_view name) const {
+        const auto start = head.find("\r\n" + std::string(name) + ": ");
+        if (start == std::string::npos)
+            return {};
+        const auto value = start + name.size() + 4;
+        return head.substr(value, head.find("\r\n", value) - value);
+    }
+};
+
+/**
+* Reads a response with a Content-Length header, or a 204 or 304 response, from a port
+* @param buffered data read from the port but not yet used, which is left holding
+*   the data read after the response, such as the start of a pipelined response
+* @param head true if the response answers a HEAD request, so it has no body
+*/
+inline Response readResponse(Port& port, std::string& buffered, bool head = false) {
+    size_t headEnd;
+    while ((headEnd = buffered.find("\r\n\r\n")) == std::string::npos) {
+        const auto read = port.read();
+        buffered.append(read.begin(), read.end());
+    }
+    Response response{ buffered.substr(0, headEnd + 4) };
+    const auto lengthStart = response.head.find("Content-Length: ");
+    size_t length = 0;
+    if (lengthStart != std::string::npos) {
+        const auto digits = response.head.data() + lengthStart + 16;
+        std::from_chars(digits, response.head.data() + response.head.size(), length);
+    }
+    else if (response.head.compare(9, 3, "204") != 0 && response.head.compare(9, 3, "304") != 0) {
+        throw std::runtime_error("Response has no Content-Length");
+    }
+    if (head)
+        length = 0;
+    while (buffered.size() < headEnd + 4 + length) {
+        const auto read = port.read();
+        buffered.append(read.begin(), read.end());
+    }
+    response.body = buffered.substr(headEnd + 4, length);
+    buffered.erase(0, headEnd + 4 + length);
+    return response;
+}
+
+/// @see readResponse(Port&, std::string&, bool)
+inline Response readResponse(Port& port, bool head = false) {
+    std::string buffered;
+    return readResponse(port, buffered, head);
+}
+
+/**
+* Answers requests with their method, path and body. The path /throw makes it throw,
+* and /inject makes it set a header value which would split the response
+*/
+inline void echoHandler(const HttpRequestFrame& request, HttpResponseFrame& response) {
+    if (request.path == "/throw")
+        throw std::runtime_error("handler failed");
+    if (request.path == "/inject")
+        response["X-Echo"] = "1\r\nSet-Cookie: id=1";
+    response.content.append(protocol_name(request.protocol));
+    response.content += ' ';
+    response.content += request.path;
+    response.content += ' ';
+    response.content += request.content;
+}
+
+/// Fixture of tests which run a server with two threads on a new port
+class ServerTest : public testing::Test {
+protected:
+    ServerOptions options;
+    std::unique_ptr<HttpServer> server;
+
+    /// Starts a server with `options` on a new port
+    void start(HttpHandler handler = &echoHandler) {
+        options.port = nextPort();
+        server = std::make_unique<HttpServer>(options, std::move(handler));
+        server->start();
+    }
+public:
+    ServerTest() {
+        options.threads = 2;
+    }
+};
@@ -0,0 +1,140 @@
+/// \file Tests sharing tls contexts and resuming sessions
+#include <gtest/gtest.h>
+#include "TestServer.h"
+#include <SSLSocket.h>
+#include <TlsContext.h>
+#include <Address.h>
+#include <Networking.h>
+#include <future>
+#include <string>
+
+/// Test fixture with a server socket using its own server context
+class TlsContextTest : public testing::Test {
+protected:
+    std::shared_ptr<TlsContext> serverCtx;
+    std::unique_ptr<SSLSocket> server;
+    port_t port;
+
+    /**
+    * Restarts the server with a new server context
+    * @param earlyData true to let the server accept early data
+    */
+    void startServer(bool earlyData) {
+        server.reset();
+        port = nextPort();
+        serverCtx = std::make_shared<TlsContext>("data/cert.pem", "data/key.pem", earlyData);
+        server = std::make_unique<SSLSocket>(Address(port), serverCtx);
+    }
+
+    /**
+    * Connects a client to the server and exchanges a message in each direction.
+    * The client has to read from the server to receive its session tickets
+    * @param firstWrite the message from the client
+    * @return the amount of bytes available on the server's connection directly after accepting
+    */
+    size_t exchange(const std::shared_ptr<TlsContext>& clientCtx,
+        const std::string& firstWrite = "ping")
+    {
+        auto fut = std::async(std::launch::async, [this]() {
+            return server->accept();
+            });
+        SSLSocket client(Address("127.0.0.1", port), clientCtx, firstWrite);
+        auto connection = fut.get();
+        const auto earlyAvailable = connection.available();
+
+        const auto request = connection.read(firstWrite.size());
+        EXPECT_EQ(std::string(request.begin(), request.end()), firstWrite);
+        connection.write("pong");
+        const auto response = client.read(4);
+        EXPECT_EQ(std::string(response.begin(), response.end()), "pong");
+        return earlyAvailable;
+    }
+public:
+    TlsContextTest() {
+        startServer(false);
+    }
+};
+
+TEST_F(TlsContextTest, resumesSessions) {
+    auto clientCtx = std::make_shared<TlsContext>();
+    for (auto i = 0; i < 5; ++i)
+        exchange(clientCtx);
+
+    const auto clientStats = clientCtx->stats();
+    ASSERT_EQ(clientStats.handshakes, 5);
+    ASSERT_EQ(clientStats.resumed, 4);
+    ASSERT_DOUBLE_EQ(clientStats.hit_rate(), 0.8);
+
+    const auto serverStats = serverCtx->stats();
+    ASSERT_EQ(serverStats.handshakes, 5);
+    ASSERT_EQ(serverStats.resumed, 4);
+}
+
+TEST_F(TlsContextTest, clearSessions) {
+    auto clientCtx = std::make_shared<TlsContext>();
+    exchange(clientCtx);
+    exchange(clientCtx);
+    ASSERT_EQ(clientCtx->stats().resumed, 1);
+
+    clientCtx->clear_sessions();
+    exchange(clientCtx);
+    ASSERT_EQ(clientCtx->stats().resumed, 1);
+    exchange(clientCtx);
+    ASSERT_EQ(clientCtx->stats().resumed, 2);
+}
+
+TEST_F(TlsContextTest, sessionsKeyedByAddress) {
+    auto clientCtx = std::make_shared<TlsContext>();
+    exchange(clientCtx);
+    startServer(false);
+    // the session of the old server doesn't belong to the new one
+    exchange(clientCtx);
+    exchange(clientCtx);
+
+    ASSERT_EQ(clientCtx->stats().handshakes, 3);
+    ASSERT_EQ(clientCtx->stats().resumed, 1);
+}
+
+TEST_F(TlsContextTest, noStats) {
+    const TlsContext ctx;
+    ASSERT_FALSE(ctx.is_server());
+    ASSERT_FALSE(ctx.early_data());
+    ASSERT_EQ(ctx.stats().handshakes, 0);
+    ASSERT_DOUBLE_EQ(ctx.stats().hit_rate(), 0.0);
+    ASSERT_TRUE(serverCtx->is_server());
+}
+
+TEST_F(TlsContextTest, earlyData) {
+    startServer(true);
+    auto clientCtx = std::make_shared<TlsContext>(true);
+    const std::string request = "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n";
+
+    // nothing to resume, so the request is sent after the handshake
+    ASSERT_EQ(exchange(clientCtx, request), 0);
+    // the request is received with the handshake
+    ASSERT_EQ(exchange(clientCtx, request), request.size());
+    ASSERT_EQ(exchange(clientCtx, request), request.size());
+    ASSERT_EQ(serverCtx->stats().resumed, 2);
+}
+
+TEST_F(TlsContextTest, earlyDataDisabledByServer) {
+    auto clientCtx = std::make_shared<TlsContext>(true);
+    exchange(clientCtx);
+    // resumes the session but writes the data normally
+    ASSERT_EQ(exchange(clientCtx), 0);
+    ASSERT_EQ(clientCtx->stats().resumed, 1);
+}
+
+TEST_F(TlsContextTest, defaultContextResumes) {
+    for (auto i = 0; i < 3; ++i) {
+        auto fut = std::async(std::launch::async, [this]() {
+            return server->accept();
+            });
+        SSLSocket client(Address("127.0.0.1", port));
+        auto connection = fut.get();
+        connection.write("pong");
+        ASSERT_EQ(client.read(4).size(), 4);
+    }
+    ASSERT_EQ(serverCtx->stats().handshakes, 3);
+    ASSERT_EQ(serverCtx->stats().resumed, 2);
+}
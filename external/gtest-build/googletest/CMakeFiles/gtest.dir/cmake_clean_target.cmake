@@ -0,0 +1,3 @@
+file(REMOVE_RECURSE
+  "/root/repo/_rel_build/lib/libgtest.a"
+)